@@ -0,0 +1,72 @@
+#!/usr/bin/env python
+
+#
+# LSST Data Management System
+# Copyright 2008-2017 LSST/AURA.
+#
+# This product includes software developed by the
+# LSST Project (http://www.lsst.org/).
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the LSST License Statement and
+# the GNU General Public License along with this program.  If not,
+# see <http://www.lsstcorp.org/LegalNotices/>.
+#
+
+"""Calibrate a CModelCostModel from the recorded CModel times (and iteration counts) in one or more
+source catalogs.
+
+The catalogs must have been measured with doRecordTime=True for all stages (and doRecordHistory=True,
+if the iteration counts should be calibrated too).  The result can be read with
+CModelCostModel.readFits and passed to CModelAlgorithm.predictCost.
+"""
+
+import argparse
+
+import numpy
+
+import lsst.afw.table
+import lsst.meas.modelfit
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("output", help="FITS file to write the calibrated cost model to")
+    parser.add_argument("catalogs", nargs="+", help="SourceCatalog FITS files with CModel outputs")
+    parser.add_argument("--config", default=None,
+                        help="CModelConfig override file matching the one used to measure the catalogs")
+    parser.add_argument("--name", default="modelfit_CModel", help="field name prefix of CModel outputs")
+    parser.add_argument("--shape", default="base_SdssShape", help="field name prefix of source moments")
+    parser.add_argument("--kron-radius", default="ext_photometryKron_KronFlux_radius",
+                        help="Kron radius field name (empty to ignore)")
+    parser.add_argument("--flux", default="base_PsfFlux",
+                        help="field name prefix of the flux used to estimate S/N (empty to ignore)")
+    args = parser.parse_args()
+    config = lsst.meas.modelfit.CModelConfig()
+    if args.config is not None:
+        config.load(args.config)
+    algorithm = lsst.meas.modelfit.CModelAlgorithm(config.makeControl())
+    catalogs = (lsst.afw.table.SourceCatalog.readFits(filename) for filename in args.catalogs)
+    features, iterationFeatures, times, iterations = lsst.meas.modelfit.makeCModelCostTrainingSet(
+        algorithm, catalogs, name=args.name, shapeName=args.shape,
+        kronRadiusName=(args.kron_radius or None), fluxName=(args.flux or None)
+    )
+    print("Calibrating on %d sources" % len(times))
+    costModel = lsst.meas.modelfit.calibrateCModelCostModel(features, iterationFeatures, times, iterations)
+    predicted = numpy.array([costModel.predictTime(f) for f in features])
+    print("Total recorded time: %g s; total predicted time: %g s" % (times.sum(), predicted.sum()))
+    print("Correlation between recorded and predicted times: %g" % numpy.corrcoef(times, predicted)[0, 1])
+    costModel.writeFits(args.output)
+
+
+if __name__ == "__main__":
+    main()
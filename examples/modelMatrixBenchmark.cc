@@ -0,0 +1,114 @@
+// -*- lsst-c++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2008-2017 LSST/AURA.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+
+// Compare the throughput of the model matrix products used in fitting (model image and Gram matrix)
+// for a packed matrix with Eigen's double-precision temporaries, as the optimizer and CModel used to
+// compute them, and for a ModelMatrix with multiplyModelMatrix and addModelMatrixGram.
+//
+// Usage: modelMatrixBenchmark [number of pixels] [number of amplitudes] [repetitions]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+
+#include "ndarray/eigen.h"
+
+#include "lsst/meas/modelfit/ModelMatrix.h"
+
+namespace modelfit = lsst::meas::modelfit;
+
+namespace {
+
+// Return the time per matrix element in nanoseconds, taking the best of several repetitions.
+double timeFunction(std::function<void()> const & function, int nElements, int nRep) {
+    double best = HUGE_VAL;
+    for (int rep = 0; rep < nRep; ++rep) {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best * 1E9 / nElements;
+}
+
+} // anonymous
+
+int main(int argc, char ** argv) {
+    int nPix = (argc > 1) ? std::atoi(argv[1]) : 100001;
+    int nAmp = (argc > 2) ? std::atoi(argv[2]) : 2;
+    int nRep = (argc > 3) ? std::atoi(argv[3]) : 20;
+    std::mt19937_64 rng(500);
+    std::normal_distribution<modelfit::Pixel> noise;
+
+    ndarray::Array<modelfit::Pixel,2,-1> packed = ndarray::allocate(nPix, nAmp);
+    modelfit::ModelMatrix aligned(nPix, nAmp);
+    ndarray::Array<modelfit::Pixel,2,-1> alignedArray = aligned.getArray();
+    for (int i = 0; i < nPix; ++i) {
+        for (int k = 0; k < nAmp; ++k) {
+            packed[i][k] = alignedArray[i][k] = noise(rng);
+        }
+    }
+    ndarray::Array<modelfit::Scalar,1,1> amplitudes = ndarray::allocate(nAmp);
+    amplitudes.deep() = 1.5;
+    ndarray::Array<modelfit::Scalar,1,1> image = ndarray::allocate(nPix);
+    modelfit::Matrix hessian(nAmp, nAmp);
+    int const nElements = nPix*nAmp;
+    std::printf("%d pixels, %d amplitudes (ns/element)\n", nPix, nAmp);
+
+    double eigenImage = timeFunction(
+        [&]() {
+            ndarray::asEigenMatrix(image) = ndarray::asEigenMatrix(packed).cast<modelfit::Scalar>()
+                * ndarray::asEigenMatrix(amplitudes);
+        },
+        nElements, nRep
+    );
+    double alignedImage = timeFunction(
+        [&]() { modelfit::multiplyModelMatrix(alignedArray, amplitudes, image); },
+        nElements, nRep
+    );
+    std::printf("  model image:  packed+cast %8.3f  aligned %8.3f\n", eigenImage, alignedImage);
+
+    double eigenGram = timeFunction(
+        [&]() {
+            hessian.setZero();
+            hessian.selfadjointView<Eigen::Lower>().rankUpdate(
+                ndarray::asEigenMatrix(packed).adjoint().cast<modelfit::Scalar>()
+            );
+        },
+        nElements, nRep
+    );
+    double alignedGram = timeFunction(
+        [&]() {
+            hessian.setZero();
+            modelfit::addModelMatrixGram(alignedArray, hessian);
+        },
+        nElements, nRep
+    );
+    std::printf("  Gram matrix:  packed+cast %8.3f  aligned %8.3f\n", eigenGram, alignedGram);
+    return 0;
+}
@@ -0,0 +1,59 @@
+#!/usr/bin/env python
+
+#
+# LSST Data Management System
+# Copyright 2008-2017 LSST/AURA.
+#
+# This product includes software developed by the
+# LSST Project (http://www.lsst.org/).
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the LSST License Statement and
+# the GNU General Public License along with this program.  If not,
+# see <http://www.lsstcorp.org/LegalNotices/>.
+#
+
+"""Train a CModelInitializer from CModel outputs in one or more source catalogs.
+
+The result can be used by setting CModelConfig.initializerSource='FILE' and initializerName to the
+absolute path of the output file (or to its name without extension, if it's copied to
+$MEAS_MODELFIT_DIR/data).
+"""
+
+import argparse
+
+import lsst.afw.table
+import lsst.meas.modelfit
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("output", help="FITS file to write the trained initializer to")
+    parser.add_argument("catalogs", nargs="+", help="SourceCatalog FITS files with CModel outputs")
+    parser.add_argument("--name", default="modelfit_CModel", help="field name prefix of CModel outputs")
+    parser.add_argument("--shape", default="base_SdssShape", help="field name prefix of source moments")
+    parser.add_argument("--psf-shape", default="base_SdssShape_psf", help="field name prefix of PSF moments")
+    parser.add_argument("--kron-radius", default="ext_photometryKron_KronFlux_radius",
+                        help="Kron radius field name (empty to ignore)")
+    args = parser.parse_args()
+    catalogs = (lsst.afw.table.SourceCatalog.readFits(filename) for filename in args.catalogs)
+    features, targets = lsst.meas.modelfit.makeCModelInitializerTrainingSet(
+        catalogs, name=args.name, shapeName=args.shape, psfShapeName=args.psf_shape,
+        kronRadiusName=(args.kron_radius or None)
+    )
+    print("Training on %d sources" % len(features))
+    initializer = lsst.meas.modelfit.trainCModelInitializer(features, targets)
+    initializer.writeFits(args.output)
+
+
+if __name__ == "__main__":
+    main()
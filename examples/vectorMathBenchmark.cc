@@ -0,0 +1,110 @@
+// -*- lsst-c++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2008-2017 LSST/AURA.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+// Compare the accuracy and throughput of the vectorized math functions in each available backend
+// to the standard library (libm) implementations.
+//
+// Usage: vectorMathBenchmark [number of elements] [repetitions]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "lsst/meas/modelfit/vectorMath.h"
+
+namespace modelfit = lsst::meas::modelfit;
+
+namespace {
+
+typedef void (*Function)(modelfit::Scalar const *, modelfit::Scalar *, std::size_t);
+
+// Return the time per element in nanoseconds, taking the best of several repetitions.
+double timeFunction(Function function, std::vector<double> const & x, std::vector<double> & out, int nRep) {
+    double best = HUGE_VAL;
+    for (int rep = 0; rep < nRep; ++rep) {
+        auto start = std::chrono::steady_clock::now();
+        function(x.data(), out.data(), x.size());
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best * 1E9 / x.size();
+}
+
+// Return the maximum relative difference from a reference, ignoring references below minimum.
+double computeMaxError(std::vector<double> const & out, std::vector<double> const & reference,
+                       double minimum) {
+    double maxError = 0.0;
+    for (std::size_t i = 0; i < out.size(); ++i) {
+        if (reference[i] >= minimum) {
+            maxError = std::max(maxError, std::abs(out[i] - reference[i]) / reference[i]);
+        }
+    }
+    return maxError;
+}
+
+void benchmark(char const * name, Function function, double (*libm)(double),
+               std::vector<double> const & x, int nRep) {
+    std::vector<double> reference(x.size());
+    std::vector<double> out(x.size());
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < x.size(); ++i) {
+        reference[i] = libm(x[i]);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::printf("%s (libm: %.2f ns/element)\n", name, elapsed.count() * 1E9 / x.size());
+    for (std::string const & backend : modelfit::detail::getVectorMathBackends()) {
+        modelfit::detail::setVectorMathBackend(backend);
+        double time = timeFunction(function, x, out, nRep);
+        double error = computeMaxError(out, reference, 1E-300);
+        std::printf("  %-8s %8.2f ns/element  max relative error %.3g\n", backend.c_str(), time, error);
+    }
+}
+
+} // anonymous
+
+int main(int argc, char ** argv) {
+    std::size_t n = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    int nRep = (argc > 2) ? std::atoi(argv[2]) : 10;
+    std::string defaultBackend = modelfit::detail::getVectorMathBackend();
+    std::printf("default backend: %s\n", defaultBackend.c_str());
+    std::mt19937_64 rng(500);
+    std::vector<double> x(n);
+    // Arguments typical of Gaussian profiles, -r^2/2 for r up to ~20 sigma.
+    std::uniform_real_distribution<double> expArgs(-200.0, 0.0);
+    for (double & v : x) {
+        v = expArgs(rng);
+    }
+    benchmark("exp", &modelfit::detail::vectorExp, &std::exp, x, nRep);
+    std::uniform_real_distribution<double> erfcArgs(-6.0, 26.0);
+    for (double & v : x) {
+        v = erfcArgs(rng);
+    }
+    benchmark("erfc", &modelfit::detail::vectorErfc, &std::erfc, x, nRep);
+    modelfit::detail::setVectorMathBackend(defaultBackend);
+    return 0;
+}
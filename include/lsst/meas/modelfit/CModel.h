@@ -25,7 +25,10 @@
 #define LSST_MEAS_MODELFIT_CModelFit_h_INCLUDED
 
 #include <bitset>
+#include <limits>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "ndarray.h"
 
@@ -42,6 +45,9 @@
 #include "lsst/meas/modelfit/UnitTransformedLikelihood.h"
 #include "lsst/meas/modelfit/optimizer.h"
 #include "lsst/meas/modelfit/PixelFitRegion.h"
+#include "lsst/meas/modelfit/CModelInitializer.h"
+#include "lsst/meas/modelfit/CModelCostModel.h"
+#include "lsst/meas/modelfit/CModelResultCache.h"
 
 namespace lsst { namespace meas { namespace modelfit {
 
@@ -131,8 +137,9 @@ namespace lsst { namespace meas { namespace modelfit {
  *      have the master implementation class (CModelAlgorithm::Impl) and a class for the nonlinear
  *      fitting stages (CModelStageImpl).
  *  In addition to these categories, we also have the @ref CModelAlgorithm class, which is the C++ public
- *  interface to all of this, and the CModelStageData class, a private class that aggregates per-source
- *  state and makes it easier to pass it around.
+ *  interface to all of this, the CModelStageData class, a private class that aggregates per-source
+ *  state and makes it easier to pass it around, and the @ref CModelWorkspace class, which holds scratch
+ *  memory that can be reused across sources.
  */
 
 /**
@@ -150,7 +157,14 @@ struct CModelStageControl {
         usePixelWeights(false),
         weightsMultiplier(1.0),
         doRecordHistory(true),
-        doRecordTime(true)
+        doRecordTime(true),
+        doAdaptiveConvergence(false),
+        adaptiveReferenceSnr(100.0),
+        adaptiveMaxScale(10.0),
+        adaptiveMinOuterIterations(20),
+        parallelMinPixels(0),
+        parallelThreads(1),
+        fftMode("NEVER")
     {}
 
     shapelet::RadialProfile const & getProfile() const {
@@ -161,6 +175,19 @@ struct CModelStageControl {
 
     PTR(Prior) getPrior() const;
 
+    /**
+     *  Return the optimizer configuration to use for a source with the given signal-to-noise ratio.
+     *
+     *  If doAdaptiveConvergence is false or snr is not positive, this is just a copy of the optimizer
+     *  field.  Otherwise the gradient and trust radius thresholds are multiplied by
+     *  adaptiveReferenceSnr/snr, and maxOuterIterations divided by it (but not below
+     *  adaptiveMinOuterIterations), with the factor clipped to [1, adaptiveMaxScale].
+     */
+    OptimizerControl getOptimizerControl(Scalar snr) const;
+
+    /// Return the likelihood configuration for this stage, with the weights scaled by weightsScale.
+    UnitTransformedLikelihoodControl getLikelihoodControl(Scalar weightsScale=1.0) const;
+
     LSST_CONTROL_FIELD(
         profileName, std::string,
         "Name of the shapelet.RadialProfile that defines the model to fit"
@@ -224,6 +251,47 @@ struct CModelStageControl {
         "Whether to record the time spent in this stage"
     );
 
+    LSST_CONTROL_FIELD(
+        doAdaptiveConvergence, bool,
+        "Whether to loosen the optimizer's convergence thresholds and iteration limit for sources with "
+        "signal-to-noise ratio below adaptiveReferenceSnr (the thresholds used are recorded in the output)"
+    );
+
+    LSST_CONTROL_FIELD(
+        adaptiveReferenceSnr, double,
+        "Signal-to-noise ratio at and above which the optimizer configuration is used as-is, if "
+        "doAdaptiveConvergence is true; fainter sources have their thresholds scaled by "
+        "adaptiveReferenceSnr/SNR"
+    );
+
+    LSST_CONTROL_FIELD(
+        adaptiveMaxScale, double,
+        "Maximum factor by which the optimizer thresholds may be loosened, if doAdaptiveConvergence is true"
+    );
+
+    LSST_CONTROL_FIELD(
+        adaptiveMinOuterIterations, int,
+        "Minimum number of optimizer iterations allowed after scaling, if doAdaptiveConvergence is true"
+    );
+
+    LSST_CONTROL_FIELD(
+        parallelMinPixels, int,
+        "Minimum number of pixels in a fit region for which the model is evaluated on several threads "
+        "(see UnitTransformedLikelihoodControl); 0 to always use one thread"
+    );
+
+    LSST_CONTROL_FIELD(
+        parallelThreads, int,
+        "Number of threads used for fit regions with at least parallelMinPixels pixels; 0 to use one "
+        "per hardware thread.  Leave at 1 when sources are already measured in parallel"
+    );
+
+    LSST_CONTROL_FIELD(
+        fftMode, std::string,
+        "When to evaluate models by FFT convolution with the PSF instead of directly: 'NEVER', 'AUTO' "
+        "(when cheaper, for large fit regions), or 'ALWAYS' (see UnitTransformedLikelihoodControl)"
+    );
+
 };
 
 /**
@@ -235,7 +303,21 @@ struct CModelControl {
     CModelControl() :
         psfName("modelfit_DoubleShapeletPsfApprox"),
         minInitialRadius(0.1),
-        fallbackInitialMomentsPsfFactor(1.5)
+        fallbackInitialMomentsPsfFactor(1.5),
+        maxTime(0.0),
+        initializerSource("MOMENTS"),
+        initializerName(),
+        warmStartSkipInitial(false),
+        coarseBinFactor(1),
+        coarseMinArea(10000),
+        coarseOnlyForMaxArea(false),
+        subsampleFraction(1.0),
+        subsampleMinArea(10000),
+        subsampleMaxIterations(20),
+        groupMaxSize(10),
+        raiseMeasurementErrors(true),
+        resultCacheName(),
+        resultCacheCapacity(65536)
     {
         initial.nComponents = 3; // use very rough model in initial fit
         initial.optimizer.gradientThreshold = 1E-3; // with slightly coarser convergence criteria
@@ -246,6 +328,9 @@ struct CModelControl {
         exp.optimizer.maxOuterIterations = 250;
     }
 
+    /// Return the initializer specified by initializerSource and initializerName, or null for 'MOMENTS'.
+    PTR(CModelInitializer) getInitializer() const;
+
     LSST_CONTROL_FIELD(
         psfName,
         std::string,
@@ -285,6 +370,107 @@ struct CModelControl {
         "  If <= 0.0, abort the fit early instead."
     );
 
+    LSST_CONTROL_FIELD(
+        maxTime, double,
+        "Maximum wall-clock time (in seconds) for all nonlinear fits of a single source.  Stages that "
+        "run out of time keep the best parameters found so far and set the maxTime flag (which implies "
+        "failure), but later stages still start from them and run with whatever remains of the budget "
+        "(usually setting maxTime as well); the exp+dev combination is then computed but flagged as "
+        "failed.  In applyGroup, the joint fits of each group get one such budget, and an unconverged "
+        "joint fit leaves the members' independent fits in place.  Per-stage limits can be set via "
+        "optimizer.maxTime.  If <= 0.0, there is no limit."
+    );
+
+    LSST_CONTROL_FIELD(
+        initializerSource, std::string,
+        "One of 'MOMENTS' or 'FILE', indicating whether the starting ellipses for the nonlinear fits "
+        "should come from PSF-deconvolved moments alone, or from a trained CModelInitializer loaded "
+        "from disk (which predicts the initial, exp, and dev radii from the moments, PSF, Kron radius, "
+        "and signal-to-noise ratio)."
+    );
+
+    LSST_CONTROL_FIELD(
+        initializerName, std::string,
+        "Name of the persisted CModelInitializer (a filename in $MEAS_MODELFIT_DIR/data with no "
+        "extension, or an absolute path to a FITS file), if initializerSource='FILE'.  Ignored for "
+        "forced fitting."
+    );
+
+    LSST_CONTROL_FIELD(
+        warmStartSkipInitial, bool,
+        "When warm-starting from a reference fit (applyWarmStart, measureWarmStart), only fit the "
+        "amplitude of the initial stage, keeping the reference ellipse, instead of redoing its "
+        "nonlinear fit."
+    );
+
+    LSST_CONTROL_FIELD(
+        coarseBinFactor, int,
+        "If > 1, start each nonlinear fit whose region has at least coarseMinArea pixels with a fit to "
+        "the region binned by this factor in each dimension (with the PSF rescaled to match), then refine "
+        "at full resolution from the coarse optimum.  Not used by applyMultiEpoch."
+    );
+
+    LSST_CONTROL_FIELD(
+        coarseMinArea, int,
+        "Minimum number of pixels in a fit region for the coarse pass (see coarseBinFactor)."
+    );
+
+    LSST_CONTROL_FIELD(
+        coarseOnlyForMaxArea, bool,
+        "If the fit region has more than region.maxArea pixels and coarseBinFactor > 1, skip the "
+        "full-resolution nonlinear fits, and only solve for the amplitudes at full resolution using "
+        "the ellipses from the coarse fits."
+    );
+
+    LSST_CONTROL_FIELD(
+        subsampleFraction, double,
+        "If < 1, start each nonlinear fit whose region has at least subsampleMinArea pixels with fits to "
+        "a deterministic, stratified random subset of about this fraction of the region's pixels "
+        "(reweighted so the objective is unbiased), doubling the fraction after each pass, then refine "
+        "(and compute fluxes and errors) using all pixels.  Not used by applyMultiEpoch."
+    );
+
+    LSST_CONTROL_FIELD(
+        subsampleMinArea, int,
+        "Minimum number of pixels in a fit region for the subsampled passes (see subsampleFraction)."
+    );
+
+    LSST_CONTROL_FIELD(
+        subsampleMaxIterations, int,
+        "Maximum number of optimizer outer iterations in each subsampled pass (see subsampleFraction); "
+        "a pass that reaches it still provides the starting point for the next."
+    );
+
+    LSST_CONTROL_FIELD(
+        groupMaxSize, int,
+        "Maximum number of sources with overlapping fit regions that applyGroup fits jointly; sources "
+        "in larger groups keep their independent fits."
+    );
+
+    LSST_CONTROL_FIELD(
+        raiseMeasurementErrors, bool,
+        "If false, report expected failures (a singular shapelet PSF approximation, a missing shape, or "
+        "a numerical error in the final linear fit) only via the flags of the result or record, instead "
+        "of by throwing MeasurementError, and flag (and log) unflagged NaNs instead of raising.  Only "
+        "genuinely fatal errors (e.g. invalid inputs or configuration) are thrown.  Useful in crowded or "
+        "bad-seeing fields, where failures are common."
+    );
+
+    LSST_CONTROL_FIELD(
+        resultCacheName, std::string,
+        "Name of a file in which to cache the results of non-forced fits, keyed on a hash of the fit "
+        "region pixels, variance and mask, the shapelet PSF approximation, the source inputs, and this "
+        "configuration (see CModelResultCache).  Sources whose inputs have not changed are not refit "
+        "when measurement is rerun.  Disabled if empty.  Warm-started fits, fits that hit maxTime, and "
+        "fits with any stage's doRecordHistory set (the default) are never cached, as the cache doesn't "
+        "hold optimizer histories."
+    );
+
+    LSST_CONTROL_FIELD(
+        resultCacheCapacity, int,
+        "Number of results the file named by resultCacheName holds, if it is created."
+    );
+
 };
 
 /**
@@ -303,6 +489,9 @@ struct CModelStageResult {
                          ///  Result will be unusable; implies FAILED.
         BAD_REFERENCE,   ///< Reference fit failed, so forced fit will fail as well.
         NO_FLUX,         ///< No flux was measured.
+        MAX_TIME,        ///< The optimizer ran out of time (per-stage or per-source); the best
+                         ///  parameters found so far are reported, and later stages still run
+                         ///  (implies FAILED).
         N_FLAGS          ///< Non-flag counter to indicate the number of flags
     };
 
@@ -317,6 +506,11 @@ struct CModelStageResult {
     Scalar instFluxInner;    ///< Flux measured strictly within the fit region (no extrapolation).
     Scalar objective;    ///< Value of the objective function at the best fit point: chisq/2 - ln(prior)
     Scalar time;         ///< Time spent in this fit in seconds.
+    Scalar gradientThreshold;        ///< Optimizer gradient threshold used in this fit.
+    Scalar minTrustRadiusThreshold;  ///< Optimizer trust radius threshold used in this fit.
+    int maxOuterIterations;          ///< Optimizer iteration limit used in this fit.
+    int nIter;                       ///< Number of optimizer iterations, if history was recorded,
+                                     ///  including any coarse or subsampled passes.
     afw::geom::ellipses::Quadrupole ellipse;  ///< Best fit half-light ellipse in pixel coordinates
 
     ndarray::Array<Scalar const,1,1> nonlinear;  ///< Opaque nonlinear parameters in specialized units
@@ -357,6 +551,10 @@ struct CModelResult {
         BAD_CENTROID,            ///< Input centroid did not land within the fit region.
         BAD_REFERENCE,           ///< Reference fit failed, so forced fit will fail as well.
         NO_FLUX,                 ///< No flux was measured.
+        REGION_COARSE_ONLY,      ///< The fit region was larger than region.maxArea, so the nonlinear fits
+                                 ///  were only done on binned pixels (see coarseOnlyForMaxArea).
+        GROUP_FIT,               ///< The exp, dev, and linear fits were done jointly with overlapping
+                                 ///  neighbors (see CModelAlgorithm::applyGroup).
         N_FLAGS                  ///< Non-flag counter to indicate the number of flags
     };
 
@@ -368,6 +566,9 @@ struct CModelResult {
     Scalar fracDev;    ///< Fraction of flux from the final linear fit in the de Vaucouleur component
                        ///  (always between 0 and 1).
     Scalar objective;  ///< Objective value at the best-fit point (chisq/2)
+    Scalar snr;        ///< Signal-to-noise estimate used to tune the fits: the approximate flux divided
+                       ///  by the root of the summed variance in the initial fit region (NaN in forced
+                       ///  mode).
 
     CModelStageResult initial; ///< Results from the initial approximate nonlinear fit that feeds the others
     CModelStageResult exp;     ///< Results from the exponential (Sersic n=1) fit
@@ -380,6 +581,47 @@ struct CModelResult {
     std::bitset<N_FLAGS> flags; ///< Array of flags.
 };
 
+/**
+ *  Reusable buffers for the parameter vectors and model matrices of CModelAlgorithm fits.
+ *
+ *  Passing the same workspace to many calls to CModelAlgorithm::apply() or applyForced() lets the
+ *  algorithm reuse the memory for its parameter vectors and model matrices from one source to the
+ *  next instead of allocating it anew for each; its buffers only ever grow, so once they are large
+ *  enough for the biggest fit region seen, they are not reallocated.  Arrays in the returned Results
+ *  never refer to workspace memory, so they remain valid after the workspace is reused.  Overloads
+ *  that don't take a workspace (and the measure() methods used by the plugins) borrow one from a
+ *  pool held by the CModelAlgorithm, so they get the same reuse.
+ *
+ *  Only the parameter vectors and the pixel-sized model matrix, data, and variance buffers come from
+ *  the workspace.  The optimizer's internal state and iteration history, the likelihood objects, the
+ *  Footprints of the fit regions, and the arrays copied into the Results are still allocated for each
+ *  source.  Fitting a source is therefore not allocation-free, and getGrowCount() only counts the
+ *  workspace's own buffers, not allocations made anywhere else.
+ *
+ *  A workspace must not be used by more than one thread at a time; callers that measure in parallel
+ *  should keep one per thread.
+ */
+class CModelWorkspace {
+public:
+
+    CModelWorkspace();
+
+    CModelWorkspace(CModelWorkspace const &) = delete;
+    CModelWorkspace & operator=(CModelWorkspace const &) = delete;
+
+    ~CModelWorkspace();
+
+    /// Return the number of times any of the workspace's buffers has had to be (re)allocated.
+    int getGrowCount() const;
+
+    class Impl; // opaque; defined in CModel.cc
+
+private:
+    friend class CModelAlgorithm;
+
+    std::unique_ptr<Impl> _impl;
+};
+
 /**
  *  Main public interface class for CModel algorithm.
  *
@@ -387,6 +629,10 @@ struct CModelResult {
  *
  *  This class provides the methods that actually execute the algorithm, and (depending on how it is
  *  constructed) holds the Key objects necessary to use SourceRecords for input and output.
+ *
+ *  Expected failures are reported by throwing meas::base::MeasurementError, unless
+ *  CModelControl::raiseMeasurementErrors is false, in which case every method reports them only via
+ *  the flags of the returned Result (or the output SourceRecord) and returns normally.
  */
 class CModelAlgorithm {
 public:
@@ -445,6 +691,17 @@ public:
     /// Return the control object the algorithm was constructed with.
     Control const & getControl() const { return _ctrl; }
 
+    /// Return the result cache (see CModelControl::resultCacheName), or null if caching is disabled.
+    PTR(CModelResultCache) getResultCache() const;
+
+    /**
+     *  Return the number of buffer (re)allocations made by the workspaces the algorithm keeps for calls
+     *  that aren't given a CModelWorkspace (including measure()).
+     *
+     *  Workspaces that are in use by a concurrent call are not included.
+     */
+    int getWorkspaceGrowCount() const;
+
     /**
      *  Run the CModel algorithm on an image, supplying inputs directly and returning outputs in a Result.
      *
@@ -471,6 +728,145 @@ public:
         int footprintArea=-1
     ) const;
 
+    /**
+     *  Run the CModel algorithm on an image, reusing the given workspace's memory.
+     *
+     *  All other arguments are the same as those of the overload without a workspace.
+     */
+    Result apply(
+        CModelWorkspace & workspace,
+        afw::image::Exposure<Pixel> const & exposure,
+        shapelet::MultiShapeletFunction const & psf,
+        geom::Point2D const & center,
+        afw::geom::ellipses::Quadrupole const & moments,
+        Scalar approxFlux=-1,
+        Scalar kronRadius=-1,
+        int footprintArea=-1
+    ) const;
+
+    /**
+     *  Run the CModel algorithm on an image, starting the nonlinear fits from a previous fit to the
+     *  same source (usually in another band).
+     *
+     *  This does a full nonlinear fit, just like apply(), but the initial, exp, and dev stages start
+     *  from the corresponding reference parameters instead of from the moments.  Those parameters are
+     *  defined in a coordinate system that depends only on the position of the source, so the
+     *  reference may come from an image with a different Wcs and PhotoCalib.  Stages that failed in
+     *  the reference start from the usual guess instead.  If CModelControl::warmStartSkipInitial is
+     *  true, the initial stage only fits an amplitude for the reference ellipse.
+     *
+     *  @param[in]   reference    Result object from a previous, non-forced run of a CModelAlgorithm
+     *                            with the same models.  Only its flags and per-stage nonlinear and
+     *                            fixed parameters are used.
+     *
+     *  All other arguments are the same as those of apply().
+     */
+    Result applyWarmStart(
+        afw::image::Exposure<Pixel> const & exposure,
+        shapelet::MultiShapeletFunction const & psf,
+        geom::Point2D const & center,
+        afw::geom::ellipses::Quadrupole const & moments,
+        Result const & reference,
+        Scalar approxFlux=-1,
+        Scalar kronRadius=-1,
+        int footprintArea=-1
+    ) const;
+
+    /**
+     *  Run the CModel algorithm with a warm start, reusing the given workspace's memory.
+     *
+     *  All other arguments are the same as those of the overload without a workspace.
+     */
+    Result applyWarmStart(
+        CModelWorkspace & workspace,
+        afw::image::Exposure<Pixel> const & exposure,
+        shapelet::MultiShapeletFunction const & psf,
+        geom::Point2D const & center,
+        afw::geom::ellipses::Quadrupole const & moments,
+        Result const & reference,
+        Scalar approxFlux=-1,
+        Scalar kronRadius=-1,
+        int footprintArea=-1
+    ) const;
+
+    /**
+     *  Run the CModel algorithm jointly on several images (epochs) of the same source, supplying inputs
+     *  directly and returning outputs in a Result.
+     *
+     *  All stages are fit simultaneously to the pixels of every epoch, using a single set of model
+     *  parameters defined in the fit coordinate system of the first exposure and each epoch's own PSF
+     *  and Wcs/PhotoCalib transform, so the results are directly comparable to running apply() on a
+     *  coadd with the Wcs and PhotoCalib of the first exposure.  Each epoch gets its own fit region
+     *  (computed by transforming the moments, Kron radius and footprint area to its pixel grid);
+     *  epochs whose fit region is entirely masked are dropped.  Fluxes, ellipses and fit regions in
+     *  the Result are all in the units and pixel coordinates of the first exposure.
+     *
+     *  @param[in]   exposures    Images to measure.  Must all have a valid Psf, Wcs and PhotoCalib.
+     *  @param[in]   psfs         multi-shapelet approximations to the PSF at the position of the
+     *                            source, one for each exposure.
+     *  @param[in]   position     Sky position of the source to be fit.
+     *  @param[in]   moments      Non-PSF-corrected moments of the source in the pixel coordinates of
+     *                            the first exposure, used to initialize the model parameters
+     *  @param[in]   approxFlux   Rough estimate of the flux of the source in the first exposure, used to
+     *                            set the fit coordinate system.  If less than or equal to zero, the sum
+     *                            of the flux within the footprint of the first usable epoch will be used.
+     *  @param[in]   kronRadius   Estimate of the Kron radius in the pixels of the first exposure
+     *                            (optional); see apply().
+     *  @param[in]   footprintArea  Area of the detection Fooptrint in the pixels of the first exposure
+     *                              (optional); see apply().
+     */
+    Result applyMultiEpoch(
+        std::vector<PTR(afw::image::Exposure<Pixel>)> const & exposures,
+        std::vector<shapelet::MultiShapeletFunction> const & psfs,
+        geom::SpherePoint const & position,
+        afw::geom::ellipses::Quadrupole const & moments,
+        Scalar approxFlux=-1,
+        Scalar kronRadius=-1,
+        int footprintArea=-1
+    ) const;
+
+    /**
+     *  Run the CModel algorithm on a group of nearby sources in the same image, fitting sources whose
+     *  fit regions overlap jointly, and returning one Result for each source.
+     *
+     *  Each source is first fit on its own, exactly as with apply().  Sources whose final fit regions
+     *  overlap (directly or through other sources) and whose independent fits succeeded are then
+     *  grouped, and the exp and dev stages of each group (of at most CModelControl::groupMaxSize
+     *  sources) are refit simultaneously to the union of the members' fit regions, starting from the
+     *  independent fits.  Each member's model only covers the pixels of its own fit region, which the
+     *  optimizer exploits when differentiating the residuals and accumulating the Hessian (see
+     *  OptimizerObjective::getResidualBlocks), so the per-pixel cost of a joint fit scales with the
+     *  size of the overlaps rather than the square of the number of members.  The trust-region solve
+     *  and the SR1 update still use the dense Hessian of all members' parameters, which is why groups
+     *  are limited to groupMaxSize members.  Stage fluxes and the final linear fit of each member use
+     *  the image with the other members' best-fit models (weighted by their fracDev from the
+     *  independent fits) subtracted.  Results of members of a joint fit have the GROUP_FIT flag set;
+     *  if the joint fit does not converge, the independent fits are kept.  Optimizer histories are
+     *  not recorded for joint fits.
+     *
+     *  @param[in]   exposure       Image to measure.  Must have a valid Psf, Wcs and PhotoCalib.
+     *  @param[in]   psfs           multi-shapelet approximations to the PSF at the position of each source
+     *  @param[in]   centers        Centroids of the sources to be fit.
+     *  @param[in]   moments        Non-PSF-corrected moments of each source, used to initialize the model
+     *                              parameters.
+     *  @param[in]   approxFluxes   Rough estimates of the flux of each source (see apply()); may be empty.
+     *  @param[in]   kronRadii      Estimates of the Kron radius of each source (see apply()); may be empty.
+     *  @param[in]   footprintAreas Areas of the detection Footprints of each source (see apply()); may be
+     *                              empty.
+     *
+     *  Throws pex::exceptions::LengthError if the sizes of the (non-empty) input vectors differ.
+     *  MeasurementErrors from the independent fit of a source are reported by setting its flags.
+     */
+    std::vector<Result> applyGroup(
+        afw::image::Exposure<Pixel> const & exposure,
+        std::vector<shapelet::MultiShapeletFunction> const & psfs,
+        std::vector<geom::Point2D> const & centers,
+        std::vector<afw::geom::ellipses::Quadrupole> const & moments,
+        std::vector<Scalar> const & approxFluxes=std::vector<Scalar>(),
+        std::vector<Scalar> const & kronRadii=std::vector<Scalar>(),
+        std::vector<int> const & footprintAreas=std::vector<int>()
+    ) const;
+
     /**
      *  Run the CModel algorithm in forced mode on an image, supplying inputs directly and returning
      *  outputs in a Result.
@@ -478,7 +874,9 @@ public:
      *  @param[in]   exposure     Image to measure.  Must have a valid Psf, Wcs and PhotoCalib.
      *  @param[in]   psf          multi-shapelet approximation to the PSF at the position of the source
      *  @param[in]   center       Centroid of the source to be fit.
-     *  @param[in]   reference    Result object from a previous, non-forced run of CModelAlgorithm.
+     *  @param[in]   reference    Result object from a previous, non-forced run of CModelAlgorithm.  The
+     *                            reference image need not have the same Wcs as exposure; the reference
+     *                            fit region is transformed using reference.fitSysToMeasSys.
      *  @param[in]   approxFlux   Rough estimate of the flux of the source, used to set the fit coordinate
      *                            system and ensure internal parameters are of order unity.  If less than
      *                            or equal to zero, the sum of the flux within the footprint will be used.
@@ -491,6 +889,49 @@ public:
         Scalar approxFlux=-1
     ) const;
 
+    /**
+     *  Run the CModel algorithm in forced mode on an image, reusing the given workspace's memory.
+     *
+     *  All other arguments are the same as those of the overload without a workspace.
+     */
+    Result applyForced(
+        CModelWorkspace & workspace,
+        afw::image::Exposure<Pixel> const & exposure,
+        shapelet::MultiShapeletFunction const & psf,
+        geom::Point2D const & center,
+        Result const & reference,
+        Scalar approxFlux=-1
+    ) const;
+
+    /**
+     *  Run the CModel algorithm in forced mode on several images of the same source that share a
+     *  pixel grid (e.g. coadds in different bands), returning one Result for each image.
+     *
+     *  This is equivalent to calling applyForced() once for each image, except that all bands use
+     *  a single fit region (with the union of their bad pixels masked), and the pixel coordinates,
+     *  ellipse transforms and model matrix evaluation are shared between bands.  All bands also
+     *  share the fit coordinate system of the first exposure; each Result's fitSysToMeasSys
+     *  transform and fluxes are nevertheless in the units of its own image.  The likelihood objects
+     *  attached to the per-stage results include the pixels from all bands.
+     *
+     *  @param[in]   exposures    Images to measure.  Must all have a valid Psf and PhotoCalib, and
+     *                            must all have the same Wcs.
+     *  @param[in]   psfs         multi-shapelet approximations to the PSF at the position of the
+     *                            source, one for each exposure.
+     *  @param[in]   center       Centroid of the source to be fit.
+     *  @param[in]   reference    Result object from a previous, non-forced run of CModelAlgorithm.
+     *  @param[in]   approxFlux   Rough estimate of the flux of the source in the first exposure,
+     *                            used to set the fit coordinate system.  If less than or equal to
+     *                            zero, the sum of the flux within the footprint will be used.
+     */
+    std::vector<Result> applyForcedMultiBand(
+        std::vector<PTR(afw::image::Exposure<Pixel>)> const & exposures,
+        std::vector<shapelet::MultiShapeletFunction> const & psfs,
+        geom::Point2D const & center,
+        Result const & reference,
+        Scalar approxFlux=-1
+    ) const;
+
     /**
      *  Run the CModel algorithm on an image, using a SourceRecord for inputs and outputs.
      *
@@ -508,6 +949,45 @@ public:
         afw::image::Exposure<Pixel> const & exposure
     ) const;
 
+    /**
+     *  Run the CModel algorithm on an image with a warm start (see applyWarmStart()), using
+     *  SourceRecords for inputs and outputs.
+     *
+     *  @param[in,out] measRecord  A SourceRecord instance used to provide inputs and receive outputs,
+     *                             as in the non-forced measure().
+     *  @param[in]     exposure    Image to be measured.  Must have a valid Psf, Wcs, and PhotoCalib.
+     *  @param[in]     refRecord   A SourceRecord with the same Schema as measRecord, containing the
+     *                             outputs of a previous run of this algorithm (usually in another band).
+     *
+     *  To run this method, the CModelAlgorithm instance must have been created using the constructor
+     *  that takes a Schema argument, and that Schema must match the Schema of the SourceRecord passed here.
+     */
+    void measureWarmStart(
+        afw::table::SourceRecord & measRecord,
+        afw::image::Exposure<Pixel> const & exposure,
+        afw::table::SourceRecord const & refRecord
+    ) const;
+
+    /**
+     *  Run the CModel algorithm in forced mode on an image, using a SourceRecord for inputs and outputs.
+     *
+     *  @param[in,out] measRecord  A SourceRecord instance used to provide a Footprint, the centroid of
+     *                             the source, a MultiShapeletFunction PSF, and an approximate
+     *                             estimate of the (via the PsfFlux slot), and to which all outputs will
+     *                             be written.
+     *  @param[in]     exposure    Image to be measured.  Must have a valid Psf, Wcs, and PhotoCalib.
+     *  @param[in]     refRecord   A SourceRecord that contains the outputs of a previous non-forced run
+     *                             of CModelAlgorithm on an image with the same Wcs as exposure.
+     *
+     *  To run this method, the CModelAlgorithm instance must have been created using the constructor
+     *  that takes a Schema argument, and that Schema must match the Schema of the SourceRecord passed here.
+     */
+    void measure(
+        afw::table::SourceRecord & measRecord,
+        afw::image::Exposure<Pixel> const & exposure,
+        afw::table::SourceRecord const & refRecord
+    ) const;
+
     /**
      *  Run the CModel algorithm in forced mode on an image, using a SourceRecord for inputs and outputs.
      *
@@ -519,6 +999,9 @@ public:
      *  @param[in]     refRecord   A SourceRecord that contains the outputs of a previous non-forced run
      *                             of CModelAlgorithm (which may have taken place on an image with a
      *                             different Wcs).
+     *  @param[in]     refWcs      Wcs of the image the reference measurement was made on; used to
+     *                             transform the reference fit region to the pixel coordinates of
+     *                             the image being measured.
      *
      *  To run this method, the CModelAlgorithm instance must have been created using the constructor
      *  that takes a Schema argument, and that Schema must match the Schema of the SourceRecord passed here.
@@ -526,9 +1009,41 @@ public:
     void measure(
         afw::table::SourceRecord & measRecord,
         afw::image::Exposure<Pixel> const & exposure,
-        afw::table::SourceRecord const & refRecord
+        afw::table::SourceRecord const & refRecord,
+        std::shared_ptr<afw::geom::SkyWcs const> refWcs
     ) const;
 
+    /**
+     *  Compute the CModelCostModel features for a source from inputs supplied directly, without fitting.
+     *
+     *  The fit region is the initial fit region (before masking), scaled down by the binning factor
+     *  for sources that would only be fit on binned pixels (see coarseOnlyForMaxArea); the work per
+     *  pixel is set by the number of components in each stage's model and the orders of the PSF
+     *  approximation.  Other arguments are as in apply(); snr may be NaN if unknown.
+     */
+    ndarray::Array<Scalar,1,1> computeCostFeatures(
+        shapelet::MultiShapeletFunction const & psf,
+        afw::geom::ellipses::Quadrupole const & moments,
+        Scalar kronRadius=-1,
+        int footprintArea=-1,
+        Scalar snr=std::numeric_limits<Scalar>::quiet_NaN()
+    ) const;
+
+    /**
+     *  Compute the CModelCostModel features for a source, reading the inputs from a SourceRecord as
+     *  measure() does (the shapelet PSF approximation, shape slot, Kron radius and Footprint area), with
+     *  the signal-to-noise ratio taken from the PsfFlux slot.
+     *
+     *  Sources measure() would reject before fitting (e.g. those with no usable shape) get a zero-area
+     *  fit region.
+     */
+    ndarray::Array<Scalar,1,1> computeCostFeatures(afw::table::SourceRecord const & record) const;
+
+    /// Return the cost of measuring a source predicted by the given model (see computeCostFeatures).
+    Scalar predictCost(CModelCostModel const & costModel, afw::table::SourceRecord const & record) const {
+        return costModel.predictTime(computeCostFeatures(record));
+    }
+
     /**
      *  Handle an exception thrown by one of the measure() methods, setting the appropriate flag in
      *  the given record.
@@ -553,19 +1068,43 @@ private:
     // results to the plugin version when we throw.
     void _applyImpl(
         Result & result,
+        CModelWorkspace::Impl & workspace,
         afw::image::Exposure<Pixel> const & exposure,
         shapelet::MultiShapeletFunction const & psf,
         geom::Point2D const & center,
         afw::geom::ellipses::Quadrupole const & moments,
         Scalar approxFlux,
         Scalar kronRadius=-1,
-        int footprintArea=-1
+        int footprintArea=-1,
+        Result const * reference=nullptr
+    ) const;
+
+    // The fit itself; _applyImpl just looks the result up in (and adds it to) the result cache.
+    void _applyUncachedImpl(
+        Result & result,
+        CModelWorkspace::Impl & workspace,
+        afw::image::Exposure<Pixel> const & exposure,
+        shapelet::MultiShapeletFunction const & psf,
+        geom::Point2D const & center,
+        afw::geom::ellipses::Quadrupole const & moments,
+        Scalar approxFlux,
+        Scalar kronRadius,
+        int footprintArea,
+        Result const * reference
+    ) const;
+
+    // Shared implementation of the non-forced measure() and measureWarmStart().
+    void _measureImpl(
+        afw::table::SourceRecord & measRecord,
+        afw::image::Exposure<Pixel> const & exposure,
+        Result const * reference
     ) const;
 
     // Actual implementations go here; we use an output argument for the result so we can get partial
     // results to the SourceRecord version when we throw.
     void _applyForcedImpl(
         Result & result,
+        CModelWorkspace::Impl & workspace,
         afw::image::Exposure<Pixel> const & exposure,
         shapelet::MultiShapeletFunction const & psf,
         geom::Point2D const & center,
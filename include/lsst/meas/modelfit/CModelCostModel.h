@@ -0,0 +1,112 @@
+// -*- lsst-c++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2008-2017 LSST/AURA.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+#ifndef LSST_MEAS_MODELFIT_CModelCostModel_h_INCLUDED
+#define LSST_MEAS_MODELFIT_CModelCostModel_h_INCLUDED
+
+#include <string>
+
+#include "ndarray.h"
+
+#include "lsst/meas/modelfit/common.h"
+
+namespace lsst { namespace meas { namespace modelfit {
+
+/**
+ *  A cheap predictor for the run time and iteration count of CModel on a single source, for use in
+ *  scheduling and budgeting.
+ *
+ *  The predicted time is a linear function of features computed without fitting (see computeFeatures):
+ *  the number of pixels in the fit region, and that number multiplied by the number of Gaussian-shapelet
+ *  products evaluated per pixel (the "work" per pixel per iteration, set by the model and PSF
+ *  approximation orders), with a term that scales the latter with the log of the signal-to-noise ratio
+ *  to account for the number of optimizer iterations.  The predicted (total, all-stage) number of
+ *  iterations is a linear function of the log of the signal-to-noise ratio alone.
+ *
+ *  The default-constructed model is uncalibrated: it predicts a cost proportional to the number of
+ *  pixel-basis-function evaluations, which is adequate for ordering sources but not for estimating
+ *  wall-clock time.  Calibrated coefficients are fit from catalogs with recorded CModel times and
+ *  iteration counts (see lsst.meas.modelfit.calibrateCModelCostModel) and persisted as a FITS binary
+ *  table.
+ */
+class CModelCostModel {
+public:
+
+    /// Number of features (time coefficients), including the constant term.
+    static int const N_FEATURES = 4;
+
+    /// Number of iteration-count coefficients, including the constant term.
+    static int const N_ITERATION_FEATURES = 2;
+
+    /// Construct an uncalibrated cost model.
+    CModelCostModel();
+
+    /**
+     *  Construct from arrays of N_FEATURES time coefficients and N_ITERATION_FEATURES iteration-count
+     *  coefficients.
+     *
+     *  Throws pex::exceptions::LengthError if either array has the wrong size.
+     */
+    CModelCostModel(
+        ndarray::Array<Scalar const,1,1> const & timeCoefficients,
+        ndarray::Array<Scalar const,1,1> const & iterationCoefficients
+    );
+
+    /// Return the coefficients of the time prediction.
+    ndarray::Array<Scalar const,1,1> getTimeCoefficients() const { return _timeCoefficients; }
+
+    /// Return the coefficients of the iteration-count prediction.
+    ndarray::Array<Scalar const,1,1> getIterationCoefficients() const { return _iterationCoefficients; }
+
+    /**
+     *  Compute the time features for a source.
+     *
+     *  The features are (1, A, A w, A w ln(max(snr, 1))), where A is the number of pixels in the fit
+     *  region and w is the number of Gaussian-shapelet products evaluated per pixel per iteration.  If
+     *  the signal-to-noise ratio is not finite, the last feature is zero.
+     */
+    static ndarray::Array<Scalar,1,1> computeFeatures(Scalar area, Scalar work, Scalar snr);
+
+    /// Compute the iteration-count features, (1, ln(max(snr, 1))), for a source.
+    static ndarray::Array<Scalar,1,1> computeIterationFeatures(Scalar snr);
+
+    /// Return the predicted time (or cost, if uncalibrated) from features; never negative.
+    Scalar predictTime(ndarray::Array<Scalar const,1,1> const & features) const;
+
+    /// Return the predicted total number of optimizer iterations in all stages; never negative.
+    Scalar predictIterations(Scalar snr) const;
+
+    /// Read a cost model from a FITS file written by writeFits.
+    static PTR(CModelCostModel) readFits(std::string const & filename);
+
+    /// Write the cost model to a FITS binary table.
+    void writeFits(std::string const & filename) const;
+
+private:
+    ndarray::Array<Scalar const,1,1> _timeCoefficients;
+    ndarray::Array<Scalar const,1,1> _iterationCoefficients;
+};
+
+}}} // namespace lsst::meas::modelfit
+
+#endif // !LSST_MEAS_MODELFIT_CModelCostModel_h_INCLUDED
@@ -0,0 +1,115 @@
+// -*- lsst-c++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2008-2017 LSST/AURA.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+#ifndef LSST_MEAS_MODELFIT_CModelInitializer_h_INCLUDED
+#define LSST_MEAS_MODELFIT_CModelInitializer_h_INCLUDED
+
+#include <string>
+
+#include "ndarray.h"
+
+#include "lsst/afw/geom/ellipses.h"
+#include "lsst/meas/modelfit/common.h"
+
+namespace lsst { namespace meas { namespace modelfit {
+
+/**
+ *  A learned predictor for the starting ellipses of the CModel nonlinear fits.
+ *
+ *  The predictor is a linear regression of the log half-light radius of each stage's best-fit ellipse
+ *  (in units of the PSF radius) on a small set of scale-free features computed from the source's
+ *  moments, its PSF moments, its Kron radius, and its signal-to-noise ratio (see computeFeatures).
+ *  Ellipticities are not predicted; they are taken from the PSF-deconvolved moments.
+ *
+ *  The coefficients are trained offline from previous CModel catalogs (see
+ *  lsst.meas.modelfit.trainCModelInitializer), and persisted as a FITS binary table with one row per
+ *  stage.
+ */
+class CModelInitializer {
+public:
+
+    /// Stages with separate regression coefficients (rows of the coefficient matrix).
+    enum Stage {
+        INITIAL=0,
+        EXP,
+        DEV,
+        N_STAGES
+    };
+
+    /// Number of features (columns of the coefficient matrix), including the constant term.
+    static int const N_FEATURES = 4;
+
+    /**
+     *  Construct from a (N_STAGES x N_FEATURES) array of coefficients.
+     *
+     *  Throws pex::exceptions::LengthError if the array has the wrong shape.
+     */
+    explicit CModelInitializer(ndarray::Array<Scalar const,2,1> const & coefficients);
+
+    /// Return the (N_STAGES x N_FEATURES) regression coefficients.
+    ndarray::Array<Scalar const,2,1> getCoefficients() const { return _coefficients; }
+
+    /**
+     *  Compute the regression features for a source.
+     *
+     *  The features are (1, ln(r/r_psf), ln(r_kron/r_psf), ln(max(snr, 1))), where r and r_psf are the
+     *  determinant radii of the source and PSF moments.  If the Kron radius is not positive, ln(r/r_psf)
+     *  is used in its place; if the signal-to-noise ratio is not finite, the last feature is zero.
+     */
+    static ndarray::Array<Scalar,1,1> computeFeatures(
+        afw::geom::ellipses::Quadrupole const & moments,
+        afw::geom::ellipses::Quadrupole const & psfMoments,
+        Scalar kronRadius,
+        Scalar snr
+    );
+
+    /// Return the predicted half-light determinant radius of the given stage, in units of the PSF radius.
+    Scalar predictRadiusRatio(Stage stage, ndarray::Array<Scalar const,1,1> const & features) const;
+
+    /**
+     *  Return the predicted half-light ellipse of the given stage, in the same coordinates as the
+     *  moments.
+     *
+     *  The ellipticity is that of the PSF-deconvolved moments, or zero if the deconvolution fails.
+     */
+    afw::geom::ellipses::Quadrupole predict(
+        Stage stage,
+        afw::geom::ellipses::Quadrupole const & moments,
+        afw::geom::ellipses::Quadrupole const & psfMoments,
+        Scalar kronRadius,
+        Scalar snr
+    ) const;
+
+    /// Read an initializer from a FITS file written by writeFits.
+    static PTR(CModelInitializer) readFits(std::string const & filename);
+
+    /// Write the initializer to a FITS binary table.
+    void writeFits(std::string const & filename) const;
+
+private:
+    ndarray::Array<Scalar const,2,1> _coefficients;
+};
+
+}}} // namespace lsst::meas::modelfit
+
+#endif // !LSST_MEAS_MODELFIT_CModelInitializer_h_INCLUDED
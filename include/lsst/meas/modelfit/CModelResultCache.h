@@ -0,0 +1,125 @@
+// -*- lsst-c++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2008-2017 LSST/AURA.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+#ifndef LSST_MEAS_MODELFIT_CModelResultCache_h_INCLUDED
+#define LSST_MEAS_MODELFIT_CModelResultCache_h_INCLUDED
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+
+#include "lsst/meas/modelfit/common.h"
+
+namespace lsst { namespace meas { namespace modelfit {
+
+struct CModelResult;
+
+/**
+ *  A persistent, file-backed cache of CModel results, used to skip sources whose inputs have not
+ *  changed when measurement is rerun.
+ *
+ *  The cache is a fixed-capacity open-addressing hash table in a memory-mapped file, keyed on a 64-bit
+ *  hash of the inputs (computed by CModelAlgorithm; see CModelControl::resultCacheName), with a second
+ *  64-bit check value stored alongside each result that the caller can validate on lookup.  When all
+ *  slots a key may occupy are full, the entry in its home slot is overwritten.
+ *
+ *  Only the numbers CModelAlgorithm writes to records are stored: the Model and Prior pointers of a
+ *  result filled from the cache are left as they were, and its likelihood, objective function, and
+ *  history are empty (though the number of optimizer iterations is restored).  The time of each stage
+ *  is not restored, since no time was spent fitting it: it is NaN in results filled from the cache.
+ *  Parameter vectors longer than MAX_PARAMETERS are not cached.
+ *
+ *  A cache object may be used from several threads, and a cache file may be shared by several
+ *  processes (or cache objects): lookups hold a shared advisory lock (flock) on the file, and
+ *  creation, stores, and clears an exclusive one.  File systems that do not support flock (some
+ *  network file systems) must not be used for caches shared between processes.
+ */
+class CModelResultCache {
+public:
+
+    /// Maximum length of the per-stage parameter vectors that can be cached.
+    static int const MAX_PARAMETERS = 16;
+
+    /**
+     *  Open a cache file, creating it with the given number of slots (rounded up to a power of two)
+     *  if it doesn't exist.  The capacity of an existing file is never changed.
+     *
+     *  Throws pex::exceptions::IoError if the file cannot be opened or mapped, or if it exists and is
+     *  not a compatible cache file.
+     */
+    CModelResultCache(std::string const & filename, int capacity);
+
+    CModelResultCache(CModelResultCache const &) = delete;
+    CModelResultCache & operator=(CModelResultCache const &) = delete;
+
+    ~CModelResultCache();
+
+    /**
+     *  Look up a result.
+     *
+     *  If an entry with the given key exists and the check value stored with it equals the one returned
+     *  by validate (which is passed the stored result), copy the stored result into result and return
+     *  true; otherwise return false, leaving result unchanged.  Updates the hit and miss counts.
+     */
+    bool get(
+        std::uint64_t key,
+        std::function<std::uint64_t(CModelResult const &)> const & validate,
+        CModelResult & result
+    );
+
+    /// Store a result and its check value, replacing any existing entry with the same key.
+    void put(std::uint64_t key, std::uint64_t check, CModelResult const & result);
+
+    /// Remove all entries (but not the hit and miss counts).
+    void clear();
+
+    /// Return the name of the cache file.
+    std::string const & getFilename() const { return _filename; }
+
+    /// Return the number of slots in the cache.
+    std::size_t getCapacity() const { return _capacity; }
+
+    /// Return the number of successful lookups since this object was created.
+    std::size_t getHitCount() const { return _hitCount; }
+
+    /// Return the number of unsuccessful lookups since this object was created.
+    std::size_t getMissCount() const { return _missCount; }
+
+private:
+
+    char * _getSlot(std::uint64_t key, bool forWriting) const;
+
+    std::string _filename;
+    std::size_t _capacity;
+    std::size_t _mappedSize;
+    int _fd;  // kept open for locking
+    char * _data;
+    std::size_t _hitCount;
+    std::size_t _missCount;
+    std::mutex _mutex;
+};
+
+}}} // namespace lsst::meas::modelfit
+
+#endif // !LSST_MEAS_MODELFIT_CModelResultCache_h_INCLUDED
@@ -0,0 +1,130 @@
+// -*- lsst-c++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2008-2017 LSST/AURA.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+
+#ifndef LSST_MEAS_MODELFIT_FlatEllipse_h_INCLUDED
+#define LSST_MEAS_MODELFIT_FlatEllipse_h_INCLUDED
+
+#include <cmath>
+#include <vector>
+
+#include "lsst/geom/AffineTransform.h"
+#include "lsst/afw/geom/ellipses/Ellipse.h"
+#include "lsst/afw/geom/ellipses/Quadrupole.h"
+
+#include "lsst/meas/modelfit/common.h"
+
+namespace lsst { namespace meas { namespace modelfit {
+
+/**
+ *  @brief An ellipse as a plain struct of second moments and center.
+ *
+ *  afw::geom::ellipses::Ellipse holds a polymorphic, heap-allocated core, so every conversion and
+ *  transform goes through virtual calls and temporary objects.  That is convenient in public
+ *  interfaces, but too slow for the inner loops of model evaluation, which instead use arrays of
+ *  FlatEllipses (see Model::writeFlatEllipses) with the conversions and transforms defined inline
+ *  here.
+ */
+struct FlatEllipse {
+    Scalar xx;  ///< second moment in x (Quadrupole::getIxx)
+    Scalar yy;  ///< second moment in y (Quadrupole::getIyy)
+    Scalar xy;  ///< cross moment (Quadrupole::getIxy)
+    Scalar x;   ///< center x
+    Scalar y;   ///< center y
+
+    /**
+     *  @brief Set the moments from the parameters of a SeparableConformalShearLogTraceRadius core.
+     *
+     *  The parameters are (eta1, eta2, ln(r)), where r^2 = (xx + yy)/2 and the conformal shear has
+     *  magnitude ln(a/b); the moments are then r^2 (1 + delta1), r^2 (1 - delta1), and r^2 delta2, with
+     *  distortion delta = eta tanh(|eta|)/|eta|.
+     */
+    void setCore(Scalar const * parameters) {
+        Scalar const eta = std::sqrt(parameters[0]*parameters[0] + parameters[1]*parameters[1]);
+        // tanh(eta)/eta -> 1 - eta^2/3 as eta -> 0; below 1E-4 that is exact to double precision.
+        Scalar const scale = eta < 1E-4 ? 1.0 - eta*eta/3.0 : std::tanh(eta) / eta;
+        Scalar const r2 = std::exp(2.0 * parameters[2]);
+        xx = r2 * (1.0 + scale * parameters[0]);
+        yy = r2 * (1.0 - scale * parameters[0]);
+        xy = r2 * scale * parameters[1];
+    }
+
+    /// Set the moments from an arbitrary ellipse core.
+    void setCore(afw::geom::ellipses::BaseCore const & core) {
+        afw::geom::ellipses::Quadrupole q(core);
+        xx = q.getIxx();
+        yy = q.getIyy();
+        xy = q.getIxy();
+    }
+
+    /// Set the moments and center from an arbitrary ellipse.
+    void setEllipse(afw::geom::ellipses::Ellipse const & ellipse) {
+        setCore(ellipse.getCore());
+        x = ellipse.getCenter().getX();
+        y = ellipse.getCenter().getY();
+    }
+
+    /// Return the ellipse transformed by an affine transform: M' = L M L^T, c' = L c + t.
+    FlatEllipse transform(geom::AffineTransform const & t) const {
+        Scalar const a = t[geom::AffineTransform::XX];
+        Scalar const b = t[geom::AffineTransform::XY];
+        Scalar const c = t[geom::AffineTransform::YX];
+        Scalar const d = t[geom::AffineTransform::YY];
+        return FlatEllipse{
+            a*a*xx + 2.0*a*b*xy + b*b*yy,
+            c*c*xx + 2.0*c*d*xy + d*d*yy,
+            a*c*xx + (a*d + b*c)*xy + b*d*yy,
+            a*x + b*y + t[geom::AffineTransform::X],
+            c*x + d*y + t[geom::AffineTransform::Y]
+        };
+    }
+
+    /**
+     *  @brief Copy the moments and center to an ellipse.
+     *
+     *  This does not allocate or convert when the ellipse has a Quadrupole core.
+     */
+    void writeEllipse(afw::geom::ellipses::Ellipse & ellipse) const {
+        auto * q = dynamic_cast<afw::geom::ellipses::Quadrupole *>(&ellipse.getCore());
+        if (q) {
+            q->setIxx(xx);
+            q->setIyy(yy);
+            q->setIxy(xy);
+        } else {
+            ellipse.setCore(afw::geom::ellipses::Quadrupole(xx, yy, xy));
+        }
+        ellipse.setCenter(geom::Point2D(x, y));
+    }
+
+    bool operator==(FlatEllipse const & other) const {
+        return xx == other.xx && yy == other.yy && xy == other.xy && x == other.x && y == other.y;
+    }
+
+    bool operator!=(FlatEllipse const & other) const { return !(*this == other); }
+};
+
+typedef std::vector<FlatEllipse> FlatEllipseVector;
+
+}}} // namespace lsst::meas::modelfit
+
+#endif // !LSST_MEAS_MODELFIT_FlatEllipse_h_INCLUDED
@@ -0,0 +1,95 @@
+// -*- lsst-c++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2008-2017 LSST/AURA.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+
+#ifndef LSST_MEAS_MODELFIT_FourierTransform_h_INCLUDED
+#define LSST_MEAS_MODELFIT_FourierTransform_h_INCLUDED
+
+#include <complex>
+#include <vector>
+
+#include "ndarray.h"
+
+#include "lsst/meas/modelfit/common.h"
+
+namespace lsst { namespace meas { namespace modelfit { namespace detail {
+
+/**
+ *  @brief A two-dimensional discrete Fourier transform of complex arrays whose dimensions are powers
+ *         of two.
+ *
+ *  This is a plain radix-2 Cooley-Tukey FFT, bundled so that model evaluation does not depend on an
+ *  external FFT library; its twiddle factors and bit-reversal permutations are computed once, on
+ *  construction, so one FourierTransform should be reused for all arrays of the same shape.
+ *
+ *  The forward transform is @f$X_{k,l} = \sum_{m,n} x_{m,n} e^{-2\pi i (km/M + ln/N)}@f$, and the
+ *  inverse transform includes the @f$1/MN@f$ normalization, so inverse(forward(x)) == x up to
+ *  round-off.  Both transform the array in place, and may be called from several threads at once.
+ */
+class FourierTransform {
+public:
+
+    typedef std::complex<Scalar> Complex;
+
+    /// Return the smallest power of two that is at least n.
+    static int computeSize(int n);
+
+    /**
+     *  @brief Construct a transform for (row-major) arrays with the given shape.
+     *
+     *  Throws pex::exceptions::InvalidParameterError if either dimension is not a positive power of two.
+     */
+    FourierTransform(int nRows, int nCols);
+
+    int getRows() const { return _rows.size; }
+    int getCols() const { return _cols.size; }
+
+    /// Replace data with its forward transform; data must have shape (getRows(), getCols()).
+    void forward(ndarray::Array<Complex,2,2> const & data) const { _apply(data, false); }
+
+    /// Replace data with its (normalized) inverse transform; data must have shape (getRows(), getCols()).
+    void inverse(ndarray::Array<Complex,2,2> const & data) const { _apply(data, true); }
+
+private:
+
+    // One-dimensional transform of a fixed size.
+    struct Plan {
+
+        explicit Plan(int size);
+
+        void operator()(Complex * data, bool inverse) const;
+
+        int size;
+        std::vector<int> reversed;     // bit-reversal permutation
+        std::vector<Complex> twiddle;  // exp(-2 pi i k / size) for 0 <= k < size/2
+    };
+
+    void _apply(ndarray::Array<Complex,2,2> const & data, bool inverse) const;
+
+    Plan _rows;  // transforms along each column, of length nRows
+    Plan _cols;  // transforms along each row, of length nCols
+};
+
+}}}} // namespace lsst::meas::modelfit::detail
+
+#endif // !LSST_MEAS_MODELFIT_FourierTransform_h_INCLUDED
@@ -329,6 +329,20 @@ public:
         bool doApplyWeights=true
     ) const override;
 
+    void updateModelMatrix(
+        ndarray::Array<Pixel,2,-1> const & modelMatrix,
+        ndarray::Array<Scalar const,1,1> const & nonlinear,
+        ndarray::Array<Scalar const,1,1> const & previousNonlinear,
+        bool doApplyWeights=true
+    ) const override;
+
+    void computeModelImage(
+        ndarray::Array<Pixel,1,1> const & modelImage,
+        ndarray::Array<Scalar const,1,1> const & nonlinear,
+        ndarray::Array<Scalar const,1,1> const & amplitudes,
+        bool doApplyWeights=true
+    ) const override;
+
     virtual ~MultiShapeletPsfLikelihood();
 
 private:
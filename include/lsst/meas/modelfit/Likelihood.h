@@ -123,6 +123,51 @@ public:
         bool doApplyWeights=true
     ) const = 0;
 
+    /**
+     *  @brief Update a model matrix computed at one vector of nonlinear parameters to another.
+     *
+     *  Each basis of the Model depends only on its own ellipse, so when only some of the ellipses
+     *  differ between the two parameter vectors (as when a single parameter is perturbed to compute
+     *  numerical derivatives), implementations may recompute only the columns of the bases whose
+     *  ellipses changed, reusing the rest.  The default implementation just calls computeModelMatrix.
+     *
+     *  @param[in,out] modelMatrix  On input, the matrix computed by computeModelMatrix (or this
+     *                              method) at previousNonlinear with the same doApplyWeights; on
+     *                              output, the matrix at nonlinear.
+     *  @param[in] nonlinear        Vector of nonlinear parameters at which to evaluate the model.
+     *  @param[in] previousNonlinear   Vector of nonlinear parameters modelMatrix was computed at.
+     *  @param[in] doApplyWeights   If False, do not apply the weights to the modelMatrix.
+     */
+    virtual void updateModelMatrix(
+        ndarray::Array<Pixel,2,-1> const & modelMatrix,
+        ndarray::Array<Scalar const,1,1> const & nonlinear,
+        ndarray::Array<Scalar const,1,1> const & previousNonlinear,
+        bool doApplyWeights=true
+    ) const {
+        computeModelMatrix(modelMatrix, nonlinear, doApplyWeights);
+    }
+
+    /**
+     *  @brief Evaluate the model image @f$B\alpha@f$ for the given nonlinear and amplitude parameters.
+     *
+     *  Implementations should sum the amplitude-weighted basis functions directly at each data point,
+     *  without forming the model matrix; this is much cheaper when only residuals are needed and the
+     *  Model has many amplitudes.  The default implementation computes the model matrix and multiplies
+     *  it by the amplitudes.  Results agree with computeModelMatrix only up to round-off error.
+     *
+     *  @param[out] modelImage      Vector with shape (dataDim) to fill with the model.  Need not be
+     *                              initialized.
+     *  @param[in] nonlinear        Vector of nonlinear parameters at which to evaluate the model.
+     *  @param[in] amplitudes       Vector of amplitudes at which to evaluate the model.
+     *  @param[in] doApplyWeights   If False, do not apply the weights to the model image.
+     */
+    virtual void computeModelImage(
+        ndarray::Array<Pixel,1,1> const & modelImage,
+        ndarray::Array<Scalar const,1,1> const & nonlinear,
+        ndarray::Array<Scalar const,1,1> const & amplitudes,
+        bool doApplyWeights=true
+    ) const;
+
     virtual ~Likelihood() {}
 
     // No copying
@@ -390,6 +390,9 @@ private:
 
     Scalar _evaluate(Scalar z) const;
 
+    // Vectorized version of _evaluate(Scalar) that replaces each element of z with its density.
+    void _evaluate(Vector & z) const;
+
     void _stream(std::ostream & os) const;
 
     bool _isGaussian;
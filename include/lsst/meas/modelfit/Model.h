@@ -30,6 +30,7 @@
 #include "lsst/afw/geom/ellipses/Ellipse.h"
 #include "lsst/shapelet/MultiShapeletBasis.h"
 #include "lsst/meas/modelfit/common.h"
+#include "lsst/meas/modelfit/FlatEllipse.h"
 
 namespace lsst { namespace meas { namespace modelfit {
 
@@ -202,6 +203,34 @@ public:
         Scalar * nonlinearIter, Scalar * fixedIter
     ) const = 0;
 
+    /**
+     *  @brief Convert a set of nonlinear+fixed parameter arrays to flat ellipses.
+     *
+     *  @param[in] nonlinearIter    Pointer to the beginning of a nonlinear parameter array.
+     *  @param[in] fixedIter        Pointer to the beginning of a fixed parameter array.
+     *  @param[out] flatIter        Pointer to the beginning of an array of getBasisCount() FlatEllipses.
+     *
+     *  This computes the same ellipses as writeEllipses(), but the Models created by make() and
+     *  makeGaussian() compute their moments directly from the parameters, without any polymorphic
+     *  ellipse objects; it is intended for evaluating models many times.  Point sources have zero
+     *  moments.  The default implementation calls writeEllipses() and converts the results.
+     */
+    virtual void writeFlatEllipses(
+        Scalar const * nonlinearIter, Scalar const * fixedIter,
+        FlatEllipse * flatIter
+    ) const;
+
+    /**
+     *  @brief Convert a set of nonlinear+fixed parameter arrays to a vector of flat ellipses.
+     *
+     *  @param[in] nonlinear        nonlinear parameter array.
+     *  @param[in] fixed            fixed parameter array.
+     */
+    FlatEllipseVector writeFlatEllipses(
+        ndarray::Array<Scalar const,1,1> const & nonlinear,
+        ndarray::Array<Scalar const,1,1> const & fixed
+    ) const;
+
     /**
      *  @brief Convert a set of nonlinear+fixed parameter arrays to a vector of ellipses.
      *
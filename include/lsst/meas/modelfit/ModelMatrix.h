@@ -0,0 +1,127 @@
+// -*- lsst-c++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2008-2017 LSST/AURA.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+
+#ifndef LSST_MEAS_MODELFIT_ModelMatrix_h_INCLUDED
+#define LSST_MEAS_MODELFIT_ModelMatrix_h_INCLUDED
+
+#include <memory>
+
+#include "Eigen/Core"
+#include "ndarray.h"
+
+#include "lsst/meas/modelfit/common.h"
+
+namespace lsst { namespace meas { namespace modelfit {
+
+/**
+ *  @brief Reusable storage for a model matrix, with columns aligned and padded to cache lines.
+ *
+ *  Model matrices are stored column-major (one column per amplitude, as expected by
+ *  Likelihood::computeModelMatrix), and are read a column at a time by vectorized code.  Here each
+ *  column starts on a 64-byte boundary and the distance between columns (getStride()) is padded to a
+ *  whole number of 64-byte cache lines, so every column can be loaded with aligned vector
+ *  instructions and no column shares a cache line with another.
+ *
+ *  Storage only grows: resize() reallocates only when the new matrix does not fit in the existing
+ *  storage, so a ModelMatrix can be reused for many sources of different sizes.  Views returned by
+ *  getArray() and getEigenMap() share the storage, and remain valid (though they may be overwritten)
+ *  after the ModelMatrix is resized or destroyed.
+ */
+class ModelMatrix {
+public:
+
+    typedef Eigen::Matrix<Pixel,Eigen::Dynamic,Eigen::Dynamic> PixelMatrix;
+    typedef Eigen::Map<PixelMatrix,Eigen::Aligned64,Eigen::OuterStride<>> EigenMap;
+
+    /// Alignment of each column, in bytes.
+    static int const ALIGNMENT = 64;
+
+    /// Construct an empty matrix.
+    ModelMatrix();
+
+    /// Construct a matrix with the given dimensions and unspecified values.
+    ModelMatrix(int nRows, int nCols);
+
+    /**
+     *  @brief Change the dimensions of the matrix, leaving its values unspecified.
+     *
+     *  Returns true if new storage had to be allocated.
+     */
+    bool resize(int nRows, int nCols);
+
+    int getRows() const { return _rows; }
+    int getCols() const { return _cols; }
+
+    /// Return the number of elements between the beginnings of consecutive columns.
+    int getStride() const { return _stride; }
+
+    /// Return a (getRows() x getCols()) view of the matrix.
+    ndarray::Array<Pixel,2,-1> getArray() const;
+
+    /// Return an Eigen view of the matrix that lets Eigen assume aligned columns.
+    EigenMap getEigenMap() const;
+
+private:
+    int _rows;
+    int _cols;
+    int _stride;
+    std::size_t _capacity;
+    std::shared_ptr<Pixel> _data;
+};
+
+/**
+ *  @brief Compute output = modelMatrix * amplitudes in double precision.
+ *
+ *  This is equivalent to (but faster than) Eigen's
+ *  @code
+ *  asEigenMatrix(output) = asEigenMatrix(modelMatrix).cast<Scalar>() * asEigenMatrix(amplitudes)
+ *  @endcode
+ *  which converts the whole model matrix to a temporary double-precision matrix before multiplying;
+ *  here each column is converted as it is accumulated, so the matrix is read once and nothing else
+ *  is written.
+ */
+void multiplyModelMatrix(
+    ndarray::Array<Pixel const,2,-1> const & modelMatrix,
+    ndarray::Array<Scalar const,1,1> const & amplitudes,
+    ndarray::Array<Scalar,1,1> const & output
+);
+
+/**
+ *  @brief Add modelMatrix^T modelMatrix to the lower triangle of a square matrix, in double precision.
+ *
+ *  Like multiplyModelMatrix, this avoids the double-precision copy of the whole matrix Eigen creates for
+ *  @code
+ *  hessian.selfadjointView<Eigen::Lower>().rankUpdate(asEigenMatrix(modelMatrix).adjoint().cast<Scalar>())
+ *  @endcode
+ *  by converting a few hundred rows at a time (or, for matrices with only a few columns, by computing
+ *  column dot products directly).
+ */
+void addModelMatrixGram(
+    ndarray::Array<Pixel const,2,-1> const & modelMatrix,
+    Matrix & hessian
+);
+
+}}} // namespace lsst::meas::modelfit
+
+#endif // !LSST_MEAS_MODELFIT_ModelMatrix_h_INCLUDED
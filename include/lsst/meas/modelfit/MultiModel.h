@@ -58,6 +58,12 @@ public:
         EllipseIterator ellipseIter
     ) const override;
 
+    /// @copydoc Model::writeFlatEllipses
+    void writeFlatEllipses(
+        Scalar const * nonlinearIter, Scalar const * fixedIter,
+        FlatEllipse * flatIter
+    ) const override;
+
     /// @copydoc Model::readEllipses
     void readEllipses(
         EllipseConstIterator ellipseIter,
@@ -0,0 +1,176 @@
+// -*- lsst-c++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2008-2017 LSST/AURA.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+
+#ifndef LSST_MEAS_MODELFIT_StreamingLikelihood_h_INCLUDED
+#define LSST_MEAS_MODELFIT_StreamingLikelihood_h_INCLUDED
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "ndarray.h"
+
+#include "lsst/geom/SpherePoint.h"
+
+#include "lsst/meas/modelfit/common.h"
+#include "lsst/meas/modelfit/Model.h"
+#include "lsst/meas/modelfit/UnitSystem.h"
+#include "lsst/meas/modelfit/UnitTransformedLikelihood.h"
+
+namespace lsst { namespace meas { namespace modelfit {
+
+/**
+ *  @brief The normal equations of a (linearized) weighted least-squares problem.
+ *
+ *  For residuals @f$r = B(\theta)\alpha - z@f$ (in the notation of Likelihood) with derivatives
+ *  @f$J@f$ with respect to some set of parameters, these are @f$J^T J@f$, @f$J^T r@f$ and
+ *  @f$r^T r@f$, which are all a Gauss-Newton optimizer needs, and whose sizes do not depend on the
+ *  number of pixels.
+ */
+struct NormalEquations {
+
+    explicit NormalEquations(int nParameters=0) :
+        hessian(Matrix::Zero(nParameters, nParameters)),
+        gradient(Vector::Zero(nParameters)),
+        chiSq(0.0),
+        dataDim(0)
+    {}
+
+    Matrix hessian;   ///< @f$J^T J@f$ (symmetric)
+    Vector gradient;  ///< @f$J^T r@f$
+    Scalar chiSq;     ///< @f$r^T r@f$, or twice the negative log likelihood
+    int dataDim;      ///< number of pixels the equations were accumulated over
+};
+
+/**
+ *  @brief A multi-epoch likelihood that loads its epochs a few at a time, so memory use does not
+ *         grow with the number of epochs.
+ *
+ *  Instead of holding all epochs' pixels like UnitTransformedLikelihood, a StreamingLikelihood
+ *  calls a user-provided loader for each epoch whenever it needs its data, builds a
+ *  UnitTransformedLikelihood for groups of groupSize consecutive epochs at a time, and accumulates
+ *  only the normal equations (see NormalEquations) of each group before releasing it.  Peak memory
+ *  is thus that of one group (plus whatever the loader keeps), at the cost of loading every epoch
+ *  once per evaluation; the loader should not hold on to the EpochFootprints it returns.
+ *
+ *  The results are those of a UnitTransformedLikelihood constructed with all epochs at once and the
+ *  same control object, up to round-off.  Every epoch is also loaded once on construction, to count
+ *  the pixels and (when the control object's usePixelWeights is false) to compute the constant
+ *  weight, which is the geometric mean of the per-pixel weights over all epochs.
+ */
+class StreamingLikelihood {
+public:
+
+    /// A function that returns the data for the epoch with the given index.
+    typedef std::function<PTR(EpochFootprint)(int)> EpochLoader;
+
+    /**
+     *  @brief Construct a StreamingLikelihood.
+     *
+     *  @param[in] model        Object that defines the model to fit and its parameters.
+     *  @param[in] fixed        Model parameters that are held fixed.
+     *  @param[in] fitSys       Geometric and photometric system to fit in.
+     *  @param[in] position     ICRS sky position of object being fit.
+     *  @param[in] epochCount   Number of epochs; the loader is called with indices in [0, epochCount).
+     *  @param[in] loader       Function that loads the data for one epoch.
+     *  @param[in] groupSize    Maximum number of epochs loaded at once.
+     *  @param[in] ctrl         Control object passed to the UnitTransformedLikelihood of each group.
+     */
+    StreamingLikelihood(
+        PTR(Model) model,
+        ndarray::Array<Scalar const,1,1> const & fixed,
+        UnitSystem const & fitSys,
+        geom::SpherePoint const & position,
+        int epochCount,
+        EpochLoader const & loader,
+        int groupSize,
+        UnitTransformedLikelihoodControl const & ctrl
+    );
+
+    /// Return the number of data points in all epochs.
+    int getDataDim() const { return _dataDim; }
+
+    /// Return the number of linear parameters.
+    int getAmplitudeDim() const { return _model->getAmplitudeDim(); }
+
+    /// Return the number of nonlinear parameters.
+    int getNonlinearDim() const { return _model->getNonlinearDim(); }
+
+    /// Return the number of epochs.
+    int getEpochCount() const { return _epochCount; }
+
+    /// Return the maximum number of epochs loaded at once.
+    int getGroupSize() const { return _groupSize; }
+
+    /// Return the number of groups of epochs.
+    int getGroupCount() const { return (_epochCount + _groupSize - 1) / _groupSize; }
+
+    /// Return the object that defines the model and its parameters.
+    PTR(Model) getModel() const { return _model; }
+
+    /**
+     *  @brief Compute the normal equations for the amplitudes at fixed nonlinear parameters.
+     *
+     *  Because the model is linear in the amplitudes, these are exact: they are evaluated at zero
+     *  amplitudes, so hessian is @f$B^T B@f$, gradient is @f$-B^T z@f$, and chiSq is @f$z^T z@f$.  The
+     *  best-fit amplitudes solve hessian * amplitudes = -gradient, and the chi-squared of any
+     *  amplitudes is chiSq + 2 gradient^T amplitudes + amplitudes^T hessian amplitudes.
+     */
+    NormalEquations computeAmplitudeNormalEquations(ndarray::Array<Scalar const,1,1> const & nonlinear) const;
+
+    /**
+     *  @brief Compute the Gauss-Newton normal equations for all parameters.
+     *
+     *  The parameters are ordered as in OptimizerObjective: the nonlinear parameters followed by the
+     *  amplitudes.  Derivatives with respect to the amplitudes are exact; those with respect to the
+     *  nonlinear parameters are forward differences with the given steps.
+     *
+     *  @param[in] parameters       Nonlinear parameters followed by amplitudes.
+     *  @param[in] nonlinearSteps   Finite-difference step for each nonlinear parameter.
+     */
+    NormalEquations computeNormalEquations(
+        ndarray::Array<Scalar const,1,1> const & parameters,
+        ndarray::Array<Scalar const,1,1> const & nonlinearSteps
+    ) const;
+
+private:
+
+    // Load the epochs in a group and build a likelihood for them.
+    PTR(UnitTransformedLikelihood) _loadGroup(int group) const;
+
+    PTR(Model) _model;
+    ndarray::Array<Scalar const,1,1> _fixed;
+    UnitSystem _fitSys;
+    geom::SpherePoint _position;
+    int _epochCount;
+    EpochLoader _loader;
+    int _groupSize;
+    int _dataDim;
+    UnitTransformedLikelihoodControl _ctrl;
+    std::vector<double> _weightsMultipliers;  // per group, to give all groups the same constant weight
+};
+
+}}} // namespace lsst::meas::modelfit
+
+#endif // !LSST_MEAS_MODELFIT_StreamingLikelihood_h_INCLUDED
@@ -26,6 +26,7 @@
 
 #include <vector>
 #include <memory>
+#include <string>
 
 #include "ndarray.h"
 
@@ -57,8 +58,31 @@ public:
     LSST_CONTROL_FIELD(weightsMultiplier, double,
                        "Scaling factor to apply to weights.");
 
+    LSST_CONTROL_FIELD(parallelMinPixels, int,
+                       "Minimum total number of pixels (summed over epochs) for which the model matrix "
+                       "is evaluated in parallel, in chunks of parallelChunkSize pixels of one epoch, and "
+                       "model images are evaluated in parallel one epoch at a time; 0 to never "
+                       "parallelize.  Results do not depend on the number of threads.");
+
+    LSST_CONTROL_FIELD(parallelChunkSize, int,
+                       "Number of pixels in each chunk of the model matrix evaluated by one thread; "
+                       "small enough that a chunk's rows and workspace stay in cache.");
+
+    LSST_CONTROL_FIELD(parallelThreads, int,
+                       "Number of threads used to evaluate the model in parallel (including "
+                       "the calling thread); 0 to use one per hardware thread.  The extra threads are "
+                       "started when the likelihood is constructed and kept until it is destroyed, so "
+                       "callers that already run one fit per thread should leave this at 1.");
+
+    LSST_CONTROL_FIELD(fftMode, std::string,
+                       "When to evaluate the model matrix by convolving analytic Gaussian profiles with "
+                       "the PSF image via FFTs on a padded grid around the pixels, instead of directly: "
+                       "'NEVER', 'AUTO' (when cheaper, for large fit regions), or 'ALWAYS'.  Only used "
+                       "for Gaussian profiles and PSF components at least 1.5 pixels wide.");
+
     explicit UnitTransformedLikelihoodControl(bool usePixelWeights_=false, double weightsMultiplier_=1.0)
-        : usePixelWeights(usePixelWeights_), weightsMultiplier(weightsMultiplier_) {}
+        : usePixelWeights(usePixelWeights_), weightsMultiplier(weightsMultiplier_),
+          parallelMinPixels(0), parallelChunkSize(4096), parallelThreads(1), fftMode("NEVER") {}
 
 };
 
@@ -109,6 +133,22 @@ public:
         bool doApplyWeights=true
     ) const override;
 
+    /// @copydoc Likelihood::updateModelMatrix
+    void updateModelMatrix(
+        ndarray::Array<Pixel,2,-1> const & modelMatrix,
+        ndarray::Array<Scalar const,1,1> const & nonlinear,
+        ndarray::Array<Scalar const,1,1> const & previousNonlinear,
+        bool doApplyWeights=true
+    ) const override;
+
+    /// @copydoc Likelihood::computeModelImage
+    void computeModelImage(
+        ndarray::Array<Pixel,1,1> const & modelImage,
+        ndarray::Array<Scalar const,1,1> const & nonlinear,
+        ndarray::Array<Scalar const,1,1> const & amplitudes,
+        bool doApplyWeights=true
+    ) const override;
+
     /**
      * @brief Initialize a UnitTransformedLikelihood with data from multiple exposures.
      *
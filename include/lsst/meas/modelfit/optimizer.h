@@ -24,6 +24,9 @@
 #ifndef LSST_MEAS_MODELFIT_optimizer_h_INCLUDED
 #define LSST_MEAS_MODELFIT_optimizer_h_INCLUDED
 
+#include <chrono>
+#include <vector>
+
 #include "ndarray.h"
 
 #include "lsst/base.h"
@@ -105,6 +108,22 @@ public:
         ndarray::Array<Scalar,1,1> const & residuals
     ) const = 0;
 
+    /**
+     *  Evaluate the residuals of the model at a point where they will not be differenced with
+     *  computeResiduals to compute numerical derivatives (e.g. a trial step or a grid point).
+     *
+     *  Subclasses may implement this with a cheaper method than computeResiduals whose rounding
+     *  errors differ from it, and should then return true; the default implementation just calls
+     *  computeResiduals and returns false.  Arguments are as for computeResiduals.
+     */
+    virtual bool computeResidualsOnly(
+        ndarray::Array<Scalar const,1,1> const & parameters,
+        ndarray::Array<Scalar,1,1> const & residuals
+    ) const {
+        computeResiduals(parameters, residuals);
+        return false;
+    }
+
     /**
      *  Evaluate analytic derivatives of the model or signal that they are not available.
      *
@@ -125,6 +144,48 @@ public:
         return false;
     }
 
+    /**
+     *  A block of consecutive parameters whose residual derivatives are zero outside a subset of the
+     *  residuals (see getResidualBlocks).
+     */
+    struct ResidualBlock {
+        int parameterBegin;     ///< Index of the first parameter in the block.
+        int parameterEnd;       ///< One past the index of the last parameter in the block.
+        std::vector<int> rows;  ///< Sorted indices of the residuals that depend on the block's parameters.
+    };
+
+    /**
+     *  Return the block-sparsity structure of the residual derivatives, or an empty vector if they are
+     *  dense (the default).
+     *
+     *  If not empty, the blocks must partition the parameters.  Optimizer will then compute derivatives
+     *  numerically one block at a time with computeBlockResiduals (differentiateResiduals is not
+     *  called), and accumulate the gradient and Hessian only over the rows touched by each block and
+     *  by each pair of blocks whose rows overlap, so the cost scales with the number of nonzero
+     *  derivatives and the size of the overlaps rather than with dataSize*parameterSize^2.  The
+     *  Hessian itself is still stored densely, and the trust-region solve and SR1 update still cost
+     *  O(parameterSize^3) and O(parameterSize^2) per iteration.
+     */
+    virtual std::vector<ResidualBlock> getResidualBlocks() const { return std::vector<ResidualBlock>(); }
+
+    /**
+     *  Evaluate the residuals of one parameter block (see getResidualBlocks) at that block's rows.
+     *
+     *  Only differences between calls that differ in the block's parameters are used, so
+     *  implementations may omit any term that does not depend on them.  The default implementation
+     *  calls computeResiduals and extracts the block's rows.
+     *
+     *  @param[in]  parameters    An array of parameters with shape (parameterSize).
+     *  @param[in]  block         Index of the block in the vector returned by getResidualBlocks.
+     *  @param[out] residuals     Output array with the same size as the block's rows.  Must be
+     *                            allocated, but need not be initialized.
+     */
+    virtual void computeBlockResiduals(
+        ndarray::Array<Scalar const,1,1> const & parameters,
+        int block,
+        ndarray::Array<Scalar,1,1> const & residuals
+    ) const;
+
 
     /**
      *  Return true if the Objective has a Bayesian prior as well as a likelihood.
@@ -164,6 +225,34 @@ public:
         hessian.deep() = 0.0;
     }
 
+    /**
+     *  Compute -ln P, where P is the Bayesian prior, for the given parameter vector.
+     *
+     *  This is what Optimizer actually minimizes (along with the residuals).  The default implementation
+     *  takes the log of computePrior(); objectives whose prior is a product of many factors should
+     *  override this (and differentiateNegLogPrior) to sum the logs of the factors instead, as the
+     *  product can underflow.  May return infinity where the prior is zero.
+     */
+    virtual Scalar computeNegLogPrior(ndarray::Array<Scalar const,1,1> const & parameters) const;
+
+    /**
+     *  Compute the first and second derivatives of -ln P with respect to the parameters.
+     *
+     *  The default implementation computes them from computePrior() and differentiatePrior().
+     *
+     *  @param[in]  parameters    An array of parameters with shape (parameterSize).
+     *  @param[out] gradient      First derivative of -ln P with respect to the parameters.
+     *                            Must be allocated to shape (parameterSize), but need not be initialized.
+     *  @param[out] hessian       Second derivative of -ln P with respect to the parameters.
+     *                            Must be allocated to shape (parameterSize, parameterSize), but need
+     *                            not be initialized.  Only the lower triangle is filled.
+     */
+    virtual void differentiateNegLogPrior(
+        ndarray::Array<Scalar const,1,1> const & parameters,
+        ndarray::Array<Scalar,1,1> const & gradient,
+        ndarray::Array<Scalar,2,1> const & hessian
+    ) const;
+
     virtual ~OptimizerObjective() {}
 };
 
@@ -276,6 +365,12 @@ public:
         "whether to save all iterations for debugging purposes"
     );
 
+    LSST_CONTROL_FIELD(
+        maxTime, double,
+        "maximum wall-clock time (in seconds) for a call to Optimizer::run(), checked before each "
+        "function evaluation; when exceeded, the best parameters so far are kept.  <= 0 means no limit"
+    );
+
     OptimizerControl() :
         noSR1Term(false), skipSR1UpdateThreshold(1E-8),
         minTrustRadiusThreshold(1E-5),
@@ -291,7 +386,8 @@ public:
         trustRegionSolverTolerance(1E-8),
         maxInnerIterations(20),
         maxOuterIterations(500),
-        doSaveIterations(false)
+        doSaveIterations(false),
+        maxTime(0.0)
     {}
 };
 
@@ -412,7 +508,9 @@ public:
         FAILED_MAX_ITERATIONS = 0x0030,
         FAILED_EXCEPTION = 0x0040,
         FAILED_NAN = 0x0080,
-        FAILED = FAILED_MAX_INNER_ITERATIONS | FAILED_MAX_OUTER_ITERATIONS | FAILED_EXCEPTION | FAILED_NAN,
+        FAILED_MAX_TIME = 0x0400,
+        FAILED = FAILED_MAX_INNER_ITERATIONS | FAILED_MAX_OUTER_ITERATIONS | FAILED_EXCEPTION | FAILED_NAN
+            | FAILED_MAX_TIME,
         STATUS_STEP_REJECTED = 0x0100,
         STATUS_STEP_ACCEPTED = 0x0200,
         STATUS_STEP = STATUS_STEP_REJECTED | STATUS_STEP_ACCEPTED,
@@ -467,6 +565,7 @@ private:
         Scalar priorValue;
         ndarray::Array<Scalar,1,1> parameters;
         ndarray::Array<Scalar,1,1> residuals;
+        bool residualsOnly;  // residuals were computed by computeResidualsOnly, not computeResiduals
 
         IterationData(int dataSize, int parameterSize);
 
@@ -483,10 +582,28 @@ private:
 
     int _runImpl(HistoryRecorder const * recorder=NULL, afw::table::BaseCatalog * history=NULL);
 
+    // Pair of parameter blocks whose rows overlap, with the positions of the shared rows within each
+    // block's rows; lower is the block with the later parameters, so (lower, upper) is in the lower
+    // triangle of the Hessian.
+    struct BlockOverlap {
+        int lower;
+        int upper;
+        std::vector<int> lowerRows;
+        std::vector<int> upperRows;
+    };
+
     void _computeDerivatives();
 
+    void _setupBlocks();
+
+    void _computeBlockDerivatives();
+
     int _state;
+    std::chrono::steady_clock::time_point _deadline; // set by run() if _ctrl.maxTime > 0
     PTR(Objective const) _objective;
+    std::vector<Objective::ResidualBlock> _blocks;   // empty if residual derivatives are dense
+    std::vector<Matrix> _blockDerivatives;           // (rows x parameters) derivatives for each block
+    std::vector<BlockOverlap> _blockOverlaps;
     Control _ctrl;
     double _trustRadius;
     IterationData _current;
@@ -0,0 +1,93 @@
+// -*- lsst-c++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2008-2017 LSST/AURA.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+#ifndef LSST_MEAS_MODELFIT_vectorMath_h_INCLUDED
+#define LSST_MEAS_MODELFIT_vectorMath_h_INCLUDED
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "lsst/meas/modelfit/common.h"
+
+namespace lsst { namespace meas { namespace modelfit { namespace detail {
+
+/**
+ *  @brief Compute out[i] = exp(x[i]) for 0 <= i < n.
+ *
+ *  The relative error is at most 2 ulp for -708 <= x <= 709.78.  Smaller arguments (whose exponentials
+ *  are below 3.4E-308) return zero, larger ones return infinity, and NaNs are propagated.  Results may
+ *  differ in the last bit between backends (see getVectorMathBackend).  On a machine with AVX-512 this
+ *  is about 7 times faster than calling std::exp in a loop (see examples/vectorMathBenchmark.cc).
+ *
+ *  The input and output arrays may be the same array.
+ */
+void vectorExp(Scalar const * x, Scalar * out, std::size_t n);
+
+/**
+ *  @brief Compute out[i] = erfc(x[i]) for 0 <= i < n.
+ *
+ *  This uses the Chebyshev-fitted approximation of Press et al. (Numerical Recipes, 2nd ed., section
+ *  6.2), with a relative error below 1.2E-7 everywhere.  That is enough for evaluating models, but
+ *  boost::math::erfc should be used where full double precision is needed (e.g. in normalizing
+ *  probability distributions).
+ *
+ *  The input and output arrays may be the same array.
+ */
+void vectorErfc(Scalar const * x, Scalar * out, std::size_t n);
+
+/**
+ *  @brief Compute out[i] = sum_k coefficients[k] x[i]^k for 0 <= i < n.
+ *
+ *  The polynomial is evaluated with Horner's rule, so its accuracy is that of Horner's rule in double
+ *  precision.  The input and output arrays may be the same array.
+ */
+void vectorPolynomial(
+    Scalar const * coefficients, int nCoefficients,
+    Scalar const * x, Scalar * out, std::size_t n
+);
+
+/**
+ *  @brief Return the name of the instruction set used by the vector math functions.
+ *
+ *  This is one of "avx512", "avx2", or "neon"; "libm", which calls std::exp and std::erfc one element
+ *  at a time and is the default when no vector instruction set is available; or "scalar", a portable
+ *  implementation of the same algorithms as the vectorized backends, used mostly for testing.  The best
+ *  backend supported by the CPU is selected the first time a vector math function is called.
+ */
+std::string getVectorMathBackend();
+
+/// Return the names of the vector math backends that can be used on this machine, best first.
+std::vector<std::string> getVectorMathBackends();
+
+/**
+ *  @brief Set the vector math backend used by all threads.
+ *
+ *  Throws pex::exceptions::InvalidParameterError if the backend is not one of those returned by
+ *  getVectorMathBackends().
+ */
+void setVectorMathBackend(std::string const & name);
+
+}}}} // namespace lsst::meas::modelfit::detail
+
+#endif // !LSST_MEAS_MODELFIT_vectorMath_h_INCLUDED
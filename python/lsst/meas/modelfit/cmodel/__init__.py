@@ -22,3 +22,5 @@
 
 from .cmodel import *
 from .cmodelContinued import *
+from .initializerTraining import *
+from .costCalibration import *
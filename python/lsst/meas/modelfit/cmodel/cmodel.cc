@@ -22,6 +22,7 @@
  */
 
 #include "pybind11/pybind11.h"
+#include "pybind11/stl.h"
 
 #include "ndarray/pybind11.h"
 
@@ -38,8 +39,12 @@ namespace {
 
 using PyCModelStageControl = py::class_<CModelStageControl, std::shared_ptr<CModelStageControl>>;
 using PyCModelControl = py::class_<CModelControl, std::shared_ptr<CModelControl>>;
+using PyCModelInitializer = py::class_<CModelInitializer, std::shared_ptr<CModelInitializer>>;
+using PyCModelCostModel = py::class_<CModelCostModel, std::shared_ptr<CModelCostModel>>;
+using PyCModelResultCache = py::class_<CModelResultCache, std::shared_ptr<CModelResultCache>>;
 using PyCModelStageResult = py::class_<CModelStageResult, std::shared_ptr<CModelStageResult>>;
 using PyCModelResult = py::class_<CModelResult, std::shared_ptr<CModelResult>>;
+using PyCModelWorkspace = py::class_<CModelWorkspace, std::shared_ptr<CModelWorkspace>>;
 using PyCModelAlgorithm = py::class_<CModelAlgorithm, std::shared_ptr<CModelAlgorithm>>;
 
 static PyCModelStageControl declareCModelStageControl(py::module &mod) {
@@ -48,6 +53,8 @@ static PyCModelStageControl declareCModelStageControl(py::module &mod) {
     cls.def("getProfile", &CModelStageControl::getProfile);
     cls.def("getModel", &CModelStageControl::getModel);
     cls.def("getPrior", &CModelStageControl::getPrior);
+    cls.def("getOptimizerControl", &CModelStageControl::getOptimizerControl, "snr"_a);
+    cls.def("getLikelihoodControl", &CModelStageControl::getLikelihoodControl, "weightsScale"_a = 1.0);
     LSST_DECLARE_CONTROL_FIELD(cls, CModelStageControl, profileName);
     LSST_DECLARE_CONTROL_FIELD(cls, CModelStageControl, priorSource);
     LSST_DECLARE_CONTROL_FIELD(cls, CModelStageControl, priorName);
@@ -60,6 +67,13 @@ static PyCModelStageControl declareCModelStageControl(py::module &mod) {
     LSST_DECLARE_NESTED_CONTROL_FIELD(cls, CModelStageControl, optimizer);
     LSST_DECLARE_CONTROL_FIELD(cls, CModelStageControl, doRecordHistory);
     LSST_DECLARE_CONTROL_FIELD(cls, CModelStageControl, doRecordTime);
+    LSST_DECLARE_CONTROL_FIELD(cls, CModelStageControl, doAdaptiveConvergence);
+    LSST_DECLARE_CONTROL_FIELD(cls, CModelStageControl, adaptiveReferenceSnr);
+    LSST_DECLARE_CONTROL_FIELD(cls, CModelStageControl, adaptiveMaxScale);
+    LSST_DECLARE_CONTROL_FIELD(cls, CModelStageControl, adaptiveMinOuterIterations);
+    LSST_DECLARE_CONTROL_FIELD(cls, CModelStageControl, parallelMinPixels);
+    LSST_DECLARE_CONTROL_FIELD(cls, CModelStageControl, parallelThreads);
+    LSST_DECLARE_CONTROL_FIELD(cls, CModelStageControl, fftMode);
     return cls;
 }
 
@@ -73,9 +87,73 @@ static PyCModelControl declareCModelControl(py::module &mod) {
     LSST_DECLARE_NESTED_CONTROL_FIELD(cls, CModelControl, dev);
     LSST_DECLARE_CONTROL_FIELD(cls, CModelControl, minInitialRadius);
     LSST_DECLARE_CONTROL_FIELD(cls, CModelControl, fallbackInitialMomentsPsfFactor);
+    LSST_DECLARE_CONTROL_FIELD(cls, CModelControl, maxTime);
+    LSST_DECLARE_CONTROL_FIELD(cls, CModelControl, initializerSource);
+    LSST_DECLARE_CONTROL_FIELD(cls, CModelControl, initializerName);
+    LSST_DECLARE_CONTROL_FIELD(cls, CModelControl, warmStartSkipInitial);
+    LSST_DECLARE_CONTROL_FIELD(cls, CModelControl, coarseBinFactor);
+    LSST_DECLARE_CONTROL_FIELD(cls, CModelControl, coarseMinArea);
+    LSST_DECLARE_CONTROL_FIELD(cls, CModelControl, coarseOnlyForMaxArea);
+    LSST_DECLARE_CONTROL_FIELD(cls, CModelControl, subsampleFraction);
+    LSST_DECLARE_CONTROL_FIELD(cls, CModelControl, subsampleMinArea);
+    LSST_DECLARE_CONTROL_FIELD(cls, CModelControl, subsampleMaxIterations);
+    LSST_DECLARE_CONTROL_FIELD(cls, CModelControl, groupMaxSize);
+    LSST_DECLARE_CONTROL_FIELD(cls, CModelControl, raiseMeasurementErrors);
+    LSST_DECLARE_CONTROL_FIELD(cls, CModelControl, resultCacheName);
+    LSST_DECLARE_CONTROL_FIELD(cls, CModelControl, resultCacheCapacity);
+    cls.def("getInitializer", &CModelControl::getInitializer);
     return cls;
 }
 
+static void declareCModelInitializer(py::module &mod) {
+    PyCModelInitializer cls(mod, "CModelInitializer");
+    py::enum_<CModelInitializer::Stage>(cls, "Stage")
+            .value("INITIAL", CModelInitializer::INITIAL)
+            .value("EXP", CModelInitializer::EXP)
+            .value("DEV", CModelInitializer::DEV)
+            .export_values();
+    cls.attr("N_STAGES") = py::cast(int(CModelInitializer::N_STAGES));
+    cls.attr("N_FEATURES") = py::cast(int(CModelInitializer::N_FEATURES));
+    cls.def(py::init<ndarray::Array<Scalar const, 2, 1> const &>(), "coefficients"_a);
+    cls.def("getCoefficients", &CModelInitializer::getCoefficients);
+    cls.def_static("computeFeatures", &CModelInitializer::computeFeatures, "moments"_a, "psfMoments"_a,
+                   "kronRadius"_a, "snr"_a);
+    cls.def("predictRadiusRatio", &CModelInitializer::predictRadiusRatio, "stage"_a, "features"_a);
+    cls.def("predict", &CModelInitializer::predict, "stage"_a, "moments"_a, "psfMoments"_a, "kronRadius"_a,
+            "snr"_a);
+    cls.def_static("readFits", &CModelInitializer::readFits, "filename"_a);
+    cls.def("writeFits", &CModelInitializer::writeFits, "filename"_a);
+}
+
+static void declareCModelCostModel(py::module &mod) {
+    PyCModelCostModel cls(mod, "CModelCostModel");
+    cls.attr("N_FEATURES") = py::cast(int(CModelCostModel::N_FEATURES));
+    cls.attr("N_ITERATION_FEATURES") = py::cast(int(CModelCostModel::N_ITERATION_FEATURES));
+    cls.def(py::init<>());
+    cls.def(py::init<ndarray::Array<Scalar const, 1, 1> const &,
+                     ndarray::Array<Scalar const, 1, 1> const &>(),
+            "timeCoefficients"_a, "iterationCoefficients"_a);
+    cls.def("getTimeCoefficients", &CModelCostModel::getTimeCoefficients);
+    cls.def("getIterationCoefficients", &CModelCostModel::getIterationCoefficients);
+    cls.def_static("computeFeatures", &CModelCostModel::computeFeatures, "area"_a, "work"_a, "snr"_a);
+    cls.def_static("computeIterationFeatures", &CModelCostModel::computeIterationFeatures, "snr"_a);
+    cls.def("predictTime", &CModelCostModel::predictTime, "features"_a);
+    cls.def("predictIterations", &CModelCostModel::predictIterations, "snr"_a);
+    cls.def_static("readFits", &CModelCostModel::readFits, "filename"_a);
+    cls.def("writeFits", &CModelCostModel::writeFits, "filename"_a);
+}
+
+static void declareCModelResultCache(py::module &mod) {
+    PyCModelResultCache cls(mod, "CModelResultCache");
+    cls.attr("MAX_PARAMETERS") = py::cast(int(CModelResultCache::MAX_PARAMETERS));
+    cls.def(py::init<std::string const &, int>(), "filename"_a, "capacity"_a);
+    cls.def("clear", &CModelResultCache::clear);
+    cls.def("getFilename", &CModelResultCache::getFilename);
+    cls.def("getCapacity", &CModelResultCache::getCapacity);
+    cls.def("getHitCount", &CModelResultCache::getHitCount);
+    cls.def("getMissCount", &CModelResultCache::getMissCount);
+}
+
 // Custom wrapper for views to std::bitset.
 template <int N>
 class BitSetView {
@@ -108,6 +186,7 @@ static PyCModelStageResult declareCModelStageResult(py::module &mod) {
     cls.attr("NUMERIC_ERROR") = py::cast(int(CModelStageResult::NUMERIC_ERROR));
     cls.attr("BAD_REFERENCE") = py::cast(int(CModelStageResult::BAD_REFERENCE));
     cls.attr("NO_FLUX") = py::cast(int(CModelStageResult::NO_FLUX));
+    cls.attr("MAX_TIME") = py::cast(int(CModelStageResult::MAX_TIME));
     cls.attr("N_FLAGS") = py::cast(int(CModelStageResult::N_FLAGS));
 
     // Data members are intentionally read-only from the Python side;
@@ -122,6 +201,11 @@ static PyCModelStageResult declareCModelStageResult(py::module &mod) {
     cls.def_readonly("instFluxInner", &CModelStageResult::instFluxInner);
     cls.def_readonly("objective", &CModelStageResult::objective);
     cls.def_readonly("time", &CModelStageResult::time);
+    cls.def_readonly("gradientThreshold", &CModelStageResult::gradientThreshold);
+    cls.def_readonly("minTrustRadiusThreshold", &CModelStageResult::minTrustRadiusThreshold);
+    cls.def_readonly("maxOuterIterations", &CModelStageResult::maxOuterIterations);
+    cls.def_readonly("nIter", &CModelStageResult::nIter);
+    cls.def_readonly("history", &CModelStageResult::history);
     cls.def_readonly("ellipse", &CModelStageResult::ellipse);
     cls.def_readonly("nonlinear", &CModelStageResult::nonlinear);
     cls.def_readonly("amplitudes", &CModelStageResult::amplitudes);
@@ -153,6 +237,8 @@ static PyCModelResult declareCModelResult(py::module &mod) {
     cls.attr("REGION_USED_INITIAL_ELLIPSE_MAX") =
             py::cast(int(CModelResult::REGION_USED_INITIAL_ELLIPSE_MAX));
     cls.attr("NO_FLUX") = py::cast(int(CModelResult::NO_FLUX));
+    cls.attr("REGION_COARSE_ONLY") = py::cast(int(CModelResult::REGION_COARSE_ONLY));
+    cls.attr("GROUP_FIT") = py::cast(int(CModelResult::GROUP_FIT));
 
     // Data members are intentionally read-only from the Python side;
     // they should only be set by the C++ algorithm code that uses
@@ -162,6 +248,7 @@ static PyCModelResult declareCModelResult(py::module &mod) {
     cls.def_readonly("instFluxInner", &CModelResult::instFluxInner);
     cls.def_readonly("fracDev", &CModelResult::fracDev);
     cls.def_readonly("objective", &CModelResult::objective);
+    cls.def_readonly("snr", &CModelResult::snr);
     cls.def_readonly("initial", &CModelResult::initial);
     cls.def_readonly("exp", &CModelResult::exp);
     cls.def_readonly("dev", &CModelResult::dev);
@@ -179,6 +266,13 @@ static PyCModelResult declareCModelResult(py::module &mod) {
     return cls;
 }
 
+static PyCModelWorkspace declareCModelWorkspace(py::module &mod) {
+    PyCModelWorkspace cls(mod, "CModelWorkspace");
+    cls.def(py::init<>());
+    cls.def("getGrowCount", &CModelWorkspace::getGrowCount);
+    return cls;
+}
+
 static PyCModelAlgorithm declareCModelAlgorithm(py::module &mod) {
     PyCModelAlgorithm cls(mod, "CModelAlgorithm");
     cls.def(py::init<std::string const &, CModelControl const &, afw::table::Schema &>(), "name"_a, "ctrl"_a,
@@ -187,10 +281,59 @@ static PyCModelAlgorithm declareCModelAlgorithm(py::module &mod) {
             "ctrl"_a, "schemaMapper"_a);
     cls.def(py::init<CModelControl const &>(), "ctrl"_a);
     cls.def("getControl", &CModelAlgorithm::getControl);
-    cls.def("apply", &CModelAlgorithm::apply, "exposure"_a, "psf"_a, "center"_a, "moments"_a,
+    cls.def("getResultCache", &CModelAlgorithm::getResultCache);
+    cls.def("getWorkspaceGrowCount", &CModelAlgorithm::getWorkspaceGrowCount);
+    cls.def("apply",
+            (CModelResult (CModelAlgorithm::*)(afw::image::Exposure<Pixel> const &,
+                                               shapelet::MultiShapeletFunction const &, geom::Point2D const &,
+                                               afw::geom::ellipses::Quadrupole const &, Scalar, Scalar, int)
+                     const) &
+                    CModelAlgorithm::apply,
+            "exposure"_a, "psf"_a, "center"_a, "moments"_a, "approxFlux"_a = -1, "kronRadius"_a = -1,
+            "footprintArea"_a = -1);
+    cls.def("apply",
+            (CModelResult (CModelAlgorithm::*)(CModelWorkspace &, afw::image::Exposure<Pixel> const &,
+                                               shapelet::MultiShapeletFunction const &, geom::Point2D const &,
+                                               afw::geom::ellipses::Quadrupole const &, Scalar, Scalar, int)
+                     const) &
+                    CModelAlgorithm::apply,
+            "workspace"_a, "exposure"_a, "psf"_a, "center"_a, "moments"_a, "approxFlux"_a = -1,
+            "kronRadius"_a = -1, "footprintArea"_a = -1);
+    cls.def("applyWarmStart",
+            (CModelResult (CModelAlgorithm::*)(afw::image::Exposure<Pixel> const &,
+                                               shapelet::MultiShapeletFunction const &, geom::Point2D const &,
+                                               afw::geom::ellipses::Quadrupole const &, CModelResult const &,
+                                               Scalar, Scalar, int) const) &
+                    CModelAlgorithm::applyWarmStart,
+            "exposure"_a, "psf"_a, "center"_a, "moments"_a, "reference"_a, "approxFlux"_a = -1,
+            "kronRadius"_a = -1, "footprintArea"_a = -1);
+    cls.def("applyWarmStart",
+            (CModelResult (CModelAlgorithm::*)(CModelWorkspace &, afw::image::Exposure<Pixel> const &,
+                                               shapelet::MultiShapeletFunction const &, geom::Point2D const &,
+                                               afw::geom::ellipses::Quadrupole const &, CModelResult const &,
+                                               Scalar, Scalar, int) const) &
+                    CModelAlgorithm::applyWarmStart,
+            "workspace"_a, "exposure"_a, "psf"_a, "center"_a, "moments"_a, "reference"_a,
             "approxFlux"_a = -1, "kronRadius"_a = -1, "footprintArea"_a = -1);
-    cls.def("applyForced", &CModelAlgorithm::applyForced, "exposure"_a, "psf"_a, "center"_a, "reference"_a,
-            "approxFlux"_a = -1);
+    cls.def("applyMultiEpoch", &CModelAlgorithm::applyMultiEpoch, "exposures"_a, "psfs"_a, "position"_a,
+            "moments"_a, "approxFlux"_a = -1, "kronRadius"_a = -1, "footprintArea"_a = -1);
+    cls.def("applyGroup", &CModelAlgorithm::applyGroup, "exposure"_a, "psfs"_a, "centers"_a, "moments"_a,
+            "approxFluxes"_a = std::vector<Scalar>(), "kronRadii"_a = std::vector<Scalar>(),
+            "footprintAreas"_a = std::vector<int>());
+    cls.def("applyForced",
+            (CModelResult (CModelAlgorithm::*)(afw::image::Exposure<Pixel> const &,
+                                               shapelet::MultiShapeletFunction const &, geom::Point2D const &,
+                                               CModelResult const &, Scalar) const) &
+                    CModelAlgorithm::applyForced,
+            "exposure"_a, "psf"_a, "center"_a, "reference"_a, "approxFlux"_a = -1);
+    cls.def("applyForced",
+            (CModelResult (CModelAlgorithm::*)(CModelWorkspace &, afw::image::Exposure<Pixel> const &,
+                                               shapelet::MultiShapeletFunction const &, geom::Point2D const &,
+                                               CModelResult const &, Scalar) const) &
+                    CModelAlgorithm::applyForced,
+            "workspace"_a, "exposure"_a, "psf"_a, "center"_a, "reference"_a, "approxFlux"_a = -1);
+    cls.def("applyForcedMultiBand", &CModelAlgorithm::applyForcedMultiBand, "exposures"_a, "psfs"_a,
+            "center"_a, "reference"_a, "approxFlux"_a = -1);
     cls.def("measure", (void (CModelAlgorithm::*)(afw::table::SourceRecord &,
                                                   afw::image::Exposure<Pixel> const &) const) &
                                CModelAlgorithm::measure,
@@ -200,6 +343,26 @@ static PyCModelAlgorithm declareCModelAlgorithm(py::module &mod) {
                                        afw::table::SourceRecord const &) const) &
                     CModelAlgorithm::measure,
             "measRecord"_a, "exposure"_a, "refRecord"_a);
+    cls.def("measure",
+            (void (CModelAlgorithm::*)(afw::table::SourceRecord &, afw::image::Exposure<Pixel> const &,
+                                       afw::table::SourceRecord const &,
+                                       std::shared_ptr<afw::geom::SkyWcs const>) const) &
+                    CModelAlgorithm::measure,
+            "measRecord"_a, "exposure"_a, "refRecord"_a, "refWcs"_a);
+    cls.def("measureWarmStart", &CModelAlgorithm::measureWarmStart, "measRecord"_a, "exposure"_a,
+            "refRecord"_a);
+    cls.def("computeCostFeatures",
+            (ndarray::Array<Scalar, 1, 1>(CModelAlgorithm::*)(
+                    shapelet::MultiShapeletFunction const &, afw::geom::ellipses::Quadrupole const &, Scalar,
+                    int, Scalar) const) &
+                    CModelAlgorithm::computeCostFeatures,
+            "psf"_a, "moments"_a, "kronRadius"_a = -1, "footprintArea"_a = -1,
+            "snr"_a = std::numeric_limits<Scalar>::quiet_NaN());
+    cls.def("computeCostFeatures",
+            (ndarray::Array<Scalar, 1, 1>(CModelAlgorithm::*)(afw::table::SourceRecord const &) const) &
+                    CModelAlgorithm::computeCostFeatures,
+            "record"_a);
+    cls.def("predictCost", &CModelAlgorithm::predictCost, "costModel"_a, "record"_a);
     cls.def("fail", &CModelAlgorithm::fail, "measRecord"_a, "error"_a);
     cls.def("writeResultToRecord", &CModelAlgorithm::writeResultToRecord, "result"_a, "record"_a);
     return cls;
@@ -208,6 +371,7 @@ static PyCModelAlgorithm declareCModelAlgorithm(py::module &mod) {
 PYBIND11_MODULE(cmodel, mod) {
     py::module::import("lsst.afw.geom.ellipses");
     py::module::import("lsst.afw.detection");
+    py::module::import("lsst.afw.table");
     py::module::import("lsst.meas.modelfit.model");
     py::module::import("lsst.meas.modelfit.priors");
     py::module::import("lsst.meas.modelfit.optimizer");
@@ -215,9 +379,13 @@ PYBIND11_MODULE(cmodel, mod) {
     py::module::import("lsst.meas.modelfit.unitTransformedLikelihood");
 
     declareCModelStageControl(mod);
+    declareCModelInitializer(mod);
+    declareCModelCostModel(mod);
+    declareCModelResultCache(mod);
     auto clsControl = declareCModelControl(mod);
     declareCModelStageResult(mod);
     auto clsResult = declareCModelResult(mod);
+    declareCModelWorkspace(mod);
     auto clsAlgorithm = declareCModelAlgorithm(mod);
     clsAlgorithm.attr("Control") = clsControl;
     clsAlgorithm.attr("Result") = clsResult;
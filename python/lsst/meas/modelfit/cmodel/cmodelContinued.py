@@ -80,9 +80,9 @@ class CModelForcedPlugin(lsst.meas.base.ForcedPlugin):
     This class simply provides __init__ and measure methods that matched the ForcedPlugin signatures
     and delegate to CModelAlgorithm implementations.
 
-    The CModel algorithm currently cannot be run in forced mode when the measurement WCS is different
-    from the reference WCS (as is the case in CCD forced photometry).  This is a temporary limitation
-    that will be addressed on DM-5405.
+    The measurement WCS may differ from the reference WCS (as is the case in CCD forced photometry); the
+    reference fit region is transformed to the measurement image's pixel coordinates, while the reference
+    ellipses are defined in a coordinate system that depends only on the position of the source.
 
     CModel forced measurement when the measurement image is the same as the reference image should be
     almost -- but not quite -- identical to unforced measurement.  The primary difference is that
@@ -100,12 +100,7 @@ class CModelForcedPlugin(lsst.meas.base.ForcedPlugin):
         self.algorithm = CModelAlgorithm(name, config.makeControl(), schemaMapper)
 
     def measure(self, measRecord, exposure, refRecord, refWcs):
-        if refWcs != exposure.getWcs():
-            raise lsst.meas.base.FatalAlgorithmError(
-                "CModel forced measurement currently requires the measurement image to have the same"
-                " Wcs as the reference catalog (this is a temporary limitation)."
-            )
-        self.algorithm.measure(measRecord, exposure, refRecord)
+        self.algorithm.measure(measRecord, exposure, refRecord, refWcs)
 
     def fail(self, measRecord, error=None):
         self.algorithm.fail(measRecord, error.cpp if error is not None else None)
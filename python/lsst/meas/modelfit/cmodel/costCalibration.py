@@ -0,0 +1,145 @@
+#
+# LSST Data Management System
+# Copyright 2008-2017 LSST/AURA.
+#
+# This product includes software developed by the
+# LSST Project (http://www.lsst.org/).
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the LSST License Statement and
+# the GNU General Public License along with this program.  If not,
+# see <http://www.lsstcorp.org/LegalNotices/>.
+#
+
+__all__ = ("makeCModelCostTrainingSet", "calibrateCModelCostModel")
+
+import numpy
+
+import lsst.afw.geom.ellipses
+import lsst.shapelet
+
+from .cmodel import CModelCostModel
+
+STAGE_NAMES = ("initial", "exp", "dev")
+
+
+def makeCModelCostTrainingSet(algorithm, catalogs, name="modelfit_CModel", shapeName="base_SdssShape",
+                              kronRadiusName="ext_photometryKron_KronFlux_radius", fluxName="base_PsfFlux"):
+    """Extract CModelCostModel features and recorded times and iteration
+    counts from previous CModel catalogs.
+
+    Parameters
+    ----------
+    algorithm : `CModelAlgorithm`
+        Algorithm configured as it was when the catalogs were measured; used
+        to compute the features.
+    catalogs : iterable of `lsst.afw.table.SourceCatalog`
+        Catalogs with CModel outputs, including the per-stage ``time``
+        fields (``doRecordTime``) and, optionally, the per-stage ``nIter``
+        fields (``doRecordHistory``), as well as the shapelet PSF
+        approximation and the moments, Kron radius and flux fields used to
+        compute features.
+    name : `str`
+        Field name prefix of the CModel outputs.
+    shapeName : `str`
+        Field name prefix of the source moments.
+    kronRadiusName : `str` or `None`
+        Name of the Kron radius field; if `None`, the Kron radius is treated
+        as unavailable.
+    fluxName : `str` or `None`
+        Field name prefix of the flux and uncertainty used to estimate the
+        signal-to-noise ratio; if `None`, it is treated as unavailable.
+
+    Returns
+    -------
+    features : `numpy.ndarray`
+        (N, CModelCostModel.N_FEATURES) array of time features.
+    iterationFeatures : `numpy.ndarray`
+        (N, CModelCostModel.N_ITERATION_FEATURES) array of iteration-count
+        features.
+    times : `numpy.ndarray`
+        (N,) array of total time spent in all stages, in seconds.
+    iterations : `numpy.ndarray`
+        (N,) array of total iterations in all stages; NaN if not recorded.
+    """
+    features = []
+    iterationFeatures = []
+    times = []
+    iterations = []
+    for catalog in catalogs:
+        psfKey = lsst.shapelet.MultiShapeletFunctionKey(catalog.schema[algorithm.getControl().psfName])
+        haveIterations = all("%s_%s_nIter" % (name, stage) in catalog.schema.getNames()
+                             for stage in STAGE_NAMES)
+        for record in catalog:
+            try:
+                moments = lsst.afw.geom.ellipses.Quadrupole(record.get(shapeName + "_xx"),
+                                                            record.get(shapeName + "_yy"),
+                                                            record.get(shapeName + "_xy"))
+                psf = record.get(psfKey)
+            except Exception:
+                continue
+            kronRadius = record.get(kronRadiusName) if kronRadiusName is not None else -1.0
+            snr = float("nan")
+            if fluxName is not None:
+                snr = record.get(fluxName + "_instFlux")/record.get(fluxName + "_instFluxErr")
+            footprintArea = record.getFootprint().getArea() if record.getFootprint() is not None else -1
+            time = sum(record.get("%s_%s_time" % (name, stage)) for stage in STAGE_NAMES)
+            if not numpy.isfinite(time):
+                continue
+            features.append(algorithm.computeCostFeatures(psf, moments, kronRadius, footprintArea, snr))
+            iterationFeatures.append(CModelCostModel.computeIterationFeatures(snr))
+            times.append(time)
+            if haveIterations:
+                iterations.append(sum(record.get("%s_%s_nIter" % (name, stage)) for stage in STAGE_NAMES))
+            else:
+                iterations.append(numpy.nan)
+    return (numpy.array(features).reshape(-1, CModelCostModel.N_FEATURES),
+            numpy.array(iterationFeatures).reshape(-1, CModelCostModel.N_ITERATION_FEATURES),
+            numpy.array(times, dtype=float), numpy.array(iterations, dtype=float))
+
+
+def calibrateCModelCostModel(features, iterationFeatures, times, iterations, minCount=10):
+    """Fit the CModelCostModel coefficients by least squares.
+
+    Parameters
+    ----------
+    features : `numpy.ndarray`
+        (N, CModelCostModel.N_FEATURES) array of time features, as returned
+        by `makeCModelCostTrainingSet`.
+    iterationFeatures : `numpy.ndarray`
+        (N, CModelCostModel.N_ITERATION_FEATURES) array of iteration-count
+        features, as returned by `makeCModelCostTrainingSet`.
+    times : `numpy.ndarray`
+        (N,) array of recorded times; non-finite values are ignored.
+    iterations : `numpy.ndarray`
+        (N,) array of recorded iteration counts; non-finite values are
+        ignored.  If fewer than ``minCount`` are usable, the uncalibrated
+        iteration-count coefficients are kept.
+    minCount : `int`
+        Minimum number of usable sources.
+
+    Returns
+    -------
+    costModel : `CModelCostModel`
+        Calibrated cost model; use its ``writeFits`` method to persist it.
+    """
+    good = numpy.logical_and(numpy.isfinite(times), numpy.isfinite(features).all(axis=1))
+    if good.sum() < minCount:
+        raise ValueError("Only %d usable sources; need at least %d" % (good.sum(), minCount))
+    timeCoefficients, _, _, _ = numpy.linalg.lstsq(features[good], times[good], rcond=None)
+    iterationCoefficients = CModelCostModel().getIterationCoefficients()
+    good = numpy.isfinite(iterations)
+    if good.sum() >= minCount:
+        iterationCoefficients, _, _, _ = numpy.linalg.lstsq(iterationFeatures[good], iterations[good],
+                                                            rcond=None)
+    return CModelCostModel(numpy.ascontiguousarray(timeCoefficients, dtype=float),
+                           numpy.ascontiguousarray(iterationCoefficients, dtype=float))
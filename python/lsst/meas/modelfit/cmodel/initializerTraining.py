@@ -0,0 +1,124 @@
+#
+# LSST Data Management System
+# Copyright 2008-2017 LSST/AURA.
+#
+# This product includes software developed by the
+# LSST Project (http://www.lsst.org/).
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the LSST License Statement and
+# the GNU General Public License along with this program.  If not,
+# see <http://www.lsstcorp.org/LegalNotices/>.
+#
+
+__all__ = ("makeCModelInitializerTrainingSet", "trainCModelInitializer")
+
+import numpy
+
+import lsst.afw.geom.ellipses
+
+from .cmodel import CModelInitializer
+
+STAGE_NAMES = ("initial", "exp", "dev")
+
+
+def _getQuadrupole(record, prefix):
+    return lsst.afw.geom.ellipses.Quadrupole(record.get(prefix + "_xx"), record.get(prefix + "_yy"),
+                                             record.get(prefix + "_xy"))
+
+
+def makeCModelInitializerTrainingSet(catalogs, name="modelfit_CModel", shapeName="base_SdssShape",
+                                     psfShapeName="base_SdssShape_psf",
+                                     kronRadiusName="ext_photometryKron_KronFlux_radius"):
+    """Extract CModelInitializer features and per-stage targets from
+    previous CModel catalogs.
+
+    Parameters
+    ----------
+    catalogs : iterable of `lsst.afw.table.SourceCatalog`
+        Catalogs with CModel outputs and the moments, PSF moments, and Kron
+        radius fields used to compute features.
+    name : `str`
+        Field name prefix of the CModel outputs.
+    shapeName : `str`
+        Field name prefix of the source moments.
+    psfShapeName : `str`
+        Field name prefix of the PSF moments.
+    kronRadiusName : `str` or `None`
+        Name of the Kron radius field; if `None`, the Kron radius is treated
+        as unavailable.
+
+    Returns
+    -------
+    features : `numpy.ndarray`
+        (N, CModelInitializer.N_FEATURES) array of features.
+    targets : `numpy.ndarray`
+        (N, CModelInitializer.N_STAGES) array of log half-light radii in
+        units of the PSF radius; NaN where a stage failed.
+    """
+    features = []
+    targets = []
+    for catalog in catalogs:
+        for record in catalog:
+            try:
+                moments = _getQuadrupole(record, shapeName)
+                psfMoments = _getQuadrupole(record, psfShapeName)
+                psfRadius = psfMoments.getDeterminantRadius()
+            except Exception:
+                continue
+            if not (psfRadius > 0.0 and moments.getDeterminantRadius() > 0.0):
+                continue
+            kronRadius = record.get(kronRadiusName) if kronRadiusName is not None else -1.0
+            # Use the signal-to-noise estimate CModel recorded, which is the same quantity it will
+            # pass to the initializer, rather than recomputing one from a different flux.
+            snr = record.get(name + "_snr")
+            features.append(CModelInitializer.computeFeatures(moments, psfMoments, kronRadius, snr))
+            row = numpy.full(CModelInitializer.N_STAGES, numpy.nan)
+            for i, stage in enumerate(STAGE_NAMES):
+                prefix = "%s_%s" % (name, stage)
+                if record.get(prefix + "_flag"):
+                    continue
+                radius = _getQuadrupole(record, prefix + "_ellipse").getDeterminantRadius()
+                if radius > 0.0:
+                    row[i] = numpy.log(radius/psfRadius)
+            targets.append(row)
+    return (numpy.array(features).reshape(-1, CModelInitializer.N_FEATURES),
+            numpy.array(targets).reshape(-1, CModelInitializer.N_STAGES))
+
+
+def trainCModelInitializer(features, targets, minCount=10):
+    """Fit the CModelInitializer regression coefficients by least squares.
+
+    Parameters
+    ----------
+    features : `numpy.ndarray`
+        (N, CModelInitializer.N_FEATURES) array of features, as returned by
+        `makeCModelInitializerTrainingSet`.
+    targets : `numpy.ndarray`
+        (N, CModelInitializer.N_STAGES) array of targets, as returned by
+        `makeCModelInitializerTrainingSet`; non-finite values are ignored.
+    minCount : `int`
+        Minimum number of usable sources for each stage.
+
+    Returns
+    -------
+    initializer : `CModelInitializer`
+        Trained initializer; use its ``writeFits`` method to persist it.
+    """
+    coefficients = numpy.zeros((CModelInitializer.N_STAGES, CModelInitializer.N_FEATURES), dtype=float)
+    for i in range(CModelInitializer.N_STAGES):
+        good = numpy.logical_and(numpy.isfinite(targets[:, i]), numpy.isfinite(features).all(axis=1))
+        if good.sum() < minCount:
+            raise ValueError("Only %d usable sources for stage '%s'; need at least %d"
+                             % (good.sum(), STAGE_NAMES[i], minCount))
+        coefficients[i], _, _, _ = numpy.linalg.lstsq(features[good], targets[good, i], rcond=None)
+    return CModelInitializer(coefficients)
@@ -22,8 +22,12 @@
  */
 
 #include "pybind11/pybind11.h"
+#include "pybind11/stl.h"
+
+#include "ndarray/pybind11.h"
 
 #include "lsst/meas/modelfit/integrals.h"
+#include "lsst/meas/modelfit/vectorMath.h"
 
 namespace py = pybind11;
 using namespace pybind11::literals;
@@ -36,6 +40,28 @@ namespace {
 PYBIND11_MODULE(integrals, mod) {
     mod.def("phid", &detail::phid);
     mod.def("bvnu", &detail::bvnu);
+    mod.def("vectorExp", [](ndarray::Array<Scalar const,1,1> const & x) {
+        ndarray::Array<Scalar,1,1> out = ndarray::allocate(x.getSize<0>());
+        detail::vectorExp(x.getData(), out.getData(), x.getSize<0>());
+        return out;
+    }, "x"_a);
+    mod.def("vectorErfc", [](ndarray::Array<Scalar const,1,1> const & x) {
+        ndarray::Array<Scalar,1,1> out = ndarray::allocate(x.getSize<0>());
+        detail::vectorErfc(x.getData(), out.getData(), x.getSize<0>());
+        return out;
+    }, "x"_a);
+    mod.def("vectorPolynomial", [](
+        ndarray::Array<Scalar const,1,1> const & coefficients,
+        ndarray::Array<Scalar const,1,1> const & x
+    ) {
+        ndarray::Array<Scalar,1,1> out = ndarray::allocate(x.getSize<0>());
+        detail::vectorPolynomial(coefficients.getData(), coefficients.getSize<0>(),
+                                 x.getData(), out.getData(), x.getSize<0>());
+        return out;
+    }, "coefficients"_a, "x"_a);
+    mod.def("getVectorMathBackend", &detail::getVectorMathBackend);
+    mod.def("getVectorMathBackends", &detail::getVectorMathBackends);
+    mod.def("setVectorMathBackend", &detail::setVectorMathBackend, "name"_a);
 }
 
 }
@@ -24,8 +24,10 @@
 #include "pybind11/pybind11.h"
 
 #include "ndarray/pybind11.h"
+#include "ndarray/eigen.h"
 
 #include "lsst/meas/modelfit/Likelihood.h"
+#include "lsst/meas/modelfit/ModelMatrix.h"
 
 namespace py = pybind11;
 using namespace pybind11::literals;
@@ -36,6 +38,7 @@ namespace modelfit {
 namespace {
 
 using PyLikelihood = py::class_<Likelihood, std::shared_ptr<Likelihood>>;
+using PyModelMatrix = py::class_<ModelMatrix, std::shared_ptr<ModelMatrix>>;
 
 PYBIND11_MODULE(likelihood, mod) {
     py::module::import("lsst.meas.modelfit.model");
@@ -53,6 +56,31 @@ PYBIND11_MODULE(likelihood, mod) {
     cls.def("getModel", &Likelihood::getModel);
     cls.def("computeModelMatrix", &Likelihood::computeModelMatrix, "modelMatrix"_a, "nonlinear"_a,
             "doApplyWeights"_a = true);
+    cls.def("updateModelMatrix", &Likelihood::updateModelMatrix, "modelMatrix"_a, "nonlinear"_a,
+            "previousNonlinear"_a, "doApplyWeights"_a = true);
+    cls.def("computeModelImage", &Likelihood::computeModelImage, "modelImage"_a, "nonlinear"_a,
+            "amplitudes"_a, "doApplyWeights"_a = true);
+
+    PyModelMatrix clsModelMatrix(mod, "ModelMatrix");
+    clsModelMatrix.attr("ALIGNMENT") = py::cast(int(ModelMatrix::ALIGNMENT));
+    clsModelMatrix.def(py::init<>());
+    clsModelMatrix.def(py::init<int, int>(), "nRows"_a, "nCols"_a);
+    clsModelMatrix.def("resize", &ModelMatrix::resize, "nRows"_a, "nCols"_a);
+    clsModelMatrix.def("getRows", &ModelMatrix::getRows);
+    clsModelMatrix.def("getCols", &ModelMatrix::getCols);
+    clsModelMatrix.def("getStride", &ModelMatrix::getStride);
+    clsModelMatrix.def("getArray", &ModelMatrix::getArray);
+
+    mod.def("multiplyModelMatrix", &multiplyModelMatrix, "modelMatrix"_a, "amplitudes"_a, "output"_a);
+    // The C++ version takes an Eigen matrix, which can't be modified in place from Python.
+    mod.def("addModelMatrixGram",
+            [](ndarray::Array<Pixel const, 2, -1> const &modelMatrix,
+               ndarray::Array<Scalar, 2, 2> const &hessian) {
+                Matrix tmp = ndarray::asEigenMatrix(hessian);
+                addModelMatrixGram(modelMatrix, tmp);
+                ndarray::asEigenMatrix(hessian) = tmp;
+            },
+            "modelMatrix"_a, "hessian"_a);
 }
 
 }
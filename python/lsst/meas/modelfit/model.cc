@@ -78,6 +78,21 @@ PYBIND11_MODULE(model, mod) {
                                              ndarray::Array<Scalar const, 1, 1> const &) const) &
                     Model::writeEllipses,
             "nonlinear"_a, "fixed"_a);
+    cls.def("writeFlatEllipses",
+            [](Model const & self, ndarray::Array<Scalar const, 1, 1> const & nonlinear,
+               ndarray::Array<Scalar const, 1, 1> const & fixed) {
+                FlatEllipseVector flat = self.writeFlatEllipses(nonlinear, fixed);
+                ndarray::Array<Scalar, 2, 2> result = ndarray::allocate(flat.size(), 5);
+                for (std::size_t i = 0; i < flat.size(); ++i) {
+                    result[i][0] = flat[i].xx;
+                    result[i][1] = flat[i].yy;
+                    result[i][2] = flat[i].xy;
+                    result[i][3] = flat[i].x;
+                    result[i][4] = flat[i].y;
+                }
+                return result;
+            },
+            "nonlinear"_a, "fixed"_a);
     cls.def("readEllipses",
             (void (Model::*)(Model::EllipseVector const &, ndarray::Array<Scalar, 1, 1> const &,
                              ndarray::Array<Scalar, 1, 1> const &) const) &
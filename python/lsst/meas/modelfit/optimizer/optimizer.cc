@@ -22,6 +22,7 @@
  */
 
 #include "pybind11/pybind11.h"
+#include "pybind11/stl.h"
 
 #include "ndarray/pybind11.h"
 
@@ -41,7 +42,29 @@ namespace meas {
 namespace modelfit {
 namespace {
 
-using PyOptimizerObjective = py::class_<OptimizerObjective, std::shared_ptr<OptimizerObjective>>;
+// Trampoline that lets OptimizerObjective be subclassed in Python (mostly for testing); only the
+// residual methods can be overridden.
+class PyOverridableOptimizerObjective : public OptimizerObjective {
+public:
+    using OptimizerObjective::OptimizerObjective;
+
+    void computeResiduals(ndarray::Array<Scalar const, 1, 1> const &parameters,
+                          ndarray::Array<Scalar, 1, 1> const &residuals) const override {
+        PYBIND11_OVERLOAD_PURE(void, OptimizerObjective, computeResiduals, parameters, residuals);
+    }
+
+    std::vector<ResidualBlock> getResidualBlocks() const override {
+        PYBIND11_OVERLOAD(std::vector<ResidualBlock>, OptimizerObjective, getResidualBlocks, );
+    }
+
+    void computeBlockResiduals(ndarray::Array<Scalar const, 1, 1> const &parameters, int block,
+                               ndarray::Array<Scalar, 1, 1> const &residuals) const override {
+        PYBIND11_OVERLOAD(void, OptimizerObjective, computeBlockResiduals, parameters, block, residuals);
+    }
+};
+
+using PyOptimizerObjective = py::class_<OptimizerObjective, PyOverridableOptimizerObjective,
+                                        std::shared_ptr<OptimizerObjective>>;
 using PyOptimizerControl = py::class_<OptimizerControl, std::shared_ptr<OptimizerControl>>;
 using PyOptimizerHistoryRecorder =
         py::class_<OptimizerHistoryRecorder, std::shared_ptr<OptimizerHistoryRecorder>>;
@@ -49,21 +72,34 @@ using PyOptimizer = py::class_<Optimizer, std::shared_ptr<Optimizer>>;
 
 static PyOptimizerObjective declareOptimizerObjective(py::module &mod) {
     PyOptimizerObjective cls(mod, "OptimizerObjective");
-    // Class is abstract, so no constructor.
+    // Class is abstract; the constructor is only for Python subclasses.
+    cls.def(py::init<int, int>(), "dataSize"_a, "parameterSize"_a);
     cls.def_readonly("dataSize", &OptimizerObjective::dataSize);
     cls.def_readonly("parameterSize", &OptimizerObjective::parameterSize);
     cls.def_static("makeFromLikelihood", &OptimizerObjective::makeFromLikelihood, "likelihood"_a,
                    "prior"_a = nullptr);
-    // class is abstract and not subclassable in Python, so we don't wrap the ctor
     cls.def("fillObjectiveValueGrid", &OptimizerObjective::fillObjectiveValueGrid, "parameters"_a,
             "output"_a);
     cls.def("computeResiduals", &OptimizerObjective::computeResiduals, "parameters"_a, "residuals"_a);
+    cls.def("computeResidualsOnly", &OptimizerObjective::computeResidualsOnly, "parameters"_a,
+            "residuals"_a);
     cls.def("differentiateResiduals", &OptimizerObjective::differentiateResiduals, "parameters"_a,
             "derivatives"_a);
     cls.def("hasPrior", &OptimizerObjective::hasPrior);
     cls.def("computePrior", &OptimizerObjective::computePrior, "parameters"_a);
     cls.def("differentiatePrior", &OptimizerObjective::differentiatePrior, "parameters"_a, "gradient"_a,
             "hessian"_a);
+    cls.def("computeNegLogPrior", &OptimizerObjective::computeNegLogPrior, "parameters"_a);
+    cls.def("differentiateNegLogPrior", &OptimizerObjective::differentiateNegLogPrior, "parameters"_a,
+            "gradient"_a, "hessian"_a);
+    cls.def("getResidualBlocks", &OptimizerObjective::getResidualBlocks);
+    cls.def("computeBlockResiduals", &OptimizerObjective::computeBlockResiduals, "parameters"_a, "block"_a,
+            "residuals"_a);
+    py::class_<OptimizerObjective::ResidualBlock> clsBlock(cls, "ResidualBlock");
+    clsBlock.def(py::init<>());
+    clsBlock.def_readwrite("parameterBegin", &OptimizerObjective::ResidualBlock::parameterBegin);
+    clsBlock.def_readwrite("parameterEnd", &OptimizerObjective::ResidualBlock::parameterEnd);
+    clsBlock.def_readwrite("rows", &OptimizerObjective::ResidualBlock::rows);
     return cls;
 }
 
@@ -87,6 +123,7 @@ static PyOptimizerControl declareOptimizerControl(py::module &mod) {
     LSST_DECLARE_CONTROL_FIELD(cls, OptimizerControl, maxInnerIterations);
     LSST_DECLARE_CONTROL_FIELD(cls, OptimizerControl, maxOuterIterations);
     LSST_DECLARE_CONTROL_FIELD(cls, OptimizerControl, doSaveIterations);
+    LSST_DECLARE_CONTROL_FIELD(cls, OptimizerControl, maxTime);
     cls.def(py::init<>());
     return cls;
 }
@@ -135,6 +172,7 @@ static PyOptimizer declareOptimizer(py::module &mod) {
     cls.attr("FAILED_MAX_ITERATIONS") = py::cast(int(Optimizer::FAILED_MAX_ITERATIONS));
     cls.attr("FAILED_EXCEPTION") = py::cast(int(Optimizer::FAILED_EXCEPTION));
     cls.attr("FAILED_NAN") = py::cast(int(Optimizer::FAILED_NAN));
+    cls.attr("FAILED_MAX_TIME") = py::cast(int(Optimizer::FAILED_MAX_TIME));
     cls.attr("FAILED") = py::cast(int(Optimizer::FAILED));
     cls.attr("STATUS_STEP_REJECTED") = py::cast(int(Optimizer::STATUS_STEP_REJECTED));
     cls.attr("STATUS_STEP_ACCEPTED") = py::cast(int(Optimizer::STATUS_STEP_ACCEPTED));
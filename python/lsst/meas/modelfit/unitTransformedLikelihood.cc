@@ -22,12 +22,15 @@
  */
 
 #include "pybind11/pybind11.h"
+#include "pybind11/eigen.h"
+#include "pybind11/functional.h"
 #include "pybind11/stl.h"
 
 #include "ndarray/pybind11.h"
 
 #include "lsst/pex/config/python.h"
 #include "lsst/meas/modelfit/UnitTransformedLikelihood.h"
+#include "lsst/meas/modelfit/StreamingLikelihood.h"
 
 namespace py = pybind11;
 using namespace pybind11::literals;
@@ -45,6 +48,10 @@ using PyEpochFootprint = py::class_<EpochFootprint, std::shared_ptr<EpochFootpri
 using PyUnitTransformedLikelihood =
         py::class_<UnitTransformedLikelihood, std::shared_ptr<UnitTransformedLikelihood>, Likelihood>;
 
+using PyNormalEquations = py::class_<NormalEquations, std::shared_ptr<NormalEquations>>;
+
+using PyStreamingLikelihood = py::class_<StreamingLikelihood, std::shared_ptr<StreamingLikelihood>>;
+
 PYBIND11_MODULE(unitTransformedLikelihood, mod) {
     py::module::import("lsst.afw.geom.ellipses");
     py::module::import("lsst.afw.detection");
@@ -56,6 +63,10 @@ PYBIND11_MODULE(unitTransformedLikelihood, mod) {
     PyUnitTransformedLikelihoodControl clsControl(mod, "UnitTransformedLikelihoodControl");
     LSST_DECLARE_CONTROL_FIELD(clsControl, UnitTransformedLikelihoodControl, usePixelWeights);
     LSST_DECLARE_CONTROL_FIELD(clsControl, UnitTransformedLikelihoodControl, weightsMultiplier);
+    LSST_DECLARE_CONTROL_FIELD(clsControl, UnitTransformedLikelihoodControl, parallelMinPixels);
+    LSST_DECLARE_CONTROL_FIELD(clsControl, UnitTransformedLikelihoodControl, parallelChunkSize);
+    LSST_DECLARE_CONTROL_FIELD(clsControl, UnitTransformedLikelihoodControl, parallelThreads);
+    LSST_DECLARE_CONTROL_FIELD(clsControl, UnitTransformedLikelihoodControl, fftMode);
     clsControl.def(py::init<bool>(), "usePixelWeights"_a = false);
 
     PyEpochFootprint clsEpochFootprint(mod, "EpochFootprint");
@@ -78,6 +89,32 @@ PYBIND11_MODULE(unitTransformedLikelihood, mod) {
                      geom::SpherePoint const &, std::vector<std::shared_ptr<EpochFootprint>> const &,
                      UnitTransformedLikelihoodControl const &>(),
             "model"_a, "fixed"_a, "fitSys"_a, "position"_a, "epochFootprintList"_a, "ctrl"_a);
+
+    PyNormalEquations clsNormalEquations(mod, "NormalEquations");
+    clsNormalEquations.def(py::init<int>(), "nParameters"_a = 0);
+    clsNormalEquations.def_readonly("hessian", &NormalEquations::hessian);
+    clsNormalEquations.def_readonly("gradient", &NormalEquations::gradient);
+    clsNormalEquations.def_readonly("chiSq", &NormalEquations::chiSq);
+    clsNormalEquations.def_readonly("dataDim", &NormalEquations::dataDim);
+
+    PyStreamingLikelihood clsStreamingLikelihood(mod, "StreamingLikelihood");
+    clsStreamingLikelihood.def(
+            py::init<std::shared_ptr<Model>, ndarray::Array<Scalar const, 1, 1> const &, UnitSystem const &,
+                     geom::SpherePoint const &, int, StreamingLikelihood::EpochLoader const &, int,
+                     UnitTransformedLikelihoodControl const &>(),
+            "model"_a, "fixed"_a, "fitSys"_a, "position"_a, "epochCount"_a, "loader"_a, "groupSize"_a,
+            "ctrl"_a);
+    clsStreamingLikelihood.def("getDataDim", &StreamingLikelihood::getDataDim);
+    clsStreamingLikelihood.def("getAmplitudeDim", &StreamingLikelihood::getAmplitudeDim);
+    clsStreamingLikelihood.def("getNonlinearDim", &StreamingLikelihood::getNonlinearDim);
+    clsStreamingLikelihood.def("getEpochCount", &StreamingLikelihood::getEpochCount);
+    clsStreamingLikelihood.def("getGroupSize", &StreamingLikelihood::getGroupSize);
+    clsStreamingLikelihood.def("getGroupCount", &StreamingLikelihood::getGroupCount);
+    clsStreamingLikelihood.def("getModel", &StreamingLikelihood::getModel);
+    clsStreamingLikelihood.def("computeAmplitudeNormalEquations",
+                               &StreamingLikelihood::computeAmplitudeNormalEquations, "nonlinear"_a);
+    clsStreamingLikelihood.def("computeNormalEquations", &StreamingLikelihood::computeNormalEquations,
+                               "parameters"_a, "nonlinearSteps"_a);
 }
 
 }
@@ -20,19 +20,32 @@
  * the GNU General Public License along with this program.  If not,
  * see <http://www.lsstcorp.org/LegalNotices/>.
  */
+#include <cstdint>
 #include <cstdlib>
 #include <memory>
+#include <map>
+#include <numeric>
+#include <type_traits>
 #include <bitset>
+#include <chrono>
 #include <filesystem>
+#include <mutex>
 
 #include "ndarray/eigen.h"
 
+#include "lsst/log/Log.h"
 #include "lsst/afw/detection/FootprintSet.h"
 #include "lsst/afw/detection/Psf.h"
+#include "lsst/afw/geom/SkyWcs.h"
+#include "lsst/afw/geom/SpanSet.h"
+#include "lsst/afw/geom/transformFactory.h"
 #include "lsst/geom/SpherePoint.h"
 #include "lsst/afw/math/LeastSquares.h"
+#include "lsst/shapelet/constants.h"
 #include "lsst/shapelet/FunctorKeys.h"
+#include "lsst/shapelet/MultiShapeletFunction.h"
 #include "lsst/meas/modelfit/TruncatedGaussian.h"
+#include "lsst/meas/modelfit/ModelMatrix.h"
 #include "lsst/meas/modelfit/MultiModel.h"
 #include "lsst/meas/modelfit/CModel.h"
 #include "lsst/meas/base/constants.h"
@@ -57,6 +70,167 @@ Pixel computeFluxInFootprint(
     return std::max(a, b);
 }
 
+Scalar computeVarianceInFootprint(
+    afw::image::Image<afw::image::VariancePixel> const & variance,
+    afw::detection::Footprint const & footprint
+) {
+    ndarray::Array<afw::image::VariancePixel,1,1> flat
+        = footprint.getSpans()->flatten(variance.getArray(), variance.getXY0());
+    return ndarray::asEigenArray(flat).cast<Scalar>().sum();
+}
+
+// Transform a fit region ellipse from the pixel coordinates of the image a reference fit was run on to
+// the pixel coordinates of the image being measured.  We go through the fitSys coordinate system, which
+// depends only on the sky position of the source, so the result is the same no matter which of the two
+// images we use to define it; referenceFitSysToMeasSys is the transform from fitSys to the reference
+// image's pixel coordinates.
+afw::geom::ellipses::Quadrupole transformReferenceRegion(
+    afw::geom::ellipses::Quadrupole const & region,
+    LocalUnitTransform const & referenceFitSysToMeasSys,
+    afw::image::Exposure<Pixel> const & exposure,
+    geom::Point2D const & center
+) {
+    UnitSystem fitSys(exposure.getWcs()->pixelToSky(center), exposure.getPhotoCalib(), 1.0);
+    LocalUnitTransform fitSysToMeasSys(fitSys.wcs->getPixelOrigin(), fitSys, UnitSystem(exposure));
+    return region.transform(
+        fitSysToMeasSys.geometric.getLinear() * referenceFitSysToMeasSys.geometric.getLinear().inverted()
+    );
+}
+
+// Bin the pixels of an exposure within a footprint by binFactor in each dimension (summing image and
+// variance, so fluxes keep their units), for the coarse pass of coarse-to-fine fitting.  Only binned
+// pixels that lie entirely within the footprint are included.  The Wcs is modified to describe the binned
+// pixel grid, and the PSF is rescaled to it after being convolved with the (discrete) box that summing
+// pixels amounts to, so evaluating the model at binned pixel centers matches the binned data.  Returns
+// null if no binned pixels lie entirely within the footprint.
+PTR(EpochFootprint) makeBinnedEpoch(
+    afw::image::Exposure<Pixel> const & exposure,
+    afw::detection::Footprint const & footprint,
+    shapelet::MultiShapeletFunction const & psf,
+    int binFactor
+) {
+    auto floorDiv = [binFactor](int a) {
+        return (a >= 0) ? a / binFactor : -((binFactor - 1 - a) / binFactor);
+    };
+    geom::Box2I const bbox = footprint.getBBox();
+    geom::Box2I const binnedBBox(
+        geom::Point2I(floorDiv(bbox.getMinX()), floorDiv(bbox.getMinY())),
+        geom::Point2I(floorDiv(bbox.getMaxX()), floorDiv(bbox.getMaxY()))
+    );
+    afw::image::MaskedImage<Pixel> binned(binnedBBox);
+    auto binnedImage = binned.getImage()->getArray();
+    auto binnedVariance = binned.getVariance()->getArray();
+    ndarray::Array<int,2,2> counts = ndarray::allocate(binnedBBox.getHeight(), binnedBBox.getWidth());
+    counts.deep() = 0;
+    auto image = exposure.getMaskedImage().getImage()->getArray();
+    auto variance = exposure.getMaskedImage().getVariance()->getArray();
+    geom::Point2I const xy0 = exposure.getXY0();
+    for (auto const & span : *footprint.getSpans()) {
+        int const y = span.getY();
+        int const j = floorDiv(y) - binnedBBox.getMinY();
+        for (int x = span.getX0(); x <= span.getX1(); ++x) {
+            int const i = floorDiv(x) - binnedBBox.getMinX();
+            binnedImage[j][i] += image[y - xy0.getY()][x - xy0.getX()];
+            binnedVariance[j][i] += variance[y - xy0.getY()][x - xy0.getX()];
+            ++counts[j][i];
+        }
+    }
+    std::vector<afw::geom::Span> spans;
+    int const fullCount = binFactor*binFactor;
+    for (int j = 0; j < binnedBBox.getHeight(); ++j) {
+        int i = 0;
+        while (i < binnedBBox.getWidth()) {
+            if (counts[j][i] != fullCount) {
+                ++i;
+                continue;
+            }
+            int const begin = i;
+            while (i < binnedBBox.getWidth() && counts[j][i] == fullCount) ++i;
+            spans.push_back(
+                afw::geom::Span(
+                    j + binnedBBox.getMinY(),
+                    begin + binnedBBox.getMinX(),
+                    i - 1 + binnedBBox.getMinX()
+                )
+            );
+        }
+    }
+    if (spans.empty()) return PTR(EpochFootprint)();
+    afw::detection::Footprint binnedFootprint(std::make_shared<afw::geom::SpanSet>(std::move(spans)));
+    // Binned pixel (i, j) covers original pixels [binFactor*i, binFactor*i + binFactor - 1] (and the same
+    // in y), so its center maps to binFactor*i + (binFactor - 1)/2.
+    Scalar const offset = 0.5*(binFactor - 1);
+    geom::AffineTransform const binnedToOriginal(
+        geom::LinearTransform::makeScaling(binFactor),
+        geom::Extent2D(offset, offset)
+    );
+    afw::image::Exposure<Pixel> binnedExposure(
+        binned,
+        afw::geom::makeModifiedWcs(afw::geom::makeTransform(binnedToOriginal), *exposure.getWcs(), false)
+    );
+    binnedExposure.setPhotoCalib(exposure.getPhotoCalib());
+    shapelet::ShapeletFunction box(0, shapelet::HERMITE, std::sqrt((fullCount - 1)/12.0));
+    box.getCoefficients()[0] = 1.0 / shapelet::ShapeletFunction::FLUX_FACTOR;
+    shapelet::MultiShapeletFunction binnedPsf = psf.convolve(box);
+    binnedPsf.transformInPlace(geom::AffineTransform(geom::LinearTransform::makeScaling(1.0/binFactor)));
+    binnedPsf.normalize();
+    return std::make_shared<EpochFootprint>(binnedFootprint, binnedExposure, binnedPsf);
+}
+
+// Select a deterministic, stratified random subset of about fraction of the pixels in a footprint, for the
+// subsampled passes of the nonlinear fits: the pixels are divided (in span order) into strata of
+// round(1/fraction) consecutive pixels, and one pixel is chosen from each stratum using a hash of the
+// stratum index seeded by the footprint's bounding box, so the subset depends only on the inputs.
+// Returns null if the subset would include every pixel.
+PTR(afw::detection::Footprint) makeSubsampledFootprint(
+    afw::detection::Footprint const & footprint,
+    Scalar fraction
+) {
+    std::int64_t const stride = std::llround(1.0 / fraction);
+    if (stride <= 1) return PTR(afw::detection::Footprint)();
+    geom::Box2I const bbox = footprint.getBBox();
+    std::uint64_t const seed = (static_cast<std::uint64_t>(static_cast<std::uint32_t>(bbox.getMinX())) << 32)
+        | static_cast<std::uint32_t>(bbox.getMinY());
+    auto hash = [seed](std::uint64_t n) {  // splitmix64 finalizer
+        std::uint64_t z = seed + (n + 1)*0x9E3779B97F4A7C15ULL;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    };
+    std::int64_t const area = footprint.getArea();
+    std::vector<afw::geom::Span> spans;
+    spans.reserve(area / stride + 1);
+    std::int64_t n = 0;
+    std::int64_t chosen = -1;
+    for (auto const & span : *footprint.getSpans()) {
+        for (int x = span.getX0(); x <= span.getX1(); ++x, ++n) {
+            if (n % stride == 0) {
+                std::int64_t const size = std::min(stride, area - n);
+                chosen = n + static_cast<std::int64_t>(hash(n / stride) % size);
+            }
+            if (n == chosen) {
+                spans.push_back(afw::geom::Span(span.getY(), x, x));
+            }
+        }
+    }
+    if (spans.empty()) return PTR(afw::detection::Footprint)();
+    return std::make_shared<afw::detection::Footprint>(
+        std::make_shared<afw::geom::SpanSet>(std::move(spans))
+    );
+}
+
+// Return the path to a file in the data directory of this package; what describes the file for errors.
+std::filesystem::path getDataPath(std::string const & filename, std::string const & what) {
+    char const * pkgDir = std::getenv("MEAS_MODELFIT_DIR");
+    if (!pkgDir) {
+        throw LSST_EXCEPT(
+            meas::base::FatalAlgorithmError,
+            "MEAS_MODELFIT_DIR environment variable not defined; cannot find persisted " + what
+        );
+    }
+    return std::filesystem::path(pkgDir) / std::filesystem::path("data") / std::filesystem::path(filename);
+}
+
 } // anonymous
 
 //-------------------- Control Objects ----------------------------------------------------------------------
@@ -69,17 +243,7 @@ PTR(Prior) CModelStageControl::getPrior() const {
     if (priorSource == "NONE") {
         return PTR(Prior)();
     } else if (priorSource == "FILE") {
-        char const * pkgDir = std::getenv("MEAS_MODELFIT_DIR");
-        if (!pkgDir) {
-            throw LSST_EXCEPT(
-                meas::base::FatalAlgorithmError,
-                "MEAS_MODELFIT_DIR environment variable not defined; cannot find persisted Priors"
-            );
-        }
-        std::filesystem::path priorPath
-            = std::filesystem::path(pkgDir)
-            / std::filesystem::path("data")
-            / std::filesystem::path(priorName + ".fits");
+        std::filesystem::path priorPath = getDataPath(priorName + ".fits", "Priors");
         PTR(Mixture) mixture = Mixture::readFits(priorPath.string());
         return std::make_shared<MixturePrior>(mixture, "single-ellipse");
     } else if (priorSource == "LINEAR") {
@@ -94,6 +258,45 @@ PTR(Prior) CModelStageControl::getPrior() const {
     }
 }
 
+OptimizerControl CModelStageControl::getOptimizerControl(Scalar snr) const {
+    OptimizerControl result(optimizer);
+    if (doAdaptiveConvergence && snr > 0.0) {
+        Scalar scale = std::min(std::max(adaptiveReferenceSnr / snr, 1.0), adaptiveMaxScale);
+        result.gradientThreshold *= scale;
+        result.minTrustRadiusThreshold *= scale;
+        result.maxOuterIterations = std::max(
+            std::min(adaptiveMinOuterIterations, optimizer.maxOuterIterations),
+            static_cast<int>(std::ceil(optimizer.maxOuterIterations / scale))
+        );
+    }
+    return result;
+}
+
+UnitTransformedLikelihoodControl CModelStageControl::getLikelihoodControl(Scalar weightsScale) const {
+    UnitTransformedLikelihoodControl result(usePixelWeights, weightsMultiplier*weightsScale);
+    result.parallelMinPixels = parallelMinPixels;
+    result.parallelThreads = parallelThreads;
+    result.fftMode = fftMode;
+    return result;
+}
+
+PTR(CModelInitializer) CModelControl::getInitializer() const {
+    if (initializerSource == "MOMENTS") {
+        return PTR(CModelInitializer)();
+    } else if (initializerSource == "FILE") {
+        std::filesystem::path path(initializerName);
+        if (!path.is_absolute()) {
+            path = getDataPath(initializerName + ".fits", "CModelInitializers");
+        }
+        return CModelInitializer::readFits(path.string());
+    } else {
+        throw LSST_EXCEPT(
+            meas::base::FatalAlgorithmError,
+            "initializerSource must be one of 'MOMENTS' or 'FILE'"
+        );
+    }
+}
+
 // ------------------- Result Objects -----------------------------------------------------------------------
 
 CModelStageResult::CModelStageResult() :
@@ -101,6 +304,11 @@ CModelStageResult::CModelStageResult() :
     instFluxErr(std::numeric_limits<Scalar>::quiet_NaN()),
     instFluxInner(std::numeric_limits<Scalar>::quiet_NaN()),
     objective(std::numeric_limits<Scalar>::quiet_NaN()),
+    time(std::numeric_limits<Scalar>::quiet_NaN()),
+    gradientThreshold(std::numeric_limits<Scalar>::quiet_NaN()),
+    minTrustRadiusThreshold(std::numeric_limits<Scalar>::quiet_NaN()),
+    maxOuterIterations(0),
+    nIter(0),
     ellipse(std::numeric_limits<Scalar>::quiet_NaN(), std::numeric_limits<Scalar>::quiet_NaN(),
             std::numeric_limits<Scalar>::quiet_NaN(), false)
 {
@@ -112,7 +320,8 @@ CModelResult::CModelResult() :
     instFluxErr(std::numeric_limits<Scalar>::quiet_NaN()),
     instFluxInner(std::numeric_limits<Scalar>::quiet_NaN()),
     fracDev(std::numeric_limits<Scalar>::quiet_NaN()),
-    objective(std::numeric_limits<Scalar>::quiet_NaN())
+    objective(std::numeric_limits<Scalar>::quiet_NaN()),
+    snr(std::numeric_limits<Scalar>::quiet_NaN())
 {
     flags[FAILED] = true;
 }
@@ -206,6 +415,20 @@ struct CModelStageKeys {
                     "Time spent in stage", "second"
                 );
             }
+            if (ctrl.doAdaptiveConvergence) {
+                gradientThreshold = schema.addField<Scalar>(
+                    schema.join(prefix, "gradientThreshold"),
+                    "optimizer gradient threshold used in the " + stage + " fit, after SNR scaling"
+                );
+                minTrustRadiusThreshold = schema.addField<Scalar>(
+                    schema.join(prefix, "minTrustRadiusThreshold"),
+                    "optimizer trust radius threshold used in the " + stage + " fit, after SNR scaling"
+                );
+                maxOuterIterations = schema.addField<int>(
+                    schema.join(prefix, "maxOuterIterations"),
+                    "optimizer iteration limit used in the " + stage + " fit, after SNR scaling"
+                );
+            }
         } else {
             flags[CModelStageResult::BAD_REFERENCE] = schema.addField<afw::table::Flag>(
                 schema.join(prefix, "flag", "badReference"),
@@ -221,6 +444,10 @@ struct CModelStageKeys {
             schema.join(prefix, "flag", "noFlux"),
             "no flux was measured on the image; this means the error will be non-finite."
         );
+        flags[CModelStageResult::MAX_TIME] = schema.addField<afw::table::Flag>(
+            schema.join(prefix, "flag", "maxTime"),
+            "the fit ran out of time; the best parameters found before the time limit are reported."
+        );
         flags[CModelStageResult::FAILED] = fluxFlag; // these flags refer to the same underlying field
     }
 
@@ -267,11 +494,16 @@ struct CModelStageKeys {
             record.set(fixed, result.fixed);
         }
         if (nIter.isValid()) {
-            record.set(nIter, result.history.size());
+            record.set(nIter, result.nIter);
         }
         if (time.isValid()) {
             record.set(time, result.time);
         }
+        if (gradientThreshold.isValid()) {
+            record.set(gradientThreshold, result.gradientThreshold);
+            record.set(minTrustRadiusThreshold, result.minTrustRadiusThreshold);
+            record.set(maxOuterIterations, result.maxOuterIterations);
+        }
         for (int b = 0; b < CModelStageResult::N_FLAGS; ++b) {
             if (flags[b].isValid()) {
                 record.set(flags[b], result.flags[b]);
@@ -309,6 +541,9 @@ struct CModelStageKeys {
     afw::table::ArrayKey<Scalar> fixed;
     afw::table::Key<Scalar> time;
     afw::table::Key<int> nIter;
+    afw::table::Key<Scalar> gradientThreshold;
+    afw::table::Key<Scalar> minTrustRadiusThreshold;
+    afw::table::Key<int> maxOuterIterations;
 };
 
 // Master Keys object for CModel; holds keys that aren't specific to one nonlinear stage
@@ -400,6 +635,15 @@ struct CModelKeys {
                 schema.join(prefix, "flags", "region", "usedInitialEllipseMax"),
                 "the pixel region for the final fit was set to the upper bound defined by the initial fit"
             );
+            flags[CModelResult::REGION_COARSE_ONLY] = schema.addField<afw::table::Flag>(
+                schema.join(prefix, "flags", "region", "coarseOnly"),
+                "the fit region was larger than region.maxArea, so the nonlinear fits were only done on "
+                "binned pixels (see coarseOnlyForMaxArea)"
+            );
+            flags[CModelResult::GROUP_FIT] = schema.addField<afw::table::Flag>(
+                schema.join(prefix, "flags", "group"),
+                "the exp, dev, and linear fits were done jointly with overlapping neighbors"
+            );
             flags[CModelResult::NO_SHAPE] = schema.addField<afw::table::Flag>(
                 schema.join(prefix, "flag", "noShape"),
                 "the shape slot needed to initialize the parameters failed or was not defined"
@@ -428,6 +672,11 @@ struct CModelKeys {
                 "ellipse used to set the pixel region for the final fit (before applying bad pixel mask)",
                 afw::table::CoordinateType::PIXEL
             );
+            snr = schema.addField<Scalar>(
+                schema.join(prefix, "snr"),
+                "signal-to-noise estimate used to tune the fits (approximate flux over the root of the "
+                "summed variance in the initial fit region)"
+            );
         } else {
             flags[CModelResult::BAD_REFERENCE] = schema.addField<afw::table::Flag>(
                 schema.join(prefix, "flag", "badReference"),
@@ -479,6 +728,9 @@ struct CModelKeys {
         record.set(instFluxInner, result.instFluxInner);
         record.set(fracDev, result.fracDev);
         record.set(objective, result.objective);
+        if (snr.isValid()) {
+            record.set(snr, result.snr);
+        }
         if (initialFitRegion.isValid()) {
             record.set(initialFitRegion, result.initialFitRegion);
         }
@@ -531,6 +783,7 @@ struct CModelKeys {
     afw::table::Key<Scalar> instFluxInner;
     afw::table::Key<Scalar> fracDev;
     afw::table::Key<Scalar> objective;
+    afw::table::Key<Scalar> snr;
     afw::table::QuadrupoleKey initialFitRegion;
     afw::table::QuadrupoleKey finalFitRegion;
     afw::table::QuadrupoleKey ellipse;
@@ -540,6 +793,142 @@ struct CModelKeys {
 
 } // anonymous
 
+// ------------------- CModelWorkspace: scratch memory reused across sources --------------------------------
+
+// The workspace hands out two kinds of memory: parameter vectors, which are allocated from a per-source
+// arena (so several CModelStageData objects can be alive at once) that is recycled by reset(), and
+// pixel-sized buffers, of which there is exactly one of each kind, because each is only ever used by
+// one step of the fit at a time.  In both cases buffers only ever grow.
+class CModelWorkspace::Impl {
+public:
+
+    enum PixelBuffer {
+        MODEL_MATRIX = 0,
+        NORMALIZED_MODEL_MATRIX,
+        NORMALIZED_DATA,
+        NORMALIZED_VARIANCE,
+        LINEAR_MODEL,
+        N_PIXEL_BUFFERS
+    };
+
+    Impl() : growCount(0), _nParameters(0) {}
+
+    // Start a new source; parameter vectors handed out for previous sources may be reused.
+    void reset() { _nParameters = 0; }
+
+    // Return a parameter vector that will not be handed out again until the next call to reset().
+    ndarray::Array<Scalar,1,1> makeParameters(int size) {
+        if (_nParameters == _parameters.size()) {
+            _parameters.push_back(ndarray::Array<Scalar,1,1>());
+        }
+        return grow(_parameters[_nParameters++], size);
+    }
+
+    // Return the first size elements of one of the pixel buffers.
+    ndarray::Array<Pixel,1,1> getPixels(PixelBuffer which, int size) {
+        return grow(_pixels[which], size);
+    }
+
+    // Return an (nRows x nCols) model matrix with aligned, padded columns (see ModelMatrix).  Matrices
+    // use separate storage from the pixel buffers with the same PixelBuffer index.
+    ndarray::Array<Pixel,2,-1> getMatrix(PixelBuffer which, int nRows, int nCols) {
+        if (_matrices[which].resize(nRows, nCols)) {
+            ++growCount;
+        }
+        return _matrices[which].getArray();
+    }
+
+    int growCount;  // number of times any buffer has been (re)allocated
+
+private:
+
+    template <typename T>
+    ndarray::Array<T,1,1> grow(ndarray::Array<T,1,1> & buffer, int size) {
+        if (buffer.template getSize<0>() < size) {
+            buffer = ndarray::allocate(size);
+            ++growCount;
+        }
+        return buffer[ndarray::view(0, size)];
+    }
+
+    std::size_t _nParameters;
+    std::vector<ndarray::Array<Scalar,1,1>> _parameters;
+    ndarray::Array<Pixel,1,1> _pixels[N_PIXEL_BUFFERS];
+    ModelMatrix _matrices[N_PIXEL_BUFFERS];
+};
+
+CModelWorkspace::CModelWorkspace() : _impl(new Impl()) {}
+
+CModelWorkspace::~CModelWorkspace() {}
+
+int CModelWorkspace::getGrowCount() const { return _impl->growCount; }
+
+namespace {
+
+// A thread-safe free list of workspaces, so the CModelAlgorithm methods that aren't given a workspace
+// (including the measure() methods used by the plugins) still reuse memory from one source to the next.
+// Each call borrows a workspace for its whole duration, so concurrent calls never share one; the pool
+// only ever holds as many workspaces as there have been concurrent calls.
+class CModelWorkspacePool {
+public:
+
+    // RAII handle to a workspace borrowed from the pool; returns it to the pool when destroyed.
+    class Borrowed {
+    public:
+
+        explicit Borrowed(CModelWorkspacePool & pool) : _pool(pool), _workspace(pool._acquire()) {}
+
+        Borrowed(Borrowed const &) = delete;
+        Borrowed & operator=(Borrowed const &) = delete;
+
+        ~Borrowed() { _pool._release(std::move(_workspace)); }
+
+        CModelWorkspace::Impl & operator*() const { return *_workspace; }
+
+    private:
+        CModelWorkspacePool & _pool;
+        std::unique_ptr<CModelWorkspace::Impl> _workspace;
+    };
+
+    // Total number of buffer (re)allocations by the workspaces currently in the pool (i.e. not borrowed).
+    int getGrowCount() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        int count = 0;
+        for (auto const & workspace : _free) {
+            count += workspace->growCount;
+        }
+        return count;
+    }
+
+private:
+
+    std::unique_ptr<CModelWorkspace::Impl> _acquire() {
+        std::unique_ptr<CModelWorkspace::Impl> workspace;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_free.empty()) {
+                workspace = std::move(_free.back());
+                _free.pop_back();
+            }
+        }
+        if (!workspace) {
+            workspace.reset(new CModelWorkspace::Impl());
+        }
+        workspace->reset();
+        return workspace;
+    }
+
+    void _release(std::unique_ptr<CModelWorkspace::Impl> workspace) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _free.push_back(std::move(workspace));
+    }
+
+    mutable std::mutex _mutex;
+    std::vector<std::unique_ptr<CModelWorkspace::Impl>> _free;
+};
+
+} // anonymous
+
 // ------------------- CModelStageData: per-object data we pass around together a lot -----------------------
 
 // Of all the objects related to CModel, CModelStageData is the only that's created per-source (i.e. in the
@@ -559,21 +948,30 @@ struct CModelStageData {
     ndarray::Array<Scalar,1,1> amplitudes;  // linear parameters (a view into parameters array)
     ndarray::Array<Scalar,1,1> fixed;       // fixed parameters (not being fit, still needed to eval model)
     shapelet::MultiShapeletFunction psf;    // multi-shapelet approximation to PSF
+    CModelWorkspace::Impl * workspace;      // scratch memory for parameters and model matrices
+    Scalar snr;                             // signal-to-noise estimate (NaN if not needed)
+    std::chrono::steady_clock::time_point deadline; // end of the per-source time budget
 
     CModelStageData(
         afw::image::Exposure<Pixel> const & exposure,
         Scalar approxFlux, geom::Point2D const & center,
         shapelet::MultiShapeletFunction const & psf_,
-        Model const & model
+        Model const & model,
+        CModelWorkspace::Impl & workspace_
     ) :
         measSysCenter(center), position(exposure.getWcs()->pixelToSky(center)),
         measSys(exposure), fitSys(position, exposure.getPhotoCalib(), approxFlux),
         fitSysToMeasSys(fitSys.wcs->getPixelOrigin(), fitSys, measSys),
-        parameters(ndarray::allocate(model.getNonlinearDim() + model.getAmplitudeDim())),
+        parameters(workspace_.makeParameters(model.getNonlinearDim() + model.getAmplitudeDim())),
         nonlinear(parameters[ndarray::view(0, model.getNonlinearDim())]),
         amplitudes(parameters[ndarray::view(model.getNonlinearDim(), parameters.getSize<0>())]),
+        // fixed parameters are held by the likelihood objects we attach to results, so they can't
+        // live in the workspace.
         fixed(ndarray::allocate(model.getFixedDim())),
-        psf(psf_)
+        psf(psf_),
+        workspace(&workspace_),
+        snr(std::numeric_limits<Scalar>::quiet_NaN()),
+        deadline(std::chrono::steady_clock::time_point::max())
     {}
 
     CModelStageData changeModel(Model const & model) const {
@@ -587,7 +985,8 @@ struct CModelStageData {
         assert(model.getAmplitudeDim() == amplitudes.getSize<0>());
         assert(model.getFixedDim() == fixed.getSize<0>());
         CModelStageData r(*this);
-        r.parameters = ndarray::copy(parameters);
+        r.parameters = workspace->makeParameters(parameters.getSize<0>());
+        r.parameters.deep() = parameters;
         r.nonlinear = r.parameters[ndarray::view(0, model.getNonlinearDim())];
         r.amplitudes = r.parameters[ndarray::view(model.getNonlinearDim(), parameters.getSize<0>())];
         // don't need to deep-copy fixed parameters because they're, well, fixed
@@ -596,25 +995,92 @@ struct CModelStageData {
 
 };
 
+// Copy the nonlinear and fixed parameters from a reference result for the same stage to a warm-start
+// data object.
+void copyReferenceParameters(CModelStageResult const & reference, CModelStageData & data) {
+    LSST_THROW_IF_NE(
+        reference.nonlinear.getSize<0>(), data.nonlinear.getSize<0>(),
+        pex::exceptions::LengthError,
+        "Number of nonlinear parameters in reference (%d) does not match model (%d)"
+    );
+    LSST_THROW_IF_NE(
+        reference.fixed.getSize<0>(), data.fixed.getSize<0>(),
+        pex::exceptions::LengthError,
+        "Number of fixed parameters in reference (%d) does not match model (%d)"
+    );
+    data.nonlinear.deep() = reference.nonlinear;
+    data.fixed.deep() = reference.fixed;
+}
+
 } // anonymous
 
 // ------------------- Private Implementation objects -------------------------------------------------------
 
 namespace {
 
-// utility function to create a model matrix: just allocates space for the matrix and calls the likelihood
-// object to do the work.
+// utility function to create a model matrix: just gets space for the matrix from the workspace and calls
+// the likelihood object to do the work.  The matrix is only valid until the next call.
 ndarray::Array<Pixel,2,-1> makeModelMatrix(
     Likelihood const & likelihood,
-    ndarray::Array<Scalar const,1,1> const & nonlinear
+    ndarray::Array<Scalar const,1,1> const & nonlinear,
+    CModelWorkspace::Impl & workspace
 ) {
-    ndarray::Array<Pixel,2,2> modelMatrixT
-        = ndarray::allocate(likelihood.getAmplitudeDim(), likelihood.getDataDim());
-    ndarray::Array<Pixel,2,-1> modelMatrix = modelMatrixT.transpose();
+    ndarray::Array<Pixel,2,-1> modelMatrix = workspace.getMatrix(
+        CModelWorkspace::Impl::MODEL_MATRIX, likelihood.getDataDim(), likelihood.getAmplitudeDim()
+    );
     likelihood.computeModelMatrix(modelMatrix, nonlinear, false);
     return modelMatrix;
 }
 
+// The rows of a (possibly multi-epoch) likelihood that belong to a single epoch, and the factor that
+// converts fluxes in that epoch's units to the units we report measurements in.
+struct EpochRows {
+    int nPix;
+    Scalar fluxScale;
+};
+
+typedef std::vector<EpochRows> EpochRowsVector;
+
+// Unweighted model matrix, data, and variance with the rows of each epoch rescaled so they're all in the
+// same flux units.  With a single unit-scale epoch (i.e. everything but multi-epoch fitting), these are
+// just shallow copies of the inputs.
+struct NormalizedRows {
+
+    NormalizedRows(
+        ndarray::Array<Pixel const,2,-1> const & modelMatrix_,
+        ndarray::Array<Pixel const,1,1> const & data_,
+        ndarray::Array<Pixel const,1,1> const & variance_,
+        EpochRowsVector const & rows,
+        CModelWorkspace::Impl & workspace
+    ) : modelMatrix(modelMatrix_), data(data_), variance(variance_) {
+        if (rows.size() == 1u && rows.front().fluxScale == 1.0) return;
+        ndarray::Array<Pixel,2,-1> newModelMatrix = workspace.getMatrix(
+            CModelWorkspace::Impl::NORMALIZED_MODEL_MATRIX,
+            modelMatrix_.getSize<0>(), modelMatrix_.getSize<1>()
+        );
+        newModelMatrix.deep() = modelMatrix_;
+        ndarray::Array<Pixel,1,1> newData
+            = workspace.getPixels(CModelWorkspace::Impl::NORMALIZED_DATA, data_.getSize<0>());
+        newData.deep() = data_;
+        ndarray::Array<Pixel,1,1> newVariance
+            = workspace.getPixels(CModelWorkspace::Impl::NORMALIZED_VARIANCE, variance_.getSize<0>());
+        newVariance.deep() = variance_;
+        int offset = 0;
+        for (auto const & epoch : rows) {
+            ndarray::asEigenMatrix(newModelMatrix).middleRows(offset, epoch.nPix) *= epoch.fluxScale;
+            ndarray::asEigenArray(newData).segment(offset, epoch.nPix) *= epoch.fluxScale;
+            ndarray::asEigenArray(newVariance).segment(offset, epoch.nPix) *= epoch.fluxScale*epoch.fluxScale;
+            offset += epoch.nPix;
+        }
+        modelMatrix = newModelMatrix;
+        data = newData;
+        variance = newVariance;
+    }
+
+    ndarray::Array<Pixel const,2,-1> modelMatrix;
+    ndarray::Array<Pixel const,1,1> data;
+    ndarray::Array<Pixel const,1,1> variance;
+};
 
 struct WeightSums {
 
@@ -660,6 +1126,287 @@ struct WeightSums {
 };
 
 
+// Use the state of the Optimizer that fit a stage to set its flags.  There's more information in the
+// state than we report in the result, but it's only useful for debugging, and for that the user should
+// look at the history by running outside of plugin mode.
+void setOptimizerFlags(CModelStageResult & result, int state) {
+    if (state & Optimizer::FAILED) {
+        result.flags[CModelStageResult::FAILED] = true;
+        if (state & Optimizer::FAILED_MAX_ITERATIONS) {
+            result.flags[CModelStageResult::MAX_ITERATIONS] = true;
+        } else if (state & Optimizer::FAILED_MAX_TIME) {
+            result.flags[CModelStageResult::MAX_TIME] = true;
+        } else if (state & Optimizer::FAILED_NAN) {
+            result.flags[CModelStageResult::NUMERIC_ERROR] = true;
+        }
+    } else {
+        result.flags[CModelStageResult::FAILED] = false;
+        if (state & Optimizer::CONVERGED_TR_SMALL) {
+            result.flags[CModelStageResult::TR_SMALL] = true;
+        }
+    }
+}
+
+// Clip an optimizer's time limit to what's left before a deadline (if there is one).  If that's already
+// used up, we still run the optimizer (with a negligible limit) so the result is filled consistently
+// from the starting parameters.
+void clipMaxTime(OptimizerControl & ctrl, std::chrono::steady_clock::time_point deadline) {
+    if (deadline == std::chrono::steady_clock::time_point::max()) return;
+    double remaining = std::chrono::duration<double>(deadline - std::chrono::steady_clock::now()).count();
+    remaining = std::max(remaining, std::numeric_limits<double>::min());
+    if (!(ctrl.maxTime > 0.0) || ctrl.maxTime > remaining) {
+        ctrl.maxTime = remaining;
+    }
+}
+
+// Return true if a stage's parameters can be used to start later stages: either its fit succeeded, or it
+// only ran out of time, in which case it holds the best parameters found before the time ran out.
+bool isStageUsable(CModelStageResult const & result) {
+    return !result.flags[CModelStageResult::FAILED]
+        || (result.flags[CModelStageResult::MAX_TIME] && !result.flags[CModelStageResult::NUMERIC_ERROR]);
+}
+
+// Return true if any of the nonlinear stages of a result ran out of time.
+bool isAnyStageOutOfTime(CModelResult const & result) {
+    return result.initial.flags[CModelStageResult::MAX_TIME] || result.exp.flags[CModelStageResult::MAX_TIME]
+        || result.dev.flags[CModelStageResult::MAX_TIME];
+}
+
+// The pixels of a group of sources with overlapping fit regions, for joint fitting (see applyGroup).
+// Pixels in the union of the members' fit regions are ordered as a SpanSet would flatten them, and
+// rows[k] holds the union indices of the pixels of member k's fit region, in its own flattening order
+// (which makes them sorted, as the Optimizer requires of residual blocks).
+struct CModelGroupPixels {
+
+    CModelGroupPixels(
+        afw::image::Exposure<Pixel> const & exposure,
+        std::vector<PTR(afw::detection::Footprint)> const & footprints_
+    ) : footprints(footprints_), rows(footprints_.size()) {
+        geom::Box2I bbox;
+        for (auto const & footprint : footprints) {
+            bbox.include(footprint->getBBox());
+        }
+        ndarray::Array<int,2,2> index = ndarray::allocate(bbox.getHeight(), bbox.getWidth());
+        index.deep() = -1;
+        for (auto const & footprint : footprints) {
+            for (auto const & span : *footprint->getSpans()) {
+                for (int x = span.getX0(); x <= span.getX1(); ++x) {
+                    index[span.getY() - bbox.getMinY()][x - bbox.getMinX()] = 0;
+                }
+            }
+        }
+        std::vector<int> xv;
+        std::vector<int> yv;
+        for (int j = 0; j < bbox.getHeight(); ++j) {
+            for (int i = 0; i < bbox.getWidth(); ++i) {
+                if (index[j][i] < 0) continue;
+                index[j][i] = xv.size();
+                xv.push_back(i + bbox.getMinX());
+                yv.push_back(j + bbox.getMinY());
+            }
+        }
+        for (std::size_t k = 0; k < footprints.size(); ++k) {
+            rows[k].reserve(footprints[k]->getArea());
+            for (auto const & span : *footprints[k]->getSpans()) {
+                for (int x = span.getX0(); x <= span.getX1(); ++x) {
+                    rows[k].push_back(index[span.getY() - bbox.getMinY()][x - bbox.getMinX()]);
+                }
+            }
+        }
+        int const nPix = xv.size();
+        x = ndarray::allocate(nPix);
+        y = ndarray::allocate(nPix);
+        data = ndarray::allocate(nPix);
+        variance = ndarray::allocate(nPix);
+        auto image = exposure.getMaskedImage().getImage()->getArray();
+        auto var = exposure.getMaskedImage().getVariance()->getArray();
+        geom::Point2I const xy0 = exposure.getXY0();
+        for (int n = 0; n < nPix; ++n) {
+            x[n] = xv[n];
+            y[n] = yv[n];
+            data[n] = image[yv[n] - xy0.getY()][xv[n] - xy0.getX()];
+            variance[n] = var[yv[n] - xy0.getY()][xv[n] - xy0.getX()];
+        }
+    }
+
+    int getSize() const { return data.getSize<0>(); }
+
+    std::vector<PTR(afw::detection::Footprint)> footprints;  // fit region of each member
+    std::vector<std::vector<int>> rows;  // union pixel indices of each member's fit region
+    ndarray::Array<int,1,1> x;           // union pixel coordinates
+    ndarray::Array<int,1,1> y;
+    ndarray::Array<Pixel,1,1> data;      // unweighted union pixel values
+    ndarray::Array<Pixel,1,1> variance;
+};
+
+// Objective for the joint fit of a single stage to a group of sources.  Each member has its own
+// likelihood (and hence fit coordinate system and PSF) on its own fit region, and its parameters are
+// a contiguous block of the joint parameter vector that only affects the residuals of that region's
+// pixels; we report that to the Optimizer so it only differentiates and accumulates where the models
+// are nonzero.  The prior is the product of the members' priors.
+class CModelGroupObjective : public OptimizerObjective {
+public:
+
+    CModelGroupObjective(
+        std::vector<PTR(Likelihood)> const & likelihoods,
+        PTR(Prior) prior,
+        PTR(CModelGroupPixels const) pixels,
+        ndarray::Array<Pixel const,1,1> const & weights
+    ) :
+        OptimizerObjective(
+            pixels->getSize(),
+            likelihoods.size()*(likelihoods.front()->getNonlinearDim()
+                                + likelihoods.front()->getAmplitudeDim())
+        ),
+        _nonlinearDim(likelihoods.front()->getNonlinearDim()),
+        _amplitudeDim(likelihoods.front()->getAmplitudeDim()),
+        _likelihoods(likelihoods), _prior(prior), _pixels(pixels), _weights(weights)
+    {
+        _modelMatrices.reserve(likelihoods.size());
+        _models.reserve(likelihoods.size());
+        for (auto const & likelihood : likelihoods) {
+            _modelMatrices.push_back(ndarray::allocate(likelihood->getDataDim(), _amplitudeDim));
+            _models.push_back(ndarray::allocate(likelihood->getDataDim()));
+        }
+    }
+
+    int getBlockSize() const { return _nonlinearDim + _amplitudeDim; }
+
+    // Compute the unweighted model of one member at the pixels of its fit region.
+    void computeMemberModel(
+        ndarray::Array<Scalar const,1,1> const & parameters,
+        int k,
+        ndarray::Array<Scalar,1,1> const & model
+    ) const {
+        int const offset = k*getBlockSize();
+        _likelihoods[k]->computeModelMatrix(
+            _modelMatrices[k], parameters[ndarray::view(offset, offset + _nonlinearDim)], false
+        );
+        auto amplitudes = parameters[ndarray::view(offset + _nonlinearDim, offset + getBlockSize())];
+        ndarray::asEigenMatrix(model)
+            = ndarray::asEigenMatrix(_modelMatrices[k]).cast<Scalar>() * ndarray::asEigenMatrix(amplitudes);
+    }
+
+    void computeResiduals(
+        ndarray::Array<Scalar const,1,1> const & parameters,
+        ndarray::Array<Scalar,1,1> const & residuals
+    ) const override {
+        residuals.deep() = 0.0;
+        for (std::size_t k = 0; k < _likelihoods.size(); ++k) {
+            std::vector<int> const & rows = _pixels->rows[k];
+            computeMemberModel(parameters, k, _models[k]);
+            for (std::size_t i = 0; i < rows.size(); ++i) {
+                residuals[rows[i]] += _models[k][i];
+            }
+        }
+        ndarray::asEigenArray(residuals) -= ndarray::asEigenArray(_pixels->data).cast<Scalar>();
+        ndarray::asEigenArray(residuals) *= ndarray::asEigenArray(_weights).cast<Scalar>();
+    }
+
+    std::vector<ResidualBlock> getResidualBlocks() const override {
+        std::vector<ResidualBlock> blocks(_likelihoods.size());
+        for (std::size_t k = 0; k < _likelihoods.size(); ++k) {
+            blocks[k].parameterBegin = k*getBlockSize();
+            blocks[k].parameterEnd = (k + 1)*getBlockSize();
+            blocks[k].rows = _pixels->rows[k];
+        }
+        return blocks;
+    }
+
+    void computeBlockResiduals(
+        ndarray::Array<Scalar const,1,1> const & parameters,
+        int block,
+        ndarray::Array<Scalar,1,1> const & residuals
+    ) const override {
+        // The other members' models and the data don't depend on this block's parameters.
+        computeMemberModel(parameters, block, residuals);
+        std::vector<int> const & rows = _pixels->rows[block];
+        for (std::size_t i = 0; i < rows.size(); ++i) {
+            residuals[i] *= _weights[rows[i]];
+        }
+    }
+
+    bool hasPrior() const override { return static_cast<bool>(_prior); }
+
+    // The prior is the product of the members' priors, which underflows for large groups, so the
+    // Optimizer works with the sum of their -ln P instead (see computeNegLogPrior); these are only for
+    // callers that want P itself.
+    Scalar computePrior(ndarray::Array<Scalar const,1,1> const & parameters) const override {
+        return std::exp(-computeNegLogPrior(parameters));
+    }
+
+    void differentiatePrior(
+        ndarray::Array<Scalar const,1,1> const & parameters,
+        ndarray::Array<Scalar,1,1> const & gradient,
+        ndarray::Array<Scalar,2,1> const & hessian
+    ) const override {
+        // dP = -P d(-ln P), d^2P = P [d(-ln P) d(-ln P)^T - d^2(-ln P)]
+        Scalar const prior = computePrior(parameters);
+        differentiateNegLogPrior(parameters, gradient, hessian);
+        auto hessianEigen = ndarray::asEigenMatrix(hessian);
+        hessianEigen *= -prior;
+        hessianEigen.selfadjointView<Eigen::Lower>().rankUpdate(ndarray::asEigenMatrix(gradient), prior);
+        ndarray::asEigenMatrix(gradient) *= -prior;
+    }
+
+    Scalar computeNegLogPrior(ndarray::Array<Scalar const,1,1> const & parameters) const override {
+        Scalar result = 0.0;
+        for (std::size_t k = 0; k < _likelihoods.size(); ++k) {
+            int const offset = k*getBlockSize();
+            result -= std::log(
+                _prior->evaluate(
+                    parameters[ndarray::view(offset, offset + _nonlinearDim)],
+                    parameters[ndarray::view(offset + _nonlinearDim, offset + getBlockSize())]
+                )
+            );
+        }
+        return result;
+    }
+
+    void differentiateNegLogPrior(
+        ndarray::Array<Scalar const,1,1> const & parameters,
+        ndarray::Array<Scalar,1,1> const & gradient,
+        ndarray::Array<Scalar,2,1> const & hessian
+    ) const override {
+        // -ln P is a sum over members, so its Hessian is block-diagonal.
+        int const n = getBlockSize();
+        ndarray::asEigenMatrix(hessian).setZero();
+        for (std::size_t k = 0; k < _likelihoods.size(); ++k) {
+            int const offset = k*n;
+            auto nonlinear = parameters[ndarray::view(offset, offset + _nonlinearDim)];
+            auto amplitudes = parameters[ndarray::view(offset + _nonlinearDim, offset + n)];
+            auto g = gradient[ndarray::view(offset, offset + n)];
+            auto h = hessian[ndarray::view(offset, offset + n)(offset, offset + n)];
+            Scalar const prior = _prior->evaluate(nonlinear, amplitudes);
+            g.deep() = 0.0;
+            _prior->evaluateDerivatives(
+                nonlinear, amplitudes,
+                g[ndarray::view(0, _nonlinearDim)],
+                g[ndarray::view(_nonlinearDim, n)],
+                h[ndarray::view(0, _nonlinearDim)(0, _nonlinearDim)],
+                h[ndarray::view(_nonlinearDim, n)(_nonlinearDim, n)],
+                h[ndarray::view(0, _nonlinearDim)(_nonlinearDim, n)]
+            );
+            auto hEigen = ndarray::asEigenMatrix(h);
+            hEigen.bottomLeftCorner(_amplitudeDim, _nonlinearDim)
+                = hEigen.topRightCorner(_nonlinearDim, _amplitudeDim).adjoint();
+            ndarray::asEigenMatrix(g) /= -prior;
+            hEigen /= -prior;
+            hEigen.selfadjointView<Eigen::Lower>().rankUpdate(ndarray::asEigenMatrix(g), 1.0);
+        }
+    }
+
+private:
+    int _nonlinearDim;
+    int _amplitudeDim;
+    std::vector<PTR(Likelihood)> _likelihoods;
+    PTR(Prior) _prior;
+    PTR(CModelGroupPixels const) _pixels;
+    ndarray::Array<Pixel const,1,1> _weights;
+    mutable std::vector<ndarray::Array<Pixel,2,-1>> _modelMatrices;
+    mutable std::vector<ndarray::Array<Scalar,1,1>> _models;  // scratch for computeResiduals
+};
+
 // Implementation object for a single nonlinear stage (one of "initial", "exp", "dev")
 // Note that this doesn't hold its own CModelStageControl; that's held by the CModelControl
 // in the main CModelAlgorithm class (for historical and compatibility-with-HSC-fork reasons),
@@ -701,9 +1448,9 @@ public:
         CModelStageData const & data,
         WeightSums const & sums
     ) const {
-        // these are shallow assignments
-        result.nonlinear = data.nonlinear;
-        result.amplitudes = data.amplitudes;
+        // the parameter vectors in data belong to the workspace, so we need to deep-copy them
+        result.nonlinear = ndarray::copy(data.nonlinear);
+        result.amplitudes = ndarray::copy(data.amplitudes);
         result.fixed = data.fixed;
         // flux is just the amplitude converted from fitSys to measSys
         result.instFlux = data.amplitudes[0] * data.fitSysToMeasSys.flux;
@@ -729,12 +1476,102 @@ public:
         }
         result.likelihood = std::make_shared<UnitTransformedLikelihood>(
             model, data.fixed, data.fitSys, data.position,
-            exposure, footprint, data.psf,
-            UnitTransformedLikelihoodControl(ctrl.usePixelWeights, ctrl.weightsMultiplier)
+            exposure, footprint, data.psf, ctrl.getLikelihoodControl()
+        );
+        fitLikelihood(ctrl, result, data, EpochRowsVector(1, EpochRows{footprint.getArea(), 1.0}), startTime);
+    }
+
+    // Do a nonlinear fit for this stage on binned data (see makeBinnedEpoch), leaving the best-fit
+    // parameters in data as the starting point for a full-resolution fit.  Returns the coarse result,
+    // which is used only for its flags.  If the coarse fit hit a numerical error, the original
+    // parameters are restored.
+    CModelStageResult fitCoarse(
+        CModelStageControl const & ctrl, CModelStageData const & data, PTR(EpochFootprint) const & epoch
+    ) const {
+        CModelStageResult result = makeResult();
+        ndarray::Array<Scalar,1,1> original = ndarray::copy(data.parameters);
+        result.likelihood = std::make_shared<UnitTransformedLikelihood>(
+            model, data.fixed, data.fitSys, data.position, std::vector<PTR(EpochFootprint)>(1, epoch),
+            ctrl.getLikelihoodControl()
+        );
+        fitLikelihood(ctrl, result, data, EpochRowsVector(1, EpochRows{epoch->footprint.getArea(), 1.0}), 0);
+        if (result.flags[CModelStageResult::NUMERIC_ERROR]) {
+            data.parameters.deep() = original;
+        }
+        return result;
+    }
+
+    // Do a sequence of nonlinear fits for this stage on stratified subsets of the pixels in footprint
+    // (see makeSubsampledFootprint), starting with the given fraction and doubling it after each pass,
+    // until the next subset would include every pixel.  Pixel weights are scaled by sqrt(area/subsetArea)
+    // so the objective is an unbiased estimate of the full one.  Each pass only needs to get close
+    // enough to be a good start for the next, so it is limited to maxIterations outer iterations, and
+    // reaching that limit doesn't stop the sequence.  The best-fit parameters are left in data as the
+    // starting point for the fit to all pixels; we stop early if the optimizer fails on a subset for
+    // any other reason, restoring the previous parameters if that was a numerical error.  Returns the
+    // total number of iterations in all passes (see CModelStageResult::nIter).
+    int fitSubsampled(
+        CModelStageControl const & ctrl, CModelStageData const & data,
+        afw::image::Exposure<Pixel> const & exposure, afw::detection::Footprint const & footprint,
+        Scalar fraction, int maxIterations
+    ) const {
+        int nIter = 0;
+        for (; fraction < 1.0; fraction *= 2.0) {
+            PTR(afw::detection::Footprint) subset = makeSubsampledFootprint(footprint, fraction);
+            if (!subset) break;
+            Scalar const scale = std::sqrt(static_cast<Scalar>(footprint.getArea()) / subset->getArea());
+            CModelStageResult result = makeResult();
+            ndarray::Array<Scalar,1,1> original = ndarray::copy(data.parameters);
+            result.likelihood = std::make_shared<UnitTransformedLikelihood>(
+                model, data.fixed, data.fitSys, data.position, exposure, *subset, data.psf,
+                ctrl.getLikelihoodControl(scale)
+            );
+            fitLikelihood(ctrl, result, data, EpochRowsVector(1, EpochRows{subset->getArea(), 1.0}), 0,
+                          maxIterations);
+            nIter += result.nIter;
+            if (result.flags[CModelStageResult::NUMERIC_ERROR]) {
+                data.parameters.deep() = original;
+                break;
+            }
+            if (result.flags[CModelStageResult::FAILED] && !result.flags[CModelStageResult::MAX_ITERATIONS]) {
+                break;
+            }
+        }
+        return nIter;
+    }
+
+    // Do the full nonlinear fit for this stage simultaneously on multiple epochs.
+    void fitMultiEpoch(
+        CModelStageControl const & ctrl, CModelStageResult & result, CModelStageData const & data,
+        std::vector<PTR(EpochFootprint)> const & epochs, EpochRowsVector const & rows
+    ) const {
+        long long startTime = 0;
+        if (ctrl.doRecordTime) {
+            startTime = daf::base::DateTime::now().nsecs();
+        }
+        result.likelihood = std::make_shared<UnitTransformedLikelihood>(
+            model, data.fixed, data.fitSys, data.position, epochs, ctrl.getLikelihoodControl()
         );
+        fitLikelihood(ctrl, result, data, rows, startTime);
+    }
+
+    // Do the nonlinear fit using the likelihood already attached to the result.  If maxIterations is
+    // positive, it caps the optimizer's maxOuterIterations.
+    void fitLikelihood(
+        CModelStageControl const & ctrl, CModelStageResult & result, CModelStageData const & data,
+        EpochRowsVector const & rows, long long startTime, int maxIterations=0
+    ) const {
         PTR(OptimizerObjective) objective = OptimizerObjective::makeFromLikelihood(result.likelihood, prior);
         result.objfunc = objective;
-        Optimizer optimizer(objective, data.parameters, ctrl.optimizer);
+        OptimizerControl optimizerCtrl = ctrl.getOptimizerControl(data.snr);
+        if (maxIterations > 0) {
+            optimizerCtrl.maxOuterIterations = std::min(optimizerCtrl.maxOuterIterations, maxIterations);
+        }
+        result.gradientThreshold = optimizerCtrl.gradientThreshold;
+        result.minTrustRadiusThreshold = optimizerCtrl.minTrustRadiusThreshold;
+        result.maxOuterIterations = optimizerCtrl.maxOuterIterations;
+        clipMaxTime(optimizerCtrl, data.deadline);  // per-stage limit can't exceed the per-source budget
+        Optimizer optimizer(objective, data.parameters, optimizerCtrl);
         try {
             if (ctrl.doRecordHistory) {
                 result.history = afw::table::BaseCatalog(historyTable);
@@ -752,23 +1589,8 @@ public:
             result.flags[CModelStageResult::NUMERIC_ERROR] = true;
         }
 
-        // Use the optimizer state to set flags.  There's more information in the state than we
-        // report in the result, but it's only useful for debugging, and for that the user should
-        // look at the history by running outside of plugin mode.
-        int state = optimizer.getState();
-        if (state & Optimizer::FAILED) {
-            result.flags[CModelStageResult::FAILED] = true;
-            if (state & Optimizer::FAILED_MAX_ITERATIONS) {
-                result.flags[CModelStageResult::MAX_ITERATIONS] = true;
-            } else if (state & Optimizer::FAILED_NAN) {
-                result.flags[CModelStageResult::NUMERIC_ERROR] = true;
-            }
-        } else {
-            result.flags[CModelStageResult::FAILED] = false;
-            if (state & Optimizer::CONVERGED_TR_SMALL) {
-                result.flags[CModelStageResult::TR_SMALL] = true;
-            }
-        }
+        setOptimizerFlags(result, optimizer.getState());
+        result.nIter = result.history.size();
 
         result.objective = optimizer.getObjectiveValue();
 
@@ -780,20 +1602,24 @@ public:
         // the best-fit model as a continuous aperture.  That's likely what we'd want for colors, but it
         // underestimates the statistical uncertainty on the total flux (though that's probably dominated by
         // systematic errors anyway).
-        ndarray::Array<Pixel,2,-1> modelMatrix = makeModelMatrix(*result.likelihood, data.nonlinear);
-        WeightSums sums(
+        ndarray::Array<Pixel,2,-1> modelMatrix
+            = makeModelMatrix(*result.likelihood, data.nonlinear, *data.workspace);
+        NormalizedRows normalized(
             modelMatrix,
             result.likelihood->getUnweightedData(),
-            result.likelihood->getVariance()
+            result.likelihood->getVariance(),
+            rows,
+            *data.workspace
         );
+        WeightSums sums(normalized.modelMatrix, normalized.data, normalized.variance);
 
         // If we're using per-pixel variances, we need to do another linear fit without them, since
         // using per-pixel variances there can cause magnitude-dependent biases in the flux.
         // (We're not sure if using per-pixel variances in the nonlinear fit can do that).
         if (ctrl.usePixelWeights) {
             afw::math::LeastSquares lstsq = afw::math::LeastSquares::fromDesignMatrix(
-                modelMatrix,
-                result.likelihood->getUnweightedData()
+                normalized.modelMatrix,
+                normalized.data
             );
             data.amplitudes.deep() = lstsq.getSolution();
         }
@@ -815,19 +1641,77 @@ public:
             model, data.fixed, data.fitSys, data.position,
             exposure, footprint, data.psf, UnitTransformedLikelihoodControl(ctrl.usePixelWeights)
         );
-        ndarray::Array<Pixel,2,-1> modelMatrix = makeModelMatrix(*result.likelihood, data.nonlinear);
+        ndarray::Array<Pixel,2,-1> modelMatrix
+            = makeModelMatrix(*result.likelihood, data.nonlinear, *data.workspace);
+        solveLinear(
+            result, data, modelMatrix,
+            result.likelihood->getUnweightedData(), result.likelihood->getVariance()
+        );
+    }
+
+    // Do a linear-only fit for this stage in several bands that share a pixel grid and Footprint
+    // (used only in forced mode).  The likelihood holds one epoch per band, so the model matrix for
+    // all bands is computed with a single call, and each band is then solved using its own block
+    // of rows.  The (shared) likelihood is attached to all of the results.
+    void fitLinearMultiBand(
+        CModelStageControl const & ctrl,
+        std::vector<CModelStageResult*> const & results,
+        CModelStageData const & data,
+        std::vector<LocalUnitTransform> const & fitSysToMeasSys,
+        std::vector<PTR(EpochFootprint)> const & epochs
+    ) const {
+        PTR(UnitTransformedLikelihood) likelihood = std::make_shared<UnitTransformedLikelihood>(
+            model, data.fixed, data.fitSys, data.position,
+            epochs, UnitTransformedLikelihoodControl(ctrl.usePixelWeights)
+        );
+        ndarray::Array<Pixel,2,-1> modelMatrix
+            = makeModelMatrix(*likelihood, data.nonlinear, *data.workspace);
+        int const nPix = likelihood->getDataDim() / results.size();
+        for (std::size_t b = 0; b < results.size(); ++b) {
+            // shallow copy; fillResult deep-copies the amplitudes into each band's result
+            CModelStageData bandData(data);
+            bandData.fitSysToMeasSys = fitSysToMeasSys[b];
+            results[b]->likelihood = likelihood;
+            auto rows = ndarray::view(b*nPix, (b + 1)*nPix);
+            // A numerical failure in one band (e.g. from bad data only it has) leaves that band's
+            // result flagged as failed, without affecting the others.
+            try {
+                solveLinear(
+                    *results[b], bandData, modelMatrix[rows()],
+                    likelihood->getUnweightedData()[rows], likelihood->getVariance()[rows]
+                );
+            } catch (std::overflow_error &) {
+                results[b]->flags[CModelStageResult::NUMERIC_ERROR] = true;
+            } catch (std::underflow_error &) {
+                results[b]->flags[CModelStageResult::NUMERIC_ERROR] = true;
+            } catch (pex::exceptions::UnderflowError &) {
+                results[b]->flags[CModelStageResult::NUMERIC_ERROR] = true;
+            } catch (pex::exceptions::OverflowError &) {
+                results[b]->flags[CModelStageResult::NUMERIC_ERROR] = true;
+            }
+        }
+    }
+
+    // Solve for the amplitudes given an unweighted model matrix and the corresponding data, and fill
+    // the result.
+    void solveLinear(
+        CModelStageResult & result, CModelStageData const & data,
+        ndarray::Array<Pixel const,2,-1> const & modelMatrix,
+        ndarray::Array<Pixel const,1,1> const & unweightedData,
+        ndarray::Array<Pixel const,1,1> const & variance
+    ) const {
         afw::math::LeastSquares lstsq = afw::math::LeastSquares::fromDesignMatrix(
             modelMatrix,
-            result.likelihood->getUnweightedData()
+            unweightedData
         );
         data.amplitudes.deep() = lstsq.getSolution();
         result.objective =
-                0.5 * (ndarray::asEigenMatrix(result.likelihood->getUnweightedData()).cast<Scalar>() -
+                0.5 * (ndarray::asEigenMatrix(unweightedData).cast<Scalar>() -
                        ndarray::asEigenMatrix(modelMatrix).cast<Scalar>() *
                                ndarray::asEigenMatrix(data.amplitudes))
                               .squaredNorm();
 
-        WeightSums sums(modelMatrix, result.likelihood->getUnweightedData(), result.likelihood->getVariance());
+        WeightSums sums(modelMatrix, unweightedData, variance);
 
         fillResult(result, data, sums);
         result.flags[CModelStageResult::FAILED] = false;
@@ -837,11 +1721,208 @@ public:
 
 } // anonymous
 
-// Master implementation object for CModel.
-// Note that this doesn't hold its own CModelControl; that's held by the CModelAlgorithm class
-// (for historical and compatibility-with-HSC-fork reasons), and hence passed to every method
-// here that needs it.
-class CModelAlgorithm::Impl {
+//-------------------- Result cache keys ---------------------------------------------------------------------
+
+namespace {
+
+// Incremented whenever a change to the algorithm could change the result for the same inputs, to keep
+// old cache files from being used.
+std::uint64_t const RESULT_CACHE_KEY_VERSION = 1;
+
+// 64-bit FNV-1a hash, used to compute result cache keys.
+class Fnv1aHash {
+public:
+
+    Fnv1aHash() : _value(14695981039346656037ULL) {}
+
+    void addBytes(void const * data, std::size_t size) {
+        unsigned char const * bytes = reinterpret_cast<unsigned char const *>(data);
+        for (std::size_t i = 0; i < size; ++i) {
+            _value ^= bytes[i];
+            _value *= 1099511628211ULL;
+        }
+    }
+
+    template <typename T>
+    void add(T const & value) {
+        static_assert(std::is_arithmetic<T>::value, "Only arithmetic values can be hashed directly");
+        addBytes(&value, sizeof(T));
+    }
+
+    void add(std::string const & value) {
+        add(value.size());
+        addBytes(value.data(), value.size());
+    }
+
+    template <typename T, int C>
+    void add(ndarray::Array<T,1,C> const & array) {
+        add(array.template getSize<0>());
+        for (auto const & element : array) {
+            add(element);
+        }
+    }
+
+    void add(afw::geom::ellipses::Quadrupole const & ellipse) {
+        add(ellipse.getIxx());
+        add(ellipse.getIyy());
+        add(ellipse.getIxy());
+    }
+
+    void add(geom::Point2D const & point) {
+        add(point.getX());
+        add(point.getY());
+    }
+
+    std::uint64_t getValue() const { return _value; }
+
+private:
+    std::uint64_t _value;
+};
+
+void hashControl(Fnv1aHash & hash, OptimizerControl const & ctrl) {
+    hash.add(ctrl.noSR1Term);
+    hash.add(ctrl.skipSR1UpdateThreshold);
+    hash.add(ctrl.minTrustRadiusThreshold);
+    hash.add(ctrl.gradientThreshold);
+    hash.add(ctrl.numDiffRelStep);
+    hash.add(ctrl.numDiffAbsStep);
+    hash.add(ctrl.numDiffTrustRadiusStep);
+    hash.add(ctrl.stepAcceptThreshold);
+    hash.add(ctrl.trustRegionInitialSize);
+    hash.add(ctrl.trustRegionGrowReductionRatio);
+    hash.add(ctrl.trustRegionGrowStepFraction);
+    hash.add(ctrl.trustRegionGrowFactor);
+    hash.add(ctrl.trustRegionShrinkReductionRatio);
+    hash.add(ctrl.trustRegionShrinkFactor);
+    hash.add(ctrl.trustRegionSolverTolerance);
+    hash.add(ctrl.maxInnerIterations);
+    hash.add(ctrl.maxOuterIterations);
+    hash.add(ctrl.doSaveIterations);
+    hash.add(ctrl.maxTime);
+}
+
+void hashControl(Fnv1aHash & hash, CModelStageControl const & ctrl) {
+    hash.add(ctrl.profileName);
+    hash.add(ctrl.priorSource);
+    hash.add(ctrl.priorName);
+    hash.add(ctrl.linearPriorConfig.ellipticityMaxOuter);
+    hash.add(ctrl.linearPriorConfig.ellipticityMaxInner);
+    hash.add(ctrl.linearPriorConfig.logRadiusMinOuter);
+    hash.add(ctrl.linearPriorConfig.logRadiusMinInner);
+    hash.add(ctrl.linearPriorConfig.logRadiusMaxOuter);
+    hash.add(ctrl.linearPriorConfig.logRadiusMaxInner);
+    hash.add(ctrl.linearPriorConfig.logRadiusMinMaxRatio);
+    hash.add(ctrl.empiricalPriorConfig.ellipticitySigma);
+    hash.add(ctrl.empiricalPriorConfig.ellipticityCore);
+    hash.add(ctrl.empiricalPriorConfig.logRadiusMinOuter);
+    hash.add(ctrl.empiricalPriorConfig.logRadiusMinInner);
+    hash.add(ctrl.empiricalPriorConfig.logRadiusMu);
+    hash.add(ctrl.empiricalPriorConfig.logRadiusSigma);
+    hash.add(ctrl.empiricalPriorConfig.logRadiusNu);
+    hash.add(ctrl.nComponents);
+    hash.add(ctrl.maxRadius);
+    hash.add(ctrl.usePixelWeights);
+    hash.add(ctrl.weightsMultiplier);
+    hashControl(hash, ctrl.optimizer);
+    hash.add(ctrl.doRecordHistory);
+    hash.add(ctrl.doRecordTime);
+    hash.add(ctrl.doAdaptiveConvergence);
+    hash.add(ctrl.adaptiveReferenceSnr);
+    hash.add(ctrl.adaptiveMaxScale);
+    hash.add(ctrl.adaptiveMinOuterIterations);
+    hash.add(ctrl.fftMode);
+}
+
+// Hash everything in the control object that can affect a fit (i.e. everything but the cache settings).
+void hashControl(Fnv1aHash & hash, CModelControl const & ctrl) {
+    hash.add(ctrl.psfName);
+    hash.add(ctrl.region.nKronRadii);
+    hash.add(ctrl.region.nPsfSigmaMin);
+    hash.add(ctrl.region.nPsfSigmaGrow);
+    hash.add(ctrl.region.nFitRadiiMin);
+    hash.add(ctrl.region.nFitRadiiMax);
+    hash.add(ctrl.region.maxArea);
+    hash.add(ctrl.region.badMaskPlanes.size());
+    for (auto const & plane : ctrl.region.badMaskPlanes) {
+        hash.add(plane);
+    }
+    hash.add(ctrl.region.maxBadPixelFraction);
+    hashControl(hash, ctrl.initial);
+    hashControl(hash, ctrl.exp);
+    hashControl(hash, ctrl.dev);
+    hash.add(ctrl.minInitialRadius);
+    hash.add(ctrl.fallbackInitialMomentsPsfFactor);
+    hash.add(ctrl.maxTime);
+    hash.add(ctrl.initializerSource);
+    hash.add(ctrl.initializerName);
+    hash.add(ctrl.warmStartSkipInitial);
+    hash.add(ctrl.coarseBinFactor);
+    hash.add(ctrl.coarseMinArea);
+    hash.add(ctrl.coarseOnlyForMaxArea);
+    hash.add(ctrl.subsampleFraction);
+    hash.add(ctrl.subsampleMinArea);
+    hash.add(ctrl.subsampleMaxIterations);
+    hash.add(ctrl.groupMaxSize);
+    hash.add(ctrl.raiseMeasurementErrors);
+}
+
+void hashPsf(Fnv1aHash & hash, shapelet::MultiShapeletFunction const & psf) {
+    hash.add(psf.getComponents().size());
+    for (auto const & component : psf.getComponents()) {
+        hash.add(component.getOrder());
+        hash.add(static_cast<int>(component.getBasisType()));
+        hash.add(afw::geom::ellipses::Quadrupole(component.getEllipse().getCore()));
+        hash.add(component.getEllipse().getCenter());
+        hash.add(component.getCoefficients());
+    }
+}
+
+// Hash the image, variance and mask pixels in a fit region, along with its shape.
+void hashPixels(
+    Fnv1aHash & hash,
+    afw::image::MaskedImage<Pixel> const & image,
+    afw::detection::Footprint const & footprint
+) {
+    afw::geom::SpanSet const & spans = *footprint.getSpans();
+    hash.add(spans.size());
+    for (auto const & span : spans) {
+        hash.add(span.getY());
+        hash.add(span.getMinX());
+        hash.add(span.getMaxX());
+    }
+    hash.add(spans.flatten(image.getImage()->getArray(), image.getXY0()));
+    hash.add(spans.flatten(image.getVariance()->getArray(), image.getXY0()));
+    hash.add(spans.flatten(image.getMask()->getArray(), image.getXY0()));
+}
+
+// Compute the value stored with each cached result to check the pixels in its final fit region, which
+// (unlike those in the initial fit region) depend on the fit and hence can't go in the key.
+std::uint64_t computeFinalRegionCheck(
+    CModelControl const & ctrl,
+    CModelResult const & result,
+    afw::image::Exposure<Pixel> const & exposure,
+    geom::Point2D const & center
+) {
+    if (result.initial.flags[CModelStageResult::FAILED]) {
+        return 0; // the final fit region was never computed
+    }
+    PixelFitRegion region(ctrl.region, result.finalFitRegion);
+    region.applyMask(*exposure.getMaskedImage().getMask(), center);
+    if (!region.footprint) {
+        return 1;
+    }
+    Fnv1aHash hash;
+    hashPixels(hash, exposure.getMaskedImage(), *region.footprint);
+    return hash.getValue();
+}
+
+} // anonymous
+
+// Master implementation object for CModel.
+// Note that this doesn't hold its own CModelControl; that's held by the CModelAlgorithm class
+// (for historical and compatibility-with-HSC-fork reasons), and hence passed to every method
+// here that needs it.
+class CModelAlgorithm::Impl {
 public:
 
     CModelStageImpl initial;  // Implementation object for initial nonlinear fitting stage
@@ -852,10 +1933,17 @@ public:
                               // and extract shapelet PSF approximation.  May be null, depending
                               // on the CModelAlgorithm ctor called
     PTR(CModelKeys) refKeys;  // Key object used to retreive reference ellipses in forced mode
+    PTR(CModelInitializer) initializer;  // Trained starting-point predictor; null to use moments alone
+    PTR(CModelResultCache) resultCache;  // Persistent cache of non-forced results; null if disabled
+    mutable CModelWorkspacePool workspaces;  // Scratch memory for calls that aren't given a workspace
 
     explicit Impl(CModelControl const & ctrl) :
-        initial(ctrl.initial), exp(ctrl.exp), dev(ctrl.dev)
+        initial(ctrl.initial), exp(ctrl.exp), dev(ctrl.dev),
+        initializer(ctrl.getInitializer())
     {
+        if (!ctrl.resultCacheName.empty()) {
+            resultCache = std::make_shared<CModelResultCache>(ctrl.resultCacheName, ctrl.resultCacheCapacity);
+        }
         // construct linear combination model
         ModelVector components(2);
         components[0] = exp.model;
@@ -881,33 +1969,112 @@ public:
         CModelStageData const & expData, CModelStageData const & devData,
         afw::image::Exposure<Pixel> const & exposure, afw::detection::Footprint const & footprint
     ) const {
-        // concatenate exp and dev parameter arrays to make parameter arrays for combined model
-        ndarray::Array<Scalar,1,1> nonlinear = ndarray::allocate(model->getNonlinearDim());
+        ndarray::Array<Scalar,1,1> nonlinear;
+        ndarray::Array<Scalar,1,1> fixed;
+        makeCombinedParameters(expData, devData, nonlinear, fixed);
+        UnitTransformedLikelihood likelihood(
+            model, fixed, expData.fitSys, expData.position,
+            exposure, footprint, expData.psf, UnitTransformedLikelihoodControl(false)
+        );
+        ndarray::Array<Pixel,2,-1> modelMatrix = makeModelMatrix(likelihood, nonlinear, *expData.workspace);
+        solveLinear(
+            result, expData.fitSysToMeasSys.flux, modelMatrix,
+            likelihood.getUnweightedData(), likelihood.getVariance(), *expData.workspace
+        );
+    }
+
+    // Do the final two-component linear fit in several bands that share a pixel grid and Footprint,
+    // evaluating the model matrix for all bands at once (see CModelStageImpl::fitLinearMultiBand).
+    void fitLinearMultiBand(
+        CModelControl const & ctrl, std::vector<CModelResult> & results,
+        CModelStageData const & expData, CModelStageData const & devData,
+        std::vector<LocalUnitTransform> const & fitSysToMeasSys,
+        std::vector<PTR(EpochFootprint)> const & epochs
+    ) const {
+        ndarray::Array<Scalar,1,1> nonlinear;
+        ndarray::Array<Scalar,1,1> fixed;
+        makeCombinedParameters(expData, devData, nonlinear, fixed);
+        UnitTransformedLikelihood likelihood(
+            model, fixed, expData.fitSys, expData.position, epochs, UnitTransformedLikelihoodControl(false)
+        );
+        ndarray::Array<Pixel,2,-1> modelMatrix = makeModelMatrix(likelihood, nonlinear, *expData.workspace);
+        int const nPix = likelihood.getDataDim() / results.size();
+        for (std::size_t b = 0; b < results.size(); ++b) {
+            if (results[b].exp.flags[CModelStageResult::FAILED] ||
+                results[b].dev.flags[CModelStageResult::FAILED]) {
+                continue;
+            }
+            auto rows = ndarray::view(b*nPix, (b + 1)*nPix);
+            try {
+                solveLinear(
+                    results[b], fitSysToMeasSys[b].flux, modelMatrix[rows()],
+                    likelihood.getUnweightedData()[rows], likelihood.getVariance()[rows],
+                    *expData.workspace
+                );
+            } catch (...) {
+                results[b].flags[CModelResult::FAILED] = true;
+                if (!handleExpectedError(ctrl, results[b])) throw;
+            }
+        }
+    }
+
+    // Do the final two-component linear fit jointly on several epochs (see CModelStageImpl::fitMultiEpoch).
+    void fitLinearMultiEpoch(
+        CModelControl const & ctrl, CModelResult & result,
+        CModelStageData const & expData, CModelStageData const & devData,
+        std::vector<PTR(EpochFootprint)> const & epochs, EpochRowsVector const & rows
+    ) const {
+        ndarray::Array<Scalar,1,1> nonlinear;
+        ndarray::Array<Scalar,1,1> fixed;
+        makeCombinedParameters(expData, devData, nonlinear, fixed);
+        UnitTransformedLikelihood likelihood(
+            model, fixed, expData.fitSys, expData.position, epochs, UnitTransformedLikelihoodControl(false)
+        );
+        ndarray::Array<Pixel,2,-1> modelMatrix = makeModelMatrix(likelihood, nonlinear, *expData.workspace);
+        NormalizedRows normalized(
+            modelMatrix, likelihood.getUnweightedData(), likelihood.getVariance(), rows, *expData.workspace
+        );
+        solveLinear(
+            result, expData.fitSysToMeasSys.flux, normalized.modelMatrix,
+            normalized.data, normalized.variance, *expData.workspace
+        );
+    }
+
+    // Concatenate exp and dev parameter arrays to make parameter arrays for the combined model
+    void makeCombinedParameters(
+        CModelStageData const & expData, CModelStageData const & devData,
+        ndarray::Array<Scalar,1,1> & nonlinear, ndarray::Array<Scalar,1,1> & fixed
+    ) const {
+        nonlinear = expData.workspace->makeParameters(model->getNonlinearDim());
         nonlinear[ndarray::view(0, exp.model->getNonlinearDim())] = expData.nonlinear;
         nonlinear[ndarray::view(exp.model->getNonlinearDim(), model->getNonlinearDim())] = devData.nonlinear;
-        ndarray::Array<Scalar,1,1> fixed = ndarray::allocate(model->getFixedDim());
+        fixed = expData.workspace->makeParameters(model->getFixedDim());
         fixed[ndarray::view(0, exp.model->getFixedDim())] = expData.fixed;
         fixed[ndarray::view(exp.model->getFixedDim(), model->getFixedDim())] = devData.fixed;
+    }
 
-        UnitTransformedLikelihood likelihood(
-            model, fixed, expData.fitSys, expData.position,
-            exposure, footprint, expData.psf, UnitTransformedLikelihoodControl(false)
-        );
-        auto unweightedData = likelihood.getUnweightedData();
-        ndarray::Array<Pixel, 2, -1> modelMatrix = makeModelMatrix(likelihood, nonlinear);
+    // Solve for the nonnegative exp and dev amplitudes given an unweighted two-column model matrix
+    // and the corresponding data, and fill the result.  The fluxScale argument converts amplitudes
+    // from fitSys units to measSys units.
+    void solveLinear(
+        CModelResult & result, Scalar fluxScale,
+        ndarray::Array<Pixel const,2,-1> const & modelMatrix,
+        ndarray::Array<Pixel const,1,1> const & unweightedData,
+        ndarray::Array<Pixel const,1,1> const & variance,
+        CModelWorkspace::Impl & workspace
+    ) const {
         Vector gradient = -(ndarray::asEigenMatrix(modelMatrix).adjoint() *
                             ndarray::asEigenMatrix(unweightedData))
                                    .cast<Scalar>();
-        Matrix hessian = Matrix::Zero(likelihood.getAmplitudeDim(), likelihood.getAmplitudeDim());
-        hessian.selfadjointView<Eigen::Lower>().rankUpdate(
-                ndarray::asEigenMatrix(modelMatrix).adjoint().cast<Scalar>());
+        Matrix hessian = Matrix::Zero(model->getAmplitudeDim(), model->getAmplitudeDim());
+        addModelMatrixGram(modelMatrix, hessian);
         Scalar q0 = 0.5 * ndarray::asEigenMatrix(unweightedData).squaredNorm();
 
         // Use truncated Gaussian to compute the maximum-likelihood amplitudes with the constraint
         // that all amplitude must be >= 0
         TruncatedGaussian tg = TruncatedGaussian::fromSeriesParameters(q0, gradient, hessian);
         Vector amplitudes = tg.maximize();
-        result.instFlux = expData.fitSysToMeasSys.flux * amplitudes.sum();
+        result.instFlux = fluxScale * amplitudes.sum();
 
         // To compute the error on the flux, we treat the best-fit composite profile as a continuous
         // aperture and compute the uncertainty on that aperture flux.
@@ -921,9 +2088,10 @@ public:
         // Doing a better job would involve taking into account that we have positivity constraints
         // on the two components, which means the actual uncertainty is neither Gaussian nor symmetric,
         // which is a lot harder to compute and a lot harder to use.
-        ndarray::Array<Pixel,1,1> model = ndarray::allocate(likelihood.getDataDim());
+        ndarray::Array<Pixel,1,1> model
+            = workspace.getPixels(CModelWorkspace::Impl::LINEAR_MODEL, unweightedData.getSize<0>());
         ndarray::asEigenMatrix(model) = ndarray::asEigenMatrix(modelMatrix) * amplitudes.cast<Pixel>();
-        WeightSums sums(model, unweightedData, likelihood.getVariance());
+        WeightSums sums(model, unweightedData, variance);
         result.instFluxInner = sums.instFluxInner;
         result.instFluxErr = std::sqrt(sums.fluxVar)*result.instFlux/result.instFluxInner;
         if (result.instFluxInner == 0.0) {
@@ -936,10 +2104,211 @@ public:
         result.objective = tg.evaluateLog()(amplitudes);
     }
 
-    // Guess parameters for the initial fit stage from image moments
+    // Return binned data for the coarse pass of coarse-to-fine fitting, or null if that's disabled or
+    // the fit region is too small to need it.
+    PTR(EpochFootprint) makeCoarseEpoch(
+        CModelControl const & ctrl,
+        afw::image::Exposure<Pixel> const & exposure,
+        afw::detection::Footprint const & footprint,
+        shapelet::MultiShapeletFunction const & psf
+    ) const {
+        if (ctrl.coarseBinFactor <= 1 || static_cast<int>(footprint.getArea()) < ctrl.coarseMinArea) {
+            return PTR(EpochFootprint)();
+        }
+        return makeBinnedEpoch(exposure, footprint, psf, ctrl.coarseBinFactor);
+    }
+
+    // Return the starting pixel fraction for the subsampled passes of the nonlinear fits, or 1 if that's
+    // disabled or the fit region is too small to need it.
+    static Scalar getSubsampleFraction(
+        CModelControl const & ctrl,
+        afw::detection::Footprint const & footprint
+    ) {
+        if (!(ctrl.subsampleFraction > 0.0 && ctrl.subsampleFraction < 1.0)
+            || static_cast<int>(footprint.getArea()) < ctrl.subsampleMinArea) {
+            return 1.0;
+        }
+        return ctrl.subsampleFraction;
+    }
+
+    // Do the nonlinear fit for a stage, starting with a pass on the binned data in coarse if it is not
+    // null, followed by passes on subsets of the pixels if subsampleFraction < 1 (each limited to
+    // subsampleMaxIterations).  If coarseOnly is true, the full-resolution fit only solves for the
+    // amplitudes, and the result's flags come from the coarse fit.  The result's nIter includes the
+    // iterations of all passes.
+    void fitStage(
+        CModelStageImpl const & impl, CModelStageControl const & ctrl, CModelStageResult & result,
+        CModelStageData const & data,
+        afw::image::Exposure<Pixel> const & exposure, afw::detection::Footprint const & footprint,
+        PTR(EpochFootprint) const & coarse, bool coarseOnly, Scalar subsampleFraction,
+        int subsampleMaxIterations
+    ) const {
+        if (!coarse && !(subsampleFraction < 1.0)) {
+            impl.fit(ctrl, result, data, exposure, footprint);
+            return;
+        }
+        long long startTime = 0;
+        if (ctrl.doRecordTime) {
+            startTime = daf::base::DateTime::now().nsecs();
+        }
+        int nIter = 0;  // iterations in passes before the full-resolution fit
+        if (coarse) {
+            CModelStageResult coarseResult = impl.fitCoarse(ctrl, data, coarse);
+            nIter += coarseResult.nIter;
+            if (coarseOnly) {
+                impl.fitLinear(ctrl, result, data, exposure, footprint);
+                result.flags |= coarseResult.flags;
+                result.flags[CModelStageResult::FAILED] = coarseResult.flags[CModelStageResult::FAILED];
+                result.history = coarseResult.history;
+                result.nIter = coarseResult.nIter;
+            }
+        }
+        if (!(coarse && coarseOnly)) {
+            if (subsampleFraction < 1.0) {
+                nIter += impl.fitSubsampled(ctrl, data, exposure, footprint, subsampleFraction,
+                                            subsampleMaxIterations);
+            }
+            impl.fit(ctrl, result, data, exposure, footprint);
+            result.nIter += nIter;
+        }
+        if (ctrl.doRecordTime) {
+            result.time = (daf::base::DateTime::now().nsecs() - startTime)/1E9;
+        }
+    }
+
+    // Fit a stage jointly to a group of sources with overlapping fit regions, starting from the
+    // parameters in data (one per member, with the same order as pixels.footprints).  On return, data
+    // holds the best-fit parameters, results holds a stage result for each member, and models holds
+    // each member's best-fit model at the pixels of its own fit region.  Each member's flux and its
+    // uncertainty are measured on the data with the other members' models subtracted.  The joint fit
+    // must finish before the earliest of the members' deadlines.  Returns false (leaving the outputs
+    // unset) if the joint fit did not converge, for any reason; the caller should then keep the
+    // members' independent fits.
+    bool fitGroupStage(
+        CModelStageImpl const & impl, CModelStageControl const & ctrl,
+        std::vector<CModelStageData> & data,
+        PTR(CModelGroupPixels const) const & pixels,
+        afw::image::Exposure<Pixel> const & exposure,
+        std::vector<CModelStageResult> & results,
+        std::vector<ndarray::Array<Scalar,1,1>> & models
+    ) const {
+        long long startTime = 0;
+        if (ctrl.doRecordTime) {
+            startTime = daf::base::DateTime::now().nsecs();
+        }
+        std::size_t const nMembers = data.size();
+        std::vector<PTR(Likelihood)> likelihoods;
+        likelihoods.reserve(nMembers);
+        Scalar snr = std::numeric_limits<Scalar>::quiet_NaN();
+        auto deadline = std::chrono::steady_clock::time_point::max();
+        for (std::size_t k = 0; k < nMembers; ++k) {
+            deadline = std::min(deadline, data[k].deadline);
+            likelihoods.push_back(
+                std::make_shared<UnitTransformedLikelihood>(
+                    impl.model, data[k].fixed, data[k].fitSys, data[k].position,
+                    exposure, *pixels->footprints[k], data[k].psf, UnitTransformedLikelihoodControl(true)
+                )
+            );
+            if (std::isfinite(data[k].snr) && !(data[k].snr >= snr)) {
+                snr = data[k].snr;  // use the most conservative convergence criteria of any member
+            }
+        }
+        // Weights for the union of the fit regions, as UnitTransformedLikelihood would compute them.
+        ndarray::Array<Pixel,1,1> weights = ndarray::allocate(pixels->getSize());
+        ndarray::asEigenArray(weights) =
+            ndarray::asEigenArray(pixels->variance).sqrt().inverse() * ctrl.weightsMultiplier;
+        if (!ctrl.usePixelWeights) {
+            weights.deep() = std::exp(ndarray::asEigenArray(weights).log().sum() / weights.getSize<0>());
+        }
+        auto objective = std::make_shared<CModelGroupObjective>(likelihoods, impl.prior, pixels, weights);
+        int const blockSize = objective->getBlockSize();
+        ndarray::Array<Scalar,1,1> parameters = ndarray::allocate(objective->parameterSize);
+        for (std::size_t k = 0; k < nMembers; ++k) {
+            parameters[ndarray::view(k*blockSize, (k + 1)*blockSize)] = data[k].parameters;
+        }
+        CModelStageResult jointResult = impl.makeResult();
+        OptimizerControl optimizerCtrl = ctrl.getOptimizerControl(snr);
+        clipMaxTime(optimizerCtrl, deadline);
+        Optimizer optimizer(objective, parameters, optimizerCtrl);
+        try {
+            optimizer.run();
+        } catch (std::overflow_error &) {
+            return false;
+        } catch (std::underflow_error &) {
+            return false;
+        } catch (pex::exceptions::UnderflowError &) {
+            return false;
+        } catch (pex::exceptions::OverflowError &) {
+            return false;
+        }
+        setOptimizerFlags(jointResult, optimizer.getState());
+        // Unlike a single-source fit, an unconverged joint fit (from running out of iterations or time)
+        // isn't better than what we started from: the independent fits did converge.
+        if (jointResult.flags[CModelStageResult::FAILED]) return false;
+
+        // Evaluate the best-fit models of all members, and their sum over the union of the regions.
+        ndarray::Array<Scalar,1,1> total = ndarray::allocate(pixels->getSize());
+        total.deep() = 0.0;
+        models.resize(nMembers);
+        for (std::size_t k = 0; k < nMembers; ++k) {
+            auto memberParameters = optimizer.getParameters()[ndarray::view(k*blockSize, (k + 1)*blockSize)];
+            data[k].parameters.deep() = memberParameters;
+            std::vector<int> const & rows = pixels->rows[k];
+            models[k] = ndarray::allocate(rows.size());
+            objective->computeMemberModel(optimizer.getParameters(), k, models[k]);
+            for (std::size_t i = 0; i < rows.size(); ++i) {
+                total[rows[i]] += models[k][i];
+            }
+        }
+
+        // Fill the per-member results, using the data with the neighbors' models subtracted.
+        results.assign(nMembers, jointResult);
+        for (std::size_t k = 0; k < nMembers; ++k) {
+            CModelStageResult & result = results[k];
+            result.likelihood = likelihoods[k];
+            result.objfunc = objective;
+            result.objective = optimizer.getObjectiveValue();
+            result.gradientThreshold = optimizer.getControl().gradientThreshold;
+            result.minTrustRadiusThreshold = optimizer.getControl().minTrustRadiusThreshold;
+            result.maxOuterIterations = optimizer.getControl().maxOuterIterations;
+            std::vector<int> const & rows = pixels->rows[k];
+            ndarray::Array<Pixel,1,1> deblended = ndarray::allocate(rows.size());
+            for (std::size_t i = 0; i < rows.size(); ++i) {
+                deblended[i] = pixels->data[rows[i]] - (total[rows[i]] - models[k][i]);
+            }
+            ndarray::Array<Pixel,2,-1> modelMatrix
+                = makeModelMatrix(*likelihoods[k], data[k].nonlinear, *data[k].workspace);
+            WeightSums sums(modelMatrix, deblended, likelihoods[k]->getVariance());
+            if (ctrl.usePixelWeights) {
+                // As in CModelStageImpl::fitLikelihood, refit the amplitude without per-pixel weights.
+                afw::math::LeastSquares lstsq
+                    = afw::math::LeastSquares::fromDesignMatrix(modelMatrix, deblended);
+                data[k].amplitudes.deep() = lstsq.getSolution();
+            }
+            impl.fillResult(result, data[k], sums);
+            if (ctrl.doRecordTime) {
+                result.time = (daf::base::DateTime::now().nsecs() - startTime)/1E9;
+            }
+        }
+        return true;
+    }
+
+    // Compute the end of the per-source time budget for a source whose processing began at start.
+    static std::chrono::steady_clock::time_point makeDeadline(
+        CModelControl const & ctrl, std::chrono::steady_clock::time_point start
+    ) {
+        if (!(ctrl.maxTime > 0.0)) return std::chrono::steady_clock::time_point::max();
+        return start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(ctrl.maxTime)
+        );
+    }
+
+    // Guess parameters for the initial fit stage from image moments (and, if we have an initializer,
+    // the Kron radius and data.snr)
     void guessParametersFromMoments(
         CModelControl const & ctrl, CModelStageData & data,
         afw::geom::ellipses::Quadrupole const & moments,
+        Scalar kronRadius,
         CModelResult & result
     ) const {
         afw::geom::ellipses::Ellipse psfEllipse = data.psf.evaluate().computeMoments();
@@ -973,6 +2342,29 @@ public:
         );
         // Convert ellipse from moments to half-light using the ratio for this profile
         deconvolvedEllipse.getCore().scale(1.0 / initial.profile->getMomentsRadiusFactor());
+        if (initializer) {
+            // Replace the moments-based size with the trained prediction (the prediction uses the
+            // deconvolved ellipticity when it can, so it agrees with the above on everything else).
+            // The prediction is an extrapolation that can overflow or underflow for unusual inputs,
+            // so we stick with the moments-based guess if it isn't finite, and apply the same
+            // minInitialRadius floor we do to the moments.
+            afw::geom::ellipses::Quadrupole predicted = initializer->predict(
+                CModelInitializer::INITIAL, moments,
+                afw::geom::ellipses::Quadrupole(psfEllipse.getCore()), kronRadius, data.snr
+            );
+            Scalar const radius = predicted.getDeterminantRadius();
+            if (std::isfinite(radius) && std::isfinite(predicted.getIxy())) {
+                if (radius < ctrl.minInitialRadius) {
+                    if (radius > 0.0) {
+                        predicted.scale(ctrl.minInitialRadius / radius);
+                    } else {
+                        predicted = afw::geom::ellipses::Quadrupole(mir2, mir2, 0.0);
+                    }
+                    result.flags[CModelResult::SMALL_SHAPE] = true;
+                }
+                deconvolvedEllipse.setCore(predicted);
+            }
+        }
         // Transform the deconvolved ellipse from MeasSys to FitSys
         deconvolvedEllipse.transform(data.fitSysToMeasSys.geometric.inverted()).inPlace();
         // Convert to the ellipse parametrization used by the Model (assigning to an ellipse converts
@@ -1000,7 +2392,66 @@ public:
         }
     }
 
-    void checkFlagDetails(afw::table::SourceRecord & record) const {
+    // If we have an initializer, rescale the starting ellipse for the exp or dev stage (copied from the
+    // initial fit) by the ratio of the radii it predicts for that stage and for the initial stage.
+    void applyInitializer(
+        CModelInitializer::Stage stage, CModelStageImpl const & impl, CModelStageData & data,
+        afw::geom::ellipses::Quadrupole const & moments,
+        afw::geom::ellipses::Quadrupole const & psfMoments,
+        Scalar kronRadius
+    ) const {
+        if (!initializer) return;
+        ndarray::Array<Scalar,1,1> features
+            = CModelInitializer::computeFeatures(moments, psfMoments, kronRadius, data.snr);
+        Scalar ratio = initializer->predictRadiusRatio(stage, features)
+            / initializer->predictRadiusRatio(CModelInitializer::INITIAL, features);
+        if (!std::isfinite(ratio)) return;
+        ndarray::Array<Scalar,1,1> original = ndarray::copy(data.nonlinear);
+        impl.model->writeEllipses(data.nonlinear.begin(), data.fixed.begin(), impl.ellipses.begin());
+        for (auto & ellipse : impl.ellipses) {
+            ellipse.getCore().scale(ratio);
+        }
+        impl.model->readEllipses(impl.ellipses.begin(), data.nonlinear.begin(), data.fixed.begin());
+        // Don't start from a point the prior rules out.
+        if (impl.prior && impl.prior->evaluate(data.nonlinear, data.amplitudes) == 0.0) {
+            data.nonlinear.deep() = original;
+        }
+    }
+
+    // Report an expected failure: set the given flag and the general failure flag, and then throw a
+    // MeasurementError with that flag unless ctrl.raiseMeasurementErrors is false.
+    static void reportFailure(
+        CModelControl const & ctrl, CModelResult & result, int flagBit, std::string const & message
+    ) {
+        result.flags[flagBit] = true;
+        result.flags[CModelResult::FAILED] = true;
+        if (ctrl.raiseMeasurementErrors) {
+            throw LSST_EXCEPT(meas::base::MeasurementError, message, flagBit);
+        }
+    }
+
+    // Must be called from a catch block.  If ctrl.raiseMeasurementErrors is false and the exception
+    // being handled is an expected failure (a MeasurementError or a numerical error), set the general
+    // failure flag (and the MeasurementError's flag) on the result and return true; otherwise return
+    // false, and the caller should rethrow.
+    static bool handleExpectedError(CModelControl const & ctrl, CModelResult & result) {
+        if (ctrl.raiseMeasurementErrors) return false;
+        try {
+            throw;
+        } catch (meas::base::MeasurementError & error) {
+            result.flags[error.getFlagBit()] = true;
+        } catch (std::overflow_error &) {
+        } catch (std::underflow_error &) {
+        } catch (pex::exceptions::UnderflowError &) {
+        } catch (pex::exceptions::OverflowError &) {
+        } catch (...) {
+            return false;
+        }
+        result.flags[CModelResult::FAILED] = true;
+        return true;
+    }
+
+    void checkFlagDetails(CModelControl const & ctrl, afw::table::SourceRecord & record) const {
         // The BAD_REFERENCE flag should always imply general failure, even if we attempted to
         // proceed (because the results should not be trusted).  But we set general failure to true
         // at the beginning so it's set if an unexpected exception is thrown, and then we unset it
@@ -1011,6 +2462,13 @@ public:
         // Check for unflagged NaNs.  Warn if we see any so we can fix the underlying problem, and
         // then flag them anyway.
         if (std::isnan(record.get(keys->instFlux)) && !record.get(keys->flags[CModelResult::FAILED])) {
+            if (!ctrl.raiseMeasurementErrors) {
+                LOGL_WARN("meas.modelfit.CModel",
+                          "Unflagged NaN detected for source %lld; please report this as a bug in CModel",
+                          static_cast<long long>(record.getId()));
+                record.set(keys->flags[CModelResult::FAILED], true);
+                return;
+            }
             // We throw a non-MeasurementError exception so the measurement error *will* log a warning.
             throw LSST_EXCEPT(
                 pex::exceptions::LogicError,
@@ -1066,30 +2524,134 @@ CModelAlgorithm::Result CModelAlgorithm::apply(
     int footprintArea
 ) const {
     Result result = _impl->makeResult();
-    _applyImpl(result, exposure, psf, center, moments, approxFlux, kronRadius, footprintArea);
+    CModelWorkspacePool::Borrowed workspace(_impl->workspaces);
+    _applyImpl(result, *workspace, exposure, psf, center, moments, approxFlux, kronRadius, footprintArea);
     return result;
 }
 
+CModelAlgorithm::Result CModelAlgorithm::apply(
+    CModelWorkspace & workspace,
+    afw::image::Exposure<Pixel> const & exposure,
+    shapelet::MultiShapeletFunction const & psf,
+    geom::Point2D const & center,
+    afw::geom::ellipses::Quadrupole const & moments,
+    Scalar approxFlux,
+    Scalar kronRadius,
+    int footprintArea
+) const {
+    Result result = _impl->makeResult();
+    workspace._impl->reset();
+    _applyImpl(result, *workspace._impl, exposure, psf, center, moments, approxFlux, kronRadius,
+               footprintArea);
+    return result;
+}
+
+PTR(CModelResultCache) CModelAlgorithm::getResultCache() const {
+    return _impl->resultCache;
+}
+
+int CModelAlgorithm::getWorkspaceGrowCount() const {
+    return _impl->workspaces.getGrowCount();
+}
+
 void CModelAlgorithm::_applyImpl(
     Result & result,
+    CModelWorkspace::Impl & workspace,
     afw::image::Exposure<Pixel> const & exposure,
     shapelet::MultiShapeletFunction const & psf,
     geom::Point2D const & center,
     afw::geom::ellipses::Quadrupole const & moments,
     Scalar approxFlux,
     Scalar kronRadius,
-    int footprintArea
+    int footprintArea,
+    Result const * reference
+) const {
+    PTR(CModelResultCache) cache = _impl->resultCache;
+    // Warm-started fits depend on the reference result too, and the cache doesn't store optimizer
+    // histories, so we don't cache either.
+    if (!cache || reference || getControl().initial.doRecordHistory || getControl().exp.doRecordHistory
+        || getControl().dev.doRecordHistory) {
+        _applyUncachedImpl(result, workspace, exposure, psf, center, moments, approxFlux, kronRadius,
+                           footprintArea, reference);
+        return;
+    }
+
+    // The key covers everything that determines the initial fit region and the fit within it; the
+    // pixels in the final fit region are checked separately, since that region depends on the fit.
+    Fnv1aHash hash;
+    hash.add(RESULT_CACHE_KEY_VERSION);
+    hashControl(hash, getControl());
+    if (_impl->initializer) {
+        ndarray::Array<Scalar const,2,1> coefficients = _impl->initializer->getCoefficients();
+        for (std::size_t i = 0; i < coefficients.getSize<0>(); ++i) {
+            for (std::size_t j = 0; j < coefficients.getSize<1>(); ++j) {
+                hash.add(coefficients[i][j]);
+            }
+        }
+    }
+    hashPsf(hash, psf);
+    hash.add(center);
+    hash.add(moments);
+    hash.add(approxFlux);
+    hash.add(kronRadius);
+    hash.add(footprintArea);
+    geom::AffineTransform::ParameterVector wcsParameters
+        = exposure.getWcs()->linearizePixelToSky(center, geom::arcseconds).getParameterVector();
+    for (int i = 0; i < wcsParameters.size(); ++i) {
+        hash.add(wcsParameters[i]);
+    }
+    if (exposure.getPhotoCalib()) {
+        hash.add(exposure.getPhotoCalib()->getCalibrationMean());
+    }
+    try {
+        afw::geom::ellipses::Quadrupole psfMoments = psf.evaluate().computeMoments().getCore();
+        PixelFitRegion region(getControl().region, moments, psfMoments, kronRadius, footprintArea);
+        region.applyMask(*exposure.getMaskedImage().getMask(), center);
+        if (region.footprint) {
+            hashPixels(hash, exposure.getMaskedImage(), *region.footprint);
+        }
+    } catch (geom::SingularTransformException const &) {
+        // _applyUncachedImpl will report this failure; the PSF is already in the key.
+    }
+    std::uint64_t const key = hash.getValue();
+
+    auto validate = [this, &exposure, &center](Result const & cached) {
+        return computeFinalRegionCheck(getControl(), cached, exposure, center);
+    };
+    if (cache->get(key, validate, result)) {
+        return;
+    }
+    _applyUncachedImpl(result, workspace, exposure, psf, center, moments, approxFlux, kronRadius,
+                       footprintArea, reference);
+    // Fits cut short by maxTime depend on how busy the machine was, so we don't reuse them.
+    if (isAnyStageOutOfTime(result)) {
+        return;
+    }
+    cache->put(key, validate(result), result);
+}
+
+void CModelAlgorithm::_applyUncachedImpl(
+    Result & result,
+    CModelWorkspace::Impl & workspace,
+    afw::image::Exposure<Pixel> const & exposure,
+    shapelet::MultiShapeletFunction const & psf,
+    geom::Point2D const & center,
+    afw::geom::ellipses::Quadrupole const & moments,
+    Scalar approxFlux,
+    Scalar kronRadius,
+    int footprintArea,
+    Result const * reference
 ) const {
 
+    auto const startClock = std::chrono::steady_clock::now();
+
     afw::geom::ellipses::Quadrupole psfMoments;
     try {
         psfMoments = psf.evaluate().computeMoments().getCore();
     } catch (geom::SingularTransformException const& exc) {
-        throw LSST_EXCEPT(
-            meas::base::MeasurementError,
-            std::string("Singular transform in shapelets: ") + exc.what(),
-            CModelResult::NO_SHAPELET_PSF
-            );
+        Impl::reportFailure(getControl(), result, CModelResult::NO_SHAPELET_PSF,
+                            std::string("Singular transform in shapelets: ") + exc.what());
+        return;
     }
 
     PixelFitRegion region(getControl().region, moments, psfMoments, kronRadius, footprintArea);
@@ -1122,16 +2684,43 @@ void CModelAlgorithm::_applyImpl(
     }
 
     // Set up coordinate systems and empty parameter vectors
-    CModelStageData initialData(exposure, approxFlux, center, psf, *_impl->initial.model);
+    CModelStageData initialData(exposure, approxFlux, center, psf, *_impl->initial.model, workspace);
     result.fitSysToMeasSys = initialData.fitSysToMeasSys;
+    initialData.deadline = _impl->makeDeadline(getControl(), startClock);
+    // We always estimate the signal-to-noise ratio (even if no stage uses it) and record it in the
+    // result, so initializers can be trained on exactly the quantity they'll be given.
+    initialData.snr = approxFlux / std::sqrt(
+        computeVarianceInFootprint(*exposure.getMaskedImage().getVariance(), *region.footprint)
+    );
+    result.snr = initialData.snr;
+
+    // Initialize the parameter vectors from the reference if we're warm-starting and it's usable (the
+    // reference parameters are in fitSys units, which depend only on the position of the source, so
+    // they don't need to be transformed), or otherwise by deconvolving the moments.
+    bool const warmInitial = reference && !reference->initial.flags[CModelStageResult::FAILED];
+    if (warmInitial) {
+        copyReferenceParameters(reference->initial, initialData);
+        initialData.amplitudes[0] = 1.0; // approximately correct in fitSys, as in a cold start
+    } else {
+        _impl->guessParametersFromMoments(getControl(), initialData, moments, kronRadius, result);
+    }
 
-    // Initialize the parameter vectors by doing deconvolving the moments
-    _impl->guessParametersFromMoments(getControl(), initialData, moments, result);
-
-    // Do the initial fit
+    // Do the initial fit (or just fit its amplitude, if so configured when warm-starting)
     // TODO: use only 0th-order terms in psf
-    _impl->initial.fit(getControl().initial, result.initial, initialData, exposure, *region.footprint);
-    if (result.initial.flags[CModelStageResult::FAILED]) return;
+    if (warmInitial && getControl().warmStartSkipInitial) {
+        _impl->initial.fitLinear(getControl().initial, result.initial, initialData,
+                                 exposure, *region.footprint);
+    } else {
+        PTR(EpochFootprint) coarse = _impl->makeCoarseEpoch(getControl(), exposure, *region.footprint, psf);
+        bool coarseOnly = coarse && getControl().coarseOnlyForMaxArea
+            && static_cast<int>(region.footprint->getArea()) > getControl().region.maxArea;
+        result.flags[CModelResult::REGION_COARSE_ONLY] = coarseOnly;
+        _impl->fitStage(_impl->initial, getControl().initial, result.initial, initialData,
+                        exposure, *region.footprint, coarse, coarseOnly,
+                        Impl::getSubsampleFraction(getControl(), *region.footprint),
+                        getControl().subsampleMaxIterations);
+    }
+    if (!isStageUsable(result.initial)) return;
 
     // Include a multiple of the initial-fit ellipse in the footprint, re-do clipping
     result.initial.model->writeEllipses(initialData.nonlinear.begin(), initialData.fixed.begin(),
@@ -1149,15 +2738,38 @@ void CModelAlgorithm::_applyImpl(
     result.flags[CModelResult::REGION_USED_INITIAL_ELLIPSE_MAX] = region.usedMaxEllipse;
     if (!region.footprint) return;
 
+    // Set up binned data for coarse-to-fine fitting in the final fit region, if enabled.
+    PTR(EpochFootprint) coarse = _impl->makeCoarseEpoch(getControl(), exposure, *region.footprint, psf);
+    bool coarseOnly = coarse && getControl().coarseOnlyForMaxArea
+        && static_cast<int>(region.footprint->getArea()) > getControl().region.maxArea;
+    if (coarseOnly) {
+        result.flags[CModelResult::REGION_COARSE_ONLY] = true;
+    }
+    Scalar const subsampleFraction = Impl::getSubsampleFraction(getControl(), *region.footprint);
+
     // Do the exponential fit
     CModelStageData expData = initialData.changeModel(*_impl->exp.model);
-    _impl->exp.fit(getControl().exp, result.exp, expData, exposure, *region.footprint);
+    if (reference && !reference->exp.flags[CModelStageResult::FAILED]) {
+        copyReferenceParameters(reference->exp, expData);
+    } else {
+        _impl->applyInitializer(CModelInitializer::EXP, _impl->exp, expData, moments, psfMoments,
+                                kronRadius);
+    }
+    _impl->fitStage(_impl->exp, getControl().exp, result.exp, expData, exposure, *region.footprint,
+                    coarse, coarseOnly, subsampleFraction, getControl().subsampleMaxIterations);
 
     // Do the de Vaucouleur fit
     CModelStageData devData = initialData.changeModel(*_impl->dev.model);
-    _impl->dev.fit(getControl().dev, result.dev, devData, exposure, *region.footprint);
+    if (reference && !reference->dev.flags[CModelStageResult::FAILED]) {
+        copyReferenceParameters(reference->dev, devData);
+    } else {
+        _impl->applyInitializer(CModelInitializer::DEV, _impl->dev, devData, moments, psfMoments,
+                                kronRadius);
+    }
+    _impl->fitStage(_impl->dev, getControl().dev, result.dev, devData, exposure, *region.footprint,
+                    coarse, coarseOnly, subsampleFraction, getControl().subsampleMaxIterations);
 
-    if (result.exp.flags[CModelStageResult::FAILED] ||result.dev.flags[CModelStageResult::FAILED])
+    if (!isStageUsable(result.exp) || !isStageUsable(result.dev))
         return;
 
     // Do the linear combination fit
@@ -1165,11 +2777,446 @@ void CModelAlgorithm::_applyImpl(
         _impl->fitLinear(getControl(), result, expData, devData, exposure, *region.footprint);
     } catch (...) {
         result.flags[CModelResult::FAILED] = true;
-        throw;
+        if (!Impl::handleExpectedError(getControl(), result)) throw;
+    }
+    // The combination of stages cut short by maxTime is reported, but can't be trusted.
+    if (isAnyStageOutOfTime(result)) {
+        result.flags[CModelResult::FAILED] = true;
     }
 }
 
+CModelAlgorithm::Result CModelAlgorithm::applyWarmStart(
+    afw::image::Exposure<Pixel> const & exposure,
+    shapelet::MultiShapeletFunction const & psf,
+    geom::Point2D const & center,
+    afw::geom::ellipses::Quadrupole const & moments,
+    Result const & reference,
+    Scalar approxFlux,
+    Scalar kronRadius,
+    int footprintArea
+) const {
+    Result result = _impl->makeResult();
+    CModelWorkspacePool::Borrowed workspace(_impl->workspaces);
+    _applyImpl(result, *workspace, exposure, psf, center, moments, approxFlux, kronRadius,
+               footprintArea, &reference);
+    return result;
+}
+
+CModelAlgorithm::Result CModelAlgorithm::applyWarmStart(
+    CModelWorkspace & workspace,
+    afw::image::Exposure<Pixel> const & exposure,
+    shapelet::MultiShapeletFunction const & psf,
+    geom::Point2D const & center,
+    afw::geom::ellipses::Quadrupole const & moments,
+    Result const & reference,
+    Scalar approxFlux,
+    Scalar kronRadius,
+    int footprintArea
+) const {
+    Result result = _impl->makeResult();
+    workspace._impl->reset();
+    _applyImpl(result, *workspace._impl, exposure, psf, center, moments, approxFlux, kronRadius,
+               footprintArea, &reference);
+    return result;
+}
+
+CModelAlgorithm::Result CModelAlgorithm::applyMultiEpoch(
+    std::vector<PTR(afw::image::Exposure<Pixel>)> const & exposures,
+    std::vector<shapelet::MultiShapeletFunction> const & psfs,
+    geom::SpherePoint const & position,
+    afw::geom::ellipses::Quadrupole const & moments,
+    Scalar approxFlux,
+    Scalar kronRadius,
+    int footprintArea
+) const {
+    LSST_THROW_IF_NE(
+        exposures.size(), psfs.size(),
+        pex::exceptions::LengthError,
+        "Number of exposures (%d) does not match number of PSFs (%d)"
+    );
+    if (exposures.empty()) {
+        throw LSST_EXCEPT(
+            pex::exceptions::LengthError,
+            "applyMultiEpoch requires at least one exposure"
+        );
+    }
+    auto const startClock = std::chrono::steady_clock::now();
+    Result result = _impl->makeResult();
+    std::size_t const nEpochs = exposures.size();
+
+    // Per-epoch inputs: the center and PSF moments in each epoch's pixel coordinates, the linear
+    // transform from the first epoch's pixel coordinates to each epoch's, and the factor that converts
+    // each epoch's fluxes to the units of the first.  We compute the last two via a fitSys centered
+    // on the source, which is what the likelihood will use too.
+    UnitSystem referenceFitSys(position, exposures.front()->getPhotoCalib(), 1.0);
+    std::vector<geom::Point2D> centers;
+    std::vector<afw::geom::ellipses::Quadrupole> psfMoments;
+    std::vector<geom::LinearTransform> fitSysToEpoch;
+    std::vector<Scalar> fluxScales;
+    for (std::size_t b = 0; b < nEpochs; ++b) {
+        afw::image::Exposure<Pixel> const & exposure = *exposures[b];
+        centers.push_back(exposure.getWcs()->skyToPixel(position));
+        try {
+            psfMoments.push_back(psfs[b].evaluate().computeMoments().getCore());
+        } catch (geom::SingularTransformException const& exc) {
+            Impl::reportFailure(getControl(), result, CModelResult::NO_SHAPELET_PSF,
+                                std::string("Singular transform in shapelets: ") + exc.what());
+            return result;
+        }
+        LocalUnitTransform transform(
+            referenceFitSys.wcs->getPixelOrigin(), referenceFitSys, UnitSystem(exposure)
+        );
+        fitSysToEpoch.push_back(transform.geometric.getLinear());
+        fluxScales.push_back(transform.flux);
+    }
+    Scalar const referenceFluxScale = fluxScales.front();
+    for (std::size_t b = 0; b < nEpochs; ++b) {
+        fluxScales[b] = referenceFluxScale / fluxScales[b];
+    }
+
+    // Compute a fit region for each epoch; those with no usable pixels are left out of the fit.
+    std::vector<PixelFitRegion> regions;
+    for (std::size_t b = 0; b < nEpochs; ++b) {
+        geom::LinearTransform toEpoch = fitSysToEpoch[b] * fitSysToEpoch.front().inverted();
+        Scalar const areaScale = std::abs(toEpoch.computeDeterminant());
+        regions.push_back(
+            PixelFitRegion(
+                getControl().region,
+                moments.transform(toEpoch),
+                psfMoments[b],
+                (kronRadius > 0.0) ? kronRadius*std::sqrt(areaScale) : kronRadius,
+                (footprintArea > 0) ? static_cast<int>(footprintArea*areaScale) : footprintArea
+            )
+        );
+        regions.back().applyMask(*exposures[b]->getMaskedImage().getMask(), centers[b]);
+    }
+    result.initialFitRegion = regions.front().ellipse;
+
+    // Set up the EpochFootprints for all epochs with a fit region, and set the region flags from
+    // just those epochs (or all epochs, if none of them could be used).
+    std::vector<PTR(EpochFootprint)> epochs;
+    EpochRowsVector rows;
+    auto makeEpochs = [&]() {
+        epochs.clear();
+        rows.clear();
+        for (std::size_t b = 0; b < nEpochs; ++b) {
+            if (regions[b].footprint) {
+                epochs.push_back(
+                    std::make_shared<EpochFootprint>(*regions[b].footprint, *exposures[b], psfs[b])
+                );
+                rows.push_back(EpochRows{static_cast<int>(regions[b].footprint->getArea()), fluxScales[b]});
+            }
+        }
+        result.flags[CModelResult::REGION_MAX_AREA] = false;
+        result.flags[CModelResult::REGION_MAX_BAD_PIXEL_FRACTION] = false;
+        for (std::size_t b = 0; b < nEpochs; ++b) {
+            if (!regions[b].footprint && !epochs.empty()) continue;
+            if (regions[b].maxArea) result.flags[CModelResult::REGION_MAX_AREA] = true;
+            if (regions[b].maxBadPixelFraction) {
+                result.flags[CModelResult::REGION_MAX_BAD_PIXEL_FRACTION] = true;
+            }
+            if (regions[b].usedFootprintArea) result.flags[CModelResult::REGION_USED_FOOTPRINT_AREA] = true;
+            if (regions[b].usedPsfArea) result.flags[CModelResult::REGION_USED_PSF_AREA] = true;
+            if (regions[b].usedMinEllipse) result.flags[CModelResult::REGION_USED_INITIAL_ELLIPSE_MIN] = true;
+            if (regions[b].usedMaxEllipse) result.flags[CModelResult::REGION_USED_INITIAL_ELLIPSE_MAX] = true;
+        }
+    };
+    makeEpochs();
+    if (epochs.empty()) return result;
+
+    // Negative approxFlux means we should come up with an estimate ourselves, from the first epoch
+    // we're actually using (converted to the units of the first exposure).
+    if (!(approxFlux > 0.0)) {
+        for (std::size_t b = 0; b < nEpochs; ++b) {
+            if (regions[b].footprint) {
+                approxFlux = fluxScales[b] * computeFluxInFootprint(
+                    *exposures[b]->getMaskedImage().getImage(), *regions[b].footprint
+                );
+                break;
+            }
+        }
+        if (!(approxFlux > 0.0)) {
+            result.initial.flags[CModelStageResult::NUMERIC_ERROR] = true;
+            result.initial.flags[CModelStageResult::FAILED] = true;
+            result.exp.flags[CModelStageResult::NUMERIC_ERROR] = true;
+            result.exp.flags[CModelStageResult::FAILED] = true;
+            result.dev.flags[CModelStageResult::NUMERIC_ERROR] = true;
+            result.dev.flags[CModelStageResult::FAILED] = true;
+            result.flags[CModelResult::FAILED] = true;
+            return result;
+        }
+    }
+
+    // Set up coordinate systems and empty parameter vectors; everything is defined relative to the
+    // first exposure, just as if we were fitting a coadd with its Wcs and PhotoCalib.
+    CModelWorkspacePool::Borrowed borrowed(_impl->workspaces);
+    CModelWorkspace::Impl & workspace = *borrowed;
+    CModelStageData initialData(
+        *exposures.front(), approxFlux, centers.front(), psfs.front(), *_impl->initial.model, workspace
+    );
+    result.fitSysToMeasSys = initialData.fitSysToMeasSys;
+    initialData.deadline = _impl->makeDeadline(getControl(), startClock);
+    {
+        Scalar variance = 0.0;
+        for (std::size_t b = 0; b < nEpochs; ++b) {
+            if (regions[b].footprint) {
+                variance += fluxScales[b] * fluxScales[b] * computeVarianceInFootprint(
+                    *exposures[b]->getMaskedImage().getVariance(), *regions[b].footprint
+                );
+            }
+        }
+        initialData.snr = approxFlux / std::sqrt(variance);
+        result.snr = initialData.snr;
+    }
+
+    // Initialize the parameter vectors by doing deconvolving the moments
+    _impl->guessParametersFromMoments(getControl(), initialData, moments, kronRadius, result);
+
+    // Do the initial fit
+    _impl->initial.fitMultiEpoch(getControl().initial, result.initial, initialData, epochs, rows);
+    if (!isStageUsable(result.initial)) return result;
+
+    // Revisit the pixel region to use in each epoch, taking into account the initial ellipse
+    result.initial.model->writeEllipses(initialData.nonlinear.begin(), initialData.fixed.begin(),
+                                        _impl->initial.ellipses.begin());
+    afw::geom::ellipses::Quadrupole initialEllipse(_impl->initial.ellipses.front().getCore());
+    for (std::size_t b = 0; b < nEpochs; ++b) {
+        regions[b].applyEllipse(initialEllipse.transform(fitSysToEpoch[b]), psfMoments[b]);
+        regions[b].applyMask(*exposures[b]->getMaskedImage().getMask(), centers[b]);
+    }
+    result.finalFitRegion = regions.front().ellipse;
+    makeEpochs();
+    if (epochs.empty()) return result;
+
+    // Do the exponential fit
+    CModelStageData expData = initialData.changeModel(*_impl->exp.model);
+    _impl->applyInitializer(
+        CModelInitializer::EXP, _impl->exp, expData, moments, psfMoments.front(), kronRadius
+    );
+    _impl->exp.fitMultiEpoch(getControl().exp, result.exp, expData, epochs, rows);
+
+    // Do the de Vaucouleur fit
+    CModelStageData devData = initialData.changeModel(*_impl->dev.model);
+    _impl->applyInitializer(
+        CModelInitializer::DEV, _impl->dev, devData, moments, psfMoments.front(), kronRadius
+    );
+    _impl->dev.fitMultiEpoch(getControl().dev, result.dev, devData, epochs, rows);
+
+    if (!isStageUsable(result.exp) || !isStageUsable(result.dev))
+        return result;
+
+    // Do the linear combination fit
+    try {
+        _impl->fitLinearMultiEpoch(getControl(), result, expData, devData, epochs, rows);
+    } catch (...) {
+        result.flags[CModelResult::FAILED] = true;
+        if (!Impl::handleExpectedError(getControl(), result)) throw;
+    }
+    // The combination of stages cut short by maxTime is reported, but can't be trusted.
+    if (isAnyStageOutOfTime(result)) {
+        result.flags[CModelResult::FAILED] = true;
+    }
+    return result;
+}
+
+std::vector<CModelAlgorithm::Result> CModelAlgorithm::applyGroup(
+    afw::image::Exposure<Pixel> const & exposure,
+    std::vector<shapelet::MultiShapeletFunction> const & psfs,
+    std::vector<geom::Point2D> const & centers,
+    std::vector<afw::geom::ellipses::Quadrupole> const & moments,
+    std::vector<Scalar> const & approxFluxes,
+    std::vector<Scalar> const & kronRadii,
+    std::vector<int> const & footprintAreas
+) const {
+    std::size_t const nSources = centers.size();
+    LSST_THROW_IF_NE(
+        psfs.size(), nSources,
+        pex::exceptions::LengthError,
+        "Number of PSFs (%d) does not match number of sources (%d)"
+    );
+    LSST_THROW_IF_NE(
+        moments.size(), nSources,
+        pex::exceptions::LengthError,
+        "Number of moments (%d) does not match number of sources (%d)"
+    );
+    if (!approxFluxes.empty()) {
+        LSST_THROW_IF_NE(
+            approxFluxes.size(), nSources,
+            pex::exceptions::LengthError,
+            "Number of approximate fluxes (%d) does not match number of sources (%d)"
+        );
+    }
+    if (!kronRadii.empty()) {
+        LSST_THROW_IF_NE(
+            kronRadii.size(), nSources,
+            pex::exceptions::LengthError,
+            "Number of Kron radii (%d) does not match number of sources (%d)"
+        );
+    }
+    if (!footprintAreas.empty()) {
+        LSST_THROW_IF_NE(
+            footprintAreas.size(), nSources,
+            pex::exceptions::LengthError,
+            "Number of footprint areas (%d) does not match number of sources (%d)"
+        );
+    }
+
+    // Fit each source on its own, and set up the final fit regions of those that succeeded.
+    CModelWorkspacePool::Borrowed borrowed(_impl->workspaces);
+    CModelWorkspace::Impl & workspace = *borrowed;
+    std::vector<Result> results;
+    results.reserve(nSources);
+    std::vector<PTR(afw::detection::Footprint)> regions(nSources);
+    for (std::size_t i = 0; i < nSources; ++i) {
+        results.push_back(_impl->makeResult());
+        workspace.reset();
+        try {
+            _applyImpl(
+                results[i], workspace, exposure, psfs[i], centers[i], moments[i],
+                approxFluxes.empty() ? -1.0 : approxFluxes[i],
+                kronRadii.empty() ? -1.0 : kronRadii[i],
+                footprintAreas.empty() ? -1 : footprintAreas[i]
+            );
+        } catch (meas::base::MeasurementError & error) {
+            results[i].flags[error.getFlagBit()] = true;
+            results[i].flags[Result::FAILED] = true;
+            continue;
+        }
+        if (results[i].flags[Result::FAILED] || results[i].exp.flags[CModelStageResult::FAILED] ||
+            results[i].dev.flags[CModelStageResult::FAILED]) {
+            continue;
+        }
+        PixelFitRegion region(getControl().region, results[i].finalFitRegion);
+        region.applyMask(*exposure.getMaskedImage().getMask(), centers[i]);
+        regions[i] = region.footprint;
+    }
+
+    // Find groups of sources whose fit regions overlap, directly or through other sources.
+    std::vector<std::size_t> parent(nSources);
+    std::iota(parent.begin(), parent.end(), 0);
+    auto findRoot = [&parent](std::size_t i) {
+        while (parent[i] != i) {
+            i = parent[i] = parent[parent[i]];
+        }
+        return i;
+    };
+    for (std::size_t i = 0; i < nSources; ++i) {
+        if (!regions[i]) continue;
+        for (std::size_t j = i + 1; j < nSources; ++j) {
+            if (!regions[j] || !regions[i]->getBBox().overlaps(regions[j]->getBBox())) continue;
+            if (regions[i]->getSpans()->overlaps(*regions[j]->getSpans())) {
+                parent[findRoot(j)] = findRoot(i);
+            }
+        }
+    }
+    std::map<std::size_t,std::vector<std::size_t>> groups;
+    for (std::size_t i = 0; i < nSources; ++i) {
+        if (regions[i]) groups[findRoot(i)].push_back(i);
+    }
+
+    for (auto const & item : groups) {
+        std::vector<std::size_t> const & members = item.second;
+        if (members.size() < 2u || static_cast<int>(members.size()) > getControl().groupMaxSize) continue;
+        std::vector<PTR(afw::detection::Footprint)> footprints;
+        for (std::size_t i : members) {
+            footprints.push_back(regions[i]);
+        }
+        auto pixels = std::make_shared<CModelGroupPixels const>(exposure, footprints);
+
+        // Set up the exp and dev parameters of each member from its independent fit (in the same
+        // fitSys, as fitSysToMeasSys.flux is the approximate flux that defined it).  The joint fits of
+        // a group share a single per-source time budget, starting now.
+        auto const deadline = _impl->makeDeadline(getControl(), std::chrono::steady_clock::now());
+        workspace.reset();
+        std::vector<CModelStageData> expData;
+        std::vector<CModelStageData> devData;
+        for (std::size_t i : members) {
+            expData.emplace_back(exposure, results[i].fitSysToMeasSys.flux, centers[i], psfs[i],
+                                 *_impl->exp.model, workspace);
+            copyReferenceParameters(results[i].exp, expData.back());
+            expData.back().amplitudes.deep() = results[i].exp.amplitudes;
+            devData.emplace_back(exposure, results[i].fitSysToMeasSys.flux, centers[i], psfs[i],
+                                 *_impl->dev.model, workspace);
+            copyReferenceParameters(results[i].dev, devData.back());
+            devData.back().amplitudes.deep() = results[i].dev.amplitudes;
+            expData.back().snr = results[i].snr;
+            devData.back().snr = results[i].snr;
+            expData.back().deadline = deadline;
+            devData.back().deadline = deadline;
+        }
+        std::vector<CModelStageResult> expResults;
+        std::vector<CModelStageResult> devResults;
+        std::vector<ndarray::Array<Scalar,1,1>> expModels;
+        std::vector<ndarray::Array<Scalar,1,1>> devModels;
+        if (!_impl->fitGroupStage(_impl->exp, getControl().exp, expData, pixels, exposure,
+                                  expResults, expModels) ||
+            !_impl->fitGroupStage(_impl->dev, getControl().dev, devData, pixels, exposure,
+                                  devResults, devModels)) {
+            continue;
+        }
+
+        // Represent each member by its exp and dev models, mixed according to the fracDev of its
+        // independent fit, and sum them over the group.
+        std::vector<ndarray::Array<Scalar,1,1>> mixed(members.size());
+        ndarray::Array<Scalar,1,1> total = ndarray::allocate(pixels->getSize());
+        total.deep() = 0.0;
+        for (std::size_t k = 0; k < members.size(); ++k) {
+            Scalar const fracDev = results[members[k]].fracDev;
+            mixed[k] = ndarray::allocate(expModels[k].getSize<0>());
+            ndarray::asEigenArray(mixed[k]) = (1.0 - fracDev)*ndarray::asEigenArray(expModels[k])
+                + fracDev*ndarray::asEigenArray(devModels[k]);
+            std::vector<int> const & rows = pixels->rows[k];
+            for (std::size_t n = 0; n < rows.size(); ++n) {
+                total[rows[n]] += mixed[k][n];
+            }
+        }
+
+        // Replace the members' exp and dev results, and redo their final linear fits on the image
+        // with their neighbors subtracted.
+        for (std::size_t k = 0; k < members.size(); ++k) {
+            Result & result = results[members[k]];
+            result.exp = expResults[k];
+            result.dev = devResults[k];
+            result.flags[Result::GROUP_FIT] = true;
+            if (result.exp.flags[CModelStageResult::FAILED] || result.dev.flags[CModelStageResult::FAILED]) {
+                result.flags[Result::FAILED] = true;
+                continue;
+            }
+            afw::detection::Footprint const & footprint = *pixels->footprints[k];
+            afw::image::Exposure<Pixel> deblended(exposure, footprint.getBBox(), afw::image::PARENT, true);
+            auto image = deblended.getMaskedImage().getImage()->getArray();
+            geom::Point2I const xy0 = deblended.getXY0();
+            std::vector<int> const & rows = pixels->rows[k];
+            for (std::size_t n = 0; n < rows.size(); ++n) {
+                image[pixels->y[rows[n]] - xy0.getY()][pixels->x[rows[n]] - xy0.getX()]
+                    -= total[rows[n]] - mixed[k][n];
+            }
+            try {
+                _impl->fitLinear(getControl(), result, expData[k], devData[k], deblended, footprint);
+            } catch (...) {
+                result.flags[Result::FAILED] = true;
+                if (!Impl::handleExpectedError(getControl(), result)) throw;
+            }
+        }
+    }
+    return results;
+}
+
+CModelAlgorithm::Result CModelAlgorithm::applyForced(
+    afw::image::Exposure<Pixel> const & exposure,
+    shapelet::MultiShapeletFunction const & psf,
+    geom::Point2D const & center,
+    CModelResult const & reference,
+    Scalar approxFlux
+) const {
+    Result result = _impl->makeResult();
+    CModelWorkspacePool::Borrowed workspace(_impl->workspaces);
+    _applyForcedImpl(result, *workspace, exposure, psf, center, reference, approxFlux);
+    return result;
+}
+
 CModelAlgorithm::Result CModelAlgorithm::applyForced(
+    CModelWorkspace & workspace,
     afw::image::Exposure<Pixel> const & exposure,
     shapelet::MultiShapeletFunction const & psf,
     geom::Point2D const & center,
@@ -1177,10 +3224,145 @@ CModelAlgorithm::Result CModelAlgorithm::applyForced(
     Scalar approxFlux
 ) const {
     Result result = _impl->makeResult();
-    _applyForcedImpl(result, exposure, psf, center, reference, approxFlux);
+    workspace._impl->reset();
+    _applyForcedImpl(result, *workspace._impl, exposure, psf, center, reference, approxFlux);
     return result;
 }
 
+std::vector<CModelAlgorithm::Result> CModelAlgorithm::applyForcedMultiBand(
+    std::vector<PTR(afw::image::Exposure<Pixel>)> const & exposures,
+    std::vector<shapelet::MultiShapeletFunction> const & psfs,
+    geom::Point2D const & center,
+    CModelResult const & reference,
+    Scalar approxFlux
+) const {
+    LSST_THROW_IF_NE(
+        exposures.size(), psfs.size(),
+        pex::exceptions::LengthError,
+        "Number of exposures (%d) does not match number of PSFs (%d)"
+    );
+    std::vector<Result> results;
+    results.reserve(exposures.size());
+    for (std::size_t b = 0; b < exposures.size(); ++b) {
+        if (!exposures[b]->getWcs() || !(*exposures[b]->getWcs() == *exposures.front()->getWcs())) {
+            throw LSST_EXCEPT(
+                pex::exceptions::InvalidParameterError,
+                "All exposures passed to applyForcedMultiBand must have the same Wcs"
+            );
+        }
+        results.push_back(_impl->makeResult());
+    }
+    if (results.empty()) return results;
+
+    auto setFlag = [&results](int bit) {
+        for (auto & result : results) {
+            result.flags[bit] = true;
+        }
+    };
+    if (reference.flags[CModelResult::FAILED]) {
+        setFlag(CModelResult::BAD_REFERENCE);
+        setFlag(CModelResult::FAILED);
+    }
+
+    // All bands use the same fit region, with the union of their bad pixels removed, so the
+    // pixel coordinates (and hence the rows of the model matrix) line up between bands.
+    PixelFitRegion region(
+        getControl().region,
+        transformReferenceRegion(reference.finalFitRegion, reference.fitSysToMeasSys,
+                                 *exposures.front(), center)
+    );
+    PTR(afw::detection::Footprint) footprint;
+    for (auto const & exposure : exposures) {
+        PixelFitRegion bandRegion(region);
+        bandRegion.applyMask(*exposure->getMaskedImage().getMask(), center);
+        if (!bandRegion.footprint) {
+            footprint.reset();
+            break;
+        }
+        if (!footprint) {
+            footprint = bandRegion.footprint;
+        } else {
+            footprint->setSpans(footprint->getSpans()->intersect(*bandRegion.footprint->getSpans()));
+        }
+    }
+    if (region.maxArea) {
+        setFlag(CModelResult::REGION_MAX_AREA);
+    }
+    // Each band's region passed the bad pixel check on its own, but the intersection can lose more
+    // pixels than any one band, so we check it again against the ellipse area (as applyMask does).
+    Scalar const regionArea = region.ellipse.getArea();
+    if (!footprint || footprint->getArea() == 0 ||
+        regionArea - footprint->getArea() > regionArea*getControl().region.maxBadPixelFraction) {
+        setFlag(CModelResult::REGION_MAX_BAD_PIXEL_FRACTION);
+        return results;
+    }
+
+    afw::image::Exposure<Pixel> const & exposure = *exposures.front();
+    if (!(approxFlux > 0.0)) {
+        approxFlux = computeFluxInFootprint(*exposure.getMaskedImage().getImage(), *footprint);
+        if (!(approxFlux > 0.0)) {
+            for (auto & result : results) {
+                result.initial.flags[CModelStageResult::NUMERIC_ERROR] = true;
+                result.exp.flags[CModelStageResult::NUMERIC_ERROR] = true;
+                result.dev.flags[CModelStageResult::NUMERIC_ERROR] = true;
+            }
+            setFlag(CModelResult::FAILED);
+            return results;
+        }
+    }
+
+    // Set up a single fitSys for all bands, and the transforms from it to each band's measSys.
+    CModelWorkspacePool::Borrowed borrowed(_impl->workspaces);
+    CModelWorkspace::Impl & workspace = *borrowed;
+    CModelStageData initialData(
+        exposure, approxFlux, center, psfs.front(), *_impl->initial.model, workspace
+    );
+    std::vector<LocalUnitTransform> fitSysToMeasSys;
+    std::vector<PTR(EpochFootprint)> epochs;
+    for (std::size_t b = 0; b < exposures.size(); ++b) {
+        fitSysToMeasSys.push_back(
+            LocalUnitTransform(initialData.fitSys.wcs->getPixelOrigin(), initialData.fitSys,
+                               UnitSystem(*exposures[b]))
+        );
+        results[b].fitSysToMeasSys = fitSysToMeasSys.back();
+        epochs.push_back(std::make_shared<EpochFootprint>(*footprint, *exposures[b], psfs[b]));
+    }
+
+    // Run an amplitude-only fit for one stage in all bands, or flag it as failed in all bands.
+    auto fitStage = [&](
+        CModelStageImpl const & impl, CModelStageControl const & ctrl,
+        CModelStageResult CModelResult::*stage, CModelStageData & data
+    ) {
+        std::vector<CModelStageResult*> stageResults;
+        for (auto & result : results) {
+            stageResults.push_back(&(result.*stage));
+        }
+        if (!(reference.*stage).flags[CModelStageResult::FAILED]) {
+            data.nonlinear.deep() = (reference.*stage).nonlinear;
+            data.fixed.deep() = (reference.*stage).fixed;
+            impl.fitLinearMultiBand(ctrl, stageResults, data, fitSysToMeasSys, epochs);
+        } else {
+            for (auto stageResult : stageResults) {
+                stageResult->flags[CModelStageResult::BAD_REFERENCE] = true;
+                stageResult->flags[CModelStageResult::FAILED] = true;
+            }
+        }
+    };
+
+    fitStage(_impl->initial, getControl().initial, &CModelResult::initial, initialData);
+    CModelStageData expData = initialData.changeModel(*_impl->exp.model);
+    fitStage(_impl->exp, getControl().exp, &CModelResult::exp, expData);
+    CModelStageData devData = initialData.changeModel(*_impl->dev.model);
+    fitStage(_impl->dev, getControl().dev, &CModelResult::dev, devData);
+
+    if (reference.exp.flags[CModelStageResult::FAILED] || reference.dev.flags[CModelStageResult::FAILED])
+        return results;
+
+    // Do the linear combination fit
+    _impl->fitLinearMultiBand(getControl(), results, expData, devData, fitSysToMeasSys, epochs);
+    return results;
+}
+
 void CModelAlgorithm::writeResultToRecord(
     Result const & result,
     afw::table::BaseRecord & record
@@ -1194,6 +3376,77 @@ void CModelAlgorithm::writeResultToRecord(
     _impl->keys->copyResultToRecord(result, record);
 }
 
+ndarray::Array<Scalar,1,1> CModelAlgorithm::computeCostFeatures(
+    shapelet::MultiShapeletFunction const & psf,
+    afw::geom::ellipses::Quadrupole const & moments,
+    Scalar kronRadius,
+    int footprintArea,
+    Scalar snr
+) const {
+    afw::geom::ellipses::Quadrupole psfMoments;
+    try {
+        psfMoments = psf.evaluate().computeMoments().getCore();
+    } catch (geom::SingularTransformException const &) {
+        return CModelCostModel::computeFeatures(0.0, 0.0, snr); // we'd fail before fitting
+    }
+    PixelFitRegion region(getControl().region, moments, psfMoments, kronRadius, footprintArea);
+    Scalar area = region.ellipse.getArea();
+    if (getControl().coarseOnlyForMaxArea && getControl().coarseBinFactor > 1
+        && area > getControl().region.maxArea) {
+        area /= getControl().coarseBinFactor * getControl().coarseBinFactor;
+    }
+    // Each model component is convolved with each PSF component, and the result is evaluated with
+    // as many basis functions as the PSF component has.
+    int psfSize = 0;
+    for (auto const & component : psf.getComponents()) {
+        psfSize += shapelet::computeSize(component.getOrder());
+    }
+    int modelSize = 0;
+    for (auto const & model : {_impl->initial.model, _impl->exp.model, _impl->dev.model}) {
+        for (auto const & basis : model->getBasisVector()) {
+            modelSize += basis->getComponentCount();
+        }
+    }
+    return CModelCostModel::computeFeatures(area, modelSize*psfSize, snr);
+}
+
+ndarray::Array<Scalar,1,1> CModelAlgorithm::computeCostFeatures(
+    afw::table::SourceRecord const & record
+) const {
+    if (!_impl->keys) {
+        throw LSST_EXCEPT(
+            meas::base::FatalAlgorithmError,
+            "Algorithm was not initialized with a schema; cannot compute costs from records"
+        );
+    }
+    Scalar snr = std::numeric_limits<Scalar>::quiet_NaN();
+    if (record.getTable()->getPsfFluxSlot().isValid() && !record.getPsfFluxFlag()) {
+        snr = record.getPsfInstFlux() / record.getPsfInstFluxErr();
+    }
+    shapelet::MultiShapeletFunction psf = record.get(_impl->keys->psf);
+    afw::geom::ellipses::Quadrupole moments;
+    if (!record.getTable()->getShapeSlot().getMeasKey().isValid() ||
+        (record.getTable()->getShapeSlot().getFlagKey().isValid() && record.getShapeFlag())) {
+        if (!(getControl().fallbackInitialMomentsPsfFactor > 0.0)) {
+            return CModelCostModel::computeFeatures(0.0, 0.0, snr);
+        }
+        try {
+            moments = psf.evaluate().computeMoments().getCore();
+        } catch (geom::SingularTransformException const &) {
+            return CModelCostModel::computeFeatures(0.0, 0.0, snr);
+        }
+        moments.scale(getControl().fallbackInitialMomentsPsfFactor);
+    } else {
+        moments = record.getShape();
+    }
+    Scalar kronRadius = -1.0;
+    if (_impl->keys->kronRadius.isValid() && record.get(_impl->keys->kronRadius) > 0) {
+        kronRadius = record.get(_impl->keys->kronRadius);
+    }
+    int footprintArea = record.getFootprint() ? record.getFootprint()->getArea() : -1;
+    return computeCostFeatures(psf, moments, kronRadius, footprintArea, snr);
+}
+
 void CModelAlgorithm::fail(
     afw::table::SourceRecord & record,
     meas::base::MeasurementError * error
@@ -1212,6 +3465,7 @@ void CModelAlgorithm::fail(
 
 void CModelAlgorithm::_applyForcedImpl(
     Result & result,
+    CModelWorkspace::Impl & workspace,
     afw::image::Exposure<Pixel> const & exposure,
     shapelet::MultiShapeletFunction const & psf,
     geom::Point2D const & center,
@@ -1224,14 +3478,16 @@ void CModelAlgorithm::_applyForcedImpl(
         result.flags[CModelResult::FAILED] = true;
     }
 
-    // n.b. we're using the fit region from the reference without transforming
-    // it to the forced photometry coordinate system.  That should be fine on coadds,
-    // but not when doing forced photometry on individual visits.
-    // We also use the final fit region from the reference here, even for the initial
+    // We use the final fit region from the reference here, even for the initial
     // fit, and then do not update it.  We expect this to be better than the initial fit
     // region, even though it makes the initial fit regions less consistent between
-    // regular and forced measurement.
-    PixelFitRegion region(getControl().region, reference.finalFitRegion);
+    // regular and forced measurement.  The reference region is defined in the pixel
+    // coordinates of the reference image, so we have to transform it to those of the
+    // image we're measuring.
+    PixelFitRegion region(
+        getControl().region,
+        transformReferenceRegion(reference.finalFitRegion, reference.fitSysToMeasSys, exposure, center)
+    );
     region.applyMask(*exposure.getMaskedImage().getMask(), center);
     result.flags[CModelResult::REGION_MAX_AREA] = region.maxArea;
     result.flags[CModelResult::REGION_MAX_BAD_PIXEL_FRACTION] = region.maxBadPixelFraction;
@@ -1256,12 +3512,13 @@ void CModelAlgorithm::_applyForcedImpl(
     }
 
     // Set up coordinate systems and empty parameter vectors
-    CModelStageData initialData(exposure, approxFlux, center, psf, *_impl->initial.model);
+    CModelStageData initialData(exposure, approxFlux, center, psf, *_impl->initial.model, workspace);
     result.fitSysToMeasSys = initialData.fitSysToMeasSys;
 
     // Initialize the parameter vectors from the reference values.  Because these are
     // in fitSys units, we don't need to transform them, as fitSys (or at least its
-    // Wcs) should be the same in both forced mode and non-forced mode.
+    // Wcs) depends only on the position of the source, and is hence the same in both
+    // forced mode and non-forced mode, even when the reference image has a different Wcs.
     initialData.nonlinear.deep() = reference.initial.nonlinear;
     initialData.fixed.deep() = reference.initial.fixed;
 
@@ -1304,7 +3561,7 @@ void CModelAlgorithm::_applyForcedImpl(
         _impl->fitLinear(getControl(), result, expData, devData, exposure, *region.footprint);
     } catch (...) {
         result.flags[CModelResult::FAILED] = true;
-        throw;
+        if (!Impl::handleExpectedError(getControl(), result)) throw;
     }
 }
 
@@ -1348,6 +3605,41 @@ shapelet::MultiShapeletFunction CModelAlgorithm::_processInputs(
 void CModelAlgorithm::measure(
     afw::table::SourceRecord & measRecord,
     afw::image::Exposure<Pixel> const & exposure
+) const {
+    _measureImpl(measRecord, exposure, nullptr);
+}
+
+void CModelAlgorithm::measureWarmStart(
+    afw::table::SourceRecord & measRecord,
+    afw::image::Exposure<Pixel> const & exposure,
+    afw::table::SourceRecord const & refRecord
+) const {
+    if (!_impl->keys) {
+        throw LSST_EXCEPT(
+            meas::base::FatalAlgorithmError,
+            "Algorithm was not initialized with a schema; cannot run in plugin mode"
+        );
+    }
+    if (!_impl->keys->initial.nonlinear.isValid()) {
+        throw LSST_EXCEPT(
+            meas::base::FatalAlgorithmError,
+            "Algorithm was initialized for forced measurement; cannot run a warm start"
+        );
+    }
+    if (refRecord.getSchema() != measRecord.getSchema()) {
+        throw LSST_EXCEPT(
+            meas::base::FatalAlgorithmError,
+            "Reference record for a warm start must have the same schema as the measurement record"
+        );
+    }
+    Result reference = _impl->keys->copyRecordToResult(refRecord);
+    _measureImpl(measRecord, exposure, &reference);
+}
+
+void CModelAlgorithm::_measureImpl(
+    afw::table::SourceRecord & measRecord,
+    afw::image::Exposure<Pixel> const & exposure,
+    Result const * reference
 ) const {
     Result result = _impl->makeResult();
     // Read the shapelet approximation to the PSF, load/verify other inputs from the SourceRecord
@@ -1360,19 +3652,19 @@ void CModelAlgorithm::measure(
             try {
                 moments = psf.evaluate().computeMoments().getCore();
             } catch (geom::SingularTransformException const& exc) {
-                throw LSST_EXCEPT(
-                    meas::base::MeasurementError,
-                    std::string("Singular transform in shapelets: ") + exc.what(),
-                    CModelResult::NO_SHAPELET_PSF
-                );
+                Impl::reportFailure(getControl(), result, CModelResult::NO_SHAPELET_PSF,
+                                    std::string("Singular transform in shapelets: ") + exc.what());
+                _impl->keys->copyResultToRecord(result, measRecord);
+                return;
             }
             moments.scale(getControl().fallbackInitialMomentsPsfFactor);
         } else {
-            throw LSST_EXCEPT(
-                meas::base::MeasurementError,
-                "Shape slot algorithm failed or was not run, and fallbackInitialMomentsPsfFactor < 0",
-                CModelResult::NO_SHAPE
+            Impl::reportFailure(
+                getControl(), result, CModelResult::NO_SHAPE,
+                "Shape slot algorithm failed or was not run, and fallbackInitialMomentsPsfFactor < 0"
             );
+            _impl->keys->copyResultToRecord(result, measRecord);
+            return;
         }
     } else {
         moments = measRecord.getShape();
@@ -1388,25 +3680,42 @@ void CModelAlgorithm::measure(
         kronRadius = measRecord.get(_impl->keys->kronRadius);
     }
     try {
-        _applyImpl(result, exposure, psf, measRecord.getCentroid(), moments, approxFlux, kronRadius,
-                   measRecord.getFootprint()->getArea());
+        CModelWorkspacePool::Borrowed borrowed(_impl->workspaces);
+        CModelWorkspace::Impl & workspace = *borrowed;
+        _applyImpl(result, workspace, exposure, psf, measRecord.getCentroid(), moments, approxFlux,
+                   kronRadius, measRecord.getFootprint()->getArea(), reference);
     } catch (...) {
         _impl->keys->copyResultToRecord(result, measRecord);
-        _impl->checkFlagDetails(measRecord);
+        _impl->checkFlagDetails(getControl(), measRecord);
         throw;
     }
     _impl->keys->copyResultToRecord(result, measRecord);
-    _impl->checkFlagDetails(measRecord);
+    _impl->checkFlagDetails(getControl(), measRecord);
 }
 
 void CModelAlgorithm::measure(
     afw::table::SourceRecord & measRecord,
     afw::image::Exposure<Pixel> const & exposure,
     afw::table::SourceRecord const & refRecord
+) const {
+    measure(measRecord, exposure, refRecord, exposure.getWcs());
+}
+
+void CModelAlgorithm::measure(
+    afw::table::SourceRecord & measRecord,
+    afw::image::Exposure<Pixel> const & exposure,
+    afw::table::SourceRecord const & refRecord,
+    std::shared_ptr<afw::geom::SkyWcs const> refWcs
 ) const {
     Result result = _impl->makeResult();
     // Read the shapelet approximation to the PSF, load/verify other inputs from the SourceRecord
     shapelet::MultiShapeletFunction psf = _processInputs(measRecord, exposure);
+    if (!refWcs) {
+        throw LSST_EXCEPT(
+            meas::base::FatalAlgorithmError,
+            "Reference Wcs is null"
+        );
+    }
     // If PsfFlux has been run, use that for approx flux; otherwise we'll compute it ourselves.
     Scalar approxFlux = -1.0;
     if (measRecord.getTable()->getPsfFluxSlot().isValid() && !measRecord.getPsfFluxFlag()) {
@@ -1414,14 +3723,25 @@ void CModelAlgorithm::measure(
     }
     try {
         Result refResult = _impl->refKeys->copyRecordToResult(refRecord);
-        _applyForcedImpl(result, exposure, psf, measRecord.getCentroid(), refResult, approxFlux);
+        // The reference record doesn't hold the transform from fitSys to the reference image's
+        // coordinates, so we reconstruct it from the reference Wcs.  Only its geometric part
+        // is used (to transform the fit region), so the PhotoCalib doesn't matter.
+        UnitSystem fitSys(exposure.getWcs()->pixelToSky(measRecord.getCentroid()),
+                          exposure.getPhotoCalib(), 1.0);
+        refResult.fitSysToMeasSys = LocalUnitTransform(
+            fitSys.wcs->getPixelOrigin(), fitSys,
+            UnitSystem(refWcs, exposure.getPhotoCalib())
+        );
+        CModelWorkspacePool::Borrowed borrowed(_impl->workspaces);
+        CModelWorkspace::Impl & workspace = *borrowed;
+        _applyForcedImpl(result, workspace, exposure, psf, measRecord.getCentroid(), refResult, approxFlux);
     } catch (...) {
         _impl->keys->copyResultToRecord(result, measRecord);
-        _impl->checkFlagDetails(measRecord);
+        _impl->checkFlagDetails(getControl(), measRecord);
         throw;
     }
     _impl->keys->copyResultToRecord(result, measRecord);
-    _impl->checkFlagDetails(measRecord);
+    _impl->checkFlagDetails(getControl(), measRecord);
 }
 
 }}} // namespace lsst::meas::modelfit
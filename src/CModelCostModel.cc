@@ -0,0 +1,182 @@
+// -*- lsst-c++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2008-2017 LSST/AURA.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "ndarray/eigen.h"
+
+#include "lsst/pex/exceptions.h"
+#include "lsst/afw/table/BaseRecord.h"
+#include "lsst/afw/table/Catalog.h"
+#include "lsst/meas/modelfit/CModelCostModel.h"
+
+namespace lsst { namespace meas { namespace modelfit {
+
+namespace {
+
+// Schema and keys for the persisted form: a single record.
+struct CModelCostModelKeys {
+    afw::table::Schema schema;
+    afw::table::Key<afw::table::Array<Scalar>> timeCoefficients;
+    afw::table::Key<afw::table::Array<Scalar>> iterationCoefficients;
+
+    static CModelCostModelKeys const & get() {
+        static CModelCostModelKeys const instance;
+        return instance;
+    }
+
+private:
+    CModelCostModelKeys() :
+        schema(),
+        timeCoefficients(
+            schema.addField<afw::table::Array<Scalar>>(
+                "timeCoefficients",
+                "coefficients of the time prediction", "second",
+                CModelCostModel::N_FEATURES
+            )
+        ),
+        iterationCoefficients(
+            schema.addField<afw::table::Array<Scalar>>(
+                "iterationCoefficients",
+                "coefficients of the total iteration count prediction",
+                CModelCostModel::N_ITERATION_FEATURES
+            )
+        )
+    {}
+};
+
+// Uncalibrated defaults: cost is the number of pixel-basis-function evaluations, assuming a fixed
+// number of iterations.
+Scalar const DEFAULT_ITERATIONS = 50.0;
+
+ndarray::Array<Scalar,1,1> makeDefaultTimeCoefficients() {
+    ndarray::Array<Scalar,1,1> coefficients = ndarray::allocate(CModelCostModel::N_FEATURES);
+    coefficients.deep() = 0.0;
+    coefficients[2] = DEFAULT_ITERATIONS;
+    return coefficients;
+}
+
+ndarray::Array<Scalar,1,1> makeDefaultIterationCoefficients() {
+    ndarray::Array<Scalar,1,1> coefficients = ndarray::allocate(CModelCostModel::N_ITERATION_FEATURES);
+    coefficients.deep() = 0.0;
+    coefficients[0] = DEFAULT_ITERATIONS;
+    return coefficients;
+}
+
+Scalar computeLogSnr(Scalar snr) {
+    return (std::isfinite(snr) && snr > 1.0) ? std::log(snr) : 0.0;
+}
+
+} // anonymous
+
+CModelCostModel::CModelCostModel() :
+    _timeCoefficients(makeDefaultTimeCoefficients()),
+    _iterationCoefficients(makeDefaultIterationCoefficients())
+{}
+
+CModelCostModel::CModelCostModel(
+    ndarray::Array<Scalar const,1,1> const & timeCoefficients,
+    ndarray::Array<Scalar const,1,1> const & iterationCoefficients
+) :
+    _timeCoefficients(ndarray::copy(timeCoefficients)),
+    _iterationCoefficients(ndarray::copy(iterationCoefficients))
+{
+    LSST_THROW_IF_NE(
+        timeCoefficients.getSize<0>(), std::size_t(N_FEATURES),
+        pex::exceptions::LengthError,
+        "Number of time coefficients (%d) does not match number of features (%d)"
+    );
+    LSST_THROW_IF_NE(
+        iterationCoefficients.getSize<0>(), std::size_t(N_ITERATION_FEATURES),
+        pex::exceptions::LengthError,
+        "Number of iteration coefficients (%d) does not match number of iteration features (%d)"
+    );
+}
+
+ndarray::Array<Scalar,1,1> CModelCostModel::computeFeatures(Scalar area, Scalar work, Scalar snr) {
+    ndarray::Array<Scalar,1,1> features = ndarray::allocate(N_FEATURES);
+    features[0] = 1.0;
+    features[1] = area;
+    features[2] = area * work;
+    features[3] = area * work * computeLogSnr(snr);
+    return features;
+}
+
+ndarray::Array<Scalar,1,1> CModelCostModel::computeIterationFeatures(Scalar snr) {
+    ndarray::Array<Scalar,1,1> features = ndarray::allocate(N_ITERATION_FEATURES);
+    features[0] = 1.0;
+    features[1] = computeLogSnr(snr);
+    return features;
+}
+
+Scalar CModelCostModel::predictTime(ndarray::Array<Scalar const,1,1> const & features) const {
+    LSST_THROW_IF_NE(
+        features.getSize<0>(), std::size_t(N_FEATURES),
+        pex::exceptions::LengthError,
+        "Number of features (%d) does not match the expected number (%d)"
+    );
+    return std::max(
+        ndarray::asEigenMatrix(_timeCoefficients).dot(ndarray::asEigenMatrix(features)),
+        0.0
+    );
+}
+
+Scalar CModelCostModel::predictIterations(Scalar snr) const {
+    return std::max(
+        ndarray::asEigenMatrix(_iterationCoefficients).dot(
+            ndarray::asEigenMatrix(computeIterationFeatures(snr))
+        ),
+        0.0
+    );
+}
+
+PTR(CModelCostModel) CModelCostModel::readFits(std::string const & filename) {
+    CModelCostModelKeys const & keys = CModelCostModelKeys::get();
+    afw::table::BaseCatalog catalog = afw::table::BaseCatalog::readFits(filename);
+    if (catalog.size() != 1u) {
+        throw LSST_EXCEPT(
+            pex::exceptions::LengthError,
+            "CModelCostModel file '" + filename + "' does not have exactly one record"
+        );
+    }
+    afw::table::Key<afw::table::Array<Scalar>> timeKey
+        = catalog.getSchema()[keys.timeCoefficients.getFieldName()];
+    afw::table::Key<afw::table::Array<Scalar>> iterationKey
+        = catalog.getSchema()[keys.iterationCoefficients.getFieldName()];
+    return std::make_shared<CModelCostModel>(
+        ndarray::copy(catalog.front().get(timeKey)),
+        ndarray::copy(catalog.front().get(iterationKey))
+    );
+}
+
+void CModelCostModel::writeFits(std::string const & filename) const {
+    CModelCostModelKeys const & keys = CModelCostModelKeys::get();
+    afw::table::BaseCatalog catalog(keys.schema);
+    PTR(afw::table::BaseRecord) record = catalog.addNew();
+    record->set(keys.timeCoefficients, _timeCoefficients);
+    record->set(keys.iterationCoefficients, _iterationCoefficients);
+    catalog.writeFits(filename);
+}
+
+}}} // namespace lsst::meas::modelfit
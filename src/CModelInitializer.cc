@@ -0,0 +1,164 @@
+// -*- lsst-c++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2008-2017 LSST/AURA.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+#include <cmath>
+
+#include "ndarray/eigen.h"
+
+#include "lsst/pex/exceptions.h"
+#include "lsst/afw/table/BaseRecord.h"
+#include "lsst/afw/table/Catalog.h"
+#include "lsst/meas/modelfit/CModelInitializer.h"
+
+namespace lsst { namespace meas { namespace modelfit {
+
+namespace {
+
+// Schema and keys for the persisted form: one record per stage.
+struct CModelInitializerKeys {
+    afw::table::Schema schema;
+    afw::table::Key<int> stage;
+    afw::table::Key<afw::table::Array<Scalar>> coefficients;
+
+    static CModelInitializerKeys const & get() {
+        static CModelInitializerKeys const instance;
+        return instance;
+    }
+
+private:
+    CModelInitializerKeys() :
+        schema(),
+        stage(schema.addField<int>("stage", "CModel stage (0=initial, 1=exp, 2=dev)")),
+        coefficients(
+            schema.addField<afw::table::Array<Scalar>>(
+                "coefficients",
+                "regression coefficients for the log half-light radius in units of the PSF radius",
+                CModelInitializer::N_FEATURES
+            )
+        )
+    {}
+};
+
+} // anonymous
+
+CModelInitializer::CModelInitializer(ndarray::Array<Scalar const,2,1> const & coefficients) :
+    _coefficients(ndarray::copy(coefficients))
+{
+    LSST_THROW_IF_NE(
+        coefficients.getSize<0>(), std::size_t(N_STAGES),
+        pex::exceptions::LengthError,
+        "Number of coefficient rows (%d) does not match number of stages (%d)"
+    );
+    LSST_THROW_IF_NE(
+        coefficients.getSize<1>(), std::size_t(N_FEATURES),
+        pex::exceptions::LengthError,
+        "Number of coefficient columns (%d) does not match number of features (%d)"
+    );
+}
+
+ndarray::Array<Scalar,1,1> CModelInitializer::computeFeatures(
+    afw::geom::ellipses::Quadrupole const & moments,
+    afw::geom::ellipses::Quadrupole const & psfMoments,
+    Scalar kronRadius,
+    Scalar snr
+) {
+    Scalar const psfRadius = psfMoments.getDeterminantRadius();
+    ndarray::Array<Scalar,1,1> features = ndarray::allocate(N_FEATURES);
+    features[0] = 1.0;
+    features[1] = std::log(moments.getDeterminantRadius() / psfRadius);
+    features[2] = (kronRadius > 0.0) ? std::log(kronRadius / psfRadius) : features[1];
+    features[3] = (std::isfinite(snr) && snr > 1.0) ? std::log(snr) : 0.0;
+    return features;
+}
+
+Scalar CModelInitializer::predictRadiusRatio(
+    Stage stage,
+    ndarray::Array<Scalar const,1,1> const & features
+) const {
+    LSST_THROW_IF_NE(
+        features.getSize<0>(), std::size_t(N_FEATURES),
+        pex::exceptions::LengthError,
+        "Number of features (%d) does not match the expected number (%d)"
+    );
+    return std::exp(ndarray::asEigenMatrix(_coefficients[stage]).dot(ndarray::asEigenMatrix(features)));
+}
+
+afw::geom::ellipses::Quadrupole CModelInitializer::predict(
+    Stage stage,
+    afw::geom::ellipses::Quadrupole const & moments,
+    afw::geom::ellipses::Quadrupole const & psfMoments,
+    Scalar kronRadius,
+    Scalar snr
+) const {
+    Scalar const radius = psfMoments.getDeterminantRadius()
+        * predictRadiusRatio(stage, computeFeatures(moments, psfMoments, kronRadius, snr));
+    Scalar const ixx = moments.getIxx() - psfMoments.getIxx();
+    Scalar const iyy = moments.getIyy() - psfMoments.getIyy();
+    Scalar const ixy = moments.getIxy() - psfMoments.getIxy();
+    if (ixx > 0.0 && iyy > 0.0 && ixx*iyy > ixy*ixy) {
+        afw::geom::ellipses::Quadrupole result(ixx, iyy, ixy, false);
+        result.scale(radius / result.getDeterminantRadius());
+        return result;
+    }
+    return afw::geom::ellipses::Quadrupole(radius*radius, radius*radius, 0.0);
+}
+
+PTR(CModelInitializer) CModelInitializer::readFits(std::string const & filename) {
+    CModelInitializerKeys const & keys = CModelInitializerKeys::get();
+    afw::table::BaseCatalog catalog = afw::table::BaseCatalog::readFits(filename);
+    if (catalog.size() != std::size_t(N_STAGES)) {
+        throw LSST_EXCEPT(
+            pex::exceptions::LengthError,
+            "CModelInitializer file '" + filename + "' does not have one record per stage"
+        );
+    }
+    afw::table::Key<int> stageKey = catalog.getSchema()[keys.stage.getFieldName()];
+    afw::table::Key<afw::table::Array<Scalar>> coefficientsKey
+        = catalog.getSchema()[keys.coefficients.getFieldName()];
+    ndarray::Array<Scalar,2,2> coefficients = ndarray::allocate(N_STAGES, N_FEATURES);
+    for (auto const & record : catalog) {
+        int stage = record.get(stageKey);
+        if (stage < 0 || stage >= N_STAGES) {
+            throw LSST_EXCEPT(
+                pex::exceptions::InvalidParameterError,
+                "Invalid stage in CModelInitializer file '" + filename + "'"
+            );
+        }
+        coefficients[stage] = record.get(coefficientsKey);
+    }
+    return std::make_shared<CModelInitializer>(coefficients);
+}
+
+void CModelInitializer::writeFits(std::string const & filename) const {
+    CModelInitializerKeys const & keys = CModelInitializerKeys::get();
+    afw::table::BaseCatalog catalog(keys.schema);
+    catalog.reserve(N_STAGES);
+    for (int stage = 0; stage < N_STAGES; ++stage) {
+        PTR(afw::table::BaseRecord) record = catalog.addNew();
+        record->set(keys.stage, stage);
+        record->set(keys.coefficients, _coefficients[stage]);
+    }
+    catalog.writeFits(filename);
+}
+
+}}} // namespace lsst::meas::modelfit
@@ -0,0 +1,382 @@
+// -*- lsst-c++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2008-2017 LSST/AURA.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "lsst/pex/exceptions.h"
+#include "lsst/meas/modelfit/CModel.h"
+#include "lsst/meas/modelfit/CModelResultCache.h"
+
+namespace lsst { namespace meas { namespace modelfit {
+
+namespace {
+
+// File layout: a fixed-size header followed by `capacity` slots.  Each slot is a 64-bit key (zero for
+// an empty slot), a 64-bit check value, and a fixed-size payload of doubles holding the result.
+char const MAGIC[8] = {'C', 'M', 'R', 'C', 'A', 'C', 'H', 'E'};
+std::uint32_t const VERSION = 3;
+std::size_t const HEADER_SIZE = 64;
+int const MAX_PROBES = 8;
+
+struct Header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t payloadSize;
+    std::uint64_t capacity;
+};
+
+// Number of doubles used to store each piece of a result.
+int const STAGE_PAYLOAD_SIZE = 13 + 3*(1 + CModelResultCache::MAX_PARAMETERS);
+int const PAYLOAD_SIZE = 21 + 3*STAGE_PAYLOAD_SIZE;
+std::size_t const SLOT_SIZE = 2*sizeof(std::uint64_t) + PAYLOAD_SIZE*sizeof(double);
+
+// Sequential writer and reader for slot payloads.
+class PayloadWriter {
+public:
+
+    explicit PayloadWriter(char * data) : _data(data) {}
+
+    void add(double value) {
+        std::memcpy(_data, &value, sizeof(double));
+        _data += sizeof(double);
+    }
+
+    void add(afw::geom::ellipses::Quadrupole const & ellipse) {
+        add(ellipse.getIxx());
+        add(ellipse.getIyy());
+        add(ellipse.getIxy());
+    }
+
+    void add(ndarray::Array<Scalar const,1,1> const & array) {
+        add(array.getSize<0>());
+        for (std::size_t i = 0; i < std::size_t(CModelResultCache::MAX_PARAMETERS); ++i) {
+            add(i < array.getSize<0>() ? array[i] : 0.0);
+        }
+    }
+
+    void add(CModelStageResult const & stage) {
+        add(stage.instFlux);
+        add(stage.instFluxErr);
+        add(stage.instFluxInner);
+        add(stage.objective);
+        add(stage.nIter);
+        add(stage.gradientThreshold);
+        add(stage.minTrustRadiusThreshold);
+        add(stage.maxOuterIterations);
+        add(stage.ellipse);
+        add(stage.flags.to_ulong());
+        add(0.0); // reserved
+        add(stage.nonlinear);
+        add(stage.amplitudes);
+        add(stage.fixed);
+    }
+
+private:
+    char * _data;
+};
+
+class PayloadReader {
+public:
+
+    explicit PayloadReader(char const * data) : _data(data) {}
+
+    double get() {
+        double value;
+        std::memcpy(&value, _data, sizeof(double));
+        _data += sizeof(double);
+        return value;
+    }
+
+    afw::geom::ellipses::Quadrupole getEllipse() {
+        double ixx = get();
+        double iyy = get();
+        double ixy = get();
+        return afw::geom::ellipses::Quadrupole(ixx, iyy, ixy, false);
+    }
+
+    ndarray::Array<Scalar const,1,1> getArray() {
+        std::size_t size = get();
+        ndarray::Array<Scalar,1,1> array = ndarray::allocate(size);
+        for (std::size_t i = 0; i < std::size_t(CModelResultCache::MAX_PARAMETERS); ++i) {
+            double value = get();
+            if (i < size) array[i] = value;
+        }
+        return array;
+    }
+
+    void getStage(CModelStageResult & stage) {
+        stage.instFlux = get();
+        stage.instFluxErr = get();
+        stage.instFluxInner = get();
+        stage.objective = get();
+        stage.nIter = get();
+        // We didn't spend any time fitting this stage, and reporting the time spent when it was cached
+        // would corrupt anything calibrated from recorded times (e.g. CModelCostModel).
+        stage.time = std::numeric_limits<Scalar>::quiet_NaN();
+        stage.gradientThreshold = get();
+        stage.minTrustRadiusThreshold = get();
+        stage.maxOuterIterations = get();
+        stage.ellipse = getEllipse();
+        stage.flags = std::bitset<CModelStageResult::N_FLAGS>(static_cast<unsigned long>(get()));
+        get(); // reserved
+        stage.nonlinear = getArray();
+        stage.amplitudes = getArray();
+        stage.fixed = getArray();
+        stage.objfunc.reset();
+        stage.likelihood.reset();
+        stage.history = afw::table::BaseCatalog();
+    }
+
+private:
+    char const * _data;
+};
+
+bool isCacheable(CModelStageResult const & stage) {
+    return stage.nonlinear.getSize<0>() <= std::size_t(CModelResultCache::MAX_PARAMETERS)
+        && stage.amplitudes.getSize<0>() <= std::size_t(CModelResultCache::MAX_PARAMETERS)
+        && stage.fixed.getSize<0>() <= std::size_t(CModelResultCache::MAX_PARAMETERS);
+}
+
+std::uint64_t readKey(char const * slot) {
+    std::uint64_t key;
+    std::memcpy(&key, slot, sizeof(key));
+    return key;
+}
+
+// Key zero marks an empty slot.
+std::uint64_t normalizeKey(std::uint64_t key) {
+    return key == 0 ? 1 : key;
+}
+
+std::string describeErrno(std::string const & what, std::string const & filename) {
+    return what + " result cache file '" + filename + "': " + std::strerror(errno);
+}
+
+// An advisory lock on a whole file, held for the lifetime of the object.  Locks are per open file, so
+// this only excludes other processes (and other cache objects); threads sharing a cache object are
+// serialized by its mutex instead.
+class FileLock {
+public:
+
+    FileLock(int fd, int operation, std::string const & filename) : _fd(fd) {
+        int status;
+        do {
+            status = ::flock(fd, operation);
+        } while (status != 0 && errno == EINTR);
+        if (status != 0) {
+            throw LSST_EXCEPT(pex::exceptions::IoError, describeErrno("Cannot lock", filename));
+        }
+    }
+
+    FileLock(FileLock const &) = delete;
+    FileLock & operator=(FileLock const &) = delete;
+
+    ~FileLock() { ::flock(_fd, LOCK_UN); }
+
+private:
+    int _fd;
+};
+
+} // anonymous
+
+CModelResultCache::CModelResultCache(std::string const & filename, int capacity) :
+    _filename(filename),
+    _capacity(1),
+    _mappedSize(0),
+    _fd(-1),
+    _data(nullptr),
+    _hitCount(0),
+    _missCount(0)
+{
+    while (_capacity < std::size_t(std::max(capacity, 1))) {
+        _capacity <<= 1;
+    }
+    _fd = ::open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+    if (_fd < 0) {
+        throw LSST_EXCEPT(pex::exceptions::IoError, describeErrno("Cannot open", filename));
+    }
+    try {
+        // Hold an exclusive lock while checking the size, so only one process initializes a new file.
+        FileLock lock(_fd, LOCK_EX, filename);
+        struct stat info;
+        if (::fstat(_fd, &info) != 0) {
+            throw LSST_EXCEPT(pex::exceptions::IoError, describeErrno("Cannot stat", filename));
+        }
+        bool const isNew = (info.st_size == 0);
+        if (isNew) {
+            _mappedSize = HEADER_SIZE + _capacity*SLOT_SIZE;
+            if (::ftruncate(_fd, _mappedSize) != 0) {
+                throw LSST_EXCEPT(pex::exceptions::IoError, describeErrno("Cannot resize", filename));
+            }
+        } else {
+            _mappedSize = info.st_size;
+        }
+        void * data = ::mmap(nullptr, _mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+        if (data == MAP_FAILED) {
+            throw LSST_EXCEPT(pex::exceptions::IoError, describeErrno("Cannot map", filename));
+        }
+        _data = static_cast<char*>(data);
+        Header header;
+        if (isNew) {
+            std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+            header.version = VERSION;
+            header.payloadSize = PAYLOAD_SIZE;
+            header.capacity = _capacity;
+            std::memcpy(_data, &header, sizeof(header));
+            return;
+        }
+        std::memcpy(&header, _data, std::min(sizeof(header), _mappedSize));
+        if (_mappedSize < HEADER_SIZE || std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0
+            || header.version != VERSION || header.payloadSize != std::uint32_t(PAYLOAD_SIZE)
+            || header.capacity == 0 || (header.capacity & (header.capacity - 1)) != 0
+            || _mappedSize != HEADER_SIZE + header.capacity*SLOT_SIZE) {
+            throw LSST_EXCEPT(
+                pex::exceptions::IoError,
+                "File '" + filename + "' is not a compatible CModel result cache"
+            );
+        }
+        _capacity = header.capacity;
+    } catch (...) {
+        if (_data) ::munmap(_data, _mappedSize);
+        ::close(_fd);
+        throw;
+    }
+}
+
+CModelResultCache::~CModelResultCache() {
+    ::munmap(_data, _mappedSize);
+    ::close(_fd);
+}
+
+char * CModelResultCache::_getSlot(std::uint64_t key, bool forWriting) const {
+    std::size_t const home = key & (_capacity - 1);
+    for (int probe = 0; probe < MAX_PROBES; ++probe) {
+        char * slot = _data + HEADER_SIZE + ((home + probe) & (_capacity - 1))*SLOT_SIZE;
+        std::uint64_t slotKey = readKey(slot);
+        if (slotKey == key) return slot;
+        if (slotKey == 0) return forWriting ? slot : nullptr;
+    }
+    return forWriting ? _data + HEADER_SIZE + home*SLOT_SIZE : nullptr;
+}
+
+bool CModelResultCache::get(
+    std::uint64_t key,
+    std::function<std::uint64_t(CModelResult const &)> const & validate,
+    CModelResult & result
+) {
+    key = normalizeKey(key);
+    CModelResult cached(result);
+    std::uint64_t check = 0;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        FileLock fileLock(_fd, LOCK_SH, _filename);
+        char const * slot = _getSlot(key, false);
+        if (!slot) {
+            ++_missCount;
+            return false;
+        }
+        std::memcpy(&check, slot + sizeof(std::uint64_t), sizeof(check));
+        PayloadReader reader(slot + 2*sizeof(std::uint64_t));
+        cached.instFlux = reader.get();
+        cached.instFluxErr = reader.get();
+        cached.instFluxInner = reader.get();
+        cached.fracDev = reader.get();
+        cached.objective = reader.get();
+        cached.initialFitRegion = reader.getEllipse();
+        cached.finalFitRegion = reader.getEllipse();
+        geom::AffineTransform::ParameterVector geometric;
+        for (int i = 0; i < 6; ++i) {
+            geometric[i] = reader.get();
+        }
+        cached.fitSysToMeasSys.geometric.setParameterVector(geometric);
+        cached.fitSysToMeasSys.flux = reader.get();
+        cached.fitSysToMeasSys.sb = reader.get();
+        cached.flags = std::bitset<CModelResult::N_FLAGS>(static_cast<unsigned long>(reader.get()));
+        cached.snr = reader.get();
+        reader.getStage(cached.initial);
+        reader.getStage(cached.exp);
+        reader.getStage(cached.dev);
+    }
+    bool const hit = (validate(cached) == check);
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (hit) {
+            ++_hitCount;
+        } else {
+            ++_missCount;
+        }
+    }
+    if (hit) {
+        result = cached;
+    }
+    return hit;
+}
+
+void CModelResultCache::put(std::uint64_t key, std::uint64_t check, CModelResult const & result) {
+    if (!isCacheable(result.initial) || !isCacheable(result.exp) || !isCacheable(result.dev)) return;
+    key = normalizeKey(key);
+    std::lock_guard<std::mutex> lock(_mutex);
+    FileLock fileLock(_fd, LOCK_EX, _filename);
+    char * slot = _getSlot(key, true);
+    // Clear the key while we write the payload, so a partially-written slot never matches.
+    std::uint64_t const empty = 0;
+    std::memcpy(slot, &empty, sizeof(empty));
+    std::memcpy(slot + sizeof(std::uint64_t), &check, sizeof(check));
+    PayloadWriter writer(slot + 2*sizeof(std::uint64_t));
+    writer.add(result.instFlux);
+    writer.add(result.instFluxErr);
+    writer.add(result.instFluxInner);
+    writer.add(result.fracDev);
+    writer.add(result.objective);
+    writer.add(result.initialFitRegion);
+    writer.add(result.finalFitRegion);
+    geom::AffineTransform::ParameterVector geometric = result.fitSysToMeasSys.geometric.getParameterVector();
+    for (int i = 0; i < 6; ++i) {
+        writer.add(geometric[i]);
+    }
+    writer.add(result.fitSysToMeasSys.flux);
+    writer.add(result.fitSysToMeasSys.sb);
+    writer.add(result.flags.to_ulong());
+    writer.add(result.snr);
+    writer.add(result.initial);
+    writer.add(result.exp);
+    writer.add(result.dev);
+    std::memcpy(slot, &key, sizeof(key));
+}
+
+void CModelResultCache::clear() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    FileLock fileLock(_fd, LOCK_EX, _filename);
+    std::memset(_data + HEADER_SIZE, 0, _capacity*SLOT_SIZE);
+}
+
+}}} // namespace lsst::meas::modelfit
@@ -29,6 +29,7 @@
 #include "lsst/afw/table/Source.h"
 #include "lsst/afw/geom/ellipses/GridTransform.h"
 #include "lsst/meas/modelfit/DoubleShapeletPsfApprox.h"
+#include "lsst/meas/modelfit/vectorMath.h"
 
 namespace lsst { namespace meas { namespace modelfit {
 namespace {
@@ -258,7 +259,9 @@ public:
         _maxRadius(ctrl.maxRadiusBoxFraction * std::sqrt(this->dataSize)),
         _minRadiusDiff(ctrl.minRadiusDiff),
         _data(ndarray::Array<Scalar,1,1>(ndarray::allocate(this->dataSize))),
-        _arg(ndarray::Array<Scalar,1,1>(ndarray::allocate(this->dataSize)))
+        _arg(ndarray::Array<Scalar,1,1>(ndarray::allocate(this->dataSize))),
+        _inner(ndarray::Array<Scalar,1,1>(ndarray::allocate(this->dataSize))),
+        _outer(ndarray::Array<Scalar,1,1>(ndarray::allocate(this->dataSize)))
     {
         // Radius parameters are defined as factors of the moments ellipse, so
         // we have to scale the constraints the same way.
@@ -284,10 +287,11 @@ public:
         Scalar oAlpha = parameters[1] * _normalization;
         Scalar iR2 = parameters[2] * parameters[2];
         Scalar oR2 = parameters[3] * parameters[3];
-        auto argEigen = ndarray::asEigenArray(_arg);
+        computeGaussian(iR2, _inner);
+        computeGaussian(oR2, _outer);
         ndarray::asEigenArray(residuals) = ndarray::asEigenArray(_data)
-            - (iAlpha/iR2)*(argEigen/iR2).exp()
-            - (oAlpha/oR2)*(argEigen/oR2).exp();
+            - (iAlpha/iR2)*ndarray::asEigenArray(_inner)
+            - (oAlpha/oR2)*ndarray::asEigenArray(_outer);
     }
 
     virtual bool differentiateResiduals(
@@ -298,8 +302,10 @@ public:
         auto argEigen = ndarray::asEigenArray(_arg);
         Scalar iR2 = parameters[2] * parameters[2];
         Scalar oR2 = parameters[3] * parameters[3];
-        d.col(0) = - (_normalization/iR2)*(argEigen/iR2).exp();
-        d.col(1) = - (_normalization/oR2)*(argEigen/oR2).exp();
+        computeGaussian(iR2, _inner);
+        computeGaussian(oR2, _outer);
+        d.col(0) = - (_normalization/iR2)*ndarray::asEigenArray(_inner);
+        d.col(1) = - (_normalization/oR2)*ndarray::asEigenArray(_outer);
         d.col(2) = -2.0*d.col(0)*(argEigen/iR2 + 1.0)*parameters[0]/parameters[2];
         d.col(3) = -2.0*d.col(1)*(argEigen/oR2 + 1.0)*parameters[1]/parameters[3];
         return true;
@@ -324,12 +330,21 @@ public:
     }
 
 private:
+
+    // Set out = exp(arg/r2), the unnormalized profile of a Gaussian with radius^2 = r2.
+    void computeGaussian(Scalar r2, ndarray::Array<Scalar,1,1> const & out) const {
+        ndarray::asEigenArray(out) = ndarray::asEigenArray(_arg) / r2;
+        detail::vectorExp(out.getData(), out.getData(), out.getSize<0>());
+    }
+
     Scalar _minRadius;
     Scalar _maxRadius;
     Scalar _minRadiusDiff;
     Scalar _normalization;
     ndarray::Array<Scalar,1,1> _data;
     ndarray::Array<Scalar,1,1> _arg;
+    ndarray::Array<Scalar,1,1> _inner;  // workspace for the inner Gaussian profile
+    ndarray::Array<Scalar,1,1> _outer;  // workspace for the outer Gaussian profile
 };
 
 } // anonymous
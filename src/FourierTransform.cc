@@ -0,0 +1,131 @@
+// -*- lsst-c++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2008-2017 LSST/AURA.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "boost/format.hpp"
+
+#include "lsst/pex/exceptions.h"
+#include "lsst/meas/modelfit/FourierTransform.h"
+
+namespace lsst { namespace meas { namespace modelfit { namespace detail {
+
+int FourierTransform::computeSize(int n) {
+    int size = 1;
+    while (size < n) {
+        size <<= 1;
+    }
+    return size;
+}
+
+FourierTransform::Plan::Plan(int size_) : size(size_), reversed(size_), twiddle(size_ / 2) {
+    if (size <= 0 || (size & (size - 1)) != 0) {
+        throw LSST_EXCEPT(
+            pex::exceptions::InvalidParameterError,
+            (boost::format("FFT dimension (%d) must be a positive power of two") % size).str()
+        );
+    }
+    int nBits = 0;
+    while ((1 << nBits) < size) {
+        ++nBits;
+    }
+    for (int k = 0; k < size; ++k) {
+        int r = 0;
+        for (int b = 0; b < nBits; ++b) {
+            r |= ((k >> b) & 1) << (nBits - 1 - b);
+        }
+        reversed[k] = r;
+    }
+    for (int k = 0; k < size / 2; ++k) {
+        // Computing each twiddle factor directly (rather than by repeated multiplication) keeps the
+        // round-off error independent of the transform size.
+        Scalar const angle = -2.0 * M_PI * k / size;
+        twiddle[k] = Complex(std::cos(angle), std::sin(angle));
+    }
+}
+
+void FourierTransform::Plan::operator()(Complex * data, bool inverse) const {
+    for (int k = 0; k < size; ++k) {
+        if (k < reversed[k]) {
+            std::swap(data[k], data[reversed[k]]);
+        }
+    }
+    for (int half = 1, stride = size / 2; half < size; half <<= 1, stride >>= 1) {
+        for (int begin = 0; begin < size; begin += 2 * half) {
+            for (int k = 0; k < half; ++k) {
+                Complex const w = inverse ? std::conj(twiddle[k * stride]) : twiddle[k * stride];
+                Complex const u = data[begin + k];
+                Complex const v = data[begin + k + half] * w;
+                data[begin + k] = u + v;
+                data[begin + k + half] = u - v;
+            }
+        }
+    }
+}
+
+FourierTransform::FourierTransform(int nRows, int nCols) : _rows(nRows), _cols(nCols) {}
+
+void FourierTransform::_apply(ndarray::Array<Complex,2,2> const & data, bool inverse) const {
+    if (data.getSize<0>() != _rows.size || data.getSize<1>() != _cols.size) {
+        throw LSST_EXCEPT(
+            pex::exceptions::LengthError,
+            (boost::format("Array shape (%d, %d) does not match FFT shape (%d, %d)")
+             % data.getSize<0>() % data.getSize<1>() % _rows.size % _cols.size).str()
+        );
+    }
+    for (int i = 0; i < _rows.size; ++i) {
+        _cols(data[i].getData(), inverse);
+    }
+    // Transform the columns in blocks copied to contiguous rows of a workspace, so each pass over the
+    // data reads whole cache lines.
+    int const blockSize = std::min(_cols.size, 16);
+    std::vector<Complex> workspace(blockSize * _rows.size);
+    for (int j0 = 0; j0 < _cols.size; j0 += blockSize) {
+        for (int i = 0; i < _rows.size; ++i) {
+            for (int j = 0; j < blockSize; ++j) {
+                workspace[j * _rows.size + i] = data[i][j0 + j];
+            }
+        }
+        for (int j = 0; j < blockSize; ++j) {
+            _rows(&workspace[j * _rows.size], inverse);
+        }
+        for (int i = 0; i < _rows.size; ++i) {
+            for (int j = 0; j < blockSize; ++j) {
+                data[i][j0 + j] = workspace[j * _rows.size + i];
+            }
+        }
+    }
+    if (inverse) {
+        Scalar const factor = 1.0 / (static_cast<Scalar>(_rows.size) * _cols.size);
+        for (int i = 0; i < _rows.size; ++i) {
+            for (int j = 0; j < _cols.size; ++j) {
+                data[i][j] *= factor;
+            }
+        }
+    }
+}
+
+}}}} // namespace lsst::meas::modelfit::detail
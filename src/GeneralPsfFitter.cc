@@ -599,7 +599,9 @@ public:
         Model::EllipseVector const & ellipses,
         Model::BasisVector const & basisVector,
         Scalar sigma
-    ) : _ellipses(ellipses),
+    ) : _x(x), _y(y),
+        _ellipses(ellipses),
+        _previousEllipses(ellipses),
         _builders(),
         _sigma(sigma)
     {
@@ -636,11 +638,68 @@ public:
         ndarray::asEigenMatrix(modelMatrix) /= _sigma;
     }
 
+    // Recompute only the columns of the bases whose ellipses differ from those at previousNonlinear.
+    void updateModelMatrix(
+        ndarray::Array<Pixel,2,-1> const & modelMatrix,
+        ndarray::Array<Scalar const,1,1> const & nonlinear,
+        ndarray::Array<Scalar const,1,1> const & previousNonlinear,
+        ndarray::Array<Scalar const,1,1> const & fixed,
+        Model const & model
+    ) {
+        model.writeEllipses(nonlinear.begin(), fixed.begin(), _ellipses.begin());
+        model.writeEllipses(previousNonlinear.begin(), fixed.begin(), _previousEllipses.begin());
+        Model::BasisVector const & basisVector = model.getBasisVector();
+        int amplitudeOffset = 0;
+        for (std::size_t i = 0; i < basisVector.size(); ++i) {
+            int amplitudeEnd = amplitudeOffset + _builders[i].getBasisSize();
+            if (_ellipses[i] != _previousEllipses[i]) {
+                ndarray::Array<Pixel,2,-1> block
+                    = modelMatrix[ndarray::view()(amplitudeOffset, amplitudeEnd)];
+                block.deep() = 0.0;
+                _builders[i](block, _ellipses[i]);
+                ndarray::asEigenMatrix(block) /= _sigma;
+            }
+            amplitudeOffset = amplitudeEnd;
+        }
+    }
+
+    // Sum the amplitude-weighted bases at each pixel without forming the model matrix.
+    void computeModelImage(
+        ndarray::Array<Pixel,1,1> const & modelImage,
+        ndarray::Array<Scalar const,1,1> const & nonlinear,
+        ndarray::Array<Scalar const,1,1> const & amplitudes,
+        ndarray::Array<Scalar const,1,1> const & fixed,
+        Model const & model
+    ) {
+        model.writeEllipses(nonlinear.begin(), fixed.begin(), _ellipses.begin());
+        Model::BasisVector const & basisVector = model.getBasisVector();
+        shapelet::MultiShapeletFunction function;
+        int amplitudeOffset = 0;
+        for (std::size_t i = 0; i < basisVector.size(); ++i) {
+            int amplitudeEnd = amplitudeOffset + _builders[i].getBasisSize();
+            shapelet::MultiShapeletFunction component = basisVector[i]->makeFunction(
+                _ellipses[i], amplitudes[ndarray::view(amplitudeOffset, amplitudeEnd)]
+            );
+            function.getComponents().insert(
+                function.getComponents().end(),
+                component.getComponents().begin(), component.getComponents().end()
+            );
+            amplitudeOffset = amplitudeEnd;
+        }
+        shapelet::MultiShapeletFunctionEvaluator evaluator = function.evaluate();
+        for (std::size_t k = 0; k < _x.getSize<0>(); ++k) {
+            modelImage[k] = evaluator(_x[k], _y[k]) / _sigma;
+        }
+    }
+
 private:
     typedef std::vector< shapelet::MatrixBuilder<Pixel> > BuilderVector;
     typedef std::vector< shapelet::MatrixBuilderFactory<Pixel> > FactoryVector;
 
+    ndarray::Array<Pixel const,1,1> _x;
+    ndarray::Array<Pixel const,1,1> _y;
     Model::EllipseVector _ellipses;
+    Model::EllipseVector _previousEllipses;
     BuilderVector _builders;
     Scalar _sigma;
 };
@@ -681,6 +740,24 @@ void MultiShapeletPsfLikelihood::computeModelMatrix(
     return _impl->computeModelMatrix(modelMatrix, nonlinear, _fixed, *getModel());
 }
 
+void MultiShapeletPsfLikelihood::updateModelMatrix(
+    ndarray::Array<Pixel,2,-1> const & modelMatrix,
+    ndarray::Array<Scalar const,1,1> const & nonlinear,
+    ndarray::Array<Scalar const,1,1> const & previousNonlinear,
+    bool doApplyWeights
+) const {
+    return _impl->updateModelMatrix(modelMatrix, nonlinear, previousNonlinear, _fixed, *getModel());
+}
+
+void MultiShapeletPsfLikelihood::computeModelImage(
+    ndarray::Array<Pixel,1,1> const & modelImage,
+    ndarray::Array<Scalar const,1,1> const & nonlinear,
+    ndarray::Array<Scalar const,1,1> const & amplitudes,
+    bool doApplyWeights
+) const {
+    return _impl->computeModelImage(modelImage, nonlinear, amplitudes, _fixed, *getModel());
+}
+
 MultiShapeletPsfLikelihood::~MultiShapeletPsfLikelihood() {}
 
 }}} // namespace lsst::meas::modelfit
@@ -0,0 +1,44 @@
+// -*- lsst-c++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2008-2013 LSST Corporation.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+#include "ndarray/eigen.h"
+
+#include "lsst/meas/modelfit/Likelihood.h"
+#include "lsst/meas/modelfit/ModelMatrix.h"
+
+namespace lsst { namespace meas { namespace modelfit {
+
+void Likelihood::computeModelImage(
+    ndarray::Array<Pixel,1,1> const & modelImage,
+    ndarray::Array<Scalar const,1,1> const & nonlinear,
+    ndarray::Array<Scalar const,1,1> const & amplitudes,
+    bool doApplyWeights
+) const {
+    ndarray::Array<Pixel,2,-1> modelMatrix = ModelMatrix(getDataDim(), getAmplitudeDim()).getArray();
+    computeModelMatrix(modelMatrix, nonlinear, doApplyWeights);
+    ndarray::Array<Scalar,1,1> image = ndarray::allocate(getDataDim());
+    multiplyModelMatrix(modelMatrix, amplitudes, image);
+    ndarray::asEigenMatrix(modelImage) = ndarray::asEigenMatrix(image).cast<Pixel>();
+}
+
+}}} // namespace lsst::meas::modelfit
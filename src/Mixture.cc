@@ -31,6 +31,7 @@
 #include "lsst/afw/table/io/CatalogVector.h"
 #include "lsst/afw/table/io/Persistable.cc"
 #include "lsst/meas/modelfit/Mixture.h"
+#include "lsst/meas/modelfit/vectorMath.h"
 
 namespace tbl = lsst::afw::table;
 
@@ -190,11 +191,19 @@ void Mixture::evaluate(
         pex::exceptions::LengthError,
         "Second dimension of x array (%d) does not dimension of mixture (%d)"
     );
-    ndarray::Array<Scalar const,2,1>::Iterator ix = x.begin(), xEnd = x.end();
-    ndarray::Array<Scalar,1,0>::Iterator ip = p.begin();
-    for (; ix != xEnd; ++ix, ++ip) {
-        *ip = evaluate(ndarray::asEigenMatrix(*ix));
+    // Evaluate one component at all points at a time, so the density function is applied to a whole
+    // vector of points.
+    int const nSamples = x.getSize<0>();
+    Vector z(nSamples);
+    Vector sum = Vector::Zero(nSamples);
+    for (const_iterator j = begin(); j != end(); ++j) {
+        for (int i = 0; i < nSamples; ++i) {
+            z[i] = _computeZ(*j, ndarray::asEigenMatrix(x[i]));
+        }
+        _evaluate(z);
+        sum += (j->weight / j->_sqrtDet) * z;
     }
+    ndarray::asEigenMatrix(p) = sum;
 }
 
 void Mixture::evaluateComponents(
@@ -216,13 +225,15 @@ void Mixture::evaluateComponents(
         pex::exceptions::LengthError,
         "Second dimension of p array (%d) does not match number of components (%d)"
     );
-    ndarray::Array<Scalar const,2,1>::Iterator ix = x.begin(), xEnd = x.end();
-    ndarray::Array<Scalar,2,1>::Iterator ip = p.begin();
-    for (; ix != xEnd; ++ix, ++ip) {
-        ndarray::Array<Scalar,2,1>::Reference::Iterator jp = ip->begin();
-        for (const_iterator j = begin(); j != end(); ++j, ++jp) {
-            *jp = evaluate(*j, ndarray::asEigenMatrix(*ix));
+    int const nSamples = x.getSize<0>();
+    Vector z(nSamples);
+    auto pEigen = ndarray::asEigenMatrix(p);
+    for (std::size_t k = 0; k < _components.size(); ++k) {
+        for (int i = 0; i < nSamples; ++i) {
+            z[i] = _computeZ(_components[k], ndarray::asEigenMatrix(x[i]));
         }
+        _evaluate(z);
+        pEigen.col(k) = (_components[k].weight / _components[k]._sqrtDet) * z;
     }
 }
 
@@ -365,16 +376,19 @@ void Mixture::updateEM(
     int const nComponents = _components.size();
     Matrix p(nSamples, nComponents);
     Matrix gamma(nSamples, nComponents);
-    for (int i = 0; i < nSamples; ++i) {
-        Scalar pSum = 0.0;
-        for (int k = 0; k < nComponents; ++k) {
-            double z = _computeZ(_components[k], ndarray::asEigenMatrix(x[i]));
-            pSum += p(i, k) = _components[k].weight*_evaluate(z)/_components[k]._sqrtDet;
-            if (!_isGaussian) {
-                gamma(i, k) = (_df + _dim) / (_df + z);
-            }
+    Vector z(nSamples);
+    for (int k = 0; k < nComponents; ++k) {
+        for (int i = 0; i < nSamples; ++i) {
+            z[i] = _computeZ(_components[k], ndarray::asEigenMatrix(x[i]));
         }
-        p.row(i) *= w[i] / pSum;
+        if (!_isGaussian) {
+            gamma.col(k) = ((_df + _dim) / (_df + z.array())).matrix();
+        }
+        _evaluate(z);
+        p.col(k) = (_components[k].weight / _components[k]._sqrtDet) * z;
+    }
+    for (int i = 0; i < nSamples; ++i) {
+        p.row(i) *= w[i] / p.row(i).sum();
     }
     if (_isGaussian) {
         for (int k = 0; k < nComponents; ++k) {
@@ -466,6 +480,16 @@ Scalar Mixture::_evaluate(Scalar z) const {
     }
 }
 
+void Mixture::_evaluate(Vector & z) const {
+    if (_isGaussian) {
+        z *= -0.5;
+        detail::vectorExp(z.data(), z.data(), z.size());
+        z /= _norm;
+    } else {
+        z = ((z.array()/_df + 1.0).pow(-0.5*(_df + _dim)) / _norm).matrix();
+    }
+}
+
 void Mixture::_stream(std::ostream & os) const {
     os << "Mixture(dim=" << _dim << ", [\n";
     for (const_iterator i = begin(); i != end(); ++i) {
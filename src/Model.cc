@@ -60,6 +60,21 @@ Model::EllipseVector makeEllipseVectorImpl(Model::BasisVector const & basisVecto
     return r;
 }
 
+// Set the moments of a flat ellipse from the SeparableConformalShearLogTraceRadius parameters of an
+// extended source (advancing the parameter pointer past them), or to zero for a point source.
+inline void writeFlatCore(
+    PTR(shapelet::MultiShapeletBasis) const & basis,
+    Scalar const * & nonlinearIter,
+    FlatEllipse & flat
+) {
+    if (basis) {
+        flat.setCore(nonlinearIter);
+        nonlinearIter += 3;
+    } else {
+        flat.xx = flat.yy = flat.xy = 0.0;
+    }
+}
+
 } // anonymous
 
 // ========== FixedCenterModel ==============================================================================
@@ -114,6 +129,17 @@ public:
         }
     }
 
+    void writeFlatEllipses(
+        Scalar const * nonlinearIter, Scalar const * fixedIter,
+        FlatEllipse * flatIter
+    ) const override {
+        for (int i = 0; i < getBasisCount(); ++i, ++flatIter) {
+            writeFlatCore(getBasisVector()[i], nonlinearIter, *flatIter);
+            flatIter->x = fixedIter[0];
+            flatIter->y = fixedIter[1];
+        }
+    }
+
     void readEllipses(
         EllipseConstIterator ellipseIter,
         Scalar * nonlinearIter, Scalar * fixedIter
@@ -173,6 +199,19 @@ public:
         }
     }
 
+    void writeFlatEllipses(
+        Scalar const * nonlinearIter, Scalar const * fixedIter,
+        FlatEllipse * flatIter
+    ) const override {
+        Scalar const x = nonlinearIter[getNonlinearDim()-2];
+        Scalar const y = nonlinearIter[getNonlinearDim()-1];
+        for (int i = 0; i < getBasisCount(); ++i, ++flatIter) {
+            writeFlatCore(getBasisVector()[i], nonlinearIter, *flatIter);
+            flatIter->x = x;
+            flatIter->y = y;
+        }
+    }
+
     void readEllipses(
         EllipseConstIterator ellipseIter,
         Scalar * nonlinearIter, Scalar * fixedIter
@@ -238,6 +277,19 @@ public:
         }
     }
 
+    void writeFlatEllipses(
+        Scalar const * nonlinearIter, Scalar const * fixedIter,
+        FlatEllipse * flatIter
+    ) const override {
+        Scalar const * centerIter = nonlinearIter + _centerParameterOffset;
+        for (int i = 0; i < getBasisCount(); ++i, ++flatIter) {
+            writeFlatCore(getBasisVector()[i], nonlinearIter, *flatIter);
+            flatIter->x = centerIter[0];
+            flatIter->y = centerIter[1];
+            centerIter += 2;
+        }
+    }
+
     void readEllipses(
         EllipseConstIterator ellipseIter,
         Scalar * nonlinearIter, Scalar * fixedIter
@@ -334,6 +386,36 @@ Model::EllipseVector Model::writeEllipses(
     return r;
 }
 
+void Model::writeFlatEllipses(
+    Scalar const * nonlinearIter, Scalar const * fixedIter,
+    FlatEllipse * flatIter
+) const {
+    EllipseVector ellipses = makeEllipseVector();
+    writeEllipses(nonlinearIter, fixedIter, ellipses.begin());
+    for (EllipseVector::const_iterator i = ellipses.begin(); i != ellipses.end(); ++i, ++flatIter) {
+        flatIter->setEllipse(*i);
+    }
+}
+
+FlatEllipseVector Model::writeFlatEllipses(
+    ndarray::Array<Scalar const,1,1> const & nonlinear,
+    ndarray::Array<Scalar const,1,1> const & fixed
+) const {
+    LSST_THROW_IF_NE(
+        nonlinear.getSize<0>(), getNonlinearDim(),
+        pex::exceptions::LengthError,
+        "Size of nonlinear array (%d) does not match dimension of model (%d)"
+    );
+    LSST_THROW_IF_NE(
+        fixed.getSize<0>(), getFixedDim(),
+        pex::exceptions::LengthError,
+        "Size of fixed array (%d) does not match dimension of model (%d)"
+    );
+    FlatEllipseVector r(getBasisCount());
+    writeFlatEllipses(nonlinear.begin(), fixed.begin(), r.data());
+    return r;
+}
+
 void Model::readEllipses(
     EllipseVector const & ellipses,
     ndarray::Array<Scalar,1,1> const & nonlinear,
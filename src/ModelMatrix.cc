@@ -0,0 +1,156 @@
+// -*- lsst-c++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2008-2017 LSST/AURA.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "boost/format.hpp"
+#include "ndarray/eigen.h"
+
+#include "lsst/pex/exceptions.h"
+#include "lsst/meas/modelfit/ModelMatrix.h"
+
+namespace lsst { namespace meas { namespace modelfit {
+
+namespace {
+
+// Number of pixels in one aligned block; column strides are a multiple of this.
+int const COLUMN_PADDING = ModelMatrix::ALIGNMENT / sizeof(Pixel);
+
+// Matrices with at most this many columns have their Gram matrices computed from column dot products;
+// wider ones are converted to double precision and passed to Eigen's rankUpdate in blocks of rows.
+int const MAX_DOT_PRODUCT_COLS = 4;
+
+// Number of rows converted at a time for the rankUpdate, chosen to keep the block in cache.
+int const GRAM_BLOCK_ROWS = 256;
+
+} // anonymous
+
+ModelMatrix::ModelMatrix() : _rows(0), _cols(0), _stride(0), _capacity(0) {
+    resize(0, 0);
+}
+
+ModelMatrix::ModelMatrix(int nRows, int nCols) : _rows(0), _cols(0), _stride(0), _capacity(0) {
+    resize(nRows, nCols);
+}
+
+bool ModelMatrix::resize(int nRows, int nCols) {
+    if (nRows < 0 || nCols < 0) {
+        throw LSST_EXCEPT(
+            pex::exceptions::InvalidParameterError,
+            (boost::format("Invalid model matrix dimensions (%d, %d)") % nRows % nCols).str()
+        );
+    }
+    int const stride = ((nRows + COLUMN_PADDING - 1) / COLUMN_PADDING) * COLUMN_PADDING;
+    // Always allocate at least one block, so views of empty matrices still have valid storage.
+    std::size_t const size = std::max(static_cast<std::size_t>(stride) * nCols,
+                                      static_cast<std::size_t>(COLUMN_PADDING));
+    bool grew = false;
+    if (size > _capacity) {
+        void * data = nullptr;
+        if (posix_memalign(&data, ALIGNMENT, size * sizeof(Pixel)) != 0) {
+            throw LSST_EXCEPT(
+                pex::exceptions::MemoryError,
+                (boost::format("Failed to allocate %d bytes for model matrix") % (size * sizeof(Pixel))).str()
+            );
+        }
+        _data.reset(static_cast<Pixel*>(data), std::free);
+        _capacity = size;
+        grew = true;
+    }
+    _rows = nRows;
+    _cols = nCols;
+    _stride = stride;
+    return grew;
+}
+
+ndarray::Array<Pixel,2,-1> ModelMatrix::getArray() const {
+    ndarray::Array<Pixel,2,2> transposed = ndarray::external(
+        _data.get(), ndarray::makeVector(_cols, _rows), ndarray::makeVector(_stride, 1), _data
+    );
+    return transposed.transpose();
+}
+
+ModelMatrix::EigenMap ModelMatrix::getEigenMap() const {
+    return EigenMap(_data.get(), _rows, _cols, Eigen::OuterStride<>(_stride));
+}
+
+void multiplyModelMatrix(
+    ndarray::Array<Pixel const,2,-1> const & modelMatrix,
+    ndarray::Array<Scalar const,1,1> const & amplitudes,
+    ndarray::Array<Scalar,1,1> const & output
+) {
+    LSST_THROW_IF_NE(
+        amplitudes.getSize<0>(), modelMatrix.getSize<1>(),
+        pex::exceptions::LengthError,
+        "Number of amplitudes (%d) does not match number of model matrix columns (%d)"
+    );
+    LSST_THROW_IF_NE(
+        output.getSize<0>(), modelMatrix.getSize<0>(),
+        pex::exceptions::LengthError,
+        "Size of output array (%d) does not match number of model matrix rows (%d)"
+    );
+    auto matrix = ndarray::asEigenMatrix(modelMatrix);
+    auto result = ndarray::asEigenMatrix(output);
+    if (matrix.cols() == 0) {
+        result.setZero();
+        return;
+    }
+    result = amplitudes[0] * matrix.col(0).cast<Scalar>();
+    for (int k = 1; k < matrix.cols(); ++k) {
+        result += amplitudes[k] * matrix.col(k).cast<Scalar>();
+    }
+}
+
+void addModelMatrixGram(
+    ndarray::Array<Pixel const,2,-1> const & modelMatrix,
+    Matrix & hessian
+) {
+    LSST_THROW_IF_NE(
+        hessian.rows(), modelMatrix.getSize<1>(),
+        pex::exceptions::LengthError,
+        "Number of rows of hessian (%d) does not match number of model matrix columns (%d)"
+    );
+    LSST_THROW_IF_NE(
+        hessian.cols(), modelMatrix.getSize<1>(),
+        pex::exceptions::LengthError,
+        "Number of columns of hessian (%d) does not match number of model matrix columns (%d)"
+    );
+    auto matrix = ndarray::asEigenMatrix(modelMatrix);
+    if (matrix.cols() <= MAX_DOT_PRODUCT_COLS) {
+        for (int j = 0; j < matrix.cols(); ++j) {
+            for (int i = j; i < matrix.cols(); ++i) {
+                hessian(i, j) += matrix.col(i).cast<Scalar>().dot(matrix.col(j).cast<Scalar>());
+            }
+        }
+        return;
+    }
+    Matrix block(GRAM_BLOCK_ROWS, matrix.cols());
+    for (int start = 0; start < matrix.rows(); start += GRAM_BLOCK_ROWS) {
+        int const size = std::min(GRAM_BLOCK_ROWS, static_cast<int>(matrix.rows()) - start);
+        block.topRows(size) = matrix.middleRows(start, size).cast<Scalar>();
+        hessian.selfadjointView<Eigen::Lower>().rankUpdate(block.topRows(size).adjoint());
+    }
+}
+
+}}} // namespace lsst::meas::modelfit
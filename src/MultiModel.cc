@@ -97,6 +97,18 @@ void MultiModel::writeEllipses(
     }
 }
 
+void MultiModel::writeFlatEllipses(
+    Scalar const * nonlinearIter, Scalar const * fixedIter,
+    FlatEllipse * flatIter
+) const {
+    for (ModelVector::const_iterator i = _components.begin(); i != _components.end(); ++i) {
+        (**i).writeFlatEllipses(nonlinearIter, fixedIter, flatIter);
+        nonlinearIter += (**i).getNonlinearDim();
+        fixedIter += (**i).getFixedDim();
+        flatIter += (**i).getBasisCount();
+    }
+}
+
 void MultiModel::readEllipses(
     EllipseConstIterator ellipseIter,
     Scalar * nonlinearIter, Scalar * fixedIter
@@ -0,0 +1,205 @@
+// -*- lsst-c++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2008-2017 LSST/AURA.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+
+#include <algorithm>
+#include <cmath>
+
+#include "boost/format.hpp"
+#include "ndarray/eigen.h"
+
+#include "lsst/pex/exceptions.h"
+#include "lsst/meas/modelfit/ModelMatrix.h"
+#include "lsst/meas/modelfit/StreamingLikelihood.h"
+
+namespace lsst { namespace meas { namespace modelfit {
+
+StreamingLikelihood::StreamingLikelihood(
+    PTR(Model) model,
+    ndarray::Array<Scalar const,1,1> const & fixed,
+    UnitSystem const & fitSys,
+    geom::SpherePoint const & position,
+    int epochCount,
+    EpochLoader const & loader,
+    int groupSize,
+    UnitTransformedLikelihoodControl const & ctrl
+) : _model(model), _fixed(fixed), _fitSys(fitSys), _position(position), _epochCount(epochCount),
+    _loader(loader), _groupSize(groupSize), _dataDim(0), _ctrl(ctrl)
+{
+    if (epochCount < 0) {
+        throw LSST_EXCEPT(
+            pex::exceptions::InvalidParameterError,
+            (boost::format("Number of epochs (%d) must not be negative") % epochCount).str()
+        );
+    }
+    if (groupSize < 1) {
+        throw LSST_EXCEPT(
+            pex::exceptions::InvalidParameterError,
+            (boost::format("Group size (%d) must be positive") % groupSize).str()
+        );
+    }
+    _weightsMultipliers.resize(getGroupCount(), ctrl.weightsMultiplier);
+    if (ctrl.usePixelWeights) {
+        // We only need the number of pixels, which doesn't require building the likelihoods.
+        for (int i = 0; i < epochCount; ++i) {
+            PTR(EpochFootprint) epoch = _loader(i);
+            if (!epoch) {
+                throw LSST_EXCEPT(
+                    pex::exceptions::InvalidParameterError,
+                    (boost::format("Epoch loader returned no data for epoch %d") % i).str()
+                );
+            }
+            _dataDim += epoch->footprint.getArea();
+        }
+        return;
+    }
+    // Each group's likelihood computes its constant weight as the geometric mean of its own per-pixel
+    // weights; we rescale them all to the geometric mean over all groups, which is what a single
+    // UnitTransformedLikelihood would use.
+    std::vector<double> groupLogWeights(getGroupCount(), 0.0);
+    double logWeightSum = 0.0;
+    for (int group = 0; group < getGroupCount(); ++group) {
+        PTR(UnitTransformedLikelihood) likelihood = _loadGroup(group);
+        if (likelihood->getDataDim() > 0) {
+            groupLogWeights[group] = std::log(likelihood->getWeights()[0]);
+            logWeightSum += groupLogWeights[group] * likelihood->getDataDim();
+        }
+        _dataDim += likelihood->getDataDim();
+    }
+    if (_dataDim > 0) {
+        for (int group = 0; group < getGroupCount(); ++group) {
+            _weightsMultipliers[group] *= std::exp(logWeightSum / _dataDim - groupLogWeights[group]);
+        }
+    }
+}
+
+NormalEquations StreamingLikelihood::computeAmplitudeNormalEquations(
+    ndarray::Array<Scalar const,1,1> const & nonlinear
+) const {
+    LSST_THROW_IF_NE(
+        nonlinear.getSize<0>(), getNonlinearDim(),
+        pex::exceptions::LengthError,
+        "Size of nonlinear array (%d) does not match nonlinear dimension (%d)"
+    );
+    NormalEquations result(getAmplitudeDim());
+    ModelMatrix modelMatrix;  // reused by all groups
+    for (int group = 0; group < getGroupCount(); ++group) {
+        PTR(UnitTransformedLikelihood) likelihood = _loadGroup(group);
+        int const nPix = likelihood->getDataDim();
+        modelMatrix.resize(nPix, getAmplitudeDim());
+        ndarray::Array<Pixel,2,-1> matrix = modelMatrix.getArray();
+        likelihood->computeModelMatrix(matrix, nonlinear);
+        addModelMatrixGram(matrix, result.hessian);
+        Vector data = ndarray::asEigenMatrix(likelihood->getData()).cast<Scalar>();
+        auto eigenMatrix = ndarray::asEigenMatrix(matrix);
+        for (int k = 0; k < getAmplitudeDim(); ++k) {
+            result.gradient[k] -= eigenMatrix.col(k).cast<Scalar>().dot(data);
+        }
+        result.chiSq += data.squaredNorm();
+        result.dataDim += nPix;
+    }
+    result.hessian.triangularView<Eigen::StrictlyUpper>() = result.hessian.adjoint();
+    return result;
+}
+
+NormalEquations StreamingLikelihood::computeNormalEquations(
+    ndarray::Array<Scalar const,1,1> const & parameters,
+    ndarray::Array<Scalar const,1,1> const & nonlinearSteps
+) const {
+    int const nlDim = getNonlinearDim();
+    int const ampDim = getAmplitudeDim();
+    LSST_THROW_IF_NE(
+        parameters.getSize<0>(), nlDim + ampDim,
+        pex::exceptions::LengthError,
+        "Size of parameters array (%d) does not match total dimension (%d)"
+    );
+    LSST_THROW_IF_NE(
+        nonlinearSteps.getSize<0>(), nlDim,
+        pex::exceptions::LengthError,
+        "Size of nonlinearSteps array (%d) does not match nonlinear dimension (%d)"
+    );
+    ndarray::Array<Scalar const,1,1> nonlinear = parameters[ndarray::view(0, nlDim)];
+    ndarray::Array<Scalar const,1,1> amplitudes = parameters[ndarray::view(nlDim, nlDim + ampDim)];
+    ndarray::Array<Scalar,1,1> perturbed = ndarray::copy(nonlinear);
+    NormalEquations result(nlDim + ampDim);
+    // Workspace reused by all groups; none of it is larger than one group's pixels.
+    ModelMatrix modelMatrix;
+    ModelMatrix perturbedMatrix;
+    Matrix jacobian;
+    for (int group = 0; group < getGroupCount(); ++group) {
+        PTR(UnitTransformedLikelihood) likelihood = _loadGroup(group);
+        int const nPix = likelihood->getDataDim();
+        modelMatrix.resize(nPix, ampDim);
+        perturbedMatrix.resize(nPix, ampDim);
+        ndarray::Array<Pixel,2,-1> matrix = modelMatrix.getArray();
+        ndarray::Array<Pixel,2,-1> perturbedArray = perturbedMatrix.getArray();
+        ndarray::Array<Scalar,1,1> model = ndarray::allocate(nPix);
+        ndarray::Array<Scalar,1,1> perturbedModel = ndarray::allocate(nPix);
+        likelihood->computeModelMatrix(matrix, nonlinear);
+        multiplyModelMatrix(matrix, amplitudes, model);
+        Vector residuals = ndarray::asEigenMatrix(model)
+            - ndarray::asEigenMatrix(likelihood->getData()).cast<Scalar>();
+        jacobian.resize(nPix, nlDim + ampDim);
+        // As in the optimizer's numerical derivatives, perturbing one nonlinear parameter changes only
+        // the columns of the bases whose ellipses depend on it, so we update a copy of the model matrix
+        // rather than recomputing it.
+        for (int n = 0; n < nlDim; ++n) {
+            perturbedArray.deep() = matrix;
+            perturbed[n] += nonlinearSteps[n];
+            likelihood->updateModelMatrix(perturbedArray, perturbed, nonlinear);
+            perturbed[n] = nonlinear[n];
+            multiplyModelMatrix(perturbedArray, amplitudes, perturbedModel);
+            jacobian.col(n) = (ndarray::asEigenMatrix(perturbedModel) - ndarray::asEigenMatrix(model))
+                / nonlinearSteps[n];
+        }
+        jacobian.rightCols(ampDim) = ndarray::asEigenMatrix(matrix).cast<Scalar>();
+        result.hessian.selfadjointView<Eigen::Lower>().rankUpdate(jacobian.adjoint());
+        result.gradient += jacobian.adjoint() * residuals;
+        result.chiSq += residuals.squaredNorm();
+        result.dataDim += nPix;
+    }
+    result.hessian.triangularView<Eigen::StrictlyUpper>() = result.hessian.adjoint();
+    return result;
+}
+
+PTR(UnitTransformedLikelihood) StreamingLikelihood::_loadGroup(int group) const {
+    int const begin = group * _groupSize;
+    int const end = std::min(begin + _groupSize, _epochCount);
+    std::vector<PTR(EpochFootprint)> epochs;
+    epochs.reserve(end - begin);
+    for (int i = begin; i < end; ++i) {
+        epochs.push_back(_loader(i));
+        if (!epochs.back()) {
+            throw LSST_EXCEPT(
+                pex::exceptions::InvalidParameterError,
+                (boost::format("Epoch loader returned no data for epoch %d") % i).str()
+            );
+        }
+    }
+    UnitTransformedLikelihoodControl ctrl(_ctrl);
+    ctrl.weightsMultiplier = _weightsMultipliers[group];
+    // The likelihood copies the pixels it needs, so the epochs are released when we return.
+    return std::make_shared<UnitTransformedLikelihood>(_model, _fixed, _fitSys, _position, epochs, ctrl);
+}
+
+}}} // namespace lsst::meas::modelfit
@@ -21,16 +21,33 @@
  * see <http://www.lsstcorp.org/LegalNotices/>.
  */
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <complex>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
 #include <limits>
+#include <mutex>
 #include <numeric>
+#include <thread>
 
 #include "boost/format.hpp"
 #include <memory>
 #include "ndarray/eigen.h"
 
+#include "lsst/pex/exceptions.h"
+#include "lsst/geom/Box.h"
+#include "lsst/afw/geom/ellipses/Axes.h"
+#include "lsst/afw/geom/ellipses/Quadrupole.h"
 #include "lsst/afw/image/PhotoCalib.h"
+#include "lsst/shapelet/constants.h"
 #include "lsst/shapelet/MatrixBuilder.h"
+#include "lsst/shapelet/MultiShapeletFunction.h"
 #include "lsst/meas/modelfit/UnitTransformedLikelihood.h"
+#include "lsst/meas/modelfit/FourierTransform.h"
+#include "lsst/meas/modelfit/vectorMath.h"
 
 namespace lsst { namespace meas { namespace modelfit {
 
@@ -47,36 +64,43 @@ int componentPixelSum(int partialNumPixels, CONST_PTR(EpochFootprint) const &epo
     return partialNumPixels + epochImagePtr->footprint.getArea();
 }
 
+/*
+ * Return the x and y coordinates of all pixels in a Footprint, in the same order used when flattening
+ * images with the Footprint's SpanSet.
+ */
+std::pair< ndarray::Array<Pixel,1,1>, ndarray::Array<Pixel,1,1> > makeCoordinateArrays(
+    afw::detection::Footprint const & footprint
+) {
+    ndarray::Array<Pixel,1,1> x = ndarray::allocate(footprint.getArea());
+    ndarray::Array<Pixel,1,1> y = ndarray::allocate(footprint.getArea());
+    int n = 0;
+    for (auto const & span : *footprint.getSpans()) {
+        for (int i = span.getMinX(); i <= span.getMaxX(); ++i, ++n) {
+            x[n] = i;
+            y[n] = span.getY();
+        }
+    }
+    return std::make_pair(x, y);
+}
+
 /*
  * Return a vector of MatrixBuilders, with one for each MultiShapeletBasis in the input vector,
- * using the pixel region defined by the given Footprint and the given shapelet PSF approximation.
+ * using the given pixel coordinates and the given shapelet PSF approximation.
  *
  * basisVector - vector of MultiShapeletBasis objects; will produce one MatrixBuilder for each.
  * psf - MultiShapeletFunction representation of the PSF
- * footprint - Footprint that defines the region of pixels that will be used in the fit.
+ * x, y - coordinates of the pixels that will be used in the fit (see makeCoordinateArrays).
  */
 BuilderVector makeMatrixBuilders(
     Model::BasisVector const & basisVector,
     shapelet::MultiShapeletFunction const & psf,
-    afw::detection::Footprint const & footprint
+    ndarray::Array<Pixel const,1,1> const & x,
+    ndarray::Array<Pixel const,1,1> const & y
 ) {
     BuilderVector builders;
     FactoryVector factories;
     builders.reserve(basisVector.size());
     factories.reserve(basisVector.size());
-    ndarray::Array<Pixel,1,1> x = ndarray::allocate(footprint.getArea());
-    ndarray::Array<Pixel,1,1> y = ndarray::allocate(footprint.getArea());
-    int n = 0;
-    for (
-        auto i = footprint.getSpans()->begin();
-        i != footprint.getSpans()->end();
-        ++i
-    ) {
-        for (afw::geom::Span::Iterator j = (*i).begin(); j != (*i).end(); ++j, ++n) {
-            x[n] = j->getX();
-            y[n] = j->getY();
-        }
-    }
     int workspaceSize = 0;
     for (Model::BasisVector::const_iterator k = basisVector.begin(); k != basisVector.end(); ++k) {
         factories.push_back(shapelet::MatrixBuilderFactory<Pixel>(x, y, **k, psf));
@@ -90,14 +114,334 @@ BuilderVector makeMatrixBuilders(
     return builders;
 }
 
+/*
+ * A fixed set of worker threads that is kept for the lifetime of a likelihood, so evaluating it many
+ * times (once per optimizer step) doesn't create and join threads each time.
+ */
+class WorkerPool {
+public:
+
+    explicit WorkerPool(int nWorkers) {
+        _threads.reserve(nWorkers);
+        for (int w = 0; w < nWorkers; ++w) {
+            _threads.emplace_back([this]() { _loop(); });
+        }
+    }
+
+    WorkerPool(WorkerPool const &) = delete;
+    WorkerPool & operator=(WorkerPool const &) = delete;
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _start.notify_all();
+        for (auto & thread : _threads) {
+            thread.join();
+        }
+    }
+
+    // Call work() on every worker and on the calling thread, and return when all calls have finished.
+    // work() must not throw.  Calls from different threads are run one at a time.
+    void run(std::function<void()> const & work) {
+        std::lock_guard<std::mutex> runLock(_runMutex);
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _work = &work;
+            _running = static_cast<int>(_threads.size());
+            ++_generation;
+        }
+        _start.notify_all();
+        work();
+        std::unique_lock<std::mutex> lock(_mutex);
+        _done.wait(lock, [this]() { return _running == 0; });
+        _work = nullptr;
+    }
+
+private:
+
+    void _loop() {
+        std::uint64_t seen = 0;
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (true) {
+            _start.wait(lock, [this, seen]() { return _stop || _generation != seen; });
+            if (_stop) return;
+            seen = _generation;
+            std::function<void()> const * work = _work;
+            lock.unlock();
+            (*work)();
+            lock.lock();
+            if (--_running == 0) {
+                _done.notify_one();
+            }
+        }
+    }
+
+    std::mutex _runMutex;  // serializes calls to run()
+    std::mutex _mutex;     // guards everything below
+    std::condition_variable _start;
+    std::condition_variable _done;
+    std::function<void()> const * _work = nullptr;
+    std::uint64_t _generation = 0;
+    int _running = 0;
+    bool _stop = false;
+    std::vector<std::thread> _threads;
+};
+
+// Minimum width (sigma, in pixels) of every PSF component for FFT convolution: the PSF must suppress
+// all frequencies beyond the pixel grid's Nyquist frequency, where its transform is at most
+// exp(-pi^2 sigma^2 / 2) = 1.5E-5 of its peak.
+Scalar const FFT_MIN_PSF_SIGMA = 1.5;
+
+// Minimum distance (in units of the convolved profile's sigma) between the pixels and the nearest
+// wrap-around image of each component on the periodic FFT grid.
+Scalar const FFT_WRAP_SIGMAS = 6.0;
+
+// Cost of one radix-2 FFT pass over one grid point, relative to that of evaluating one term of a
+// PSF-convolved shapelet expansion at one pixel (dominated by an exponential); used to choose between
+// FFT convolution and direct evaluation.
+Scalar const FFT_PASS_COST = 0.2;
+
+/*
+ * Evaluates Gaussian (zeroth-order shapelet) profiles convolved with a PSF on an epoch's pixels by
+ * FFT convolution.
+ *
+ * The pixels' bounding box is padded to make room for the PSF and rounded up to a power-of-two grid.
+ * The PSF is sampled on that grid (centered on the grid origin, wrapping around) and transformed once,
+ * on construction, while the Fourier transform of each Gaussian is computed analytically on the grid's
+ * frequencies, so each evaluation needs only one inverse transform, however many components the
+ * profile has.  The result is exact at the pixel centers (up to round-off) as long as the PSF is wide
+ * enough to band-limit the convolved profile (see FFT_MIN_PSF_SIGMA) and the profile's wrap-around
+ * images are negligible (see FFT_WRAP_SIGMAS); evaluate() checks the latter for every profile.
+ *
+ * Evaluation uses workspace owned by the evaluator, so an evaluator must not be used by more than one
+ * thread at a time.
+ */
+class FourierEvaluator {
+public:
+
+    typedef detail::FourierTransform::Complex Complex;
+
+    // Return true if the PSF is wide enough for FFT convolution.
+    static bool isSupported(shapelet::MultiShapeletFunction const & psf) {
+        for (auto const & component : psf.getComponents()) {
+            afw::geom::ellipses::Axes axes(component.getEllipse().getCore());
+            if (axes.getB() < FFT_MIN_PSF_SIGMA) {
+                return false;
+            }
+        }
+        return !psf.getComponents().empty();
+    }
+
+    // Return the number of points in the grid an evaluator would use for the given pixels and PSF.
+    static int computeGridSize(
+        ndarray::Array<Pixel const,1,1> const & x,
+        ndarray::Array<Pixel const,1,1> const & y,
+        shapelet::MultiShapeletFunction const & psf
+    ) {
+        geom::Box2I bbox = computeGrid(x, y, psf);
+        return bbox.getWidth() * bbox.getHeight();
+    }
+
+    FourierEvaluator(
+        ndarray::Array<Pixel const,1,1> const & x,
+        ndarray::Array<Pixel const,1,1> const & y,
+        shapelet::MultiShapeletFunction const & psf
+    ) :
+        _grid(computeGrid(x, y, psf)),
+        _transform(_grid.getHeight(), _grid.getWidth()),
+        _psfTransform(ndarray::allocate(_grid.getHeight(), _grid.getWidth())),
+        _spectrum(ndarray::allocate(_grid.getHeight(), _grid.getWidth())),
+        _gaussian(ndarray::allocate(_grid.getHeight() * _grid.getWidth())),
+        _frequencyX(_grid.getWidth()), _frequencyY(_grid.getHeight()),
+        _phaseX(_grid.getWidth()), _phaseY(_grid.getHeight()),
+        _index(x.getSize<0>()),
+        _psfVariance(0.0, 0.0)
+    {
+        int const nx = _grid.getWidth();
+        int const ny = _grid.getHeight();
+        for (int i = 0; i < nx; ++i) {
+            _frequencyX[i] = 2.0 * M_PI * (i < nx / 2 ? i : i - nx) / nx;
+        }
+        for (int i = 0; i < ny; ++i) {
+            _frequencyY[i] = 2.0 * M_PI * (i < ny / 2 ? i : i - ny) / ny;
+        }
+        _xMin = _yMin = std::numeric_limits<Scalar>::infinity();
+        _xMax = _yMax = -std::numeric_limits<Scalar>::infinity();
+        for (int n = 0; n < x.getSize<0>(); ++n) {
+            int const i = static_cast<int>(std::lround(x[n])) - _grid.getMinX();
+            int const j = static_cast<int>(std::lround(y[n])) - _grid.getMinY();
+            _index[n] = j * nx + i;
+            _xMin = std::min(_xMin, Scalar(x[n]));
+            _xMax = std::max(_xMax, Scalar(x[n]));
+            _yMin = std::min(_yMin, Scalar(y[n]));
+            _yMax = std::max(_yMax, Scalar(y[n]));
+        }
+        shapelet::MultiShapeletFunctionEvaluator psfEvaluator = psf.evaluate();
+        for (int j = 0; j < ny; ++j) {
+            for (int i = 0; i < nx; ++i) {
+                _psfTransform[j][i] = psfEvaluator(i < nx / 2 ? i : i - nx, j < ny / 2 ? j : j - ny);
+            }
+        }
+        _transform.forward(_psfTransform);
+        for (auto const & component : psf.getComponents()) {
+            afw::geom::ellipses::Quadrupole q(component.getEllipse().getCore());
+            _psfVariance.setX(std::max(_psfVariance.getX(), q.getIxx()));
+            _psfVariance.setY(std::max(_psfVariance.getY(), q.getIyy()));
+        }
+    }
+
+    int getGridSize() const { return _grid.getWidth() * _grid.getHeight(); }
+
+    // Evaluate the convolution of the given unconvolved function with the PSF at each of the pixels.
+    // Returns false, leaving the output in an unspecified state, if the function has components other
+    // than Gaussians or is too large relative to the grid.
+    bool evaluate(
+        shapelet::MultiShapeletFunction const & function,
+        ndarray::Array<Pixel,1,1> const & output
+    ) const {
+        int const nx = _grid.getWidth();
+        int const ny = _grid.getHeight();
+        for (auto const & component : function.getComponents()) {
+            if (component.getOrder() != 0) {
+                return false;
+            }
+            afw::geom::ellipses::Quadrupole q(component.getEllipse().getCore());
+            geom::Point2D const center = component.getEllipse().getCenter();
+            Scalar const xDistance = std::max(center.getX() - _xMin, _xMax - center.getX());
+            Scalar const yDistance = std::max(center.getY() - _yMin, _yMax - center.getY());
+            if (nx - xDistance < FFT_WRAP_SIGMAS * std::sqrt(q.getIxx() + _psfVariance.getX()) ||
+                ny - yDistance < FFT_WRAP_SIGMAS * std::sqrt(q.getIyy() + _psfVariance.getY())) {
+                return false;
+            }
+        }
+        _spectrum.deep() = Complex(0.0);
+        for (auto const & component : function.getComponents()) {
+            // The Fourier transform of a Gaussian with flux F, center c, and second moments Q is
+            // F exp(-k^T Q k / 2 - i k.c); we shift c to the grid origin.
+            afw::geom::ellipses::Quadrupole q(component.getEllipse().getCore());
+            geom::Point2D const center = component.getEllipse().getCenter();
+            Scalar const flux = component.getCoefficients()[0] * shapelet::ShapeletFunction::FLUX_FACTOR;
+            for (int i = 0; i < nx; ++i) {
+                Scalar const angle = -_frequencyX[i] * (center.getX() - _grid.getMinX());
+                _phaseX[i] = flux * Complex(std::cos(angle), std::sin(angle));
+            }
+            for (int j = 0; j < ny; ++j) {
+                Scalar const angle = -_frequencyY[j] * (center.getY() - _grid.getMinY());
+                _phaseY[j] = Complex(std::cos(angle), std::sin(angle));
+            }
+            for (int j = 0, n = 0; j < ny; ++j) {
+                for (int i = 0; i < nx; ++i, ++n) {
+                    _gaussian[n] = -0.5 * (_frequencyX[i] * (q.getIxx() * _frequencyX[i]
+                                                             + 2.0 * q.getIxy() * _frequencyY[j])
+                                           + q.getIyy() * _frequencyY[j] * _frequencyY[j]);
+                }
+            }
+            detail::vectorExp(_gaussian.getData(), _gaussian.getData(), _gaussian.getSize<0>());
+            for (int j = 0, n = 0; j < ny; ++j) {
+                for (int i = 0; i < nx; ++i, ++n) {
+                    _spectrum[j][i] += _gaussian[n] * _phaseX[i] * _phaseY[j];
+                }
+            }
+        }
+        for (int j = 0; j < ny; ++j) {
+            for (int i = 0; i < nx; ++i) {
+                _spectrum[j][i] *= _psfTransform[j][i];
+            }
+        }
+        _transform.inverse(_spectrum);
+        Complex const * spectrum = _spectrum.getData();
+        for (std::size_t n = 0; n < _index.size(); ++n) {
+            output[n] = spectrum[_index[n]].real();
+        }
+        return true;
+    }
+
+private:
+
+    // Compute the grid: the pixels' bounding box, padded by half the wrap-around margin for the
+    // widest PSF component on each side, with dimensions rounded up to powers of two.
+    static geom::Box2I computeGrid(
+        ndarray::Array<Pixel const,1,1> const & x,
+        ndarray::Array<Pixel const,1,1> const & y,
+        shapelet::MultiShapeletFunction const & psf
+    ) {
+        geom::Box2I bbox;
+        for (int n = 0; n < x.getSize<0>(); ++n) {
+            bbox.include(geom::Point2I(std::lround(x[n]), std::lround(y[n])));
+        }
+        Scalar sigma = 0.0;
+        for (auto const & component : psf.getComponents()) {
+            sigma = std::max(sigma, afw::geom::ellipses::Axes(component.getEllipse().getCore()).getA());
+        }
+        int const padding = static_cast<int>(std::ceil(0.5 * FFT_WRAP_SIGMAS * sigma));
+        return geom::Box2I(
+            geom::Point2I(bbox.getMinX() - padding, bbox.getMinY() - padding),
+            geom::Extent2I(detail::FourierTransform::computeSize(bbox.getWidth() + 2 * padding),
+                           detail::FourierTransform::computeSize(bbox.getHeight() + 2 * padding))
+        );
+    }
+
+    geom::Box2I _grid;
+    detail::FourierTransform _transform;
+    ndarray::Array<Complex,2,2> _psfTransform;
+    ndarray::Array<Complex,2,2> _spectrum;  // workspace
+    ndarray::Array<Scalar,1,1> _gaussian;   // workspace
+    std::vector<Scalar> _frequencyX;
+    std::vector<Scalar> _frequencyY;
+    mutable std::vector<Complex> _phaseX;   // workspace
+    mutable std::vector<Complex> _phaseY;   // workspace
+    std::vector<int> _index;  // index of each pixel in the (flattened) grid
+    geom::Extent2D _psfVariance;  // largest Ixx and Iyy of any PSF component
+    Scalar _xMin;
+    Scalar _xMax;
+    Scalar _yMin;
+    Scalar _yMax;
+};
+
+/*
+ * Return true if evaluating the model matrix for an epoch by FFT convolution is expected to be faster
+ * than evaluating it directly with MatrixBuilders.
+ *
+ * Direct evaluation costs about one shapelet term per pixel for each pair of basis and PSF components.
+ * FFT convolution costs, for each basis function, one exponential per grid point for each of its
+ * components, plus an inverse transform with log2(gridSize) passes over the grid.
+ */
+bool isFourierFaster(
+    int nPix, int gridSize,
+    Model::BasisVector const & basisVector,
+    shapelet::MultiShapeletFunction const & psf
+) {
+    int nPsfTerms = 0;
+    for (auto const & component : psf.getComponents()) {
+        nPsfTerms += shapelet::computeSize(component.getOrder());
+    }
+    Scalar const nPasses = std::log2(static_cast<Scalar>(gridSize));
+    Scalar directCost = 0.0;
+    Scalar fourierCost = 0.0;
+    for (auto const & basis : basisVector) {
+        directCost += static_cast<Scalar>(nPix) * basis->getComponentCount() * nPsfTerms;
+        fourierCost += static_cast<Scalar>(gridSize) * basis->getSize()
+            * (basis->getComponentCount() + FFT_PASS_COST * nPasses);
+    }
+    return fourierCost < directCost;
+}
+
 /*
  *  Flatten image and variance arrays from a MaskedImage using a footprint, and transform
  *  the variance into weights.
  *
+ *  This reads each span of the image and variance planes once, writing all of the flattened arrays in
+ *  the same pass, rather than flattening each plane separately and then copying and transforming the
+ *  results.
+ *
  *  image - MaskedImage whose image and variance pixels should be used in the fit
  *  footprint - Footprint that defines the pixels to be included in the fit
- *  data - array to be filled with flattened values from the MaskedImage's image plane
+ *  data - array to be filled with flattened values from the MaskedImage's image plane, times weights
+ *  variance - array to be filled with flattened values from the MaskedImage's variance plane
  *  weights - array to be filled with flattened values computed from the MaskedImage's variance plane
+ *  unweightedData - array to be filled with flattened values from the MaskedImage's image plane
  *  usePixelWeights - if true, weights will be per-pixel inverse sqrt(variance); if false, a constant
  *                    average value will be used
  */
@@ -111,13 +455,23 @@ void setupArrays(
     bool usePixelWeights,
     double weightsMultiplier
 ) {
-    footprint.getSpans()->flatten(data, image.getImage()->getArray(), image.getXY0());
-    footprint.getSpans()->flatten(variance, image.getVariance()->getArray(), image.getXY0());
-    unweightedData.deep() = data;
+    auto const imageArray = image.getImage()->getArray();
+    auto const varianceArray = image.getVariance()->getArray();
+    geom::Point2I const xy0 = image.getXY0();
     // Convert from variance to weights (1/sigma); this is actually the usual inverse-variance
     // weighting, because we implicitly square it later.
-    ndarray::asEigenArray(weights) =
-        ndarray::asEigenArray(variance).sqrt().inverse() * weightsMultiplier;
+    Pixel const multiplier = weightsMultiplier;
+    int n = 0;
+    for (auto const & span : *footprint.getSpans()) {
+        Pixel const * imageIter = &imageArray[span.getY() - xy0.getY()][span.getMinX() - xy0.getX()];
+        Pixel const * varianceIter = &varianceArray[span.getY() - xy0.getY()][span.getMinX() - xy0.getX()];
+        for (int end = n + span.getWidth(); n < end; ++n, ++imageIter, ++varianceIter) {
+            unweightedData[n] = *imageIter;
+            variance[n] = *varianceIter;
+            weights[n] = (Pixel(1) / std::sqrt(*varianceIter)) * multiplier;
+            data[n] = *imageIter * weights[n];
+        }
+    }
     if (!usePixelWeights) {
         // If we're not using per-pixel weights, we need to use a constant non-unit weight instead,
         // which we compute as the geometric mean of the per-pixel weights.  The choice of geometric
@@ -126,8 +480,8 @@ void setupArrays(
         // motivation for making the weights uniform (we do it to prevent model bias) and hence no
         // rigorous choice.
         weights.deep() = std::exp(ndarray::asEigenArray(weights).log().sum() / weights.getSize<0>());
+        ndarray::asEigenArray(data) = ndarray::asEigenArray(unweightedData) * ndarray::asEigenArray(weights);
     }
-    ndarray::asEigenArray(data) *= ndarray::asEigenArray(weights);
 }
 
 } // anonymous
@@ -145,22 +499,312 @@ EpochFootprint::EpochFootprint(
 class UnitTransformedLikelihood::Impl {
 public:
 
+    // A contiguous range of an epoch's pixels, with MatrixBuilders (and hence workspace) of its own so
+    // chunks can be evaluated concurrently.
+    struct Chunk {
+        int begin;
+        int end;
+        BuilderVector builders;
+    };
+
     class Epoch {
     public:
 
-        Epoch(int nPix_, LocalUnitTransform const & transform_, BuilderVector const & builders_) :
-            nPix(nPix_), transform(transform_), builders(builders_) {}
+        Epoch(
+            int nPix_, LocalUnitTransform const & transform_,
+            ndarray::Array<Pixel const,1,1> const & x_, ndarray::Array<Pixel const,1,1> const & y_,
+            shapelet::MultiShapeletFunction const & psf_
+        ) :
+            nPix(nPix_), dataOffset(0), transform(transform_), x(x_), y(y_), psf(psf_), geometryIndex(0)
+        {}
 
         int nPix;
+        int dataOffset;  // index of the epoch's first row in the model matrix
         LocalUnitTransform transform;
-        BuilderVector builders;
+        ndarray::Array<Pixel const,1,1> x;  // pixel coordinates; may be shared with other epochs
+        ndarray::Array<Pixel const,1,1> y;
+        std::vector<Chunk> chunks;  // a single chunk with all pixels unless evaluating in parallel
+        shapelet::MultiShapeletFunction psf;  // used only by computeModelImage
+        int geometryIndex;  // index of the first epoch with the same transform.geometric and pixels
+        std::shared_ptr<FourierEvaluator> fourier;  // null unless using FFT convolution
+    };
+
+    // A chunk of one epoch, the unit of work for parallel evaluation.
+    struct Task {
+        int epoch;
+        int chunk;
+        int dataOffset;  // index of the chunk's first row in the model matrix
     };
 
-    Impl() : scratch(afw::geom::ellipses::Quadrupole(), geom::Point2D()) {}
+    enum FourierMode { FFT_NEVER, FFT_AUTO, FFT_ALWAYS };
+
+    explicit Impl(UnitTransformedLikelihoodControl const & ctrl, int totPixels) :
+        chunkSize(std::numeric_limits<int>::max()), nThreads(1)
+    {
+        if (ctrl.fftMode == "NEVER") {
+            fourierMode = FFT_NEVER;
+        } else if (ctrl.fftMode == "AUTO") {
+            fourierMode = FFT_AUTO;
+        } else if (ctrl.fftMode == "ALWAYS") {
+            fourierMode = FFT_ALWAYS;
+        } else {
+            throw LSST_EXCEPT(
+                pex::exceptions::InvalidParameterError,
+                "fftMode must be one of 'NEVER', 'AUTO', or 'ALWAYS'; got '" + ctrl.fftMode + "'"
+            );
+        }
+        if (ctrl.parallelMinPixels > 0 && totPixels >= ctrl.parallelMinPixels) {
+            chunkSize = std::max(ctrl.parallelChunkSize, 1);
+            nThreads = ctrl.parallelThreads;
+            if (nThreads <= 0) {
+                nThreads = std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+            }
+            if (nThreads > 1) {
+                workers.reset(new WorkerPool(nThreads - 1));
+            }
+        }
+    }
+
+    // Allocate workspace ellipses for the given model; must be called before addEpoch.
+    void setupEllipses(Model const & model) {
+        basisVector = model.getBasisVector();
+        ellipses.resize(model.getBasisCount());
+        previousEllipses.resize(model.getBasisCount());
+    }
+
+    // Add an epoch, reusing the coordinate arrays and transformed ellipses of the previous epoch
+    // when its Footprint and geometric transform are the same (as when fitting the same pixel
+    // grid in multiple bands).  We use Quadrupole cores for the transformed ellipses so assigning
+    // to them doesn't require any conversions.
+    void addEpoch(
+        Model const & model,
+        UnitSystem const & fitSys,
+        geom::Point2D const & fitPixel,
+        afw::detection::Footprint const & footprint,
+        afw::image::Exposure<Pixel> const & exposure,
+        shapelet::MultiShapeletFunction const & psf
+    ) {
+        LocalUnitTransform transform(fitPixel, fitSys, exposure);
+        ndarray::Array<Pixel const,1,1> x;
+        ndarray::Array<Pixel const,1,1> y;
+        int geometryIndex = epochs.size();
+        if (!epochs.empty() && lastFootprint && *lastFootprint->getSpans() == *footprint.getSpans()) {
+            x = epochs.back().x;
+            y = epochs.back().y;
+            if (transform.geometric.getMatrix() == epochs.back().transform.geometric.getMatrix()) {
+                geometryIndex = epochs.back().geometryIndex;
+            }
+        } else {
+            auto xy = makeCoordinateArrays(footprint);
+            x = xy.first;
+            y = xy.second;
+        }
+        epochs.push_back(Epoch(footprint.getArea(), transform, x, y, psf));
+        Epoch & epoch = epochs.back();
+        epoch.dataOffset = dataDim;
+        epoch.geometryIndex = geometryIndex;
+        if (fourierMode != FFT_NEVER && FourierEvaluator::isSupported(psf)) {
+            int gridSize = FourierEvaluator::computeGridSize(x, y, psf);
+            if (fourierMode == FFT_ALWAYS || isFourierFaster(epoch.nPix, gridSize, basisVector, psf)) {
+                epoch.fourier = std::make_shared<FourierEvaluator>(x, y, psf);
+            }
+        }
+        // An epoch evaluated by FFT convolution is a single task, because the whole grid is transformed
+        // at once; its chunk's MatrixBuilders are only used for profiles FFTs cannot handle.
+        int const epochChunkSize = epoch.fourier ? epoch.nPix : chunkSize;
+        for (int begin = 0; begin < epoch.nPix; begin += epochChunkSize) {
+            int end = begin + std::min(epochChunkSize, epoch.nPix - begin);
+            epoch.chunks.push_back(
+                Chunk{
+                    begin, end,
+                    makeMatrixBuilders(model.getBasisVector(), psf, x[ndarray::view(begin, end)],
+                                       y[ndarray::view(begin, end)])
+                }
+            );
+            tasks.push_back(Task{static_cast<int>(epochs.size()) - 1,
+                                 static_cast<int>(epoch.chunks.size()) - 1, dataDim + begin});
+        }
+        dataDim += epoch.nPix;
+        transformed.push_back(
+            Model::EllipseVector(
+                ellipses.size(),
+                afw::geom::ellipses::Ellipse(afw::geom::ellipses::Quadrupole(), geom::Point2D())
+            )
+        );
+        lastFootprint = &footprint;
+    }
+
+    // Transform the current ellipses to the pixel coordinates of each epoch that needs them.  This
+    // works on flat ellipses, and only the Quadrupole cores and centers of the transformed ellipses
+    // (which are what MatrixBuilders take) are assigned, so nothing is allocated or converted.
+    void transformEllipses(std::vector<bool> const & changed) {
+        for (std::size_t e = 0; e < epochs.size(); ++e) {
+            if (epochs[e].geometryIndex != static_cast<int>(e)) continue;
+            for (std::size_t j = 0; j < ellipses.size(); ++j) {
+                if (changed[j]) {
+                    ellipses[j].transform(epochs[e].transform.geometric).writeEllipse(transformed[e][j]);
+                }
+            }
+        }
+    }
+
+    // Fill the model matrix rows of one task, for the bases with changed[j] set, applying the flux
+    // scaling and (if weights is not empty) the weights in the same pass.
+    void fillTask(
+        Task const & task,
+        ndarray::Array<Pixel,2,-1> const & modelMatrix,
+        std::vector<bool> const & changed,
+        ndarray::Array<Pixel const,1,1> const & weights
+    ) const {
+        Epoch const & epoch = epochs[task.epoch];
+        Chunk const & chunk = epoch.chunks[task.chunk];
+        Model::EllipseVector const & epochEllipses = transformed[epoch.geometryIndex];
+        int const dataEnd = task.dataOffset + chunk.end - chunk.begin;
+        int amplitudeOffset = 0;
+        for (std::size_t j = 0; j < chunk.builders.size(); ++j) {
+            int amplitudeEnd = amplitudeOffset + chunk.builders[j].getBasisSize();
+            if (changed[j]) {
+                ndarray::Array<Pixel,2,-1> block
+                    = modelMatrix[ndarray::view(task.dataOffset, dataEnd)(amplitudeOffset, amplitudeEnd)];
+                if (!(epoch.fourier && fillFourier(epoch, *basisVector[j], epochEllipses[j], block))) {
+                    block.deep() = 0.0;
+                    chunk.builders[j](block, epochEllipses[j]);
+                }
+                block.deep() *= epoch.transform.flux;
+                if (!weights.isEmpty()) {
+                    ndarray::asEigenArray(block).colwise() *=
+                        ndarray::asEigenArray(weights[ndarray::view(task.dataOffset, dataEnd)]);
+                }
+            }
+            amplitudeOffset = amplitudeEnd;
+        }
+    }
+
+    // Fill the columns of one basis in an epoch evaluated by FFT convolution (which always has a single
+    // chunk).  Returns false if any of the basis functions cannot be evaluated that way (see
+    // FourierEvaluator::evaluate); the caller then overwrites the block with another method.
+    bool fillFourier(
+        Epoch const & epoch,
+        shapelet::MultiShapeletBasis const & basis,
+        afw::geom::ellipses::Ellipse const & ellipse,
+        ndarray::Array<Pixel,2,-1> const & block
+    ) const {
+        ndarray::Array<Scalar,1,1> coefficients = ndarray::allocate(basis.getSize());
+        for (int k = 0; k < basis.getSize(); ++k) {
+            coefficients.deep() = 0.0;
+            coefficients[k] = 1.0;
+            if (!epoch.fourier->evaluate(basis.makeFunction(ellipse, coefficients), block.transpose()[k])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Evaluate the model image of one epoch, given the amplitudes of all bases.  Should be called after
+    // transformEllipses.
+    void fillEpochImage(
+        Epoch const & epoch,
+        ndarray::Array<Scalar const,1,1> const & amplitudes,
+        ndarray::Array<Pixel,1,1> const & epochImage
+    ) const {
+        // Combine the amplitude-weighted bases into a single function, so each pixel is evaluated
+        // once rather than once per amplitude.
+        Model::EllipseVector const & epochEllipses = transformed[epoch.geometryIndex];
+        shapelet::MultiShapeletFunction combined;
+        int amplitudeOffset = 0;
+        for (std::size_t j = 0; j < basisVector.size(); ++j) {
+            int amplitudeEnd = amplitudeOffset + basisVector[j]->getSize();
+            shapelet::MultiShapeletFunction component = basisVector[j]->makeFunction(
+                epochEllipses[j], amplitudes[ndarray::view(amplitudeOffset, amplitudeEnd)]
+            );
+            combined.getComponents().insert(
+                combined.getComponents().end(),
+                component.getComponents().begin(), component.getComponents().end()
+            );
+            amplitudeOffset = amplitudeEnd;
+        }
+        if (epoch.fourier && epoch.fourier->evaluate(combined, epochImage)) {
+            epochImage.deep() *= epoch.transform.flux;
+            return;
+        }
+        shapelet::MultiShapeletFunctionEvaluator evaluator = combined.convolve(epoch.psf).evaluate();
+        for (int k = 0; k < epoch.nPix; ++k) {
+            epochImage[k] = evaluator(epoch.x[k], epoch.y[k]) * epoch.transform.flux;
+        }
+    }
+
+    // Call function(i) for 0 <= i < n, on the worker pool and the calling thread.  Each call must write
+    // only to memory no other call writes to, so the result does not depend on the number of threads or
+    // the order of the calls.  The first exception thrown by any call is rethrown after all threads
+    // have finished.
+    template <typename Function>
+    void parallelFor(int n, Function const & function) const {
+        if (!workers || n <= 1) {
+            for (int i = 0; i < n; ++i) {
+                function(i);
+            }
+            return;
+        }
+        std::atomic<int> next(0);
+        std::exception_ptr error;
+        std::mutex errorMutex;
+        std::function<void()> work = [&]() {
+            for (int i = next++; i < n; i = next++) {
+                try {
+                    function(i);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!error) error = std::current_exception();
+                }
+            }
+        };
+        workers->run(work);
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    // Fill the model matrix for all tasks, in parallel if configured to.
+    void fill(
+        ndarray::Array<Pixel,2,-1> const & modelMatrix,
+        std::vector<bool> const & changed,
+        ndarray::Array<Pixel const,1,1> const & weights
+    ) const {
+        parallelFor(
+            static_cast<int>(tasks.size()),
+            [&](int t) { fillTask(tasks[t], modelMatrix, changed, weights); }
+        );
+    }
+
+    // Evaluate the model image for all epochs, in parallel if configured to.
+    void fillImage(
+        ndarray::Array<Pixel,1,1> const & modelImage,
+        ndarray::Array<Scalar const,1,1> const & amplitudes
+    ) const {
+        parallelFor(
+            static_cast<int>(epochs.size()),
+            [&](int e) {
+                Epoch const & epoch = epochs[e];
+                fillEpochImage(
+                    epoch, amplitudes,
+                    modelImage[ndarray::view(epoch.dataOffset, epoch.dataOffset + epoch.nPix)]
+                );
+            }
+        );
+    }
 
     std::vector<Epoch> epochs;
-    Model::EllipseVector ellipses;
-    afw::geom::ellipses::Ellipse scratch;
+    std::vector<Task> tasks;
+    int dataDim = 0;
+    int chunkSize;
+    int nThreads;
+    std::unique_ptr<WorkerPool> workers;  // nThreads - 1 threads; null unless evaluating in parallel
+    FourierMode fourierMode;
+    Model::BasisVector basisVector;
+    FlatEllipseVector ellipses;
+    FlatEllipseVector previousEllipses;  // used by updateModelMatrix to find ellipses that changed
+    std::vector<Model::EllipseVector> transformed;  // ellipses in each epoch's pixel coordinates
+    afw::detection::Footprint const * lastFootprint = nullptr;  // only valid during construction
 };
 
 UnitTransformedLikelihood::UnitTransformedLikelihood(
@@ -170,7 +814,14 @@ UnitTransformedLikelihood::UnitTransformedLikelihood(
     geom::SpherePoint const & position,
     std::vector<PTR(EpochFootprint)> const & epochFootprintList,
     UnitTransformedLikelihoodControl const & ctrl
-) : Likelihood(model, fixed), _impl(new Impl()) {
+) : Likelihood(model, fixed),
+    _impl(
+        new Impl(
+            ctrl,
+            std::accumulate(epochFootprintList.begin(), epochFootprintList.end(), 0, componentPixelSum)
+        )
+    )
+{
     int totPixels = std::accumulate(epochFootprintList.begin(), epochFootprintList.end(),
                                     0, componentPixelSum);
     _data = ndarray::allocate(totPixels);
@@ -178,7 +829,7 @@ UnitTransformedLikelihood::UnitTransformedLikelihood(
     _weights = ndarray::allocate(totPixels);
     _unweightedData = ndarray::allocate(totPixels);
     _impl->epochs.reserve(epochFootprintList.size());
-    _impl->ellipses = model->makeEllipseVector();
+    _impl->setupEllipses(*model);
     int dataOffset = 0;
     geom::Point2D fitPixel = fitSys.wcs->skyToPixel(position);
     for (
@@ -188,12 +839,8 @@ UnitTransformedLikelihood::UnitTransformedLikelihood(
     ) {
         int nPix = (**imPtrIter).footprint.getArea();
         int dataEnd = dataOffset + nPix;
-        _impl->epochs.push_back(
-            Impl::Epoch(
-                nPix, LocalUnitTransform(fitPixel, fitSys, (**imPtrIter).exposure),
-                makeMatrixBuilders(model->getBasisVector(), (**imPtrIter).psf, (**imPtrIter).footprint)
-            )
-        );
+        _impl->addEpoch(*model, fitSys, fitPixel, (**imPtrIter).footprint, (**imPtrIter).exposure,
+                        (**imPtrIter).psf);
         setupArrays(
             (**imPtrIter).exposure.getMaskedImage(),
             (**imPtrIter).footprint,
@@ -204,7 +851,9 @@ UnitTransformedLikelihood::UnitTransformedLikelihood(
             ctrl.usePixelWeights,
             ctrl.weightsMultiplier
         );
+        dataOffset = dataEnd;
     }
+    _impl->lastFootprint = nullptr;
 }
 
 UnitTransformedLikelihood::UnitTransformedLikelihood(
@@ -216,20 +865,16 @@ UnitTransformedLikelihood::UnitTransformedLikelihood(
     afw::detection::Footprint const & footprint,
     shapelet::MultiShapeletFunction const & psf,
     UnitTransformedLikelihoodControl const & ctrl
-) : Likelihood(model, fixed), _impl(new Impl()) {
+) : Likelihood(model, fixed), _impl(new Impl(ctrl, footprint.getArea())) {
     int totPixels = footprint.getArea();
     _data = ndarray::allocate(totPixels);
     _variance = ndarray::allocate(totPixels);
     _weights = ndarray::allocate(totPixels);
     _unweightedData = ndarray::allocate(totPixels);
-    _impl->ellipses = model->makeEllipseVector();
+    _impl->setupEllipses(*model);
     geom::Point2D fitPixel = fitSys.wcs->skyToPixel(position);
-    _impl->epochs.push_back(
-        Impl::Epoch(
-            totPixels, LocalUnitTransform(fitPixel, fitSys, exposure),
-            makeMatrixBuilders(model->getBasisVector(), psf, footprint)
-        )
-    );
+    _impl->addEpoch(*model, fitSys, fitPixel, footprint, exposure, psf);
+    _impl->lastFootprint = nullptr;
     setupArrays(exposure.getMaskedImage(), footprint, _data, _variance, _weights, _unweightedData,
                 ctrl.usePixelWeights, ctrl.weightsMultiplier);
 }
@@ -241,30 +886,39 @@ void UnitTransformedLikelihood::computeModelMatrix(
     ndarray::Array<Scalar const,1,1> const & nonlinear,
     bool doApplyWeights
 ) const {
-    getModel()->writeEllipses(nonlinear.begin(), _fixed.begin(), _impl->ellipses.begin());
-    int dataOffset = 0;
-    modelMatrix.deep() = 0.0;
-    for (
-        std::vector<Impl::Epoch>::const_iterator i = _impl->epochs.begin();
-        i != _impl->epochs.end();
-        ++i
-    ) {
-        int dataEnd = dataOffset + i->nPix;
-        int amplitudeOffset = 0;
-        for (std::size_t j = 0; j < _impl->ellipses.size(); ++j) {
-            _impl->scratch = _impl->ellipses[j].transform(i->transform.geometric);
-            int amplitudeEnd = amplitudeOffset + i->builders[j].getBasisSize();
-            i->builders[j](
-                modelMatrix[ndarray::view(dataOffset, dataEnd)(amplitudeOffset, amplitudeEnd)],
-                _impl->scratch
-            );
-            amplitudeOffset = amplitudeEnd;
-        }
-        modelMatrix[ndarray::view(dataOffset, dataEnd)()] *= i->transform.flux;
-        dataOffset = dataEnd;
+    getModel()->writeFlatEllipses(nonlinear.begin(), _fixed.begin(), _impl->ellipses.data());
+    std::vector<bool> const changed(_impl->ellipses.size(), true);
+    _impl->transformEllipses(changed);
+    _impl->fill(modelMatrix, changed, doApplyWeights ? _weights : ndarray::Array<Pixel,1,1>());
+}
+
+void UnitTransformedLikelihood::updateModelMatrix(
+    ndarray::Array<Pixel,2,-1> const & modelMatrix,
+    ndarray::Array<Scalar const,1,1> const & nonlinear,
+    ndarray::Array<Scalar const,1,1> const & previousNonlinear,
+    bool doApplyWeights
+) const {
+    getModel()->writeFlatEllipses(nonlinear.begin(), _fixed.begin(), _impl->ellipses.data());
+    getModel()->writeFlatEllipses(previousNonlinear.begin(), _fixed.begin(), _impl->previousEllipses.data());
+    std::vector<bool> changed(_impl->ellipses.size());
+    for (std::size_t j = 0; j < _impl->ellipses.size(); ++j) {
+        changed[j] = (_impl->ellipses[j] != _impl->previousEllipses[j]);
     }
+    _impl->transformEllipses(changed);
+    _impl->fill(modelMatrix, changed, doApplyWeights ? _weights : ndarray::Array<Pixel,1,1>());
+}
+
+void UnitTransformedLikelihood::computeModelImage(
+    ndarray::Array<Pixel,1,1> const & modelImage,
+    ndarray::Array<Scalar const,1,1> const & nonlinear,
+    ndarray::Array<Scalar const,1,1> const & amplitudes,
+    bool doApplyWeights
+) const {
+    getModel()->writeFlatEllipses(nonlinear.begin(), _fixed.begin(), _impl->ellipses.data());
+    _impl->transformEllipses(std::vector<bool>(_impl->ellipses.size(), true));
+    _impl->fillImage(modelImage, amplitudes);
     if (doApplyWeights) {
-        ndarray::asEigenArray(modelMatrix).colwise() *= ndarray::asEigenArray(_weights);
+        ndarray::asEigenArray(modelImage) *= ndarray::asEigenArray(_weights);
     }
 }
 
@@ -20,6 +20,7 @@
  * the GNU General Public License along with this program.  If not,
  * see <http://www.lsstcorp.org/LegalNotices/>.
  */
+#include <algorithm>
 #include <cmath>
 
 #include "Eigen/Eigenvalues"
@@ -33,6 +34,7 @@
 #include "lsst/afw/table/BaseRecord.h"
 #include "lsst/meas/modelfit/optimizer.h"
 #include "lsst/meas/modelfit/Likelihood.h"
+#include "lsst/meas/modelfit/ModelMatrix.h"
 #include "lsst/meas/modelfit/Prior.h"
 
 namespace lsst { namespace meas { namespace modelfit {
@@ -45,11 +47,10 @@ void OptimizerObjective::fillObjectiveValueGrid(
 ) const {
     ndarray::Array<Scalar,1,1> residuals = ndarray::allocate(dataSize);
     for (int i = 0, n = output.getSize<0>(); i < n; ++i) {
-        computeResiduals(grid[i], residuals);
+        computeResidualsOnly(grid[i], residuals);
         output[i] = 0.5*ndarray::asEigenMatrix(residuals).squaredNorm();
         if (hasPrior()) {
-            Scalar prior = computePrior(grid[i]);
-            output[i] -= std::log(prior);
+            output[i] += computeNegLogPrior(grid[i]);
             if (std::isnan(output[i])) {
                 output[i] = std::numeric_limits<Scalar>::infinity();
             }
@@ -57,6 +58,40 @@ void OptimizerObjective::fillObjectiveValueGrid(
     }
 }
 
+Scalar OptimizerObjective::computeNegLogPrior(ndarray::Array<Scalar const,1,1> const & parameters) const {
+    return -std::log(computePrior(parameters));
+}
+
+void OptimizerObjective::differentiateNegLogPrior(
+    ndarray::Array<Scalar const,1,1> const & parameters,
+    ndarray::Array<Scalar,1,1> const & gradient,
+    ndarray::Array<Scalar,2,1> const & hessian
+) const {
+    Scalar const prior = computePrior(parameters);
+    gradient.deep() = 0.0;
+    hessian.deep() = 0.0;
+    differentiatePrior(parameters, gradient, hessian);
+    // d(-ln P) = -dP/P, d^2(-ln P) = -d^2P/P + (dP/P)(dP/P)^T
+    ndarray::asEigenMatrix(gradient) /= -prior;
+    ndarray::asEigenMatrix(hessian) /= -prior;
+    ndarray::asEigenMatrix(hessian).selfadjointView<Eigen::Lower>().rankUpdate(
+        ndarray::asEigenMatrix(gradient), 1.0
+    );
+}
+
+void OptimizerObjective::computeBlockResiduals(
+    ndarray::Array<Scalar const,1,1> const & parameters,
+    int block,
+    ndarray::Array<Scalar,1,1> const & residuals
+) const {
+    std::vector<int> const rows = getResidualBlocks().at(block).rows;
+    ndarray::Array<Scalar,1,1> all = ndarray::allocate(dataSize);
+    computeResiduals(parameters, all);
+    for (std::size_t i = 0; i < rows.size(); ++i) {
+        residuals[i] = all[rows[i]];
+    }
+}
+
 namespace {
 
 class LikelihoodOptimizerObjective : public OptimizerObjective {
@@ -67,7 +102,10 @@ public:
             likelihood->getDataDim(), likelihood->getNonlinearDim() + likelihood->getAmplitudeDim()
         ),
         _likelihood(likelihood), _prior(prior),
-        _modelMatrix(ndarray::allocate(likelihood->getDataDim(), likelihood->getAmplitudeDim()))
+        _modelMatrix(ModelMatrix(likelihood->getDataDim(), likelihood->getAmplitudeDim()).getArray()),
+        _modelMatrixNonlinear(ndarray::allocate(likelihood->getNonlinearDim())),
+        _modelMatrixValid(false),
+        _modelImage(ndarray::allocate(likelihood->getDataDim()))
     {}
 
     void computeResiduals(
@@ -76,13 +114,36 @@ public:
     ) const override {
         int nlDim = _likelihood->getNonlinearDim();
         int ampDim = _likelihood->getAmplitudeDim();
-        _likelihood->computeModelMatrix(_modelMatrix, parameters[ndarray::view(0, nlDim)]);
-        ndarray::asEigenMatrix(residuals) = ndarray::asEigenMatrix(_modelMatrix).cast<Scalar>()
-            * ndarray::asEigenMatrix(parameters[ndarray::view(nlDim, nlDim+ampDim)]);
+        // The optimizer's numerical derivatives perturb one nonlinear parameter at a time, which
+        // changes only one ellipse, so we update the last model matrix instead of recomputing it.
+        if (_modelMatrixValid) {
+            _likelihood->updateModelMatrix(_modelMatrix, parameters[ndarray::view(0, nlDim)],
+                                           _modelMatrixNonlinear);
+        } else {
+            _likelihood->computeModelMatrix(_modelMatrix, parameters[ndarray::view(0, nlDim)]);
+            _modelMatrixValid = true;
+        }
+        _modelMatrixNonlinear.deep() = parameters[ndarray::view(0, nlDim)];
+        multiplyModelMatrix(_modelMatrix, parameters[ndarray::view(nlDim, nlDim+ampDim)], residuals);
         auto likelihoodData = _likelihood->getData();
         ndarray::asEigenMatrix(residuals) -= ndarray::asEigenMatrix(likelihoodData).cast<Scalar>();
     }
 
+    bool computeResidualsOnly(
+        ndarray::Array<Scalar const,1,1> const & parameters,
+        ndarray::Array<Scalar,1,1> const & residuals
+    ) const override {
+        int nlDim = _likelihood->getNonlinearDim();
+        int ampDim = _likelihood->getAmplitudeDim();
+        // We don't need the model matrix here, so we let the likelihood sum the model image directly.
+        _likelihood->computeModelImage(_modelImage, parameters[ndarray::view(0, nlDim)],
+                                       parameters[ndarray::view(nlDim, nlDim+ampDim)]);
+        auto likelihoodData = _likelihood->getData();
+        ndarray::asEigenMatrix(residuals) = ndarray::asEigenMatrix(_modelImage).cast<Scalar>()
+            - ndarray::asEigenMatrix(likelihoodData).cast<Scalar>();
+        return true;
+    }
+
     bool hasPrior() const override { return static_cast<bool>(_prior); }
 
     Scalar computePrior(ndarray::Array<Scalar const,1,1> const & parameters) const override {
@@ -115,6 +176,9 @@ private:
     PTR(Likelihood) _likelihood;
     PTR(Prior) _prior;
     ndarray::Array<Pixel,2,-1> _modelMatrix;
+    ndarray::Array<Scalar,1,1> _modelMatrixNonlinear;  // nonlinear parameters _modelMatrix was computed at
+    mutable bool _modelMatrixValid;
+    ndarray::Array<Pixel,1,1> _modelImage;
 };
 
 } // anonymous
@@ -131,7 +195,8 @@ PTR(OptimizerObjective) OptimizerObjective::makeFromLikelihood(
 Optimizer::IterationData::IterationData(int dataSize, int parameterSize) :
     objectiveValue(0.0), priorValue(0.0),
     parameters(ndarray::allocate(parameterSize)),
-    residuals(ndarray::allocate(dataSize))
+    residuals(ndarray::allocate(dataSize)),
+    residualsOnly(false)
 {}
 
 void Optimizer::IterationData::swap(IterationData & other) {
@@ -139,6 +204,7 @@ void Optimizer::IterationData::swap(IterationData & other) {
     std::swap(priorValue, other.priorValue);
     parameters.swap(other.parameters);
     residuals.swap(other.residuals);
+    std::swap(residualsOnly, other.residualsOnly);
 }
 
 // ----------------- OptimizerHistoryRecorder ---------------------------------------------------------------
@@ -329,7 +395,9 @@ Optimizer::Optimizer(
     Control const & ctrl
 ) :
     _state(0x0),
+    _deadline(std::chrono::steady_clock::time_point::max()),
     _objective(objective),
+    _blocks(objective->getResidualBlocks()),
     _ctrl(ctrl),
     _trustRadius(ctrl.trustRegionInitialSize),
     _current(objective->dataSize, objective->parameterSize),
@@ -337,7 +405,9 @@ Optimizer::Optimizer(
     _step(ndarray::allocate(objective->parameterSize)),
     _gradient(ndarray::allocate(objective->parameterSize)),
     _hessian(ndarray::allocate(objective->parameterSize, objective->parameterSize)),
-    _residualDerivative(ndarray::allocate(objective->dataSize, objective->parameterSize)),
+    _residualDerivative(
+        ndarray::allocate(_blocks.empty() ? objective->dataSize : 0, objective->parameterSize)
+    ),
     _sr1b(objective->parameterSize, objective->parameterSize),
     _sr1v(objective->parameterSize),
     _sr1jtr(objective->parameterSize)
@@ -355,41 +425,172 @@ Optimizer::Optimizer(
     _objective->computeResiduals(_current.parameters, _current.residuals);
     _current.objectiveValue = 0.5*ndarray::asEigenMatrix(_current.residuals).squaredNorm();
     if (_objective->hasPrior()) {
-        _current.priorValue = _objective->computePrior(_current.parameters);
-        _current.objectiveValue -= std::log(_current.priorValue);
+        Scalar const negLogPrior = _objective->computeNegLogPrior(_current.parameters);
+        _current.priorValue = std::exp(-negLogPrior);
+        _current.objectiveValue += negLogPrior;
     }
     LOGL_DEBUG(trace3Logger, "Initial objective value is %g", _current.objectiveValue);
     _sr1b.setZero();
+    _setupBlocks();
     _computeDerivatives();
     ndarray::asEigenMatrix(_hessian) = ndarray::asEigenMatrix(_hessian).selfadjointView<Eigen::Lower>();
 }
 
-void Optimizer::_computeDerivatives() {
-    auto resDer = ndarray::asEigenMatrix(_residualDerivative);
-    resDer.setZero();
+void Optimizer::_setupBlocks() {
+    if (_blocks.empty()) return;
+    std::vector<bool> covered(_objective->parameterSize, false);
+    for (auto const & block : _blocks) {
+        if (block.parameterBegin < 0 || block.parameterEnd > _objective->parameterSize
+            || block.parameterBegin >= block.parameterEnd) {
+            throw LSST_EXCEPT(
+                pex::exceptions::InvalidParameterError,
+                (boost::format("Invalid residual block parameter range [%d, %d)")
+                 % block.parameterBegin % block.parameterEnd).str()
+            );
+        }
+        for (int n = block.parameterBegin; n < block.parameterEnd; ++n) {
+            if (covered[n]) {
+                throw LSST_EXCEPT(
+                    pex::exceptions::InvalidParameterError,
+                    (boost::format("Parameter %d is in more than one residual block") % n).str()
+                );
+            }
+            covered[n] = true;
+        }
+        if (!std::is_sorted(block.rows.begin(), block.rows.end())) {
+            throw LSST_EXCEPT(
+                pex::exceptions::InvalidParameterError,
+                "Residual block rows must be sorted"
+            );
+        }
+        _blockDerivatives.push_back(
+            Matrix::Zero(block.rows.size(), block.parameterEnd - block.parameterBegin)
+        );
+    }
+    if (std::find(covered.begin(), covered.end(), false) != covered.end()) {
+        throw LSST_EXCEPT(
+            pex::exceptions::InvalidParameterError,
+            "Residual blocks do not include all parameters"
+        );
+    }
+    for (std::size_t a = 0; a < _blocks.size(); ++a) {
+        for (std::size_t b = a + 1; b < _blocks.size(); ++b) {
+            BlockOverlap overlap;
+            if (_blocks[a].parameterBegin > _blocks[b].parameterBegin) {
+                overlap.lower = a;
+                overlap.upper = b;
+            } else {
+                overlap.lower = b;
+                overlap.upper = a;
+            }
+            std::vector<int> const & lowerRows = _blocks[overlap.lower].rows;
+            std::vector<int> const & upperRows = _blocks[overlap.upper].rows;
+            for (std::size_t i = 0, j = 0; i < lowerRows.size() && j < upperRows.size();) {
+                if (lowerRows[i] < upperRows[j]) {
+                    ++i;
+                } else if (upperRows[j] < lowerRows[i]) {
+                    ++j;
+                } else {
+                    overlap.lowerRows.push_back(i++);
+                    overlap.upperRows.push_back(j++);
+                }
+            }
+            if (!overlap.lowerRows.empty()) {
+                _blockOverlaps.push_back(std::move(overlap));
+            }
+        }
+    }
+}
+
+void Optimizer::_computeBlockDerivatives() {
     _next.parameters.deep() = _current.parameters;
-    if (!_objective->differentiateResiduals(_current.parameters, _residualDerivative)) {
-        for (int n = 0; n < _objective->parameterSize; ++n) {
+    for (std::size_t b = 0; b < _blocks.size(); ++b) {
+        int const nRows = _blocks[b].rows.size();
+        ndarray::Array<Scalar,1,1> base = ndarray::allocate(nRows);
+        ndarray::Array<Scalar,1,1> perturbed = ndarray::allocate(nRows);
+        _objective->computeBlockResiduals(_current.parameters, b, base);
+        for (int n = _blocks[b].parameterBegin; n < _blocks[b].parameterEnd; ++n) {
             double numDiffStep = _ctrl.numDiffRelStep * _next.parameters[n]
                 + _ctrl.numDiffTrustRadiusStep * _trustRadius
                 + _ctrl.numDiffAbsStep;
             _next.parameters[n] += numDiffStep;
-            _objective->computeResiduals(_next.parameters, _next.residuals);
-            resDer.col(n) =
-                    (ndarray::asEigenMatrix(_next.residuals) - ndarray::asEigenMatrix(_current.residuals)) /
-                    numDiffStep;
+            _objective->computeBlockResiduals(_next.parameters, b, perturbed);
+            _blockDerivatives[b].col(n - _blocks[b].parameterBegin) =
+                (ndarray::asEigenMatrix(perturbed) - ndarray::asEigenMatrix(base)) / numDiffStep;
             _next.parameters[n] = _current.parameters[n];
         }
     }
+}
+
+void Optimizer::_computeDerivatives() {
+    auto resDer = ndarray::asEigenMatrix(_residualDerivative);
+    if (!_blocks.empty()) {
+        _computeBlockDerivatives();
+    } else {
+        resDer.setZero();
+        _next.parameters.deep() = _current.parameters;
+        if (!_objective->differentiateResiduals(_current.parameters, _residualDerivative)) {
+            // Residuals from computeResidualsOnly may not be consistent enough with those from
+            // computeResiduals to difference them, so recompute them here if necessary.
+            ndarray::Array<Scalar const,1,1> base = _current.residuals;
+            if (_current.residualsOnly) {
+                ndarray::Array<Scalar,1,1> recomputed = ndarray::allocate(_objective->dataSize);
+                _objective->computeResiduals(_current.parameters, recomputed);
+                base = recomputed;
+            }
+            for (int n = 0; n < _objective->parameterSize; ++n) {
+                double numDiffStep = _ctrl.numDiffRelStep * _next.parameters[n]
+                    + _ctrl.numDiffTrustRadiusStep * _trustRadius
+                    + _ctrl.numDiffAbsStep;
+                _next.parameters[n] += numDiffStep;
+                _objective->computeResiduals(_next.parameters, _next.residuals);
+                resDer.col(n) = (
+                    ndarray::asEigenMatrix(_next.residuals) - ndarray::asEigenMatrix(base)
+                ) / numDiffStep;
+                _next.parameters[n] = _current.parameters[n];
+            }
+        }
+    }
     _gradient.deep() = 0.0;
     _hessian.deep() = 0.0;
     if (_objective->hasPrior()) {
-        _objective->differentiatePrior(_current.parameters, _gradient, _hessian);
-        // objective evaluates P(x); we want -ln P(x) and associated derivatives
-        ndarray::asEigenMatrix(_gradient) /= -_current.priorValue;
-        ndarray::asEigenMatrix(_hessian) /= -_current.priorValue;
-        ndarray::asEigenMatrix(_hessian).selfadjointView<Eigen::Lower>().rankUpdate(
-                ndarray::asEigenMatrix(_gradient), 1.0);
+        _objective->differentiateNegLogPrior(_current.parameters, _gradient, _hessian);
+    }
+    if (!_blocks.empty()) {
+        // Accumulate J^T r and J^T J block by block; off-diagonal Hessian blocks only get contributions
+        // from the rows shared by the two blocks, and we only fill the lower triangle.
+        Vector jtr = Vector::Zero(_objective->parameterSize);
+        auto hessian = ndarray::asEigenMatrix(_hessian);
+        for (std::size_t b = 0; b < _blocks.size(); ++b) {
+            std::vector<int> const & rows = _blocks[b].rows;
+            Vector residuals(rows.size());
+            for (std::size_t i = 0; i < rows.size(); ++i) {
+                residuals[i] = _current.residuals[rows[i]];
+            }
+            int const begin = _blocks[b].parameterBegin;
+            int const size = _blocks[b].parameterEnd - begin;
+            jtr.segment(begin, size) = _blockDerivatives[b].adjoint() * residuals;
+            hessian.block(begin, begin, size, size) += _blockDerivatives[b].adjoint() * _blockDerivatives[b];
+        }
+        for (auto const & overlap : _blockOverlaps) {
+            Matrix const & lowerDer = _blockDerivatives[overlap.lower];
+            Matrix const & upperDer = _blockDerivatives[overlap.upper];
+            Matrix lowerShared(overlap.lowerRows.size(), lowerDer.cols());
+            Matrix upperShared(overlap.upperRows.size(), upperDer.cols());
+            for (std::size_t i = 0; i < overlap.lowerRows.size(); ++i) {
+                lowerShared.row(i) = lowerDer.row(overlap.lowerRows[i]);
+                upperShared.row(i) = upperDer.row(overlap.upperRows[i]);
+            }
+            hessian.block(
+                _blocks[overlap.lower].parameterBegin, _blocks[overlap.upper].parameterBegin,
+                lowerShared.cols(), upperShared.cols()
+            ) += lowerShared.adjoint() * upperShared;
+        }
+        if (!_ctrl.noSR1Term) {
+            _sr1jtr = jtr;
+        }
+        ndarray::asEigenMatrix(_gradient) += jtr;
+        return;
     }
     if (!_ctrl.noSR1Term) {
         _sr1jtr = resDer.adjoint() * ndarray::asEigenMatrix(_current.residuals);
@@ -421,6 +622,11 @@ bool Optimizer::_stepImpl(
     for (int innerIterCount = 0; innerIterCount < _ctrl.maxInnerIterations; ++innerIterCount) {
         LOGL_DEBUG(trace5Logger, "Starting inner iteration %d", innerIterCount);
         _state &= ~int(STATUS);
+        if (_ctrl.maxTime > 0.0 && std::chrono::steady_clock::now() >= _deadline) {
+            LOGL_DEBUG(trace3Logger, "Maximum time of %g seconds exceeded", _ctrl.maxTime);
+            _state |= FAILED_MAX_TIME;
+            return false;
+        }
         _next.objectiveValue = 0.0;
         _next.priorValue = 1.0;
         solveTrustRegion(
@@ -436,9 +642,10 @@ bool Optimizer::_stepImpl(
         }
         LOGL_DEBUG(trace5Logger, "Step has length %g", stepLength);
         if (_objective->hasPrior()) {
-            _next.priorValue = _objective->computePrior(_next.parameters);
-            _next.objectiveValue = -std::log(_next.priorValue);
-            if (_next.priorValue <= 0.0 || std::isnan(_next.objectiveValue)) {
+            _next.objectiveValue = _objective->computeNegLogPrior(_next.parameters);
+            _next.priorValue = std::exp(-_next.objectiveValue);
+            if (std::isnan(_next.objectiveValue)
+                || _next.objectiveValue == std::numeric_limits<Scalar>::infinity()) {
                 _next.objectiveValue = std::numeric_limits<Scalar>::infinity();
                 LOGL_DEBUG(trace5Logger, "Rejecting step due to zero prior");
                 if (stepLength < _trustRadius) {
@@ -462,7 +669,9 @@ bool Optimizer::_stepImpl(
                 continue;
             }
         }
-        _objective->computeResiduals(_next.parameters, _next.residuals);
+        // Trial-step residuals are never used as the base for numerical derivatives (see
+        // _computeDerivatives), so we can use the cheaper residuals-only path.
+        _next.residualsOnly = _objective->computeResidualsOnly(_next.parameters, _next.residuals);
         _next.objectiveValue += 0.5*ndarray::asEigenMatrix(_next.residuals).squaredNorm();
         double actualChange = _next.objectiveValue - _current.objectiveValue;
         double predictedChange = ndarray::asEigenMatrix(_step).dot(ndarray::asEigenMatrix(_gradient) +
@@ -543,6 +752,12 @@ int Optimizer::_runImpl(HistoryRecorder const * recorder, afw::table::BaseCatalo
     LOG_LOGGER trace5Logger = LOG_GET("TRACE5.meas.modelfit.optimizer.Optimizer");
     LOG_LOGGER trace3Logger = LOG_GET("TRACE3.meas.modelfit.optimizer.Optimizer");
     if (recorder) recorder->apply(-1, -1, *history, *this);
+    if (_ctrl.maxTime > 0.0) {
+        _deadline = std::chrono::steady_clock::now()
+            + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(_ctrl.maxTime)
+            );
+    }
     int outerIterCount = 0;
     try {
         for (; outerIterCount < _ctrl.maxOuterIterations; ++outerIterCount) {
@@ -0,0 +1,340 @@
+// -*- lsst-c++ -*-
+/*
+ * LSST Data Management System
+ * Copyright 2008-2017 LSST/AURA.
+ *
+ * This product includes software developed by the
+ * LSST Project (http://www.lsst.org/).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the LSST License Statement and
+ * the GNU General Public License along with this program.  If not,
+ * see <http://www.lsstcorp.org/LegalNotices/>.
+ */
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "lsst/pex/exceptions.h"
+#include "lsst/meas/modelfit/vectorMath.h"
+
+// The kernels below are written once in terms of GCC/Clang vector extensions, templated on the number
+// of doubles in a vector, and instantiated in functions compiled for each instruction set.  Everything
+// between those functions and the arithmetic is forced inline, so it is compiled for the instruction
+// set of the function it is inlined into.
+#define VECTOR_MATH_INLINE inline __attribute__((always_inline))
+
+namespace lsst { namespace meas { namespace modelfit { namespace detail {
+
+namespace {
+
+template <int N>
+struct Pack {
+    typedef double Double __attribute__((vector_size(8*N)));
+    typedef std::int64_t Int __attribute__((vector_size(8*N)));
+};
+
+// Vectors are passed by reference so the functions below have no vector ABI of their own.
+
+// Set x to value where mask is set (all bits one), leaving it unchanged where it is not (all bits zero).
+template <typename D, typename M>
+VECTOR_MATH_INLINE void blend(D & x, M const & mask, D const & value) {
+    typedef decltype(mask & mask) I;
+    x = (D)(((I)value & mask) | ((I)x & ~mask));
+}
+
+// Cody-Waite argument reduction: exp(x) = 2^k exp(r), with k = round(x/ln2) and |r| <= ln2/2.  The
+// high part of ln2 has enough trailing zeros that k*LN2_HI is exact, and rounding to an integer is done
+// by adding and subtracting 1.5*2^52, which leaves k in the low bits of the intermediate sum.
+double const EXP_MIN = -708.0;
+double const EXP_MAX = 709.78;
+double const LOG2E = 1.44269504088896338700e+00;
+double const LN2_HI = 6.93147180369123816490e-01;
+double const LN2_LO = 1.90821492927058770002e-10;
+double const ROUNDING_SHIFT = 6755399441055744.0;
+
+template <int N>
+VECTOR_MATH_INLINE void expPack(typename Pack<N>::Double & x) {
+    typedef typename Pack<N>::Double D;
+    typedef typename Pack<N>::Int I;
+    D const zero = D{} + 0.0;
+    D const shift = zero + ROUNDING_SHIFT;
+    D xc = x;
+    blend(xc, x < EXP_MIN, zero + EXP_MIN);
+    blend(xc, x > EXP_MAX, zero + EXP_MAX);
+    D t = xc*LOG2E + shift;
+    D k = t - shift;
+    D r = (xc - k*LN2_HI) - k*LN2_LO;
+    // Taylor series of exp(r) through r^13; the truncation error is below 5E-18 for |r| <= ln2/2.
+    D p = zero + 1.0/6227020800.0;
+    p = p*r + 1.0/479001600.0;
+    p = p*r + 1.0/39916800.0;
+    p = p*r + 1.0/3628800.0;
+    p = p*r + 1.0/362880.0;
+    p = p*r + 1.0/40320.0;
+    p = p*r + 1.0/5040.0;
+    p = p*r + 1.0/720.0;
+    p = p*r + 1.0/120.0;
+    p = p*r + 1.0/24.0;
+    p = p*r + 1.0/6.0;
+    p = p*r + 0.5;
+    p = p*r + 1.0;
+    p = p*r + 1.0;
+    // Scale by 2^(k-1) and then by 2, so k up to 1024 does not overflow the exponent field.
+    I n = (I)t - (I)shift;
+    D scale = (D)((n + 1022) << 52);
+    D result = p*scale*2.0;
+    blend(result, x < EXP_MIN, zero);
+    blend(result, x > EXP_MAX, zero + HUGE_VAL);
+    x = result;
+}
+
+// Numerical Recipes' erfcc: erfc(z) = t exp(-z^2 + P(t)) with t = 1/(1 + z/2) for z >= 0, and
+// erfc(-z) = 2 - erfc(z).
+template <int N>
+VECTOR_MATH_INLINE void erfcPack(typename Pack<N>::Double & x) {
+    typedef typename Pack<N>::Double D;
+    typedef typename Pack<N>::Int I;
+    D const zero = D{} + 0.0;
+    D z = (D)((I)x & (I{} + 0x7fffffffffffffff));
+    D t = 1.0/(1.0 + 0.5*z);
+    D p = zero + 0.17087277;
+    p = p*t - 0.82215223;
+    p = p*t + 1.48851587;
+    p = p*t - 1.13520398;
+    p = p*t + 0.27886807;
+    p = p*t - 0.18628806;
+    p = p*t + 0.09678418;
+    p = p*t + 0.37409196;
+    p = p*t + 1.00002368;
+    p = p*t - 1.26551223;
+    p -= z*z;
+    expPack<N>(p);
+    D result = t*p;
+    blend(result, x < 0.0, 2.0 - result);
+    x = result;
+}
+
+template <int N>
+struct ExpOp {
+    VECTOR_MATH_INLINE void operator()(typename Pack<N>::Double & x) const {
+        expPack<N>(x);
+    }
+};
+
+template <int N>
+struct ErfcOp {
+    VECTOR_MATH_INLINE void operator()(typename Pack<N>::Double & x) const {
+        erfcPack<N>(x);
+    }
+};
+
+template <int N>
+struct PolynomialOp {
+    VECTOR_MATH_INLINE void operator()(typename Pack<N>::Double & x) const {
+        typename Pack<N>::Double p = (typename Pack<N>::Double{}) + 0.0;
+        for (int k = nCoefficients - 1; k >= 0; --k) {
+            p = p*x + coefficients[k];
+        }
+        x = p;
+    }
+
+    Scalar const * coefficients;
+    int nCoefficients;
+};
+
+// Apply an op to full vectors, then to a zero-padded copy of any remainder.
+template <int N, typename Op>
+VECTOR_MATH_INLINE void apply(Op const & op, Scalar const * x, Scalar * out, std::size_t n) {
+    typedef typename Pack<N>::Double D;
+    std::size_t i = 0;
+    for (; i + N <= n; i += N) {
+        D v;
+        std::memcpy(&v, x + i, sizeof(D));
+        op(v);
+        std::memcpy(out + i, &v, sizeof(D));
+    }
+    if (i < n) {
+        D v = D{} + 0.0;
+        std::memcpy(&v, x + i, (n - i)*sizeof(Scalar));
+        op(v);
+        std::memcpy(out + i, &v, (n - i)*sizeof(Scalar));
+    }
+}
+
+typedef void (*UnaryFunction)(Scalar const *, Scalar *, std::size_t);
+typedef void (*PolynomialFunction)(Scalar const *, int, Scalar const *, Scalar *, std::size_t);
+
+struct Backend {
+    char const * name;
+    bool (*isSupported)();
+    UnaryFunction exp;
+    UnaryFunction erfc;
+    PolynomialFunction polynomial;
+};
+
+bool alwaysSupported() { return true; }
+
+void expScalar(Scalar const * x, Scalar * out, std::size_t n) {
+    apply<1>(ExpOp<1>(), x, out, n);
+}
+
+void erfcScalar(Scalar const * x, Scalar * out, std::size_t n) {
+    apply<1>(ErfcOp<1>(), x, out, n);
+}
+
+void polynomialScalar(Scalar const * c, int m, Scalar const * x, Scalar * out, std::size_t n) {
+    apply<1>(PolynomialOp<1>{c, m}, x, out, n);
+}
+
+void expLibm(Scalar const * x, Scalar * out, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) {
+        out[i] = std::exp(x[i]);
+    }
+}
+
+void erfcLibm(Scalar const * x, Scalar * out, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) {
+        out[i] = std::erfc(x[i]);
+    }
+}
+
+#if defined(__x86_64__)
+
+bool isAvx512Supported() { return __builtin_cpu_supports("avx512f"); }
+
+bool isAvx2Supported() { return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"); }
+
+__attribute__((target("avx512f")))
+void expAvx512(Scalar const * x, Scalar * out, std::size_t n) {
+    apply<8>(ExpOp<8>(), x, out, n);
+}
+
+__attribute__((target("avx512f")))
+void erfcAvx512(Scalar const * x, Scalar * out, std::size_t n) {
+    apply<8>(ErfcOp<8>(), x, out, n);
+}
+
+__attribute__((target("avx512f")))
+void polynomialAvx512(Scalar const * c, int m, Scalar const * x, Scalar * out, std::size_t n) {
+    apply<8>(PolynomialOp<8>{c, m}, x, out, n);
+}
+
+__attribute__((target("avx2,fma")))
+void expAvx2(Scalar const * x, Scalar * out, std::size_t n) {
+    apply<4>(ExpOp<4>(), x, out, n);
+}
+
+__attribute__((target("avx2,fma")))
+void erfcAvx2(Scalar const * x, Scalar * out, std::size_t n) {
+    apply<4>(ErfcOp<4>(), x, out, n);
+}
+
+__attribute__((target("avx2,fma")))
+void polynomialAvx2(Scalar const * c, int m, Scalar const * x, Scalar * out, std::size_t n) {
+    apply<4>(PolynomialOp<4>{c, m}, x, out, n);
+}
+
+#elif defined(__aarch64__)
+
+// NEON is part of the aarch64 baseline, so 128-bit vectors need no target attribute.
+
+void expNeon(Scalar const * x, Scalar * out, std::size_t n) {
+    apply<2>(ExpOp<2>(), x, out, n);
+}
+
+void erfcNeon(Scalar const * x, Scalar * out, std::size_t n) {
+    apply<2>(ErfcOp<2>(), x, out, n);
+}
+
+void polynomialNeon(Scalar const * c, int m, Scalar const * x, Scalar * out, std::size_t n) {
+    apply<2>(PolynomialOp<2>{c, m}, x, out, n);
+}
+
+#endif
+
+// Ordered from best to worst; the first supported backend is the default.  Without vector instructions
+// the standard library is faster than the portable implementation of our kernels, so it comes first.
+Backend const BACKENDS[] = {
+#if defined(__x86_64__)
+    {"avx512", &isAvx512Supported, &expAvx512, &erfcAvx512, &polynomialAvx512},
+    {"avx2", &isAvx2Supported, &expAvx2, &erfcAvx2, &polynomialAvx2},
+#elif defined(__aarch64__)
+    {"neon", &alwaysSupported, &expNeon, &erfcNeon, &polynomialNeon},
+#endif
+    {"libm", &alwaysSupported, &expLibm, &erfcLibm, &polynomialScalar},
+    {"scalar", &alwaysSupported, &expScalar, &erfcScalar, &polynomialScalar},
+};
+
+std::atomic<Backend const *> currentBackend(nullptr);
+
+Backend const & getBackend() {
+    Backend const * backend = currentBackend.load(std::memory_order_relaxed);
+    if (!backend) {
+        for (Backend const & candidate : BACKENDS) {
+            if (candidate.isSupported()) {
+                backend = &candidate;
+                break;
+            }
+        }
+        currentBackend.store(backend, std::memory_order_relaxed);
+    }
+    return *backend;
+}
+
+} // anonymous
+
+void vectorExp(Scalar const * x, Scalar * out, std::size_t n) {
+    getBackend().exp(x, out, n);
+}
+
+void vectorErfc(Scalar const * x, Scalar * out, std::size_t n) {
+    getBackend().erfc(x, out, n);
+}
+
+void vectorPolynomial(
+    Scalar const * coefficients, int nCoefficients,
+    Scalar const * x, Scalar * out, std::size_t n
+) {
+    getBackend().polynomial(coefficients, nCoefficients, x, out, n);
+}
+
+std::string getVectorMathBackend() {
+    return getBackend().name;
+}
+
+std::vector<std::string> getVectorMathBackends() {
+    std::vector<std::string> names;
+    for (Backend const & backend : BACKENDS) {
+        if (backend.isSupported()) {
+            names.push_back(backend.name);
+        }
+    }
+    return names;
+}
+
+void setVectorMathBackend(std::string const & name) {
+    for (Backend const & backend : BACKENDS) {
+        if (name == backend.name && backend.isSupported()) {
+            currentBackend.store(&backend, std::memory_order_relaxed);
+            return;
+        }
+    }
+    throw LSST_EXCEPT(
+        pex::exceptions::InvalidParameterError,
+        "Vector math backend '" + name + "' is not available on this machine"
+    );
+}
+
+}}}} // namespace lsst::meas::modelfit::detail
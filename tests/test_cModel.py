@@ -84,12 +84,25 @@ class CModelTestCase(lsst.utils.tests.TestCase):
         subImage = lsst.afw.image.ImageF(self.exposure.getMaskedImage().getImage(), psfBBox,
                                          lsst.afw.image.PARENT)
         subImage.getArray()[:, :] = psfImage.getArray()
+        # Shapelet approximation to the PSF and its moments, as passed to CModelAlgorithm.apply().
+        self.psf = makeMultiShapeletCircularGaussian(self.psfSigma)
+        self.moments = psf.computeShape()
+
+    def addNoise(self, noiseSigma=1.0):
+        """Add Gaussian noise with standard deviation noiseSigma to the image,
+        and set the variance plane to match.
+        """
+        self.exposure.getMaskedImage().getVariance().getArray()[:] = noiseSigma**2
+        self.exposure.getMaskedImage().getImage().getArray()[:] += \
+            noiseSigma*numpy.random.randn(self.exposure.getHeight(), self.exposure.getWidth())
 
     def tearDown(self):
         del self.xyPosition
         del self.exposure
         del self.trueFlux
         del self.psfSigma
+        del self.psf
+        del self.moments
 
     def testNoNoise(self):
         """Test that CModelAlgorithm.apply() works when applied to a postage-stamp
@@ -145,6 +158,413 @@ class CModelTestCase(lsst.utils.tests.TestCase):
             self.assertFloatsAlmostEqual(psfFlux, cmodel.instFlux, rtol=0.1/fluxFactor**0.5)
             self.assertFloatsAlmostEqual(psfFluxErr, cmodel.instFluxErr, rtol=0.1/fluxFactor**0.5)
 
+    def testAdaptiveConvergence(self):
+        """Test that the SNR-adaptive convergence policy loosens the optimizer
+        thresholds for a faint source, and records what it used.
+        """
+        self.addNoise()
+        ctrl = lsst.meas.modelfit.CModelControl()
+        schema = lsst.afw.table.SourceTable.makeMinimalSchema()
+        algorithm = lsst.meas.modelfit.CModelAlgorithm("cmodel", ctrl, schema)
+        self.assertNotIn("cmodel_exp_gradientThreshold", schema.getNames())
+        result = algorithm.apply(self.exposure, self.psf, self.xyPosition, self.moments)
+        self.assertEqual(result.exp.gradientThreshold, ctrl.exp.optimizer.gradientThreshold)
+        self.assertEqual(result.exp.maxOuterIterations, ctrl.exp.optimizer.maxOuterIterations)
+        for stageCtrl in (ctrl.initial, ctrl.exp, ctrl.dev):
+            stageCtrl.doAdaptiveConvergence = True
+            stageCtrl.adaptiveReferenceSnr = 1E6  # guarantees maximum loosening for this source
+        schema = lsst.afw.table.SourceTable.makeMinimalSchema()
+        algorithm = lsst.meas.modelfit.CModelAlgorithm("cmodel", ctrl, schema)
+        self.assertIn("cmodel_exp_gradientThreshold", schema.getNames())
+        result = algorithm.apply(self.exposure, self.psf, self.xyPosition, self.moments)
+        stages = (result.initial, result.exp, result.dev)
+        for stageCtrl, stage in zip((ctrl.initial, ctrl.exp, ctrl.dev), stages):
+            scale = stageCtrl.adaptiveMaxScale
+            self.assertFloatsAlmostEqual(stage.gradientThreshold, scale*stageCtrl.optimizer.gradientThreshold)
+            self.assertFloatsAlmostEqual(stage.minTrustRadiusThreshold,
+                                         scale*stageCtrl.optimizer.minTrustRadiusThreshold)
+            self.assertEqual(stage.maxOuterIterations,
+                             max(min(stageCtrl.adaptiveMinOuterIterations,
+                                     stageCtrl.optimizer.maxOuterIterations),
+                                 int(numpy.ceil(stageCtrl.optimizer.maxOuterIterations/scale))))
+        self.assertFalse(result.flags[result.FAILED])
+
+    def testMaxTime(self):
+        """Test that a per-source time budget that is always exceeded marks the
+        nonlinear stages as failed due to time, while still running all of them
+        and reporting fluxes.
+        """
+        ctrl = lsst.meas.modelfit.CModelControl()
+        ctrl.maxTime = 1E-9
+        schema = lsst.afw.table.SourceTable.makeMinimalSchema()
+        algorithm = lsst.meas.modelfit.CModelAlgorithm("cmodel", ctrl, schema)
+        self.assertIn("cmodel_exp_flag_maxTime", schema.getNames())
+        result = algorithm.apply(self.exposure, self.psf, self.xyPosition, self.moments)
+        for stage in (result.initial, result.exp, result.dev):
+            self.assertTrue(stage.flags[stage.MAX_TIME])
+            self.assertTrue(stage.flags[stage.FAILED])
+            self.assertTrue(numpy.isfinite(stage.instFlux))
+        # The combination is computed from the time-limited stages, but can't be trusted.
+        self.assertTrue(numpy.isfinite(result.instFlux))
+        self.assertTrue(result.flags[result.FAILED])
+        # Without a budget, the same fit should not run out of time.
+        ctrl.maxTime = 0.0
+        algorithm = lsst.meas.modelfit.CModelAlgorithm(ctrl)
+        result = algorithm.apply(self.exposure, self.psf, self.xyPosition, self.moments)
+        for stage in (result.initial, result.exp, result.dev):
+            self.assertFalse(stage.flags[stage.MAX_TIME])
+
+    def testInitializer(self):
+        """Test CModelInitializer persistence, and that CModel can start its
+        fits from a trained initializer.
+        """
+        coefficients = numpy.zeros((lsst.meas.modelfit.CModelInitializer.N_STAGES,
+                                    lsst.meas.modelfit.CModelInitializer.N_FEATURES), dtype=float)
+        coefficients[:, 0] = numpy.log([0.1, 0.08, 0.12])
+        coefficients[:, 1] = 0.5
+        initializer = lsst.meas.modelfit.CModelInitializer(coefficients)
+        moments = self.exposure.getPsf().computeShape()
+        features = initializer.computeFeatures(moments, moments, -1.0, float("nan"))
+        self.assertFloatsAlmostEqual(features, numpy.array([1.0, 0.0, 0.0, 0.0]), atol=1E-12)
+        self.assertFloatsAlmostEqual(initializer.predictRadiusRatio(initializer.EXP, features), 0.08)
+        with lsst.utils.tests.getTempFilePath(".fits") as filename:
+            initializer.writeFits(filename)
+            self.assertFloatsAlmostEqual(
+                lsst.meas.modelfit.CModelInitializer.readFits(filename).getCoefficients(), coefficients
+            )
+            ctrl = lsst.meas.modelfit.CModelControl()
+            ctrl.initializerSource = "FILE"
+            ctrl.initializerName = filename
+            algorithm = lsst.meas.modelfit.CModelAlgorithm(ctrl)
+        self.exposure.getMaskedImage().getVariance().getArray()[:, :] = 1E-16
+        result = algorithm.apply(self.exposure, makeMultiShapeletCircularGaussian(self.psfSigma),
+                                 self.xyPosition, moments)
+        for stage in (result.initial, result.exp, result.dev):
+            self.assertFalse(stage.flags[stage.FAILED])
+            self.assertFloatsAlmostEqual(stage.instFlux, self.trueFlux, rtol=0.01)
+        self.assertFalse(result.flags[result.FAILED])
+        # The signal-to-noise estimate given to the initializer is recorded for training.
+        self.assertGreater(result.snr, 0.0)
+        # Predictions that overflow should fall back to the moments, and those that underflow should
+        # be floored at minInitialRadius.
+        for logRatio in (1E3, -1E3):
+            coefficients[:, 0] = logRatio
+            with lsst.utils.tests.getTempFilePath(".fits") as filename:
+                lsst.meas.modelfit.CModelInitializer(coefficients).writeFits(filename)
+                ctrl.initializerName = filename
+                algorithm = lsst.meas.modelfit.CModelAlgorithm(ctrl)
+            result = algorithm.apply(self.exposure, makeMultiShapeletCircularGaussian(self.psfSigma),
+                                     self.xyPosition, moments)
+            self.assertFalse(result.initial.flags[result.initial.FAILED])
+            self.assertTrue(numpy.isfinite(result.initial.ellipse.getDeterminantRadius()))
+
+    def testCostModel(self):
+        """Test CModelCostModel calibration and persistence, and that the
+        predicted cost grows with the size of the source.
+        """
+        algorithm = lsst.meas.modelfit.CModelAlgorithm(lsst.meas.modelfit.CModelControl())
+        features = []
+        for scale in numpy.linspace(1.0, 5.0, 20):
+            scaled = lsst.afw.geom.ellipses.Quadrupole(self.moments)
+            scaled.scale(scale)
+            features.append(algorithm.computeCostFeatures(self.psf, scaled, snr=10.0*scale))
+        features = numpy.array(features)
+        self.assertTrue((numpy.diff(features[:, 1]) > 0).all())
+        self.assertTrue((features[:, 2] > features[:, 1]).all())
+        costModel = lsst.meas.modelfit.CModelCostModel()
+        costs = [costModel.predictTime(f) for f in features]
+        self.assertTrue((numpy.diff(costs) > 0).all())
+        # Calibrate against synthetic times and iteration counts that follow the model exactly.
+        timeCoefficients = numpy.array([1E-3, 2E-6, 3E-7, 1E-8])
+        iterationCoefficients = numpy.array([20.0, 5.0])
+        iterationFeatures = numpy.array([costModel.computeIterationFeatures(10.0*scale)
+                                         for scale in numpy.linspace(1.0, 5.0, 20)])
+        calibrated = lsst.meas.modelfit.calibrateCModelCostModel(
+            features, iterationFeatures, features.dot(timeCoefficients),
+            iterationFeatures.dot(iterationCoefficients)
+        )
+        self.assertFloatsAlmostEqual(calibrated.getTimeCoefficients(), timeCoefficients, rtol=1E-4)
+        self.assertFloatsAlmostEqual(calibrated.getIterationCoefficients(), iterationCoefficients,
+                                     rtol=1E-8)
+        self.assertFloatsAlmostEqual(calibrated.predictIterations(10.0), 20.0 + 5.0*numpy.log(10.0))
+        with lsst.utils.tests.getTempFilePath(".fits") as filename:
+            calibrated.writeFits(filename)
+            loaded = lsst.meas.modelfit.CModelCostModel.readFits(filename)
+        self.assertFloatsAlmostEqual(loaded.getTimeCoefficients(), calibrated.getTimeCoefficients())
+        self.assertFloatsAlmostEqual(loaded.getIterationCoefficients(),
+                                     calibrated.getIterationCoefficients())
+
+    def testWarmStart(self):
+        """Test that warm-starting from a previous fit converges to the same
+        result in fewer iterations.
+        """
+        self.addNoise()
+        ctrl = lsst.meas.modelfit.CModelControl()
+        algorithm = lsst.meas.modelfit.CModelAlgorithm(ctrl)
+        cold = algorithm.apply(self.exposure, self.psf, self.xyPosition, self.moments)
+        warm = algorithm.applyWarmStart(self.exposure, self.psf, self.xyPosition, self.moments, cold)
+        for stage in ("initial", "exp", "dev"):
+            coldStage = getattr(cold, stage)
+            warmStage = getattr(warm, stage)
+            self.assertFalse(warmStage.flags[warmStage.FAILED])
+            self.assertFloatsAlmostEqual(warmStage.instFlux, coldStage.instFlux, rtol=1E-3)
+            self.assertLessEqual(len(warmStage.history), len(coldStage.history))
+        self.assertFalse(warm.flags[warm.FAILED])
+        self.assertFloatsAlmostEqual(warm.instFlux, cold.instFlux, rtol=1E-3)
+        ctrl.warmStartSkipInitial = True
+        algorithm = lsst.meas.modelfit.CModelAlgorithm(ctrl)
+        skipped = algorithm.applyWarmStart(self.exposure, self.psf, self.xyPosition, self.moments, cold)
+        self.assertFloatsAlmostEqual(skipped.initial.nonlinear, cold.initial.nonlinear, rtol=0.0)
+        self.assertFalse(skipped.flags[skipped.FAILED])
+        self.assertFloatsAlmostEqual(skipped.instFlux, cold.instFlux, rtol=1E-3)
+
+    def testCoarseToFine(self):
+        """Test that a coarse pass on binned pixels before the full-resolution
+        fits doesn't change the results, and that the coarse-only fallback for
+        very large regions still gives sensible fluxes.
+        """
+        self.exposure.getMaskedImage().getVariance().getArray()[:, :] = 1E-4
+        ctrl = lsst.meas.modelfit.CModelControl()
+        expected = lsst.meas.modelfit.CModelAlgorithm(ctrl).apply(self.exposure, self.psf, self.xyPosition,
+                                                                  self.moments)
+        ctrl.coarseBinFactor = 2
+        ctrl.coarseMinArea = 1
+        result = lsst.meas.modelfit.CModelAlgorithm(ctrl).apply(self.exposure, self.psf, self.xyPosition,
+                                                                self.moments)
+        self.assertFalse(result.flags[result.REGION_COARSE_ONLY])
+        self.assertFalse(result.flags[result.FAILED])
+        for stage in ("initial", "exp", "dev"):
+            self.assertFloatsAlmostEqual(getattr(result, stage).instFlux, getattr(expected, stage).instFlux,
+                                         rtol=1E-3)
+        self.assertFloatsAlmostEqual(result.instFlux, expected.instFlux, rtol=1E-3)
+        ctrl.coarseOnlyForMaxArea = True
+        ctrl.region.maxArea = 1
+        result = lsst.meas.modelfit.CModelAlgorithm(ctrl).apply(self.exposure, self.psf, self.xyPosition,
+                                                                self.moments)
+        self.assertTrue(result.flags[result.REGION_COARSE_ONLY])
+        self.assertFloatsAlmostEqual(result.instFlux, self.trueFlux, rtol=0.02)
+
+    def testSubsample(self):
+        """Test that starting the nonlinear fits on subsets of the pixels
+        doesn't change the results, saves full-resolution iterations, and
+        counts the subsampled iterations in nIter.
+        """
+        self.exposure.getMaskedImage().getVariance().getArray()[:, :] = 1E-4
+        ctrl = lsst.meas.modelfit.CModelControl()
+        expected = lsst.meas.modelfit.CModelAlgorithm(ctrl).apply(self.exposure, self.psf, self.xyPosition,
+                                                                  self.moments)
+        ctrl.subsampleFraction = 0.125
+        ctrl.subsampleMinArea = 1
+        result = lsst.meas.modelfit.CModelAlgorithm(ctrl).apply(self.exposure, self.psf, self.xyPosition,
+                                                                self.moments)
+        self.assertFalse(result.flags[result.FAILED])
+        for stage in ("initial", "exp", "dev"):
+            self.assertFloatsAlmostEqual(getattr(result, stage).instFlux, getattr(expected, stage).instFlux,
+                                         rtol=1E-3)
+            self.assertFloatsAlmostEqual(getattr(result, stage).instFluxErr,
+                                         getattr(expected, stage).instFluxErr, rtol=1E-3)
+        self.assertFloatsAlmostEqual(result.instFlux, expected.instFlux, rtol=1E-3)
+        self.assertFloatsAlmostEqual(result.instFluxErr, expected.instFluxErr, rtol=1E-3)
+        # The history only holds the full-resolution fit, while nIter includes the subsampled passes.
+        fullIterations = 0
+        for stage in ("exp", "dev"):
+            self.assertGreater(getattr(result, stage).nIter, len(getattr(result, stage).history))
+            fullIterations += len(getattr(result, stage).history)
+        self.assertLess(fullIterations, expected.exp.nIter + expected.dev.nIter)
+        # Capping the subsampled passes shouldn't change the results either.
+        ctrl.subsampleMaxIterations = 2
+        capped = lsst.meas.modelfit.CModelAlgorithm(ctrl).apply(self.exposure, self.psf, self.xyPosition,
+                                                                self.moments)
+        self.assertFalse(capped.flags[capped.FAILED])
+        self.assertFloatsAlmostEqual(capped.instFlux, expected.instFlux, rtol=1E-3)
+
+    def testGroup(self):
+        """Test that CModelAlgorithm.applyGroup() recovers the true fluxes of
+        two blended point sources.
+        """
+        neighborFlux = 40.0
+        neighborPosition = lsst.geom.Point2D(self.xyPosition.getX() + 12.0, self.xyPosition.getY())
+        psfImage = self.exposure.getPsf().computeImage(neighborPosition)
+        psfImage.getArray()[:, :] *= neighborFlux
+        subImage = lsst.afw.image.ImageF(self.exposure.getMaskedImage().getImage(),
+                                         psfImage.getBBox(lsst.afw.image.PARENT), lsst.afw.image.PARENT)
+        subImage.getArray()[:, :] += psfImage.getArray()
+        self.exposure.getMaskedImage().getVariance().getArray()[:, :] = 1E-4
+        ctrl = lsst.meas.modelfit.CModelControl()
+        algorithm = lsst.meas.modelfit.CModelAlgorithm(ctrl)
+        results = algorithm.applyGroup(self.exposure, [self.psf, self.psf],
+                                       [self.xyPosition, neighborPosition], [self.moments, self.moments])
+        self.assertEqual(len(results), 2)
+        for result, trueFlux in zip(results, (self.trueFlux, neighborFlux)):
+            self.assertTrue(result.flags[result.GROUP_FIT])
+            self.assertFalse(result.flags[result.FAILED])
+            self.assertFloatsAlmostEqual(result.instFlux, trueFlux, rtol=0.02)
+
+    def testWorkspace(self):
+        """Test that reusing a CModelWorkspace gives the same results as not
+        using one, and that a workspace sized for a large fit region does not
+        grow again for smaller ones.
+        """
+        self.addNoise()
+        ctrl = lsst.meas.modelfit.CModelControl()
+        algorithm = lsst.meas.modelfit.CModelAlgorithm(ctrl)
+        largeMoments = lsst.afw.geom.ellipses.Quadrupole(4*self.moments.getIxx(), 4*self.moments.getIyy(),
+                                                         4*self.moments.getIxy())
+        expected = algorithm.apply(self.exposure, self.psf, self.xyPosition, self.moments)
+        large = algorithm.apply(self.exposure, self.psf, self.xyPosition, largeMoments)
+        self.assertGreater(large.initialFitRegion.getDeterminantRadius(),
+                           expected.initialFitRegion.getDeterminantRadius())
+        workspace = lsst.meas.modelfit.CModelWorkspace()
+        self.assertEqual(workspace.getGrowCount(), 0)
+        algorithm.apply(workspace, self.exposure, self.psf, self.xyPosition, largeMoments)
+        growCount = workspace.getGrowCount()
+        self.assertGreater(growCount, 0)
+        # Fits with smaller regions, in either mode, must fit in the buffers the large fit allocated.
+        first = algorithm.apply(workspace, self.exposure, self.psf, self.xyPosition, self.moments)
+        forced = algorithm.applyForced(workspace, self.exposure, self.psf, self.xyPosition, first)
+        second = algorithm.apply(workspace, self.exposure, self.psf, self.xyPosition, self.moments)
+        self.assertEqual(workspace.getGrowCount(), growCount)
+        for result in (first, second):
+            self.assertFloatsEqual(result.instFlux, expected.instFlux)
+            self.assertFloatsEqual(result.instFluxErr, expected.instFluxErr)
+            for stage in ("initial", "exp", "dev"):
+                self.assertFloatsEqual(getattr(result, stage).nonlinear,
+                                       getattr(expected, stage).nonlinear)
+                self.assertFloatsEqual(getattr(result, stage).amplitudes,
+                                       getattr(expected, stage).amplitudes)
+        self.assertFloatsAlmostEqual(forced.instFlux, expected.instFlux, rtol=1E-5)
+
+    def testResultCache(self):
+        """Test that the result cache persists results across algorithm
+        instances, and misses when a pixel in the fit region changes.
+        """
+        self.addNoise()
+        with lsst.utils.tests.getTempFilePath(".cache") as filename:
+            ctrl = lsst.meas.modelfit.CModelControl()
+            ctrl.resultCacheName = filename
+            ctrl.resultCacheCapacity = 16
+            # Fits that record histories bypass the cache, since it can't return them.
+            recording = lsst.meas.modelfit.CModelAlgorithm(ctrl)
+            recorded = recording.apply(self.exposure, self.psf, self.xyPosition, self.moments)
+            self.assertGreater(len(recorded.exp.history), 0)
+            self.assertEqual(recording.getResultCache().getMissCount(), 0)
+            self.assertEqual(recording.getResultCache().getHitCount(), 0)
+            del recording
+            for stage in (ctrl.initial, ctrl.exp, ctrl.dev):
+                stage.doRecordHistory = False
+            first = lsst.meas.modelfit.CModelAlgorithm(ctrl)
+            expected = first.apply(self.exposure, self.psf, self.xyPosition, self.moments)
+            self.assertEqual(first.getResultCache().getMissCount(), 1)
+            del first
+            second = lsst.meas.modelfit.CModelAlgorithm(ctrl)
+            cached = second.apply(self.exposure, self.psf, self.xyPosition, self.moments)
+            self.assertEqual(second.getResultCache().getHitCount(), 1)
+            self.assertEqual(second.getResultCache().getMissCount(), 0)
+            self.assertFloatsEqual(cached.instFlux, expected.instFlux)
+            self.assertFloatsEqual(cached.instFluxErr, expected.instFluxErr)
+            self.assertFloatsEqual(cached.fracDev, expected.fracDev)
+            for stage in ("initial", "exp", "dev"):
+                self.assertFloatsEqual(getattr(cached, stage).nonlinear,
+                                       getattr(expected, stage).nonlinear)
+                self.assertFloatsEqual(getattr(cached, stage).amplitudes,
+                                       getattr(expected, stage).amplitudes)
+                # The iteration count is cached; timings are not reused.
+                self.assertGreater(getattr(expected, stage).nIter, 0)
+                self.assertEqual(getattr(cached, stage).nIter, getattr(expected, stage).nIter)
+                self.assertTrue(numpy.isnan(getattr(cached, stage).time))
+            # The iteration count also reaches the output record on a hit.
+            schema = lsst.afw.table.SourceTable.makeMinimalSchema()
+            plugin = lsst.meas.modelfit.CModelAlgorithm("cmodel", ctrl, schema)
+            record = lsst.afw.table.SourceCatalog(schema).addNew()
+            result = plugin.apply(self.exposure, self.psf, self.xyPosition, self.moments)
+            plugin.writeResultToRecord(result, record)
+            self.assertEqual(record.get("cmodel_exp_nIter"), expected.exp.nIter)
+            self.exposure.getMaskedImage().getImage()[lsst.geom.Point2I(self.xyPosition)] += 1.0
+            second.apply(self.exposure, self.psf, self.xyPosition, self.moments)
+            self.assertEqual(second.getResultCache().getHitCount(), 1)
+            self.assertEqual(second.getResultCache().getMissCount(), 1)
+            self.assertEqual(lsst.meas.modelfit.CModelAlgorithm(lsst.meas.modelfit.CModelControl())
+                             .getResultCache(), None)
+
+    def testMultiEpoch(self):
+        """Test that CModelAlgorithm.applyMultiEpoch() recovers the true flux
+        (in the units of the first exposure) when fitting a point source
+        jointly on two epochs with different calibrations.
+        """
+        ctrl = lsst.meas.modelfit.CModelControl()
+        ctrl.initial.usePixelWeights = False
+        algorithm = lsst.meas.modelfit.CModelAlgorithm(ctrl)
+        self.exposure.getMaskedImage().getVariance().getArray()[:, :] = 1E-16
+        exposure2 = self.exposure.Factory(self.exposure, True)
+        exposure2.getMaskedImage().getImage().getArray()[:, :] *= 2.0
+        exposure2.setPhotoCalib(lsst.afw.image.PhotoCalib(2.0))
+        psf = makeMultiShapeletCircularGaussian(self.psfSigma)
+        position = self.exposure.getWcs().pixelToSky(self.xyPosition)
+        result = algorithm.applyMultiEpoch(
+            [self.exposure, exposure2], [psf, psf], position, self.exposure.getPsf().computeShape()
+        )
+        for stage in (result.initial, result.exp, result.dev):
+            self.assertFalse(stage.flags[result.FAILED])
+            self.assertFloatsAlmostEqual(stage.instFlux, self.trueFlux, rtol=0.01)
+            self.assertLess(stage.ellipse.getDeterminantRadius(), 0.2)
+        self.assertFalse(result.flags[result.FAILED])
+        self.assertFloatsAlmostEqual(result.instFlux, self.trueFlux, rtol=0.01)
+
+    def testForcedMultiBand(self):
+        """Test that CModelAlgorithm.applyForcedMultiBand() gives the same
+        results as running applyForced() on each band separately.
+        """
+        self.addNoise()
+        ctrl = lsst.meas.modelfit.CModelControl()
+        algorithm = lsst.meas.modelfit.CModelAlgorithm(ctrl)
+        reference = algorithm.apply(self.exposure, self.psf, self.xyPosition, self.moments)
+        exposures = []
+        psfs = []
+        for fluxFactor in (1.0, 3.0, 0.5):
+            exposure = self.exposure.Factory(self.exposure, True)
+            exposure.getMaskedImage().getImage().getArray()[:] *= fluxFactor
+            exposures.append(exposure)
+            psfs.append(self.psf)
+        results = algorithm.applyForcedMultiBand(exposures, psfs, self.xyPosition, reference)
+        self.assertEqual(len(results), len(exposures))
+        for exposure, psf, result in zip(exposures, psfs, results):
+            single = algorithm.applyForced(exposure, psf, self.xyPosition, reference)
+            self.assertFalse(result.flags[result.FAILED])
+            for stage in ("initial", "exp", "dev"):
+                self.assertFloatsAlmostEqual(getattr(result, stage).instFlux,
+                                             getattr(single, stage).instFlux, rtol=1E-5)
+                self.assertFloatsAlmostEqual(getattr(result, stage).instFluxErr,
+                                             getattr(single, stage).instFluxErr, rtol=1E-5)
+            self.assertFloatsAlmostEqual(result.instFlux, single.instFlux, rtol=1E-5)
+            self.assertFloatsAlmostEqual(result.instFluxErr, single.instFluxErr, rtol=1E-5)
+            self.assertFloatsAlmostEqual(result.fracDev, single.fracDev, rtol=1E-5, atol=1E-6)
+
+    def testForcedMultiBandBadPixels(self):
+        """Test that applyForcedMultiBand() applies maxBadPixelFraction to
+        the intersection of the bands' fit regions, even when each band's
+        region passes on its own.
+        """
+        ctrl = lsst.meas.modelfit.CModelControl()
+        algorithm = lsst.meas.modelfit.CModelAlgorithm(ctrl)
+        psf = makeMultiShapeletCircularGaussian(self.psfSigma)
+        reference = algorithm.apply(self.exposure, psf, self.xyPosition,
+                                    self.exposure.getPsf().computeShape())
+        # Each band masks a different 1/15 of the pixels, so each loses less than the default
+        # maxBadPixelFraction (0.1) of its region, but together they lose more.
+        y, x = numpy.indices((self.exposure.getHeight(), self.exposure.getWidth()))
+        exposures = []
+        for offset in (0, 7):
+            exposure = self.exposure.Factory(self.exposure, True)
+            mask = exposure.getMaskedImage().getMask()
+            mask.getArray()[(x + y) % 15 == offset] |= mask.getPlaneBitMask("BAD")
+            single = algorithm.applyForced(exposure, psf, self.xyPosition, reference)
+            self.assertFalse(single.flags[single.REGION_MAX_BAD_PIXEL_FRACTION])
+            exposures.append(exposure)
+        results = algorithm.applyForcedMultiBand(exposures, [psf, psf], self.xyPosition, reference)
+        for result in results:
+            self.assertTrue(result.flags[result.REGION_MAX_BAD_PIXEL_FRACTION])
+            self.assertTrue(result.flags[result.FAILED])
+
 
 class TestMemory(lsst.utils.tests.MemoryTestCase):
     pass
@@ -94,10 +94,7 @@ class CModelTestCase(lsst.meas.base.tests.AlgorithmTestCase, lsst.utils.tests.Te
         exposure1, catalog1 = self.dataset.realize(10.0, sfmTask.schema, randomSeed=0)
         sfmTask.run(catalog1, exposure1)
         self.checkOutputs(catalog1)
-        if False:  # this line should be re-enabled on DM-5405
-            wcs2 = self.dataset.makePerturbedWcs(self.dataset.exposure.getWcs(), randomSeed=0)
-        else:
-            wcs2 = self.dataset.exposure.getWcs()
+        wcs2 = self.dataset.makePerturbedWcs(self.dataset.exposure.getWcs(), randomSeed=0)
         dataset2 = self.dataset.transform(wcs2)
         # catalog2 will contain only the truth catalog for sources in exposure 1; the structure of
         # ForcedMeasurementTask means we can't put the outputs in the same catalog.
@@ -109,6 +106,41 @@ class CModelTestCase(lsst.meas.base.tests.AlgorithmTestCase, lsst.utils.tests.Te
         forcedTask.run(measCat, exposure2, refCat, refWcs)
         self.checkOutputs(measCat, catalog2)
 
+    def testWorkspaceReuse(self):
+        """Test that repeated plugin measurements reuse the buffers in the algorithm's workspaces
+        instead of growing new ones for every source."""
+        plugin = "modelfit_CModel"
+        dependencies = ("modelfit_DoubleShapeletPsfApprox", "base_PsfFlux")
+        sfmTask = self.makeSingleFrameMeasurementTask(plugin, dependencies=dependencies)
+        exposure, catalog = self.dataset.realize(10.0, sfmTask.schema, randomSeed=0)
+        sfmTask.run(catalog, exposure)
+        algorithm = sfmTask.plugins[plugin].algorithm
+        growCount = algorithm.getWorkspaceGrowCount()
+        self.assertGreater(growCount, 0)
+        for record in catalog:
+            sfmTask.plugins[plugin].measure(record, exposure)
+            self.assertFalse(record.get("modelfit_CModel_flag"))
+        self.assertEqual(algorithm.getWorkspaceGrowCount(), growCount)
+
+    def testNoRaise(self):
+        """Test that the plugin reports expected failures only via flags when raiseMeasurementErrors
+        is False."""
+        plugin = "modelfit_CModel"
+        dependencies = ("modelfit_DoubleShapeletPsfApprox", "base_PsfFlux")
+        config = self.makeSingleFrameMeasurementConfig(plugin, dependencies=dependencies)
+        config.slots.shape = None
+        config.plugins[plugin].fallbackInitialMomentsPsfFactor = -1.0
+        config.plugins[plugin].raiseMeasurementErrors = False
+        sfmTask = self.makeSingleFrameMeasurementTask(config=config)
+        exposure, catalog = self.dataset.realize(10.0, sfmTask.schema, randomSeed=0)
+        sfmTask.run(catalog, exposure)
+        for record in catalog:
+            # Calling the plugin directly would raise MeasurementError if raiseMeasurementErrors were True.
+            sfmTask.plugins[plugin].measure(record, exposure)
+            self.assertTrue(record.get("modelfit_CModel_flag"))
+            self.assertTrue(record.get("modelfit_CModel_flag_noShape"))
+            self.assertTrue(record.get("modelfit_CModel_exp_flag"))
+
 
 class TestMemory(lsst.utils.tests.MemoryTestCase):
     pass
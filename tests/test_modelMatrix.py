@@ -0,0 +1,126 @@
+#
+# LSST Data Management System
+#
+# Copyright 2008-2016  AURA/LSST.
+#
+# This product includes software developed by the
+# LSST Project (http://www.lsst.org/).
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the LSST License Statement and
+# the GNU General Public License along with this program.  If not,
+# see <https://www.lsstcorp.org/LegalNotices/>.
+#
+
+import unittest
+
+import numpy
+
+import lsst.utils.tests
+import lsst.meas.modelfit
+
+
+def makeColumnMajor(rng, nRows, nCols):
+    """Return a random column-major Pixel array of the given shape."""
+    return rng.randn(nCols, nRows).astype(lsst.meas.modelfit.Pixel).transpose()
+
+
+class ModelMatrixTestCase(lsst.utils.tests.TestCase):
+
+    def setUp(self):
+        self.rng = numpy.random.RandomState(500)
+        self.itemSize = numpy.dtype(lsst.meas.modelfit.Pixel).itemsize
+
+    def testLayout(self):
+        """Test that columns are aligned and the column stride is padded to whole cache lines."""
+        alignment = lsst.meas.modelfit.ModelMatrix.ALIGNMENT
+        for nRows in (1, 15, 16, 17, 1000):
+            matrix = lsst.meas.modelfit.ModelMatrix(nRows, 3)
+            self.assertEqual(matrix.getRows(), nRows)
+            self.assertEqual(matrix.getCols(), 3)
+            self.assertGreaterEqual(matrix.getStride(), nRows)
+            self.assertEqual((matrix.getStride()*self.itemSize) % alignment, 0)
+            self.assertLess(matrix.getStride() - nRows, alignment // self.itemSize)
+            array = matrix.getArray()
+            self.assertEqual(array.shape, (nRows, 3))
+            self.assertEqual(array.strides, (self.itemSize, matrix.getStride()*self.itemSize))
+            self.assertEqual(array.ctypes.data % alignment, 0)
+            # Columns must not overlap.
+            array[:, :] = numpy.arange(3)[numpy.newaxis, :]
+            for k in range(3):
+                self.assertFloatsEqual(array[:, k], k)
+        empty = lsst.meas.modelfit.ModelMatrix()
+        self.assertEqual(empty.getArray().shape, (0, 0))
+
+    def testResize(self):
+        """Test that resizing only reallocates when the new matrix doesn't fit, and that views of
+        the old storage stay valid."""
+        matrix = lsst.meas.modelfit.ModelMatrix(100, 4)
+        old = matrix.getArray()
+        address = old.ctypes.data
+        self.assertFalse(matrix.resize(50, 3))
+        self.assertEqual(matrix.getArray().shape, (50, 3))
+        self.assertEqual(matrix.getArray().ctypes.data, address)
+        self.assertFalse(matrix.resize(200, 2))
+        self.assertEqual(matrix.getArray().ctypes.data, address)
+        self.assertTrue(matrix.resize(200, 4))
+        new = matrix.getArray()
+        self.assertEqual(new.shape, (200, 4))
+        self.assertEqual(new.ctypes.data % lsst.meas.modelfit.ModelMatrix.ALIGNMENT, 0)
+        old[:, :] = 1.0
+        self.assertFloatsEqual(old, 1.0)
+
+    def testMultiply(self):
+        """Test multiplyModelMatrix against numpy, for padded and plain column-major inputs."""
+        for nRows, nCols in ((1, 1), (37, 2), (1001, 7)):
+            expectedInput = makeColumnMajor(self.rng, nRows, nCols)
+            amplitudes = self.rng.randn(nCols)
+            expected = numpy.dot(expectedInput.astype(float), amplitudes)
+            matrix = lsst.meas.modelfit.ModelMatrix(nRows, nCols)
+            matrix.getArray()[:, :] = expectedInput
+            for modelMatrix in (matrix.getArray(), expectedInput):
+                output = numpy.zeros(nRows, dtype=float)
+                lsst.meas.modelfit.multiplyModelMatrix(modelMatrix, amplitudes, output)
+                self.assertFloatsAlmostEqual(output, expected, rtol=1E-12, atol=1E-12)
+
+    def testGram(self):
+        """Test addModelMatrixGram against numpy, on both sides of the switch from column dot
+        products (at most 4 columns) to blocked rank updates, with row counts that aren't a multiple
+        of the block size.  Only the lower triangle may be written, and it must be added to.
+        """
+        for nCols in (1, 2, 4, 5, 8):
+            for nRows in (1, 255, 257, 1000):
+                modelMatrix = makeColumnMajor(self.rng, nRows, nCols)
+                expected = numpy.dot(modelMatrix.transpose().astype(float), modelMatrix.astype(float))
+                matrix = lsst.meas.modelfit.ModelMatrix(nRows, nCols)
+                matrix.getArray()[:, :] = modelMatrix
+                for candidate in (matrix.getArray(), modelMatrix):
+                    hessian = numpy.full((nCols, nCols), 2.0)
+                    lsst.meas.modelfit.addModelMatrixGram(candidate, hessian)
+                    lower = numpy.tril_indices(nCols)
+                    upper = numpy.triu_indices(nCols, 1)
+                    self.assertFloatsAlmostEqual(hessian[lower], expected[lower] + 2.0, rtol=1E-10,
+                                                 atol=1E-10*nRows)
+                    self.assertFloatsEqual(hessian[upper], 2.0)
+
+
+class TestMemory(lsst.utils.tests.MemoryTestCase):
+    pass
+
+
+def setup_module(module):
+    lsst.utils.tests.init()
+
+
+if __name__ == "__main__":
+    lsst.utils.tests.init()
+    unittest.main()
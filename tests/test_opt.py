@@ -33,6 +33,44 @@ lsst.log.utils.traceSetAt("meas.modelfit.optimizer", 5)
 log = lsst.log.Log.getLogger("meas.modelfit.optimizer")
 
 
+class GaussianSumObjective(lsst.meas.modelfit.OptimizerObjective):
+    """A sum of 1-d Gaussians, each with (center, amplitude) parameters and nonzero only on its own range
+    of pixels, optionally reporting that block-sparsity to the Optimizer.
+    """
+
+    def __init__(self, ranges, data, sigma=2.0, useBlocks=True):
+        lsst.meas.modelfit.OptimizerObjective.__init__(self, len(data), 2*len(ranges))
+        self.ranges = ranges
+        self.data = data
+        self.sigma = sigma
+        self.useBlocks = useBlocks
+
+    def computeMember(self, parameters, k):
+        center, amplitude = parameters[2*k:2*k + 2]
+        x = numpy.arange(*self.ranges[k], dtype=float)
+        return amplitude*numpy.exp(-0.5*((x - center)/self.sigma)**2)
+
+    def computeResiduals(self, parameters, residuals):
+        residuals[:] = -self.data
+        for k, (begin, end) in enumerate(self.ranges):
+            residuals[begin:end] += self.computeMember(parameters, k)
+
+    def getResidualBlocks(self):
+        if not self.useBlocks:
+            return []
+        blocks = []
+        for k, (begin, end) in enumerate(self.ranges):
+            block = lsst.meas.modelfit.OptimizerObjective.ResidualBlock()
+            block.parameterBegin = 2*k
+            block.parameterEnd = 2*k + 2
+            block.rows = list(range(begin, end))
+            blocks.append(block)
+        return blocks
+
+    def computeBlockResiduals(self, parameters, block, residuals):
+        residuals[:] = self.computeMember(parameters, block)
+
+
 class OptimizerTestCase(lsst.utils.tests.TestCase):
 
     def setUp(self):
@@ -73,6 +111,34 @@ class OptimizerTestCase(lsst.utils.tests.TestCase):
                 lsst.meas.modelfit.solveTrustRegion(x, f, g, r, tolerance)
                 self.assertLessEqual(numpy.linalg.norm(x), r * (1.0 + tolerance))
 
+    def testBlockDerivatives(self):
+        """Test that block-sparse residual derivatives give the same gradient, Hessian, and fit as dense
+        ones, with blocks that overlap one, two, or no other blocks.
+        """
+        ranges = [(0, 30), (20, 50), (45, 60), (60, 70)]
+        truth = numpy.array([15.0, 3.0, 35.0, 2.0, 52.0, 4.0, 65.0, 1.0])
+        data = numpy.zeros(70, dtype=float)
+        GaussianSumObjective(ranges, data).computeResiduals(truth, data)
+        data += 0.01*numpy.random.randn(data.size)
+        parameters = truth + numpy.array([0.5, -0.3, -0.4, 0.2, 0.3, 0.5, -0.2, 0.1])
+        ctrl = lsst.meas.modelfit.OptimizerControl()
+        ctrl.noSR1Term = True
+        optimizers = []
+        for useBlocks in (True, False):
+            objective = GaussianSumObjective(ranges, data, useBlocks=useBlocks)
+            self.assertEqual(len(objective.getResidualBlocks()), len(ranges) if useBlocks else 0)
+            optimizers.append(lsst.meas.modelfit.Optimizer(objective, parameters, ctrl))
+        sparse, dense = optimizers
+        self.assertFloatsAlmostEqual(sparse.getGradient(), dense.getGradient(), rtol=1E-8, atol=1E-10)
+        self.assertFloatsAlmostEqual(sparse.getHessian(), dense.getHessian(), rtol=1E-8, atol=1E-10)
+        # Blocks that share no rows have no cross terms.
+        self.assertFloatsEqual(sparse.getHessian()[6:8, 0:4], 0.0)
+        for optimizer in optimizers:
+            optimizer.run()
+            self.assertFalse(optimizer.getState() & lsst.meas.modelfit.Optimizer.FAILED)
+        self.assertFloatsAlmostEqual(sparse.getParameters(), dense.getParameters(), rtol=1E-5)
+        self.assertFloatsAlmostEqual(sparse.getParameters(), truth, rtol=1E-2)
+
 
 class TestMemory(lsst.utils.tests.MemoryTestCase):
     pass
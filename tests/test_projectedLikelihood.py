@@ -31,6 +31,7 @@ import lsst.afw.geom.ellipses
 import lsst.afw.image
 import lsst.afw.math
 import lsst.afw.detection
+import lsst.pex.exceptions
 import lsst.meas.modelfit
 
 
@@ -131,6 +132,16 @@ class UnitTransformedLikelihoodTestCase(lsst.utils.tests.TestCase):
         del self.footprint1
         del self.psf1
 
+    def makeMultiModel(self):
+        """Return a two-component MultiModel built from self.model, with fixed, nonlinear and amplitude
+        parameter vectors that give the components different shapes and fluxes.
+        """
+        model = lsst.meas.modelfit.MultiModel([self.model, self.model], ["a", "b"])
+        fixed = numpy.concatenate([self.fixed, self.fixed])
+        nonlinear = numpy.concatenate([self.nonlinear, self.nonlinear + 0.1])
+        amplitudes = numpy.array([self.flux, 0.5*self.flux], dtype=lsst.meas.modelfit.Scalar)
+        return model, fixed, nonlinear, amplitudes
+
     def checkLikelihood(self, likelihood, data):
         self.assertFloatsAlmostEqual(likelihood.getData().reshape(data.shape), data, rtol=1E-6,
                                      **ASSERT_CLOSE_KWDS)
@@ -140,6 +151,26 @@ class UnitTransformedLikelihoodTestCase(lsst.utils.tests.TestCase):
         self.assertFloatsAlmostEqual(model.reshape(data.shape), data, rtol=1E-6, atol=1E-7,
                                      **ASSERT_CLOSE_KWDS)
 
+    def testFlatEllipses(self):
+        """Test that Model.writeFlatEllipses agrees with Model.writeEllipses.
+        """
+        models = [lsst.meas.modelfit.Model.makeGaussian(center)
+                  for center in (lsst.meas.modelfit.Model.FIXED_CENTER,
+                                 lsst.meas.modelfit.Model.SINGLE_CENTER,
+                                 lsst.meas.modelfit.Model.MULTI_CENTER)]
+        models.append(lsst.meas.modelfit.MultiModel(models, ["a", "b", "c"]))
+        for model in models:
+            nonlinear = numpy.random.randn(model.getNonlinearDim()).astype(lsst.meas.modelfit.Scalar)
+            fixed = numpy.random.randn(model.getFixedDim()).astype(lsst.meas.modelfit.Scalar)
+            flat = model.writeFlatEllipses(nonlinear, fixed)
+            ellipses = model.writeEllipses(nonlinear, fixed)
+            self.assertEqual(flat.shape, (model.getBasisCount(), 5))
+            for row, ellipse in zip(flat, ellipses):
+                quadrupole = lsst.afw.geom.ellipses.Quadrupole(ellipse.getCore())
+                self.assertFloatsAlmostEqual(row[:3], quadrupole.getParameterVector(), rtol=1E-12,
+                                             atol=1E-12*numpy.abs(row[:3]).max())
+                self.assertFloatsEqual(row[3:], numpy.array(ellipse.getCenter()))
+
     def testModel(self):
         """Test that when we use a Model to create a MultiShapeletFunction from our parameter vectors
         it agrees with the reimplementation here."""
@@ -221,6 +252,30 @@ class UnitTransformedLikelihoodTestCase(lsst.utils.tests.TestCase):
                                                            efv, ctrl)
         self.checkLikelihood(l0d, data*weights)
 
+    def testSpanArrays(self):
+        """Test that the flattened data, variance and weight arrays match those produced by flattening
+        each plane of the image separately, for a non-rectangular Footprint.
+        """
+        var = numpy.random.rand(self.bbox0.getHeight(), self.bbox0.getWidth()) + 2.0
+        self.exposure0.getMaskedImage().getVariance().getArray()[:, :] = var
+        spanSet = lsst.afw.geom.SpanSet.fromShape(30, lsst.afw.geom.Stencil.CIRCLE,
+                                                  lsst.geom.Point2I(10, -20))
+        footprint = lsst.afw.detection.Footprint(spanSet)
+        xy0 = self.exposure0.getXY0()
+        image = spanSet.flatten(self.exposure0.getMaskedImage().getImage().getArray(), xy0)
+        variance = spanSet.flatten(self.exposure0.getMaskedImage().getVariance().getArray(), xy0)
+        for usePixelWeights in (True, False):
+            ctrl = lsst.meas.modelfit.UnitTransformedLikelihoodControl(usePixelWeights)
+            likelihood = lsst.meas.modelfit.UnitTransformedLikelihood(self.model, self.fixed, self.sys0,
+                                                                      self.position, self.exposure0,
+                                                                      footprint, self.psf0, ctrl)
+            self.assertEqual(likelihood.getDataDim(), footprint.getArea())
+            self.assertFloatsEqual(likelihood.getUnweightedData(), image)
+            self.assertFloatsEqual(likelihood.getVariance(), variance)
+            if usePixelWeights:
+                self.assertFloatsAlmostEqual(likelihood.getWeights(), variance**-0.5, rtol=1E-6)
+            self.assertFloatsAlmostEqual(likelihood.getData(), image*likelihood.getWeights(), rtol=1E-6)
+
     def testProjected(self):
         """Test likelihood evaluation when the fit system is not the same as the data system.
         """
@@ -254,6 +309,177 @@ class UnitTransformedLikelihoodTestCase(lsst.utils.tests.TestCase):
                                                            efv, ctrl)
         self.checkLikelihood(l1d, data*weights)
 
+    def testComputeModelImage(self):
+        """Test that evaluating the model image directly agrees with multiplying the model matrix by the
+        amplitudes.
+        """
+        model, fixed, nonlinear, amplitudes = self.makeMultiModel()
+        ctrl = lsst.meas.modelfit.UnitTransformedLikelihoodControl()
+        likelihood = lsst.meas.modelfit.UnitTransformedLikelihood(model, fixed, self.sys0, self.position,
+                                                                  self.exposure0, self.footprint1, self.psf1,
+                                                                  ctrl)
+        matrix = numpy.zeros((likelihood.getAmplitudeDim(), likelihood.getDataDim()),
+                             dtype=lsst.meas.modelfit.Pixel).transpose()
+        image = numpy.zeros(likelihood.getDataDim(), dtype=lsst.meas.modelfit.Pixel)
+        for doApplyWeights in (True, False):
+            likelihood.computeModelMatrix(matrix, nonlinear, doApplyWeights)
+            likelihood.computeModelImage(image, nonlinear, amplitudes, doApplyWeights)
+            expected = numpy.dot(matrix, amplitudes)
+            self.assertFloatsAlmostEqual(image, expected, rtol=1E-5, atol=1E-5*numpy.abs(expected).max())
+
+    def testFourierModelMatrix(self):
+        """Test that evaluating the model by FFT convolution agrees with evaluating it directly.
+        """
+        model, fixed, nonlinear, amplitudes = self.makeMultiModel()
+        results = []
+        for fftMode in ("NEVER", "ALWAYS"):
+            ctrl = lsst.meas.modelfit.UnitTransformedLikelihoodControl(False)
+            ctrl.fftMode = fftMode
+            likelihood = lsst.meas.modelfit.UnitTransformedLikelihood(model, fixed, self.sys0,
+                                                                      self.position, self.exposure0,
+                                                                      self.footprint0, self.psf1, ctrl)
+            matrix = numpy.zeros((likelihood.getAmplitudeDim(), likelihood.getDataDim()),
+                                 dtype=lsst.meas.modelfit.Pixel).transpose()
+            likelihood.computeModelMatrix(matrix, nonlinear)
+            image = numpy.zeros(likelihood.getDataDim(), dtype=lsst.meas.modelfit.Pixel)
+            likelihood.computeModelImage(image, nonlinear, amplitudes)
+            results.append((matrix, image))
+        self.assertFloatsAlmostEqual(results[1][0], results[0][0], atol=1E-5*numpy.abs(results[0][0]).max(),
+                                     **ASSERT_CLOSE_KWDS)
+        self.assertFloatsAlmostEqual(results[1][1], results[0][1], atol=1E-5*numpy.abs(results[0][1]).max(),
+                                     **ASSERT_CLOSE_KWDS)
+        ctrl = lsst.meas.modelfit.UnitTransformedLikelihoodControl(False)
+        ctrl.fftMode = "SOMETIMES"
+        with self.assertRaises(lsst.pex.exceptions.InvalidParameterError):
+            lsst.meas.modelfit.UnitTransformedLikelihood(model, fixed, self.sys0, self.position,
+                                                         self.exposure0, self.footprint0, self.psf1, ctrl)
+
+    def testParallel(self):
+        """Test that evaluating the model matrix in parallel chunks and the model image in parallel
+        epochs gives the same result as evaluating them on one thread, including when the same
+        likelihood (and hence its worker threads) is reused.
+        """
+        model, fixed, nonlinear, amplitudes = self.makeMultiModel()
+        perturbed = nonlinear.copy()
+        perturbed[1] += 0.05
+        # More epochs than threads, so some threads evaluate several epochs.
+        efv = [lsst.meas.modelfit.EpochFootprint(self.footprint1, self.exposure0, psf)
+               for psf in (self.psf1, self.psf0, self.psf1, self.psf0, self.psf1)]
+        matrices = []
+        images = []
+        for parallelMinPixels in (0, 1):
+            ctrl = lsst.meas.modelfit.UnitTransformedLikelihoodControl(True)
+            ctrl.parallelMinPixels = parallelMinPixels
+            ctrl.parallelChunkSize = 300
+            ctrl.parallelThreads = 3
+            likelihood = lsst.meas.modelfit.UnitTransformedLikelihood(model, fixed, self.sys0,
+                                                                      self.position, efv, ctrl)
+            shape = (likelihood.getAmplitudeDim(), likelihood.getDataDim())
+            full = numpy.zeros(shape, dtype=lsst.meas.modelfit.Pixel).transpose()
+            likelihood.computeModelMatrix(full, nonlinear)
+            updated = full.copy(order="F")
+            likelihood.updateModelMatrix(updated, perturbed, nonlinear)
+            matrices.append((full, updated))
+            image = numpy.zeros(likelihood.getDataDim(), dtype=lsst.meas.modelfit.Pixel)
+            likelihood.computeModelImage(image, nonlinear, amplitudes)
+            images.append(image)
+            for i in range(3):
+                again = numpy.zeros(shape, dtype=lsst.meas.modelfit.Pixel).transpose()
+                likelihood.computeModelMatrix(again, nonlinear)
+                self.assertFloatsEqual(again, full)
+        self.assertFloatsEqual(matrices[1][0], matrices[0][0])
+        self.assertFloatsEqual(matrices[1][1], matrices[0][1])
+        self.assertFloatsEqual(images[1], images[0])
+
+    def testStreaming(self):
+        """Test that normal equations accumulated over groups of epochs loaded on demand agree with those
+        computed from a likelihood holding all epochs.
+        """
+        model, fixed, nonlinear, amplitudes = self.makeMultiModel()
+        parameters = numpy.concatenate([nonlinear, amplitudes])
+        steps = numpy.full(nonlinear.size, 1E-3)
+        # Give the epochs different variances, so the constant weight depends on all of them.
+        exposures = []
+        for variance in (1.0, 2.0, 0.5, 3.0, 1.5):
+            exposure = self.exposure0.clone()
+            exposure.getMaskedImage().getVariance().set(variance)
+            exposures.append(exposure)
+        efv = [lsst.meas.modelfit.EpochFootprint(self.footprint1, exposure, psf)
+               for exposure, psf in zip(exposures, (self.psf1, self.psf0, self.psf1, self.psf0, self.psf1))]
+        loaded = []
+
+        def loader(i):
+            loaded.append(i)
+            return efv[i]
+
+        for usePixelWeights in (True, False):
+            ctrl = lsst.meas.modelfit.UnitTransformedLikelihoodControl(usePixelWeights)
+            full = lsst.meas.modelfit.UnitTransformedLikelihood(model, fixed, self.sys0, self.position, efv,
+                                                                ctrl)
+            del loaded[:]
+            streaming = lsst.meas.modelfit.StreamingLikelihood(model, fixed, self.sys0, self.position,
+                                                               len(efv), loader, 2, ctrl)
+            self.assertEqual(streaming.getGroupCount(), 3)
+            self.assertEqual(streaming.getDataDim(), full.getDataDim())
+            self.assertEqual(loaded, list(range(len(efv))))
+
+            shape = (full.getAmplitudeDim(), full.getDataDim())
+            matrix = numpy.zeros(shape, dtype=lsst.meas.modelfit.Pixel).transpose()
+            full.computeModelMatrix(matrix, nonlinear)
+            matrix = matrix.astype(float)
+            data = full.getData().astype(float)
+            del loaded[:]
+            linear = streaming.computeAmplitudeNormalEquations(nonlinear)
+            self.assertEqual(loaded, list(range(len(efv))))
+            self.assertEqual(linear.dataDim, full.getDataDim())
+            self.assertFloatsAlmostEqual(linear.hessian, numpy.dot(matrix.T, matrix), rtol=1E-5)
+            self.assertFloatsAlmostEqual(linear.gradient, -numpy.dot(matrix.T, data), rtol=1E-5)
+            self.assertFloatsAlmostEqual(linear.chiSq, numpy.dot(data, data), rtol=1E-5)
+
+            residuals = numpy.dot(matrix, amplitudes) - data
+            jacobian = numpy.zeros((full.getDataDim(), parameters.size), dtype=float)
+            for n in range(nonlinear.size):
+                perturbed = nonlinear.copy()
+                perturbed[n] += steps[n]
+                perturbedMatrix = numpy.zeros(shape, dtype=lsst.meas.modelfit.Pixel).transpose()
+                full.computeModelMatrix(perturbedMatrix, perturbed)
+                jacobian[:, n] = numpy.dot(perturbedMatrix.astype(float) - matrix, amplitudes) / steps[n]
+            jacobian[:, nonlinear.size:] = matrix
+            gaussNewton = streaming.computeNormalEquations(parameters, steps)
+            hessian = numpy.dot(jacobian.T, jacobian)
+            self.assertFloatsAlmostEqual(gaussNewton.hessian, hessian, rtol=1E-4,
+                                         atol=1E-6*numpy.abs(hessian).max())
+            gradient = numpy.dot(jacobian.T, residuals)
+            self.assertFloatsAlmostEqual(gaussNewton.gradient, gradient, rtol=1E-4,
+                                         atol=1E-6*numpy.abs(gradient).max())
+            self.assertFloatsAlmostEqual(gaussNewton.chiSq, numpy.dot(residuals, residuals), rtol=1E-5)
+        with self.assertRaises(lsst.pex.exceptions.InvalidParameterError):
+            lsst.meas.modelfit.StreamingLikelihood(model, fixed, self.sys0, self.position, len(efv), loader,
+                                                   0, ctrl)
+
+    def testUpdateModelMatrix(self):
+        """Test that updating the model matrix after changing only one component's parameters
+        gives the same result as recomputing it.
+        """
+        model, fixed, nonlinear, _ = self.makeMultiModel()
+        ctrl = lsst.meas.modelfit.UnitTransformedLikelihoodControl()
+        likelihood = lsst.meas.modelfit.UnitTransformedLikelihood(model, fixed, self.sys0, self.position,
+                                                                  self.exposure0, self.footprint1, self.psf0,
+                                                                  ctrl)
+        shape = (likelihood.getAmplitudeDim(), likelihood.getDataDim())
+        previous = numpy.zeros(shape, dtype=lsst.meas.modelfit.Pixel).transpose()
+        likelihood.computeModelMatrix(previous, nonlinear)
+        for n in range(model.getNonlinearDim()):
+            perturbed = nonlinear.copy()
+            perturbed[n] += 0.05
+            expected = numpy.zeros(shape, dtype=lsst.meas.modelfit.Pixel).transpose()
+            likelihood.computeModelMatrix(expected, perturbed)
+            updated = previous.copy(order="F")
+            likelihood.updateModelMatrix(updated, perturbed, nonlinear)
+            self.assertFloatsEqual(updated, expected)
+            unchanged = 1 if n < self.model.getNonlinearDim() else 0
+            self.assertFloatsEqual(updated[:, unchanged], previous[:, unchanged])
+
 
 class TestMemory(lsst.utils.tests.MemoryTestCase):
     pass
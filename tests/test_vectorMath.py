@@ -0,0 +1,92 @@
+#
+# LSST Data Management System
+#
+# Copyright 2008-2016  AURA/LSST.
+#
+# This product includes software developed by the
+# LSST Project (http://www.lsst.org/).
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the LSST License Statement and
+# the GNU General Public License along with this program.  If not,
+# see <https://www.lsstcorp.org/LegalNotices/>.
+#
+
+import math
+import unittest
+
+import numpy
+
+import lsst.utils.tests
+import lsst.pex.exceptions
+import lsst.meas.modelfit
+
+
+class VectorMathTestCase(lsst.utils.tests.TestCase):
+
+    def setUp(self):
+        self.rng = numpy.random.RandomState(500)
+        self.backend = lsst.meas.modelfit.detail.getVectorMathBackend()
+
+    def tearDown(self):
+        lsst.meas.modelfit.detail.setVectorMathBackend(self.backend)
+
+    def testBackends(self):
+        backends = lsst.meas.modelfit.detail.getVectorMathBackends()
+        self.assertIn("scalar", backends)
+        self.assertIn("libm", backends)
+        self.assertEqual(self.backend, backends[0])
+        with self.assertRaises(lsst.pex.exceptions.InvalidParameterError):
+            lsst.meas.modelfit.detail.setVectorMathBackend("nonexistent")
+
+    def testExp(self):
+        # Use a length that is not a multiple of any vector width, to test the remainder handling.
+        x = numpy.concatenate([self.rng.uniform(-708.0, 709.78, size=1001),
+                               numpy.linspace(-20.0, 20.0, 101)])
+        for backend in lsst.meas.modelfit.detail.getVectorMathBackends():
+            lsst.meas.modelfit.detail.setVectorMathBackend(backend)
+            self.assertFloatsAlmostEqual(lsst.meas.modelfit.detail.vectorExp(x), numpy.exp(x),
+                                         rtol=4.5E-16)
+            special = lsst.meas.modelfit.detail.vectorExp(numpy.array([-800.0, 800.0, numpy.nan, 0.0]))
+            self.assertEqual(special[0], 0.0)
+            self.assertEqual(special[1], numpy.inf)
+            self.assertTrue(numpy.isnan(special[2]))
+            self.assertEqual(special[3], 1.0)
+
+    def testErfc(self):
+        x = self.rng.uniform(-6.0, 26.0, size=1001)
+        expected = numpy.array([math.erfc(v) for v in x])
+        for backend in lsst.meas.modelfit.detail.getVectorMathBackends():
+            lsst.meas.modelfit.detail.setVectorMathBackend(backend)
+            self.assertFloatsAlmostEqual(lsst.meas.modelfit.detail.vectorErfc(x), expected, rtol=1.2E-7)
+
+    def testPolynomial(self):
+        x = self.rng.uniform(-2.0, 2.0, size=1001)
+        coefficients = self.rng.randn(6)
+        expected = numpy.polynomial.polynomial.polyval(x, coefficients)
+        for backend in lsst.meas.modelfit.detail.getVectorMathBackends():
+            lsst.meas.modelfit.detail.setVectorMathBackend(backend)
+            self.assertFloatsAlmostEqual(lsst.meas.modelfit.detail.vectorPolynomial(coefficients, x),
+                                         expected, rtol=1E-12, atol=1E-14)
+
+
+class TestMemory(lsst.utils.tests.MemoryTestCase):
+    pass
+
+
+def setup_module(module):
+    lsst.utils.tests.init()
+
+
+if __name__ == "__main__":
+    lsst.utils.tests.init()
+    unittest.main()